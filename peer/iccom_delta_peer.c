@@ -0,0 +1,356 @@
+/*
+ * Copyright (c) 2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#include <string.h>
+#include "iccom_delta_peer.h"
+
+/*****************************************************************************/
+/* define definition                                                         */
+/*****************************************************************************/
+#define ICCOM_DELTA_PEER_KEY_INTERVAL (64U)	/* keyframe interval default */
+
+/*****************************************************************************/
+/* internal function prototype definition                                    */
+/*****************************************************************************/
+static uint32_t iccom_delta_peer_get16(const uint8_t *buf);
+static uint32_t iccom_delta_peer_get32(const uint8_t *buf);
+static void iccom_delta_peer_put16(uint8_t *buf, uint32_t value);
+static void iccom_delta_peer_put32(uint8_t *buf, uint32_t value);
+static uint32_t iccom_delta_peer_diff(const uint8_t *old_frame,
+	const uint8_t *new_frame, uint32_t size, uint8_t *out,
+	uint32_t *run_count);
+static int32_t iccom_delta_peer_patch(const uint8_t *runs,
+	uint32_t runs_size, uint32_t run_count, uint8_t *frame,
+	uint32_t size);
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_delta_peer_tx_init                                      */
+/*  Function : Initialize sender state of a stream.                          */
+/*  Input    : *tx             : Sender state.                               */
+/*             stream_id       : Stream ID.                                  */
+/*             *last           : Frame area (max_size bytes).                */
+/*             max_size        : Frame maximum size.                         */
+/*             key_interval    : Keyframe interval (0: 64).                  */
+/*  Return   : NON                                                           */
+/*                                                                           */
+/*****************************************************************************/
+void iccom_delta_peer_tx_init(struct iccom_delta_peer_tx_t *tx,
+			uint32_t stream_id, uint8_t *last, uint32_t max_size,
+			uint32_t key_interval)
+{
+	tx->last = last;
+	tx->max_size = max_size;
+	tx->stream_id = stream_id;
+	tx->key_interval = (key_interval == 0U) ?
+		ICCOM_DELTA_PEER_KEY_INTERVAL : key_interval;
+	tx->size = 0U;
+	tx->seq = 0U;
+	tx->diff_cnt = 0U;
+	tx->valid = 0U;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_delta_peer_encode                                       */
+/*  Function : Encode data to a keyframe or a delta frame, and keep it as    */
+/*             the last frame sent.  A keyframe is made for the first frame, */
+/*             a frame of other size, every key_interval frames, after       */
+/*             iccom_delta_peer_tx_reset, or when the delta frame is not     */
+/*             smaller.                                                      */
+/*  Input    : *tx             : Sender state.                               */
+/*             *data           : Data.                                       */
+/*             size            : Data size.                                  */
+/*  Output   : *out            : Coded frame.                                */
+/*  Return   : Coded frame size (0 : size over max_size)                     */
+/*                                                                           */
+/*****************************************************************************/
+uint32_t iccom_delta_peer_encode(struct iccom_delta_peer_tx_t *tx,
+			const uint8_t *data, uint32_t size, uint8_t *out)
+{
+	uint8_t *l_coded = &out[ICCOM_DELTA_PEER_HEADER_SIZE]; /* coded data */
+	uint32_t l_coded_size = size;		/* coded data size           */
+	uint32_t l_run_count = 0U;		/* changed range count       */
+	uint32_t l_type = ICCOM_DELTA_PEER_KEY;	/* frame type                */
+
+	if (size > tx->max_size) {
+		return 0U;
+	}
+
+	if ((tx->valid != 0U) && (tx->size == size) &&
+	    ((tx->diff_cnt + 1U) < tx->key_interval)) {
+		l_coded_size = iccom_delta_peer_diff(tx->last, data, size,
+				l_coded, &l_run_count);
+	}
+
+	if (l_coded_size < size) {
+		l_type = ICCOM_DELTA_PEER_DIFF;
+		(void)memcpy(tx->last, data, size);
+		tx->diff_cnt++;
+	} else {
+		(void)memcpy(l_coded, data, size);
+		(void)memcpy(tx->last, data, size);
+		l_coded_size = size;
+		l_run_count = 0U;
+		tx->diff_cnt = 0U;
+	}
+	tx->seq++;
+	tx->size = size;
+	tx->valid = 1U;
+
+	iccom_delta_peer_put32(&out[0], tx->stream_id);
+	iccom_delta_peer_put32(&out[4], tx->seq);
+	iccom_delta_peer_put16(&out[8], l_type);
+	iccom_delta_peer_put16(&out[10], l_run_count);
+	iccom_delta_peer_put32(&out[12], size);
+	return ICCOM_DELTA_PEER_HEADER_SIZE + l_coded_size;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_delta_peer_tx_reset                                     */
+/*  Function : Make the next frame of the stream a keyframe. Call it when    */
+/*             the frame was not sent, as Linux side may not have it.        */
+/*  Input    : *tx             : Sender state.                               */
+/*  Return   : NON                                                           */
+/*                                                                           */
+/*****************************************************************************/
+void iccom_delta_peer_tx_reset(struct iccom_delta_peer_tx_t *tx)
+{
+	tx->valid = 0U;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_delta_peer_rx_init                                      */
+/*  Function : Initialize receiver state of a stream.                        */
+/*  Input    : *rx             : Receiver state.                             */
+/*             *ref            : Frame area (max_size bytes).                */
+/*             max_size        : Frame maximum size.                         */
+/*  Return   : NON                                                           */
+/*                                                                           */
+/*****************************************************************************/
+void iccom_delta_peer_rx_init(struct iccom_delta_peer_rx_t *rx,
+			uint8_t *ref, uint32_t max_size)
+{
+	rx->ref = ref;
+	rx->max_size = max_size;
+	rx->stream_id = 0U;
+	rx->size = 0U;
+	rx->seq = 0U;
+	rx->valid = 0U;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_delta_peer_stream                                       */
+/*  Function : Get stream ID of a coded frame.                               */
+/*  Input    : *in             : Coded frame.                                */
+/*             in_size         : Coded frame size.                           */
+/*  Output   : *stream_id      : Stream ID.                                  */
+/*  Return   : ICCOM_DELTA_PEER_OK, ICCOM_DELTA_PEER_ERR_FORMAT              */
+/*                                                                           */
+/*****************************************************************************/
+int32_t iccom_delta_peer_stream(const uint8_t *in, uint32_t in_size,
+			uint32_t *stream_id)
+{
+	if (in_size < ICCOM_DELTA_PEER_HEADER_SIZE) {
+		return ICCOM_DELTA_PEER_ERR_FORMAT;
+	}
+	*stream_id = iccom_delta_peer_get32(&in[0]);
+	return ICCOM_DELTA_PEER_OK;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_delta_peer_decode                                       */
+/*  Function : Reconstruct the data of a keyframe or a delta frame.          */
+/*             A keyframe of other stream ID restarts the receiver state.    */
+/*  Input    : *rx             : Receiver state.                             */
+/*             *in             : Coded frame.                                */
+/*             in_size         : Coded frame size.                           */
+/*  Output   : **data          : Data (reference frame of rx).               */
+/*             *size           : Data size.                                  */
+/*  Return   : ICCOM_DELTA_PEER_OK, ICCOM_DELTA_PEER_ERR_FORMAT,             */
+/*             ICCOM_DELTA_PEER_ERR_REF                                      */
+/*                                                                           */
+/*****************************************************************************/
+int32_t iccom_delta_peer_decode(struct iccom_delta_peer_rx_t *rx,
+			const uint8_t *in, uint32_t in_size,
+			const uint8_t **data, uint32_t *size)
+{
+	uint32_t l_stream_id;			/* stream ID                 */
+	uint32_t l_seq;				/* sequence number           */
+	uint32_t l_type;			/* frame type                */
+	uint32_t l_run_count;			/* changed range count       */
+	uint32_t l_size;			/* data size                 */
+
+	if (in_size < ICCOM_DELTA_PEER_HEADER_SIZE) {
+		return ICCOM_DELTA_PEER_ERR_FORMAT;
+	}
+	l_stream_id = iccom_delta_peer_get32(&in[0]);
+	l_seq = iccom_delta_peer_get32(&in[4]);
+	l_type = iccom_delta_peer_get16(&in[8]);
+	l_run_count = iccom_delta_peer_get16(&in[10]);
+	l_size = iccom_delta_peer_get32(&in[12]);
+	if (l_size > rx->max_size) {
+		return ICCOM_DELTA_PEER_ERR_FORMAT;
+	}
+
+	if (l_type == ICCOM_DELTA_PEER_KEY) {
+		if ((l_run_count != 0U) ||
+		    (in_size != (ICCOM_DELTA_PEER_HEADER_SIZE + l_size))) {
+			return ICCOM_DELTA_PEER_ERR_FORMAT;
+		}
+		(void)memcpy(rx->ref, &in[ICCOM_DELTA_PEER_HEADER_SIZE],
+			l_size);
+		rx->stream_id = l_stream_id;
+	} else if (l_type == ICCOM_DELTA_PEER_DIFF) {
+		if ((rx->valid == 0U) || (rx->stream_id != l_stream_id) ||
+		    (rx->size != l_size) || (rx->seq != (l_seq - 1U))) {
+			rx->valid = 0U;
+			return ICCOM_DELTA_PEER_ERR_REF;
+		}
+		if (iccom_delta_peer_patch(&in[ICCOM_DELTA_PEER_HEADER_SIZE],
+			in_size - ICCOM_DELTA_PEER_HEADER_SIZE, l_run_count,
+			rx->ref, l_size) != ICCOM_DELTA_PEER_OK) {
+			rx->valid = 0U;
+			return ICCOM_DELTA_PEER_ERR_FORMAT;
+		}
+	} else {
+		return ICCOM_DELTA_PEER_ERR_FORMAT;
+	}
+
+	rx->size = l_size;
+	rx->seq = l_seq;
+	rx->valid = 1U;
+	*data = rx->ref;
+	*size = l_size;
+	return ICCOM_DELTA_PEER_OK;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_delta_peer_diff                                         */
+/*  Function : Encode the byte ranges of new frame changed from old frame.   */
+/*             Ranges separated by ICCOM_DELTA_PEER_RUN_SIZE unchanged bytes */
+/*             or less are merged (same ranges as Linux side).               */
+/*  Input    : *old_frame      : Last frame sent.                            */
+/*             *new_frame      : Frame to send.                              */
+/*             size            : Frame size.                                 */
+/*  Output   : *out            : Changed byte ranges.                        */
+/*             *run_count      : Range count.                                */
+/*  Return   : Encoded size (size : not smaller than the frame)              */
+/*                                                                           */
+/*****************************************************************************/
+static uint32_t iccom_delta_peer_diff(const uint8_t *old_frame,
+			const uint8_t *new_frame, uint32_t size, uint8_t *out,
+			uint32_t *run_count)
+{
+	uint32_t l_out_size = 0U;		/* encoded size              */
+	uint32_t l_pos = 0U;			/* range start               */
+	uint32_t l_end;				/* range end                 */
+	uint32_t l_gap;				/* unchanged byte count      */
+	uint32_t l_len;				/* range length              */
+
+	*run_count = 0U;
+	while (l_pos < size) {
+		if (old_frame[l_pos] == new_frame[l_pos]) {
+			l_pos++;
+			continue;
+		}
+		/* extend range over short unchanged gaps */
+		l_end = l_pos + 1U;
+		l_gap = 0U;
+		while (((l_end + l_gap) < size) &&
+		       (l_gap <= ICCOM_DELTA_PEER_RUN_SIZE)) {
+			if (old_frame[l_end + l_gap] !=
+			    new_frame[l_end + l_gap]) {
+				l_end += l_gap + 1U;
+				l_gap = 0U;
+			} else {
+				l_gap++;
+			}
+		}
+		l_len = l_end - l_pos;
+		if ((l_out_size + ICCOM_DELTA_PEER_RUN_SIZE + l_len) >= size) {
+			return size;
+		}
+		iccom_delta_peer_put16(&out[l_out_size], l_pos);
+		iccom_delta_peer_put16(&out[l_out_size + 2U], l_len);
+		(void)memcpy(&out[l_out_size + ICCOM_DELTA_PEER_RUN_SIZE],
+			&new_frame[l_pos], l_len);
+		l_out_size += ICCOM_DELTA_PEER_RUN_SIZE + l_len;
+		(*run_count)++;
+		l_pos = l_end;
+	}
+	return l_out_size;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_delta_peer_patch                                        */
+/*  Function : Apply changed byte ranges to frame.                           */
+/*  Input    : *runs           : Changed byte ranges.                        */
+/*             runs_size       : Changed byte ranges size.                   */
+/*             run_count       : Range count.                                */
+/*             *frame          : Frame.                                      */
+/*             size            : Frame size.                                 */
+/*  Return   : ICCOM_DELTA_PEER_OK, ICCOM_DELTA_PEER_ERR_FORMAT              */
+/*                                                                           */
+/*****************************************************************************/
+static int32_t iccom_delta_peer_patch(const uint8_t *runs,
+			uint32_t runs_size, uint32_t run_count, uint8_t *frame,
+			uint32_t size)
+{
+	uint32_t l_pos = 0U;			/* read position of ranges   */
+	uint32_t l_offset;			/* range offset              */
+	uint32_t l_len;				/* range length              */
+
+	while (run_count > 0U) {
+		if ((runs_size - l_pos) < ICCOM_DELTA_PEER_RUN_SIZE) {
+			return ICCOM_DELTA_PEER_ERR_FORMAT;
+		}
+		l_offset = iccom_delta_peer_get16(&runs[l_pos]);
+		l_len = iccom_delta_peer_get16(&runs[l_pos + 2U]);
+		l_pos += ICCOM_DELTA_PEER_RUN_SIZE;
+		if ((l_offset > size) || (l_len > (size - l_offset)) ||
+		    (l_len > (runs_size - l_pos))) {
+			return ICCOM_DELTA_PEER_ERR_FORMAT;
+		}
+		(void)memcpy(&frame[l_offset], &runs[l_pos], l_len);
+		l_pos += l_len;
+		run_count--;
+	}
+	return (l_pos == runs_size) ?
+		ICCOM_DELTA_PEER_OK : ICCOM_DELTA_PEER_ERR_FORMAT;
+}
+
+/* little endian access functions */
+static uint32_t iccom_delta_peer_get16(const uint8_t *buf)
+{
+	return (uint32_t)buf[0] | ((uint32_t)buf[1] << 8);
+}
+
+static uint32_t iccom_delta_peer_get32(const uint8_t *buf)
+{
+	return (uint32_t)buf[0] | ((uint32_t)buf[1] << 8) |
+		((uint32_t)buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+static void iccom_delta_peer_put16(uint8_t *buf, uint32_t value)
+{
+	buf[0] = (uint8_t)value;
+	buf[1] = (uint8_t)(value >> 8);
+}
+
+static void iccom_delta_peer_put32(uint8_t *buf, uint32_t value)
+{
+	buf[0] = (uint8_t)value;
+	buf[1] = (uint8_t)(value >> 8);
+	buf[2] = (uint8_t)(value >> 16);
+	buf[3] = (uint8_t)(value >> 24);
+}
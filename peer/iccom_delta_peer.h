@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/*
+ * Reference implementation of the ICCOM delta encoding (ICCOM_INIT_DELTA)
+ * for the CR7 side.  Plain C99 without heap or OS dependency: the caller
+ * gives the frame area of every stream.
+ *
+ * Frame data of a delta encoded channel (after the send stamp header,
+ * before the CRC32C trailer, all little endian):
+ *   +0  stream ID      (32 bits)
+ *   +4  sequence number of the stream (32 bits, keyframe of a new stream: 1)
+ *   +8  type           (16 bits, 0: keyframe, 1: delta frame)
+ *   +10 range count    (16 bits, 0 for keyframe)
+ *   +12 data size      (32 bits)
+ *   +16 keyframe   : data
+ *       delta frame: ranges of offset (16 bits), length (16 bits) and the
+ *                    bytes changed from the frame of sequence number - 1
+ */
+
+#ifndef ICCOM_DELTA_PEER_H
+#define ICCOM_DELTA_PEER_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* delta header size, range header size */
+#define ICCOM_DELTA_PEER_HEADER_SIZE	16U
+#define ICCOM_DELTA_PEER_RUN_SIZE	4U
+
+/* header type */
+#define ICCOM_DELTA_PEER_KEY		0U
+#define ICCOM_DELTA_PEER_DIFF		1U
+
+/* iccom_delta_peer_decode return codes */
+#define ICCOM_DELTA_PEER_OK		0	/* data reconstructed       */
+#define ICCOM_DELTA_PEER_ERR_FORMAT	(-1)	/* malformed frame          */
+#define ICCOM_DELTA_PEER_ERR_REF	(-2)	/* no reference frame       */
+						/* (wait for keyframe)      */
+
+/* sender state of one stream */
+struct iccom_delta_peer_tx_t {
+	uint8_t *last;				/* last frame sent          */
+	uint32_t max_size;			/* frame area size          */
+	uint32_t stream_id;			/* stream ID                */
+	uint32_t key_interval;			/* keyframe interval        */
+	uint32_t size;				/* last frame size          */
+	uint32_t seq;				/* last sequence number     */
+	uint32_t diff_cnt;			/* delta frames after key   */
+	uint32_t valid;				/* last frame valid         */
+};
+
+/* receiver state of one stream */
+struct iccom_delta_peer_rx_t {
+	uint8_t *ref;				/* reference frame          */
+	uint32_t max_size;			/* frame area size          */
+	uint32_t stream_id;			/* stream ID                */
+	uint32_t size;				/* reference frame size     */
+	uint32_t seq;				/* reference sequence number*/
+	uint32_t valid;				/* reference frame valid    */
+};
+
+/* sender initialization (key_interval 0: 64) */
+void iccom_delta_peer_tx_init(struct iccom_delta_peer_tx_t *tx,
+	uint32_t stream_id, uint8_t *last, uint32_t max_size,
+	uint32_t key_interval);
+
+/* encode function (out : size + ICCOM_DELTA_PEER_HEADER_SIZE bytes) */
+/* return : coded size (0 : size over max_size)                      */
+uint32_t iccom_delta_peer_encode(struct iccom_delta_peer_tx_t *tx,
+	const uint8_t *data, uint32_t size, uint8_t *out);
+
+/* send error notification function (next frame is keyframe) */
+void iccom_delta_peer_tx_reset(struct iccom_delta_peer_tx_t *tx);
+
+/* receiver initialization */
+void iccom_delta_peer_rx_init(struct iccom_delta_peer_rx_t *rx,
+	uint8_t *ref, uint32_t max_size);
+
+/* stream ID get function (to select the receiver state) */
+int32_t iccom_delta_peer_stream(const uint8_t *in, uint32_t in_size,
+	uint32_t *stream_id);
+
+/* decode function (*data : reference frame of the receiver state) */
+int32_t iccom_delta_peer_decode(struct iccom_delta_peer_rx_t *rx,
+	const uint8_t *in, uint32_t in_size, const uint8_t **data,
+	uint32_t *size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ICCOM_DELTA_PEER_H */
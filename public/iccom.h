@@ -10,6 +10,10 @@
 #ifndef __KERNEL__
 #include <stdint.h>
 #endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 /*****************************************************************************/
 /*  macro definition                                                         */
 /*****************************************************************************/
@@ -35,6 +39,49 @@ typedef void (*Iccom_recv_callback_t) (
 	uint32_t recv_size,			/* receive byte count       */
 	uint8_t *recv_buf );			/* data receive buffer      */
 
+/* callback function parameter with user data (Iccom_lib_InitEx) */
+typedef void (*Iccom_recv_callback_ex_t) (
+	void *user_data,			/* user data of InitEx      */
+	enum Iccom_channel_number channel_no,	/* channel number           */
+	uint32_t recv_size,			/* receive byte count       */
+	uint8_t *recv_buf );			/* data receive buffer      */
+
+/* receive information */
+typedef struct {
+	uint64_t recv_time;	/* read completion time (CLOCK_MONOTONIC, ns) */
+	uint64_t recv_seq;	/* receive sequence number of channel        */
+	uint64_t send_time;	/* send time stamped by sender (ns)          */
+	uint32_t send_seq;	/* send sequence number stamped by sender    */
+	uint32_t flags;		/* ICCOM_RECV_INFO_xxx                       */
+} Iccom_recv_info;
+
+/* callback function parameter with receive information (Iccom_lib_InitEx) */
+typedef void (*Iccom_recv_info_callback_t) (
+	void *user_data,			/* user data of InitEx      */
+	enum Iccom_channel_number channel_no,	/* channel number           */
+	uint32_t recv_size,			/* receive byte count       */
+	uint8_t *recv_buf,			/* data receive buffer      */
+	const Iccom_recv_info *recv_info );	/* receive information      */
+
+/* message handler function parameter (Iccom_lib_DispatchRegister) */
+typedef void (*Iccom_msg_handler_t) (
+	void *user_data,			/* user data of handler     */
+	enum Iccom_channel_number channel_no,	/* channel number           */
+	uint32_t msg_id,			/* message ID               */
+	uint32_t recv_size,			/* receive byte count       */
+	uint8_t *recv_buf,			/* data receive buffer      */
+	const Iccom_recv_info *recv_info );	/* receive information      */
+
+/* receive error callback function parameter (Iccom_lib_InitEx) */
+typedef void (*Iccom_error_callback_t) (
+	void *user_data,			/* user data of InitEx      */
+	enum Iccom_channel_number channel_no,	/* channel number           */
+	int32_t error,				/* ICCOM_ERR_CRC,           */
+						/* ICCOM_ERR_DELTA or       */
+						/* ICCOM_ERR_SIZE           */
+	uint32_t recv_size,			/* receive byte count       */
+	uint8_t *recv_buf );			/* received frame           */
+
 /* channel handle */
 typedef void* Iccom_channel_t;
 
@@ -45,6 +92,361 @@ typedef struct {
 	Iccom_recv_callback_t recv_cb;		/* callback function        */
 } Iccom_init_param;
 
+/* context handle */
+typedef void* Iccom_ctx_t;
+
+/* Iccom_lib_CtxCreate parameter */
+typedef struct {
+	const char *dev_path;			/* device file path template*/
+						/* ("%u": channel number,   */
+						/*  NULL: "/dev/iccom%u")   */
+	uint32_t channel_max;			/* channel count            */
+						/* (0: ICCOM_CHANNEL_MAX)   */
+} Iccom_ctx_param;
+
+/* Iccom_lib_InitEx parameter                                 */
+/* (members which are not used must be zero cleared)          */
+typedef struct {
+	enum Iccom_channel_number channel_no;	/* channel number           */
+	uint8_t *recv_buf;			/* data receive buffer      */
+	Iccom_recv_callback_ex_t recv_cb;	/* callback function        */
+	void *user_data;			/* callback user data       */
+	Iccom_recv_info_callback_t recv_info_cb; /* callback function     */
+						/* (with receive info.)     */
+	uint32_t flags;				/* ICCOM_INIT_xxx           */
+	Iccom_error_callback_t error_cb;	/* receive error callback   */
+						/* (frame is not delivered) */
+	uint32_t frame_max;			/* frame maximum size       */
+						/* requested to the driver  */
+						/* (0: ICCOM_BUF_MAX_SIZE,  */
+						/*  recv_buf of this size)  */
+} Iccom_init_param_ex;
+
+/* send stamp header (ICCOM_INIT_STAMP)                       */
+/* Precedes the data of every frame of the channel.           */
+typedef struct {
+	uint32_t seq;				/* send sequence number     */
+	uint32_t reserved;			/* reserved (0)             */
+	uint64_t time;				/* send time                */
+						/* (CLOCK_MONOTONIC, ns)    */
+} Iccom_stamp_header;
+
+/* delta header (ICCOM_INIT_DELTA)                            */
+/* Follows the send stamp header of every frame of the        */
+/* channel.  A keyframe (ICCOM_DELTA_KEY) is followed by the  */
+/* data; a delta frame (ICCOM_DELTA_DIFF) by run_count ranges */
+/* of 16-bit offset and length (little endian) and the bytes  */
+/* of the range, changed from the previous frame (seq - 1) of */
+/* the stream.                                                */
+typedef struct {
+	uint32_t stream_id;			/* stream ID                */
+	uint32_t seq;				/* stream sequence number   */
+	uint16_t type;				/* ICCOM_DELTA_xxx          */
+	uint16_t run_count;			/* changed range count      */
+	uint32_t size;				/* data size                */
+} Iccom_delta_header;
+
+/* Iccom_lib_DispatchConfig parameter */
+typedef struct {
+	uint32_t id_offset;			/* message ID byte offset   */
+	uint32_t id_width;			/* message ID byte width    */
+						/* (1, 2 or 4)              */
+	uint32_t id_order;			/* ICCOM_ID_xxx_ENDIAN      */
+	uint32_t id_max_count;			/* registered ID max count  */
+	Iccom_msg_handler_t default_handler;	/* handler of unknown ID    */
+						/* (NULL: callback function)*/
+	void *default_user_data;		/* user data of default     */
+} Iccom_dispatch_param;
+
+/* Iccom_lib_DispatchGetStats statistics */
+typedef struct {
+	uint32_t msg_id;			/* message ID               */
+	uint32_t flags;				/* ICCOM_DISPATCH_STATS_xxx */
+	uint64_t count;				/* handler call count       */
+	uint64_t total_time;			/* handler total time (ns)  */
+	uint64_t max_time;			/* handler maximum time (ns)*/
+} Iccom_dispatch_stats;
+
+/* Iccom_lib_GetIntegrityStats statistics */
+typedef struct {
+	uint64_t check_count;			/* CRC32C checked frames    */
+	uint64_t crc_error_count;		/* CRC32C mismatch frames   */
+	uint64_t short_count;			/* frames shorter than      */
+						/* stamp header and trailer */
+} Iccom_integrity_stats;
+
+/* Iccom_lib_DeltaConfig parameter                           */
+/* (members which are not used must be zero cleared)          */
+typedef struct {
+	uint32_t key_interval;			/* keyframe interval        */
+						/* (frames, 0: 64)          */
+	uint32_t stream_max;			/* stream max count (0: 1)  */
+	uint32_t id_offset;			/* stream ID byte offset    */
+	uint32_t id_width;			/* stream ID byte width     */
+						/* (0: one stream, 1, 2, 4) */
+	uint32_t id_order;			/* ICCOM_ID_xxx_ENDIAN      */
+} Iccom_delta_param;
+
+/* Iccom_lib_GetDeltaStats statistics */
+typedef struct {
+	uint64_t key_count;			/* sent keyframes           */
+	uint64_t diff_count;			/* sent delta frames        */
+	uint64_t data_bytes;			/* sent data bytes          */
+	uint64_t coded_bytes;			/* sent bytes after encoding*/
+						/* (with delta header)      */
+	uint64_t recv_key_count;		/* received keyframes       */
+	uint64_t recv_diff_count;		/* received delta frames    */
+	uint64_t desync_count;			/* ICCOM_ERR_DELTA count    */
+	uint64_t format_error_count;		/* malformed frame count    */
+	uint64_t stream_over_count;		/* frames of streams over   */
+						/* stream_max               */
+} Iccom_delta_stats;
+
+/* Iccom_lib_SetShaper parameter                             */
+/* (rate 0: the bucket is not used)                           */
+typedef struct {
+	uint32_t byte_rate;			/* byte rate (bytes/s)      */
+	uint32_t byte_burst;			/* byte bucket size (bytes) */
+	uint32_t msg_rate;			/* message rate (msgs/s)    */
+	uint32_t msg_burst;			/* message bucket size      */
+	uint32_t mode;				/* ICCOM_SHAPER_xxx         */
+} Iccom_shaper_param;
+
+/* Iccom_lib_GetShaperStats statistics */
+typedef struct {
+	uint64_t pass_count;			/* sent without delay       */
+	uint64_t delay_count;			/* sent after delay         */
+	uint64_t delay_total;			/* total delay time (ns)    */
+	uint64_t delay_max;			/* maximum delay time (ns)  */
+	uint64_t reject_count;			/* ICCOM_ERR_RATE count     */
+	uint64_t drop_count;			/* dropped message count    */
+	uint64_t drop_bytes;			/* dropped byte count       */
+} Iccom_shaper_stats;
+
+/* Iccom_lib_SpillConfig parameter                           */
+/* (members which are not used must be zero cleared)          */
+typedef struct {
+	const char *path;			/* segment file path        */
+	uint32_t file_size;			/* segment file size (bytes)*/
+	uint32_t byte_rate;			/* drain byte rate (bytes/s)*/
+						/* (0: not limited)         */
+	uint32_t msg_rate;			/* drain message rate       */
+						/* (msgs/s, 0: not limited) */
+	uint32_t retry_time;			/* drain retry interval (ms)*/
+						/* (0: 100ms)               */
+} Iccom_spill_param;
+
+/* Iccom_lib_GetSpillStats statistics */
+typedef struct {
+	uint64_t depth_count;			/* queued message count     */
+	uint64_t depth_bytes;			/* queued data bytes        */
+	uint64_t used_size;			/* used segment area (bytes)*/
+	uint64_t capacity;			/* segment area size (bytes)*/
+	uint64_t spill_count;			/* queued message total     */
+	uint64_t drain_count;			/* sent message total       */
+	uint64_t drain_bytes;			/* sent data bytes total    */
+	uint64_t drain_time;			/* sending time total (ns)  */
+	uint64_t drop_count;			/* dropped message total    */
+	uint64_t drop_bytes;			/* dropped data bytes total */
+	uint64_t retry_count;			/* send error (retry) count */
+} Iccom_spill_stats;
+
+/* Iccom_lib_ConflateConfig parameter                        */
+/* (members which are not used must be zero cleared)          */
+typedef struct {
+	uint32_t topic_max;			/* topic max count (0: 1)   */
+	uint32_t id_offset;			/* topic ID byte offset     */
+	uint32_t id_width;			/* topic ID byte width      */
+						/* (0: one topic, 1, 2, 4)  */
+	uint32_t id_order;			/* ICCOM_ID_xxx_ENDIAN      */
+	uint32_t retry_time;			/* send retry interval (ms) */
+						/* (0: 100ms)               */
+} Iccom_conflate_param;
+
+/* Iccom_lib_GetConflateStats statistics */
+typedef struct {
+	uint64_t topic_count;			/* topics in use            */
+	uint64_t depth_count;			/* topics waiting to be sent*/
+	uint64_t put_count;			/* data put by Iccom_lib_Send*/
+	uint64_t conflate_count;		/* data replaced before sent*/
+	uint64_t send_count;			/* data sent                */
+	uint64_t retry_count;			/* send error (retry) count */
+	uint64_t drop_count;			/* data not sendable        */
+	uint64_t overflow_count;		/* topics over topic_max    */
+	uint64_t latency_total;			/* put to sent time total   */
+						/* (ns, newest data)        */
+	uint64_t latency_max;			/* put to sent time maximum */
+} Iccom_conflate_stats;
+
+/* frame descriptor of batch callback function */
+typedef struct {
+	uint8_t *recv_buf;			/* received data            */
+						/* (valid during the call)  */
+	uint32_t recv_size;			/* receive byte count       */
+	uint32_t reserved;			/* reserved (0)             */
+	Iccom_recv_info recv_info;		/* receive information      */
+} Iccom_recv_frame;
+
+/* batch callback function (Iccom_lib_BatchConfig)           */
+/* (called by the deliver thread, also in Iccom_lib_Final;   */
+/*  channel functions then return ICCOM_ERR_PARAM)            */
+typedef void (*Iccom_recv_batch_callback_t) (
+	void *user_data,			/* user data of parameter   */
+	enum Iccom_channel_number channel_no,	/* channel number           */
+	const Iccom_recv_frame *frames,		/* received frames (oldest  */
+						/* first)                   */
+	uint32_t count );			/* frame count              */
+
+/* Iccom_lib_BatchConfig parameter                           */
+/* (members which are not used must be zero cleared)          */
+typedef struct {
+	Iccom_recv_batch_callback_t batch_cb;	/* batch callback function  */
+	void *user_data;			/* user data of batch_cb    */
+	uint32_t batch_max;			/* frames per call maximum  */
+						/* (0: 16)                  */
+	uint32_t batch_time;			/* time budget (us) : wait  */
+						/* for more frames after the*/
+						/* first one received       */
+						/* (0: frames received only)*/
+} Iccom_batch_param;
+
+/* Iccom_lib_GetBatchStats statistics */
+typedef struct {
+	uint64_t call_count;			/* batch callback calls     */
+	uint64_t frame_count;			/* frames delivered         */
+	uint64_t full_count;			/* calls with batch_max     */
+						/* frames                   */
+	uint64_t max_count;			/* frames of largest call   */
+	uint64_t wait_count;			/* receive waits for free   */
+						/* frame slot               */
+	uint64_t depth_count;			/* frames waiting for call  */
+} Iccom_batch_stats;
+
+/* link health probe frame (Iccom_lib_HealthConfig)          */
+/* (CR7 side sends the probe frames received back unchanged  */
+/*  on the channel; members little endian)                    */
+typedef struct {
+	uint32_t magic;				/* ICCOM_HEALTH_MAGIC       */
+	uint32_t seq;				/* probe sequence number    */
+	uint64_t send_time;			/* probe send time (ns)     */
+} Iccom_health_probe;
+
+/* link health state change information */
+typedef struct {
+	uint32_t state;				/* ICCOM_HEALTH_OK/DEGRADED */
+	uint32_t reason;			/* ICCOM_HEALTH_REASON_xxx  */
+						/* (DEGRADED)               */
+	uint64_t rtt_ewma;			/* round trip time average  */
+						/* (ns)                     */
+	uint64_t ack_ewma;			/* ack latency average (ns) */
+	int32_t send_error;			/* last probe send error    */
+	uint32_t reserved;			/* reserved (0)             */
+} Iccom_health_event;
+
+/* link health state change callback function               */
+/* (called by the probe thread, also in Iccom_lib_Final;     */
+/*  channel functions then return ICCOM_ERR_PARAM)            */
+typedef void (*Iccom_health_callback_t) (
+	void *user_data,			/* user data of parameter   */
+	enum Iccom_channel_number channel_no,	/* channel number           */
+	const Iccom_health_event *event );	/* state change information */
+
+/* Iccom_lib_HealthConfig parameter                          */
+/* (members which are not used must be zero cleared)          */
+typedef struct {
+	Iccom_health_callback_t health_cb;	/* state change callback    */
+						/* (NULL: not called)       */
+	void *user_data;			/* user data of health_cb   */
+	uint32_t interval;			/* probe interval (ms)      */
+						/* (0: 100ms)               */
+	uint32_t timeout;			/* probe echo timeout (ms)  */
+						/* (0: 1000ms)              */
+	uint32_t rtt_threshold;			/* round trip time average  */
+						/* threshold (us, 0: none)  */
+	uint32_t ack_threshold;			/* ack latency average      */
+						/* threshold (us, 0: none)  */
+} Iccom_health_param;
+
+/* Iccom_lib_GetHealthStats statistics                       */
+/* (times in ns; percentiles of the last ICCOM_HEALTH_WINDOW */
+/*  probes)                                                   */
+typedef struct {
+	uint32_t state;				/* ICCOM_HEALTH_OK/DEGRADED */
+	uint32_t reason;			/* ICCOM_HEALTH_REASON_xxx  */
+	uint64_t probe_count;			/* probes sent              */
+	uint64_t echo_count;			/* probe echoes received    */
+	uint64_t lost_count;			/* probes without echo      */
+						/* within timeout           */
+	uint64_t send_error_count;		/* probe send errors        */
+	uint64_t rtt_last;			/* round trip time : last   */
+	uint64_t rtt_ewma;			/*  average (EWMA, 1/8)     */
+	uint64_t rtt_min;			/*  minimum                 */
+	uint64_t rtt_max;			/*  maximum                 */
+	uint64_t rtt_p50;			/*  50 percentile           */
+	uint64_t rtt_p90;			/*  90 percentile           */
+	uint64_t rtt_p99;			/*  99 percentile           */
+	uint64_t ack_last;			/* ack latency : last       */
+	uint64_t ack_ewma;			/*  average (EWMA, 1/8)     */
+	uint64_t ack_max;			/*  maximum                 */
+	uint64_t ack_p50;			/*  50 percentile           */
+	uint64_t ack_p90;			/*  90 percentile           */
+	uint64_t ack_p99;			/*  99 percentile           */
+} Iccom_health_stats;
+
+/* metrics page (Iccom_lib_MetricsStart, or environment variable      */
+/* ICCOM_METRICS=<interval ms> at the first channel initialization)    */
+#define ICCOM_METRICS_SHM_PREFIX "/iccom-metrics."	/* + process ID */
+#define ICCOM_METRICS_MAGIC	(0x544D4349U)	/* "ICMT"                   */
+#define ICCOM_METRICS_VERSION	(1U)
+#define ICCOM_METRICS_SLOT_MAX	256U	/* channels in the page             */
+#define ICCOM_METRICS_NAME_LEN	32U	/* device / process name length     */
+#define ICCOM_METRICS_ERROR_MAX	16U	/* error code count                 */
+#define ICCOM_METRICS_HIST_SIZE	32U	/* latency histogram buckets        */
+#define ICCOM_METRICS_INTERVAL_MAX 60000U /* update interval maximum (ms) */
+
+/* metrics of one channel in the metrics page (Iccom_lib_MetricsStart)    */
+/* (seq is odd while the slot is being updated : a reader copies the     */
+/*  slot and retries when seq was odd or changed during the copy)         */
+typedef struct {
+	uint32_t seq;				/* update sequence number   */
+	uint32_t in_use;			/* 1: channel open          */
+	uint32_t channel_no;			/* channel number           */
+	uint32_t flags;				/* ICCOM_INIT_xxx           */
+	char dev_name[ICCOM_METRICS_NAME_LEN];	/* device file name         */
+	uint64_t send_count;			/* frames sent              */
+	uint64_t send_bytes;			/* frame bytes sent         */
+	uint64_t send_error_count;		/* Iccom_lib_Send errors    */
+	uint64_t recv_count;			/* frames received          */
+	uint64_t recv_bytes;			/* frame bytes received     */
+	uint64_t recv_error_count;		/* receive errors           */
+	int32_t last_send_error;		/* last Iccom_lib_Send error*/
+	int32_t last_recv_error;		/* last receive error       */
+	uint32_t in_flight;			/* Iccom_lib_Send in progress*/
+	uint32_t reserved;			/* reserved (0)             */
+	uint64_t spill_depth;			/* spill queue messages     */
+	uint64_t conflate_depth;		/* conflation queue topics  */
+	uint64_t error_count[ICCOM_METRICS_ERROR_MAX];
+						/* [n]: errors of return    */
+						/* code -n (0: others)      */
+	uint64_t send_latency[ICCOM_METRICS_HIST_SIZE];
+						/* [n]: frame writes taking */
+						/* 2^n to 2^(n+1)-1 ns      */
+} Iccom_metrics_channel;
+
+/* metrics page : shared memory ICCOM_METRICS_SHM_PREFIX<pid> */
+typedef struct {
+	uint32_t magic;				/* ICCOM_METRICS_MAGIC      */
+	uint32_t version;			/* ICCOM_METRICS_VERSION    */
+	uint32_t pid;				/* process ID               */
+	uint32_t slot_max;			/* ICCOM_METRICS_SLOT_MAX   */
+	uint32_t slot_count;			/* slots used (in_use or not)*/
+	uint32_t interval;			/* update interval (ms)     */
+	uint64_t update_time;			/* last update time         */
+						/* (CLOCK_MONOTONIC, ns)    */
+	char name[ICCOM_METRICS_NAME_LEN];	/* process name             */
+	Iccom_metrics_channel slot[ICCOM_METRICS_SLOT_MAX];
+} Iccom_metrics_page;
+
 /* Iccom_lib_Send parameter */
 typedef struct {
 	Iccom_channel_t channel_handle;		/* channel handle           */
@@ -59,12 +461,104 @@ typedef struct {
 int32_t Iccom_lib_Init(const Iccom_init_param *pIccomInit,
 			Iccom_channel_t  *pChannelHandle);
 
+/* channel initialization function (callback with user data) */
+int32_t Iccom_lib_InitEx(const Iccom_init_param_ex *pIccomInit,
+			Iccom_channel_t  *pChannelHandle);
+
+/* context creation function */
+int32_t Iccom_lib_CtxCreate(const Iccom_ctx_param *pCtxParam,
+			Iccom_ctx_t *pCtx);
+
+/* context release function */
+int32_t Iccom_lib_CtxDestroy(Iccom_ctx_t Ctx);
+
+/* channel initialization function of context (Ctx NULL: default) */
+int32_t Iccom_lib_CtxInit(Iccom_ctx_t Ctx,
+			const Iccom_init_param_ex *pIccomInit,
+			Iccom_channel_t  *pChannelHandle);
+
 /* channel finalization function */
 int32_t Iccom_lib_Final(Iccom_channel_t ChannelHandle);
 
 /* data send function   */
 int32_t Iccom_lib_Send(const Iccom_send_param *pIccomSend);
 
+/* message ID dispatch configuration function */
+int32_t Iccom_lib_DispatchConfig(Iccom_channel_t ChannelHandle,
+			const Iccom_dispatch_param *pDispatchParam);
+
+/* message handler registration function (handler NULL : unregister) */
+int32_t Iccom_lib_DispatchRegister(Iccom_channel_t ChannelHandle,
+			uint32_t msg_id, Iccom_msg_handler_t handler,
+			void *user_data);
+
+/* message handler statistics get function */
+int32_t Iccom_lib_DispatchGetStats(Iccom_channel_t ChannelHandle,
+			Iccom_dispatch_stats *pStats, uint32_t stats_num,
+			uint32_t *pStatsCount);
+
+/* send rate shaper setting function (pShaperParam NULL : disable) */
+int32_t Iccom_lib_SetShaper(Iccom_channel_t ChannelHandle,
+			const Iccom_shaper_param *pShaperParam);
+
+/* send rate shaper statistics get function */
+int32_t Iccom_lib_GetShaperStats(Iccom_channel_t ChannelHandle,
+			Iccom_shaper_stats *pStats);
+
+/* frame maximum size get function */
+int32_t Iccom_lib_GetFrameSize(Iccom_channel_t ChannelHandle,
+			uint32_t *pFrameMax, uint32_t *pDataMax);
+
+/* receive integrity statistics get function */
+int32_t Iccom_lib_GetIntegrityStats(Iccom_channel_t ChannelHandle,
+			Iccom_integrity_stats *pStats);
+
+/* spill queue configuration function */
+int32_t Iccom_lib_SpillConfig(Iccom_channel_t ChannelHandle,
+			const Iccom_spill_param *pSpillParam);
+
+/* spill queue statistics get function */
+int32_t Iccom_lib_GetSpillStats(Iccom_channel_t ChannelHandle,
+			Iccom_spill_stats *pStats);
+
+/* conflation queue configuration function */
+int32_t Iccom_lib_ConflateConfig(Iccom_channel_t ChannelHandle,
+			const Iccom_conflate_param *pConflateParam);
+
+/* conflation queue statistics get function */
+int32_t Iccom_lib_GetConflateStats(Iccom_channel_t ChannelHandle,
+			Iccom_conflate_stats *pStats);
+
+/* delta encoding configuration function (ICCOM_INIT_DELTA) */
+int32_t Iccom_lib_DeltaConfig(Iccom_channel_t ChannelHandle,
+			const Iccom_delta_param *pDeltaParam);
+
+/* delta encoding statistics get function */
+int32_t Iccom_lib_GetDeltaStats(Iccom_channel_t ChannelHandle,
+			Iccom_delta_stats *pStats);
+
+/* batch callback configuration function */
+int32_t Iccom_lib_BatchConfig(Iccom_channel_t ChannelHandle,
+			const Iccom_batch_param *pBatchParam);
+
+/* batch callback statistics get function */
+int32_t Iccom_lib_GetBatchStats(Iccom_channel_t ChannelHandle,
+			Iccom_batch_stats *pStats);
+
+/* link health probing configuration function */
+int32_t Iccom_lib_HealthConfig(Iccom_channel_t ChannelHandle,
+			const Iccom_health_param *pHealthParam);
+
+/* link health statistics get function */
+int32_t Iccom_lib_GetHealthStats(Iccom_channel_t ChannelHandle,
+			Iccom_health_stats *pStats);
+
+/* metrics page publication start function (interval 0 : 100ms) */
+int32_t Iccom_lib_MetricsStart(uint32_t interval);
+
+/* metrics page publication stop function */
+int32_t Iccom_lib_MetricsStop(void);
+
 /* API return codes */
 #define ICCOM_OK		0	/* Normal completion                */
 #define ICCOM_NG		(-1)	/* Abnormal completion              */
@@ -77,8 +571,81 @@ int32_t Iccom_lib_Send(const Iccom_send_param *pIccomSend);
 #define ICCOM_ERR_TO_SEND	(-7)	/* Data send timeout error          */
 #define ICCOM_ERR_UNSUPPORT	(-8)	/* Channel unsupported              */
 #define ICCOM_ERR_SIZE		(-9)	/* Send size illegal                */
+#define ICCOM_ERR_RATE		(-10)	/* Send rate exceeded               */
+					/* (ICCOM_SHAPER_NONBLOCK)          */
+#define ICCOM_ERR_CRC		(-11)	/* Received data CRC32C mismatch    */
+#define ICCOM_ERR_DELTA		(-12)	/* Received delta frame without     */
+					/* reference frame                  */
 
-/* communication maximum buffer size */
+/* communication maximum buffer size                        */
+/* (frame size of drivers without frame size negotiation,    */
+/*  and default of Iccom_init_param_ex frame_max)            */
 #define ICCOM_BUF_MAX_SIZE 2048U
 
+/* Iccom_init_param_ex frame_max maximum */
+#define ICCOM_FRAME_MAX_SIZE 65536U
+
+/* Iccom_init_param_ex flags */
+#define ICCOM_INIT_STAMP	(0x00000001U)	/* send stamp header        */
+#define ICCOM_INIT_CRC32C	(0x00000002U)	/* CRC32C trailer           */
+#define ICCOM_INIT_DELTA	(0x00000004U)	/* delta encoding           */
+
+/* Iccom_recv_info flags */
+#define ICCOM_RECV_INFO_STAMPED	(0x00000001U)	/* send_time, send_seq valid*/
+
+/* id_order of Iccom_dispatch_param, Iccom_delta_param and           */
+/* Iccom_conflate_param (byte order of message, stream and topic ID) */
+#define ICCOM_ID_LITTLE_ENDIAN	(0U)	/* little endian ID                 */
+#define ICCOM_ID_BIG_ENDIAN	(1U)	/* big endian ID                    */
+
+/* Iccom_dispatch_stats flags */
+#define ICCOM_DISPATCH_STATS_DEFAULT	(0x00000001U) /* unknown IDs       */
+
+/* Iccom_shaper_param mode */
+#define ICCOM_SHAPER_BLOCK	(0U)	/* wait until the data conforms     */
+#define ICCOM_SHAPER_NONBLOCK	(1U)	/* return ICCOM_ERR_RATE            */
+#define ICCOM_SHAPER_DROP	(2U)	/* discard data, return ICCOM_OK    */
+
+/* send stamp header size */
+#define ICCOM_STAMP_HEADER_SIZE	16U
+
+/* CRC32C trailer size (ICCOM_INIT_CRC32C)                    */
+/* CRC32C of the frame before the trailer, little endian      */
+#define ICCOM_CRC32C_SIZE	4U
+
+/* delta header size and changed range header size          */
+/* (ICCOM_INIT_DELTA)                                         */
+#define ICCOM_DELTA_HEADER_SIZE	16U
+#define ICCOM_DELTA_RUN_SIZE	4U
+
+/* Iccom_batch_param limits */
+#define ICCOM_BATCH_MAX		256U	/* batch_max maximum                */
+#define ICCOM_BATCH_TIME_MAX	1000000U /* batch_time maximum (us)         */
+
+/* link health probe frame                                   */
+#define ICCOM_HEALTH_MAGIC	(0x50484349U)	/* "ICHP"                   */
+#define ICCOM_HEALTH_PROBE_SIZE	16U		/* probe frame data size    */
+#define ICCOM_HEALTH_WINDOW	256U		/* probes of percentiles    */
+
+/* Iccom_health_event state */
+#define ICCOM_HEALTH_OK		(0U)	/* link healthy                     */
+#define ICCOM_HEALTH_DEGRADED	(1U)	/* link degraded (reason)           */
+
+/* Iccom_health_event reason */
+#define ICCOM_HEALTH_REASON_RTT	 (0x00000001U) /* rtt_ewma over threshold */
+#define ICCOM_HEALTH_REASON_ACK	 (0x00000002U) /* ack_ewma over threshold */
+#define ICCOM_HEALTH_REASON_LOST (0x00000004U) /* probe echo timeout      */
+#define ICCOM_HEALTH_REASON_SEND (0x00000008U) /* probe send error        */
+
+/* Iccom_health_param limits */
+#define ICCOM_HEALTH_TIME_MAX	60000U	/* interval, timeout maximum (ms)   */
+
+/* Iccom_delta_header type */
+#define ICCOM_DELTA_KEY		(0U)	/* keyframe (whole data)            */
+#define ICCOM_DELTA_DIFF	(1U)	/* changed ranges of data           */
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* ICCOM_H */
@@ -0,0 +1,629 @@
+/*
+ * Copyright (c) 2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/*
+ * Header-only C++20 interface of the ICCOM library.
+ *
+ *  - iccom::channel<Handler> opens a channel on construction and closes it
+ *    on destruction.  It is move-only.  The handler is called on the
+ *    receive thread with a std::span of the received bytes (and the
+ *    Iccom_recv_info, if it accepts one); its type is a template
+ *    parameter, so the call is resolved at compile time.  A handler with
+ *    on_error(std::error_code, payload) also gets the frames failing the
+ *    receive checks (ICCOM_INIT_CRC32C).
+ *  - iccom::receive_queue<Executor, Depth, FrameMax> is a handler which
+ *    keeps up to Depth frames of up to FrameMax bytes in preallocated
+ *    slots, so that a coroutine can "co_await ch.handler().receive()".
+ *  - channel::async_send() moves the awaiting coroutine to an executor and
+ *    sends from there.
+ *  - iccom::context owns an Iccom_ctx_t (another ICCOM device); channels
+ *    opened without one use the default context.
+ *
+ * An executor is any object with post(std::coroutine_handle<>).
+ */
+
+#ifndef ICCOM_HPP
+#define ICCOM_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <concepts>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "iccom.h"
+
+namespace iccom {
+
+/* error codes of the C API (ICCOM_xxx), as std::error_code */
+enum class errc : std::int32_t {
+	ng         = ICCOM_NG,
+	param      = ICCOM_ERR_PARAM,
+	buf_full   = ICCOM_ERR_BUF_FULL,
+	to_ack     = ICCOM_ERR_TO_ACK,
+	busy       = ICCOM_ERR_BUSY,
+	to_init    = ICCOM_ERR_TO_INIT,
+	to_send    = ICCOM_ERR_TO_SEND,
+	unsupport  = ICCOM_ERR_UNSUPPORT,
+	size       = ICCOM_ERR_SIZE,
+	rate       = ICCOM_ERR_RATE,
+	crc        = ICCOM_ERR_CRC,
+	delta      = ICCOM_ERR_DELTA,
+};
+
+class error_category_impl : public std::error_category {
+public:
+	const char *name() const noexcept override { return "iccom"; }
+
+	std::string message(int ev) const override
+	{
+		switch (ev) {
+		case ICCOM_OK:            return "success";
+		case ICCOM_NG:            return "abnormal completion";
+		case ICCOM_ERR_PARAM:     return "parameter error";
+		case ICCOM_ERR_BUF_FULL:  return "buffer full";
+		case ICCOM_ERR_TO_ACK:    return "acknowledgement timeout";
+		case ICCOM_ERR_BUSY:      return "channel busy";
+		case ICCOM_ERR_TO_INIT:   return "channel initialization timeout";
+		case ICCOM_ERR_TO_SEND:   return "data send timeout";
+		case ICCOM_ERR_UNSUPPORT: return "channel unsupported";
+		case ICCOM_ERR_SIZE:      return "send size illegal";
+		case ICCOM_ERR_RATE:      return "send rate exceeded";
+		case ICCOM_ERR_CRC:       return "CRC32C mismatch";
+		case ICCOM_ERR_DELTA:     return "no delta reference frame";
+		default:                  return "unknown error";
+		}
+	}
+};
+
+inline const std::error_category &error_category() noexcept
+{
+	static const error_category_impl cat;
+	return cat;
+}
+
+inline std::error_code make_error_code(errc e) noexcept
+{
+	return { static_cast<int>(e), error_category() };
+}
+
+/* convert an ICCOM_xxx return code, ICCOM_OK becomes an empty error_code */
+inline std::error_code to_error_code(std::int32_t ret) noexcept
+{
+	return ret == ICCOM_OK ? std::error_code{}
+			       : std::error_code{ ret, error_category() };
+}
+
+using payload = std::span<const std::uint8_t>;
+
+template <class E>
+concept executor = requires(E &e, std::coroutine_handle<> h) {
+	e.post(h);
+};
+
+/* resumes the coroutine on the posting thread */
+struct inline_executor {
+	void post(std::coroutine_handle<> h) const { h.resume(); }
+};
+
+/* move-only owner of an ICCOM context (Iccom_lib_CtxCreate) */
+class context {
+public:
+	explicit context(const char *dev_path = nullptr,
+			 std::uint32_t channel_max = 0)
+	{
+		Iccom_ctx_param cp{ dev_path, channel_max };
+
+		const auto ec = to_error_code(Iccom_lib_CtxCreate(&cp, &ctx_));
+		if (ec)
+			throw std::system_error(ec, "Iccom_lib_CtxCreate");
+	}
+
+	context(const context &) = delete;
+	context &operator=(const context &) = delete;
+
+	context(context &&o) noexcept : ctx_(std::exchange(o.ctx_, nullptr)) {}
+
+	context &operator=(context &&o) noexcept
+	{
+		if (this != &o) {
+			destroy();
+			ctx_ = std::exchange(o.ctx_, nullptr);
+		}
+		return *this;
+	}
+
+	/* every channel of the context must be closed before */
+	~context() { destroy(); }
+
+	std::error_code destroy() noexcept
+	{
+		if (ctx_ == nullptr)
+			return {};
+		const auto ec = to_error_code(Iccom_lib_CtxDestroy(ctx_));
+		if (!ec)
+			ctx_ = nullptr;
+		return ec;
+	}
+
+	Iccom_ctx_t get() const noexcept { return ctx_; }
+
+private:
+	Iccom_ctx_t ctx_ = nullptr;
+};
+
+template <class H>
+concept info_handler = std::invocable<H &, payload, const Iccom_recv_info &>;
+
+template <class H>
+concept handler = std::invocable<H &, payload> || info_handler<H>;
+
+template <class H>
+concept error_handler = requires(H &h, std::error_code ec, payload p) {
+	h.on_error(ec, p);
+};
+
+template <handler Handler>
+class channel {
+public:
+	channel(Iccom_channel_number no, Handler h)
+		: channel(no, std::in_place, std::move(h))
+	{
+	}
+
+	/*
+	 * "param" supplies the channel number and options (flags, frame_max,
+	 * ...); its receive buffer (of frame_max bytes), callbacks and user
+	 * data are set by the channel.
+	 */
+	channel(const Iccom_init_param_ex &param, Handler h)
+		: channel(param, std::in_place, std::move(h))
+	{
+	}
+
+	channel(const context &ctx, const Iccom_init_param_ex &param,
+		Handler h)
+		: channel(ctx, param, std::in_place, std::move(h))
+	{
+	}
+
+	/* construct the handler in place (for handlers which cannot move) */
+	template <class... Args>
+	channel(Iccom_channel_number no, std::in_place_t, Args &&...args)
+		: channel(make_param(no), std::in_place,
+			  std::forward<Args>(args)...)
+	{
+	}
+
+	template <class... Args>
+	channel(const Iccom_init_param_ex &param, std::in_place_t,
+		Args &&...args)
+		: channel(nullptr, param, std::in_place,
+			  std::forward<Args>(args)...)
+	{
+	}
+
+	template <class... Args>
+	channel(const context &ctx, const Iccom_init_param_ex &param,
+		std::in_place_t, Args &&...args)
+		: channel(ctx.get(), param, std::in_place,
+			  std::forward<Args>(args)...)
+	{
+	}
+
+	channel(const channel &) = delete;
+	channel &operator=(const channel &) = delete;
+
+	channel(channel &&) noexcept = default;
+
+	channel &operator=(channel &&other) noexcept
+	{
+		if (this != &other) {
+			finalize();
+			s_ = std::move(other.s_);
+		}
+		return *this;
+	}
+
+	/* must not be destroyed from its own handler (receive thread) */
+	~channel() { finalize(); }
+
+	/* finalize the channel; fails while a send is in progress */
+	std::error_code close() noexcept
+	{
+		if (!s_)
+			return {};
+		const auto ec = to_error_code(Iccom_lib_Final(s_->handle));
+		if (!ec)
+			s_.reset();
+		return ec;
+	}
+
+	std::error_code send(payload data) const noexcept
+	{
+		Iccom_send_param sp;
+
+		if (!s_)
+			return make_error_code(errc::param);
+		sp.channel_handle = s_->handle;
+		sp.send_size = static_cast<std::uint32_t>(data.size());
+		/* the library does not write to the send buffer */
+		sp.send_buf = const_cast<std::uint8_t *>(data.data());
+		return to_error_code(Iccom_lib_Send(&sp));
+	}
+
+	/*
+	 * co_await ch.async_send(ex, data): the coroutine is resumed through
+	 * ex and the (blocking) send runs on the executor's thread.  "data"
+	 * must stay valid until the co_await completes.
+	 */
+	template <executor Executor>
+	auto async_send(Executor &ex, payload data) const noexcept
+	{
+		struct awaiter {
+			const channel *ch;
+			Executor *ex;
+			payload data;
+
+			bool await_ready() const noexcept { return false; }
+			void await_suspend(std::coroutine_handle<> h) const
+			{
+				ex->post(h);
+			}
+			std::error_code await_resume() const noexcept
+			{
+				return ch->send(data);
+			}
+		};
+		return awaiter{ this, &ex, data };
+	}
+
+	/* token-bucket shaping of send() and async_send(), nullptr: off */
+	std::error_code set_shaper(const Iccom_shaper_param *param) noexcept
+	{
+		if (!s_)
+			return make_error_code(errc::param);
+		return to_error_code(Iccom_lib_SetShaper(s_->handle, param));
+	}
+
+	std::error_code shaper_stats(Iccom_shaper_stats &stats) const noexcept
+	{
+		if (!s_)
+			return make_error_code(errc::param);
+		return to_error_code(
+			Iccom_lib_GetShaperStats(s_->handle, &stats));
+	}
+
+	/* streams and keyframe interval of ICCOM_INIT_DELTA channels */
+	std::error_code set_delta(const Iccom_delta_param &param) noexcept
+	{
+		if (!s_)
+			return make_error_code(errc::param);
+		return to_error_code(Iccom_lib_DeltaConfig(s_->handle, &param));
+	}
+
+	std::error_code delta_stats(Iccom_delta_stats &stats) const noexcept
+	{
+		if (!s_)
+			return make_error_code(errc::param);
+		return to_error_code(
+			Iccom_lib_GetDeltaStats(s_->handle, &stats));
+	}
+
+	/* frame maximum size negotiated with the driver at construction */
+	std::uint32_t frame_max() const noexcept
+	{
+		std::uint32_t size = 0;
+
+		if (s_)
+			(void)Iccom_lib_GetFrameSize(s_->handle, &size,
+						     nullptr);
+		return size;
+	}
+
+	/* largest payload of send() (frame_max less headers of the flags) */
+	std::uint32_t data_max() const noexcept
+	{
+		std::uint32_t size = 0;
+
+		if (s_)
+			(void)Iccom_lib_GetFrameSize(s_->handle, nullptr,
+						     &size);
+		return size;
+	}
+
+	/* not on a moved-from channel */
+	Handler &handler() noexcept { return s_->handler; }
+	const Handler &handler() const noexcept { return s_->handler; }
+
+	/* nullptr on a moved-from channel */
+	Iccom_channel_t native_handle() const noexcept
+	{
+		return s_ ? s_->handle : nullptr;
+	}
+
+	Iccom_channel_number number() const noexcept
+	{
+		return s_ ? s_->no : ICCOM_CHANNEL_0;
+	}
+	explicit operator bool() const noexcept { return s_ != nullptr; }
+
+private:
+	template <class... Args>
+	channel(Iccom_ctx_t ctx, const Iccom_init_param_ex &param,
+		std::in_place_t, Args &&...args)
+		: s_(std::make_unique<state>(std::forward<Args>(args)...))
+	{
+		Iccom_init_param_ex ip = param;
+
+		s_->buf = std::make_unique_for_overwrite<std::uint8_t[]>(
+			std::max<std::uint32_t>(param.frame_max,
+						ICCOM_BUF_MAX_SIZE));
+		ip.recv_buf = s_->buf.get();
+		ip.recv_cb = nullptr;
+		ip.recv_info_cb = nullptr;
+		if constexpr (info_handler<Handler>)
+			ip.recv_info_cb = &channel::on_receive_info;
+		else
+			ip.recv_cb = &channel::on_receive;
+		ip.error_cb = nullptr;
+		if constexpr (error_handler<Handler>)
+			ip.error_cb = &channel::on_error;
+		ip.user_data = s_.get();
+
+		const auto ec = to_error_code(
+			Iccom_lib_CtxInit(ctx, &ip, &s_->handle));
+		if (ec)
+			throw std::system_error(ec, "Iccom_lib_CtxInit");
+		s_->no = param.channel_no;
+	}
+
+	/* heap state: its address is the callback user data and never moves */
+	struct state {
+		template <class... Args>
+		explicit state(Args &&...args)
+			: handler(std::forward<Args>(args)...)
+		{
+		}
+
+		Handler handler;
+		Iccom_channel_t handle = nullptr;
+		Iccom_channel_number no = ICCOM_CHANNEL_0;
+		std::unique_ptr<std::uint8_t[]> buf;	/* frame_max bytes */
+	};
+
+	static Iccom_init_param_ex make_param(Iccom_channel_number no) noexcept
+	{
+		Iccom_init_param_ex ip{};
+
+		ip.channel_no = no;
+		return ip;
+	}
+
+	static void on_receive(void *user_data, Iccom_channel_number,
+			       std::uint32_t size, std::uint8_t *buf)
+	{
+		static_cast<state *>(user_data)->handler(payload(buf, size));
+	}
+
+	static void on_receive_info(void *user_data, Iccom_channel_number,
+				    std::uint32_t size, std::uint8_t *buf,
+				    const Iccom_recv_info *info)
+	{
+		static_cast<state *>(user_data)->handler(payload(buf, size),
+							 *info);
+	}
+
+	static void on_error(void *user_data, Iccom_channel_number,
+			     std::int32_t error, std::uint32_t size,
+			     std::uint8_t *buf)
+	{
+		static_cast<state *>(user_data)->handler.on_error(
+			to_error_code(error), payload(buf, size));
+	}
+
+	/*
+	 * Iccom_lib_Final fails with ICCOM_ERR_PARAM while a send is in
+	 * progress, but also for a handle it does not know (finalized
+	 * through native_handle()).  It is retried only while the library
+	 * still knows the handle.  After any other failure the library may
+	 * still use the state (callback user data, receive buffer) from its
+	 * receive thread, so it is leaked rather than freed.
+	 */
+	void finalize() noexcept
+	{
+		using namespace std::chrono_literals;
+		std::error_code ec;
+		std::uint32_t size;
+
+		while (s_) {
+			ec = close();
+			if (!ec || ec.value() != ICCOM_ERR_PARAM ||
+			    Iccom_lib_GetFrameSize(s_->handle, &size,
+						   nullptr) != ICCOM_OK)
+				break;
+			std::this_thread::sleep_for(1ms);
+		}
+		if (ec)
+			(void)s_.release();
+	}
+
+	std::unique_ptr<state> s_;
+};
+
+/*
+ * Handler which queues received frames for coroutines.
+ *
+ * Frames are copied into Depth preallocated slots; a slot is given back
+ * when the frame returned by receive() is destroyed.  When every slot is
+ * in use the received frame is dropped and counted in overruns().
+ * FrameMax should be the frame_max of the channel; larger frames are
+ * dropped and counted in overruns() as well.
+ * A single coroutine may wait in receive() at a time.
+ */
+template <executor Executor, std::size_t Depth = 16,
+	  std::size_t FrameMax = ICCOM_BUF_MAX_SIZE>
+class receive_queue {
+	static_assert(Depth > 0);
+	static_assert(FrameMax >= ICCOM_BUF_MAX_SIZE &&
+		      FrameMax <= ICCOM_FRAME_MAX_SIZE);
+
+	struct slot {
+		std::uint32_t size = 0;
+		bool done = false;
+		Iccom_recv_info info{};
+		alignas(64) std::array<std::uint8_t, FrameMax> data;
+	};
+
+public:
+	class frame {
+	public:
+		frame() = default;
+		frame(const frame &) = delete;
+		frame &operator=(const frame &) = delete;
+		frame(frame &&o) noexcept
+			: q_(std::exchange(o.q_, nullptr)), idx_(o.idx_)
+		{
+		}
+		frame &operator=(frame &&o) noexcept
+		{
+			if (this != &o) {
+				release();
+				q_ = std::exchange(o.q_, nullptr);
+				idx_ = o.idx_;
+			}
+			return *this;
+		}
+		~frame() { release(); }
+
+		payload data() const noexcept
+		{
+			const auto &s = q_->slots_[idx_];
+			return { s.data.data(), s.size };
+		}
+
+		const Iccom_recv_info &info() const noexcept
+		{
+			return q_->slots_[idx_].info;
+		}
+
+	private:
+		friend class receive_queue;
+		frame(receive_queue *q, std::size_t idx) : q_(q), idx_(idx) {}
+
+		void release() noexcept
+		{
+			if (q_)
+				q_->release(idx_);
+			q_ = nullptr;
+		}
+
+		receive_queue *q_ = nullptr;
+		std::size_t idx_ = 0;
+	};
+
+	explicit receive_queue(Executor ex) : ex_(std::move(ex)) {}
+
+	receive_queue(const receive_queue &) = delete;
+	receive_queue &operator=(const receive_queue &) = delete;
+
+	/* receive thread side */
+	void operator()(payload p, const Iccom_recv_info &info)
+	{
+		std::coroutine_handle<> waiter;
+
+		{
+			std::lock_guard lock(mtx_);
+			if (wr_ - free_ == Depth || p.size() > FrameMax) {
+				overruns_.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+			auto &s = slots_[wr_ % Depth];
+			s.size = static_cast<std::uint32_t>(p.size());
+			s.done = false;
+			s.info = info;
+			std::copy(p.begin(), p.end(), s.data.begin());
+			wr_++;
+			waiter = std::exchange(waiter_, nullptr);
+		}
+		if (waiter)
+			ex_.post(waiter);
+	}
+
+	/* co_await q.receive() yields a frame */
+	auto receive() noexcept
+	{
+		struct awaiter {
+			receive_queue *q;
+
+			bool await_ready() const
+			{
+				std::lock_guard lock(q->mtx_);
+				return q->rd_ != q->wr_;
+			}
+			bool await_suspend(std::coroutine_handle<> h) const
+			{
+				std::lock_guard lock(q->mtx_);
+				if (q->rd_ != q->wr_)
+					return false;
+				q->waiter_ = h;
+				return true;
+			}
+			frame await_resume() const
+			{
+				std::lock_guard lock(q->mtx_);
+				return frame(q, q->rd_++ % Depth);
+			}
+		};
+		return awaiter{ this };
+	}
+
+	std::uint64_t overruns() const noexcept
+	{
+		return overruns_.load(std::memory_order_relaxed);
+	}
+
+private:
+	void release(std::size_t idx) noexcept
+	{
+		std::lock_guard lock(mtx_);
+		slots_[idx].done = true;
+		/* slots are reused in order once every older one is released */
+		while (free_ != rd_ && slots_[free_ % Depth].done)
+			free_++;
+	}
+
+	Executor ex_;
+	std::mutex mtx_;
+	std::coroutine_handle<> waiter_;
+	std::size_t wr_ = 0;	/* next slot written by the receive thread */
+	std::size_t rd_ = 0;	/* next slot handed out by receive() */
+	std::size_t free_ = 0;	/* oldest slot not given back yet */
+	std::atomic<std::uint64_t> overruns_{ 0 };
+	std::array<slot, Depth> slots_;
+};
+
+template <executor Executor, std::size_t Depth = 16,
+	  std::size_t FrameMax = ICCOM_BUF_MAX_SIZE>
+using async_channel = channel<receive_queue<Executor, Depth, FrameMax>>;
+
+} /* namespace iccom */
+
+template <>
+struct std::is_error_code_enum<iccom::errc> : std::true_type {};
+
+#endif /* ICCOM_HPP */
@@ -0,0 +1,353 @@
+/*
+ * Copyright (c) 2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "iccom.h"
+#include "iccom_library.h"
+
+/*****************************************************************************/
+/* define definition                                                         */
+/*****************************************************************************/
+#define ICCOM_BATCH_DEFAULT (16U)		/* batch_max default         */
+
+/*****************************************************************************/
+/* structure definition                                                      */
+/*****************************************************************************/
+/* batch receive queue                                                  */
+/* (frame slots : from head, frames in callback (busy) then frames      */
+/*  waiting for callback (count); 2 x batch_max slots, so the receive   */
+/*  thread fills the next batch while the callback processes one)       */
+struct iccom_batch_t {
+	struct iccom_channel_info_t *channel_info; /* channel of queue       */
+	Iccom_recv_batch_callback_t batch_cb;	/* batch callback function   */
+	void *user_data;			/* user data of batch_cb     */
+	uint32_t batch_max;			/* frames per call maximum   */
+	uint64_t batch_time;			/* time budget (ns)          */
+	uint32_t slot_max;			/* frame slot count          */
+	Iccom_recv_frame *slot;			/* frame slots (ring)        */
+	Iccom_recv_frame *frames;		/* frames passed to callback */
+	uint8_t *area;				/* data area of all slots    */
+	uint32_t head;				/* ring head                 */
+	uint32_t busy;				/* frames in callback        */
+	uint32_t count;				/* frames waiting callback   */
+	uint32_t stop;				/* deliver thread stop req.  */
+	Iccom_batch_stats stats;		/* statistics                */
+	pthread_mutex_t mutex;			/* mutex of queue            */
+	pthread_cond_t cond;			/* frame put / stop          */
+	pthread_cond_t cond_free;		/* frame slots freed         */
+	pthread_t deliver_thread_id;		/* deliver thread ID         */
+};
+
+/*****************************************************************************/
+/* internal function prototype definition                                    */
+/*****************************************************************************/
+/* deliver thread function */
+static void *iccom_batch_deliver_thread(void *arg);
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_batch_create                                            */
+/*  Function : Create batch receive queue and its deliver thread.            */
+/*  Callinq seq.                                                             */
+/*           iccom_batch_create(const Iccom_batch_param *param,              */
+/*                       struct iccom_channel_info_t *channel_info,          */
+/*                       struct iccom_batch_t **batch)                       */
+/*  Input    : *param          : Batch parameter pointer.                    */
+/*             *channel_info   : Channel handle information pointer.         */
+/*  Output   : **batch         : Batch receive queue pointer.                */
+/*  Return   : 1. ICCOM_OK           (0)  : Normal                           */
+/*             2. ICCOM_ERR_PARAM    (-2) : Parameter error                  */
+/*             3. ICCOM_NG           (-1) : Other error                      */
+/*  Caller   : Iccom_lib_BatchConfig                                         */
+/*                                                                           */
+/*****************************************************************************/
+int32_t iccom_batch_create(const Iccom_batch_param *param,
+			struct iccom_channel_info_t *channel_info,
+			struct iccom_batch_t **batch)
+{
+	struct iccom_batch_t *l_batch = NULL;	/* batch receive queue       */
+	pthread_condattr_t l_condattr;		/* condition attribute       */
+	int32_t retcode = ICCOM_OK;		/* return code               */
+	int ret;				/* call function return code */
+	uint32_t l_batch_max;			/* frames per call maximum   */
+	uint32_t l_cnt;				/* loop counter              */
+	uint8_t l_sync_flag = ICCOM_LIB_OFF;	/* mutex/cond initialized    */
+
+	l_batch_max = (param->batch_max == 0U) ? ICCOM_BATCH_DEFAULT :
+		param->batch_max;
+
+	/* check batch parameter contents */
+	if ((param->batch_cb == NULL) || (l_batch_max > ICCOM_BATCH_MAX) ||
+	    (param->batch_time > ICCOM_BATCH_TIME_MAX)) {
+		LIBPRT_ERR("parameter err : batch_cb = %p, batch_max = %u,"
+			" batch_time = %u", (void *)param->batch_cb,
+			param->batch_max, param->batch_time);
+		retcode = ICCOM_ERR_PARAM;
+	}
+
+	if (retcode == ICCOM_OK) {
+		l_batch = (struct iccom_batch_t *)calloc(1U, sizeof(*l_batch));
+		if (l_batch == NULL) {
+			LIBPRT_ERR("cannot get batch receive queue area");
+			retcode = ICCOM_NG;
+		}
+	}
+
+	if (retcode == ICCOM_OK) {
+		l_batch->channel_info = channel_info;
+		l_batch->batch_cb = param->batch_cb;
+		l_batch->user_data = param->user_data;
+		l_batch->batch_max = l_batch_max;
+		l_batch->batch_time = (uint64_t)param->batch_time * 1000U;
+		l_batch->slot_max = l_batch_max * 2U;
+		l_batch->slot = (Iccom_recv_frame *)calloc(
+			(size_t)l_batch->slot_max, sizeof(*l_batch->slot));
+		l_batch->frames = (Iccom_recv_frame *)calloc(
+			(size_t)l_batch_max, sizeof(*l_batch->frames));
+		l_batch->area = (uint8_t *)malloc((size_t)l_batch->slot_max *
+			(size_t)channel_info->frame_max);
+		if ((l_batch->slot == NULL) || (l_batch->frames == NULL) ||
+		    (l_batch->area == NULL)) {
+			LIBPRT_ERR("cannot get frame slot area :"
+				" batch_max = %u", l_batch_max);
+			retcode = ICCOM_NG;
+		} else {
+			for (l_cnt = 0U; l_cnt < l_batch->slot_max; l_cnt++) {
+				l_batch->slot[l_cnt].recv_buf =
+					&l_batch->area[(size_t)l_cnt *
+					channel_info->frame_max];
+			}
+		}
+	}
+
+	if (retcode == ICCOM_OK) {
+		(void)pthread_mutex_init(&l_batch->mutex, NULL);
+		(void)pthread_condattr_init(&l_condattr);
+		(void)pthread_condattr_setclock(&l_condattr, CLOCK_MONOTONIC);
+		(void)pthread_cond_init(&l_batch->cond, &l_condattr);
+		(void)pthread_condattr_destroy(&l_condattr);
+		(void)pthread_cond_init(&l_batch->cond_free, NULL);
+		l_sync_flag = ICCOM_LIB_ON;
+
+		/* create deliver thread */
+		ret = pthread_create(&l_batch->deliver_thread_id, NULL,
+			iccom_batch_deliver_thread, (void *)l_batch);
+		if (ret != 0) {
+			LIBPRT_ERR("pthread_create : ret = %d", ret);
+			retcode = ICCOM_NG;
+		}
+	}
+
+	if (retcode == ICCOM_OK) {
+		*batch = l_batch;
+	} else if (l_batch != NULL) {
+		if (l_sync_flag == ICCOM_LIB_ON) {
+			(void)pthread_cond_destroy(&l_batch->cond_free);
+			(void)pthread_cond_destroy(&l_batch->cond);
+			(void)pthread_mutex_destroy(&l_batch->mutex);
+		}
+		free(l_batch->slot);
+		free(l_batch->frames);
+		free(l_batch->area);
+		free(l_batch);
+	} else {
+		/* nothing to release */
+	}
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_batch_destroy                                           */
+/*  Function : Deliver the frames waiting, end the deliver thread and        */
+/*             release batch receive queue.                                  */
+/*  Callinq seq.                                                             */
+/*           iccom_batch_destroy(struct iccom_batch_t *batch)                */
+/*  Input    : *batch          : Batch receive queue pointer (NULL: none).   */
+/*  Return   : NON                                                           */
+/*  Caller   : Iccom_lib_Final                                               */
+/*  Note     : The receive thread must be ended before.                      */
+/*                                                                           */
+/*****************************************************************************/
+void iccom_batch_destroy(struct iccom_batch_t *batch)
+{
+	if (batch != NULL) {
+		(void)pthread_mutex_lock(&batch->mutex);
+		batch->stop = ICCOM_LIB_ON;
+		(void)pthread_cond_broadcast(&batch->cond);
+		(void)pthread_mutex_unlock(&batch->mutex);
+		(void)pthread_join(batch->deliver_thread_id, NULL);
+
+		(void)pthread_cond_destroy(&batch->cond_free);
+		(void)pthread_cond_destroy(&batch->cond);
+		(void)pthread_mutex_destroy(&batch->mutex);
+		free(batch->slot);
+		free(batch->frames);
+		free(batch->area);
+		free(batch);
+	}
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_batch_put                                               */
+/*  Function : Queue a received frame for the batch callback function.       */
+/*             When all frame slots are used, wait until the callback        */
+/*             function returns (the driver keeps the frames meanwhile).     */
+/*  Callinq seq.                                                             */
+/*           iccom_batch_put(struct iccom_batch_t *batch,                    */
+/*                           const uint8_t *buf, uint32_t size,              */
+/*                           const Iccom_recv_info *recv_info)               */
+/*  Input    : *batch          : Batch receive queue pointer.                */
+/*             *buf            : Received data pointer.                      */
+/*             size            : Received data size.                         */
+/*             *recv_info      : Receive information pointer.                */
+/*  Return   : NON                                                           */
+/*  Caller   : iccom_lib_call_callback (receive thread)                      */
+/*                                                                           */
+/*****************************************************************************/
+void iccom_batch_put(struct iccom_batch_t *batch, const uint8_t *buf,
+			uint32_t size, const Iccom_recv_info *recv_info)
+{
+	Iccom_recv_frame *l_slot;		/* frame slot                */
+
+	(void)pthread_mutex_lock(&batch->mutex);
+
+	if ((batch->busy + batch->count) == batch->slot_max) {
+		batch->stats.wait_count++;
+		while ((batch->busy + batch->count) == batch->slot_max) {
+			(void)pthread_cond_wait(&batch->cond_free,
+				&batch->mutex);
+		}
+	}
+
+	l_slot = &batch->slot[(batch->head + batch->busy + batch->count) %
+		batch->slot_max];
+	(void)memcpy((void *)l_slot->recv_buf, (const void *)buf,
+		(size_t)size);
+	l_slot->recv_size = size;
+	l_slot->recv_info = *recv_info;
+	batch->count++;
+	if ((batch->count == 1U) || (batch->count == batch->batch_max)) {
+		/* wake up deliver thread (waiting for first or full batch) */
+		(void)pthread_cond_signal(&batch->cond);
+	}
+
+	(void)pthread_mutex_unlock(&batch->mutex);
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_batch_get_stats                                         */
+/*  Function : Get statistics of batch receive queue.                        */
+/*  Callinq seq.                                                             */
+/*           iccom_batch_get_stats(struct iccom_batch_t *batch,              */
+/*                                 Iccom_batch_stats *stats)                 */
+/*  Input    : *batch          : Batch receive queue pointer.                */
+/*  Output   : *stats          : Statistics.                                 */
+/*  Return   : NON                                                           */
+/*  Caller   : Iccom_lib_GetBatchStats                                       */
+/*                                                                           */
+/*****************************************************************************/
+void iccom_batch_get_stats(struct iccom_batch_t *batch,
+			Iccom_batch_stats *stats)
+{
+	(void)pthread_mutex_lock(&batch->mutex);
+	*stats = batch->stats;
+	stats->depth_count = batch->count;
+	(void)pthread_mutex_unlock(&batch->mutex);
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_batch_deliver_thread                                    */
+/*  Function : Pass the frames received to the batch callback function,      */
+/*             up to batch_max frames per call.  With batch_time, the call   */
+/*             waits for more frames until batch_time after the oldest       */
+/*             frame was received (or batch_max frames are received).        */
+/*  Callinq seq.                                                             */
+/*           iccom_batch_deliver_thread(void *arg)                           */
+/*  Input    : *arg            : Batch receive queue pointer                 */
+/*  return   : NULL                                                          */
+/*  Note     : This thread is created in iccom_batch_create and ends in       */
+/*             iccom_batch_destroy, after the frames waiting are delivered.  */
+/*                                                                           */
+/*****************************************************************************/
+static void *iccom_batch_deliver_thread(void *arg)
+{
+	struct iccom_batch_t *l_batch;		/* batch receive queue       */
+	struct timespec l_wake;			/* budget end time           */
+	uint64_t l_time;			/* budget end time (ns)      */
+	uint32_t l_num;				/* frames of the call        */
+	uint32_t l_cnt;				/* loop counter              */
+	int ret;				/* call function return code */
+
+	l_batch = (struct iccom_batch_t *)arg;
+
+	(void)pthread_mutex_lock(&l_batch->mutex);
+	while ((l_batch->stop == ICCOM_LIB_OFF) || (l_batch->count != 0U)) {
+		if (l_batch->count == 0U) {
+			(void)pthread_cond_wait(&l_batch->cond,
+				&l_batch->mutex);
+			continue;
+		}
+
+		if ((l_batch->batch_time != 0U) &&
+		    (l_batch->count < l_batch->batch_max)) {
+			/* wait for more frames within the time budget */
+			l_time = l_batch->slot[l_batch->head].recv_info.
+				recv_time + l_batch->batch_time;
+			l_wake.tv_sec = (time_t)(l_time / 1000000000U);
+			l_wake.tv_nsec = (long)(l_time % 1000000000U);
+			ret = 0;
+			while ((ret == 0) &&
+			       (l_batch->count < l_batch->batch_max) &&
+			       (l_batch->stop == ICCOM_LIB_OFF)) {
+				ret = pthread_cond_timedwait(&l_batch->cond,
+					&l_batch->mutex, &l_wake);
+			}
+		}
+
+		/* take the oldest frames (callback array is contiguous) */
+		l_num = (l_batch->count < l_batch->batch_max) ?
+			l_batch->count : l_batch->batch_max;
+		for (l_cnt = 0U; l_cnt < l_num; l_cnt++) {
+			l_batch->frames[l_cnt] = l_batch->slot[
+				(l_batch->head + l_cnt) % l_batch->slot_max];
+		}
+		l_batch->busy = l_num;
+		l_batch->count -= l_num;
+		l_batch->stats.call_count++;
+		l_batch->stats.frame_count += l_num;
+		if (l_num == l_batch->batch_max) {
+			l_batch->stats.full_count++;
+		}
+		if (l_num > l_batch->stats.max_count) {
+			l_batch->stats.max_count = l_num;
+		}
+		(void)pthread_mutex_unlock(&l_batch->mutex);
+
+		LIBPRT_DBG("call batch callback function : channel No. = %d,"
+			" count = %u",
+			(int32_t)l_batch->channel_info->channel_no, l_num);
+		(*l_batch->batch_cb)(l_batch->user_data,
+			l_batch->channel_info->channel_no, l_batch->frames,
+			l_num);
+
+		/* release the frame slots of the call */
+		(void)pthread_mutex_lock(&l_batch->mutex);
+		l_batch->head = (l_batch->head + l_batch->busy) %
+			l_batch->slot_max;
+		l_batch->busy = 0U;
+		(void)pthread_cond_signal(&l_batch->cond_free);
+	}
+	(void)pthread_mutex_unlock(&l_batch->mutex);
+	return NULL;
+}
@@ -0,0 +1,440 @@
+/*
+ * Copyright (c) 2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "iccom.h"
+#include "iccom_library.h"
+
+/*****************************************************************************/
+/* define definition                                                         */
+/*****************************************************************************/
+#define ICCOM_CONFLATE_RETRY_DEFAULT (100U)	/* retry interval default(ms)*/
+
+/*****************************************************************************/
+/* structure definition                                                      */
+/*****************************************************************************/
+/* topic (newest data not sent yet) */
+struct iccom_conflate_topic_t {
+	uint32_t topic_id;			/* topic ID                  */
+	uint32_t pending;			/* waiting to be sent        */
+	uint32_t size;				/* data size                 */
+	uint64_t put_time;			/* data put time (ns)        */
+	uint8_t *data;				/* data area                 */
+};
+
+/* conflation queue */
+struct iccom_conflate_t {
+	struct iccom_channel_info_t *channel_info; /* channel of queue       */
+	uint32_t id_offset;			/* topic ID byte offset      */
+	uint32_t id_width;			/* topic ID byte width       */
+	uint32_t id_order;			/* topic ID byte order       */
+	uint32_t topic_max;			/* topic max count           */
+	uint32_t topic_cnt;			/* used topic count          */
+	struct iccom_conflate_topic_t *topic;	/* topic table               */
+	uint8_t *area;				/* data area of all topics   */
+	uint8_t *buf;				/* send data area (thread)   */
+	uint32_t *order;			/* pending topics (ring)     */
+	uint32_t head;				/* ring head                 */
+	uint32_t count;				/* pending topic count       */
+	uint64_t retry_time;			/* retry interval (ns)       */
+	uint32_t stop;				/* send thread stop request  */
+	Iccom_conflate_stats stats;		/* statistics                */
+	pthread_mutex_t mutex;			/* mutex of queue            */
+	pthread_cond_t cond;			/* queue put / stop          */
+	pthread_t send_thread_id;		/* send thread ID            */
+};
+
+/*****************************************************************************/
+/* internal function prototype definition                                    */
+/*****************************************************************************/
+/* send thread function */
+static void *iccom_conflate_send_thread(void *arg);
+/* topic search function */
+static struct iccom_conflate_topic_t *iccom_conflate_find_topic(
+	struct iccom_conflate_t *conflate, uint32_t topic_id);
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_conflate_create                                         */
+/*  Function : Create conflation queue and its send thread.                  */
+/*  Callinq seq.                                                             */
+/*           iccom_conflate_create(const Iccom_conflate_param *param,        */
+/*                       struct iccom_channel_info_t *channel_info,          */
+/*                       struct iccom_conflate_t **conflate)                 */
+/*  Input    : *param          : Conflation parameter pointer.               */
+/*             *channel_info   : Channel handle information pointer.         */
+/*  Output   : **conflate      : Conflation queue pointer.                   */
+/*  Return   : 1. ICCOM_OK           (0)  : Normal                           */
+/*             2. ICCOM_ERR_PARAM    (-2) : Parameter error                  */
+/*             3. ICCOM_NG           (-1) : Other error                      */
+/*  Caller   : Iccom_lib_ConflateConfig                                      */
+/*                                                                           */
+/*****************************************************************************/
+int32_t iccom_conflate_create(const Iccom_conflate_param *param,
+			struct iccom_channel_info_t *channel_info,
+			struct iccom_conflate_t **conflate)
+{
+	struct iccom_conflate_t *l_conflate = NULL; /* conflation queue      */
+	pthread_condattr_t l_condattr;		/* condition attribute       */
+	int32_t retcode = ICCOM_OK;		/* return code               */
+	int ret;				/* call function return code */
+	uint32_t l_topic_max;			/* topic max count           */
+	uint32_t l_cnt;				/* loop counter              */
+	uint8_t l_sync_flag = ICCOM_LIB_OFF;	/* mutex/cond initialized    */
+
+	l_topic_max = (param->topic_max == 0U) ? 1U : param->topic_max;
+
+	/* check conflation parameter contents */
+	if (((param->id_width != 0U) && (param->id_width != 1U) &&
+	     (param->id_width != 2U) && (param->id_width != 4U)) ||
+	    ((param->id_width != 0U) &&
+	     (param->id_offset > (channel_info->data_max_size -
+	      param->id_width))) ||
+	    (param->id_order > ICCOM_ID_BIG_ENDIAN) ||
+	    (l_topic_max > ICCOM_CONFLATE_TOPIC_MAX)) {
+		LIBPRT_ERR("parameter err : id_offset = %u, id_width = %u,"
+			" id_order = %u, topic_max = %u",
+			param->id_offset, param->id_width, param->id_order,
+			param->topic_max);
+		retcode = ICCOM_ERR_PARAM;
+	}
+
+	if (retcode == ICCOM_OK) {
+		l_conflate = (struct iccom_conflate_t *)calloc(1U,
+			sizeof(*l_conflate));
+		if (l_conflate == NULL) {
+			LIBPRT_ERR("cannot get conflation queue area");
+			retcode = ICCOM_NG;
+		}
+	}
+
+	if (retcode == ICCOM_OK) {
+		l_conflate->channel_info = channel_info;
+		l_conflate->id_offset = param->id_offset;
+		l_conflate->id_width = param->id_width;
+		l_conflate->id_order = param->id_order;
+		l_conflate->topic_max = l_topic_max;
+		l_conflate->retry_time = (uint64_t)
+			((param->retry_time != 0U) ? param->retry_time :
+			ICCOM_CONFLATE_RETRY_DEFAULT) * 1000000U;
+		l_conflate->topic = (struct iccom_conflate_topic_t *)calloc(
+			(size_t)l_topic_max, sizeof(*l_conflate->topic));
+		l_conflate->area = (uint8_t *)malloc((size_t)l_topic_max *
+			(size_t)channel_info->data_max_size);
+		l_conflate->order = (uint32_t *)calloc((size_t)l_topic_max,
+			sizeof(*l_conflate->order));
+		l_conflate->buf = (uint8_t *)malloc(
+			(size_t)channel_info->data_max_size);
+		if ((l_conflate->topic == NULL) || (l_conflate->area == NULL) ||
+		    (l_conflate->order == NULL) || (l_conflate->buf == NULL)) {
+			LIBPRT_ERR("cannot get topic area : topic_max = %u",
+				l_topic_max);
+			retcode = ICCOM_NG;
+		} else {
+			for (l_cnt = 0U; l_cnt < l_topic_max; l_cnt++) {
+				l_conflate->topic[l_cnt].data =
+					&l_conflate->area[(size_t)l_cnt *
+					channel_info->data_max_size];
+			}
+		}
+	}
+
+	if (retcode == ICCOM_OK) {
+		(void)pthread_mutex_init(&l_conflate->mutex, NULL);
+		(void)pthread_condattr_init(&l_condattr);
+		(void)pthread_condattr_setclock(&l_condattr, CLOCK_MONOTONIC);
+		(void)pthread_cond_init(&l_conflate->cond, &l_condattr);
+		(void)pthread_condattr_destroy(&l_condattr);
+		l_sync_flag = ICCOM_LIB_ON;
+
+		/* create send thread */
+		ret = pthread_create(&l_conflate->send_thread_id, NULL,
+			iccom_conflate_send_thread, (void *)l_conflate);
+		if (ret != 0) {
+			LIBPRT_ERR("pthread_create : ret = %d", ret);
+			retcode = ICCOM_NG;
+		}
+	}
+
+	if (retcode == ICCOM_OK) {
+		*conflate = l_conflate;
+	} else if (l_conflate != NULL) {
+		if (l_sync_flag == ICCOM_LIB_ON) {
+			(void)pthread_cond_destroy(&l_conflate->cond);
+			(void)pthread_mutex_destroy(&l_conflate->mutex);
+		}
+		free(l_conflate->topic);
+		free(l_conflate->area);
+		free(l_conflate->order);
+		free(l_conflate->buf);
+		free(l_conflate);
+	} else {
+		/* nothing to release */
+	}
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_conflate_destroy                                        */
+/*  Function : Stop send thread and release conflation queue.                */
+/*             The data not sent yet is discarded.                           */
+/*  Callinq seq.                                                             */
+/*           iccom_conflate_destroy(struct iccom_conflate_t *conflate)       */
+/*  Input    : *conflate       : Conflation queue pointer (NULL: nothing).   */
+/*  Return   : NON                                                           */
+/*  Caller   : Iccom_lib_Final                                               */
+/*                                                                           */
+/*****************************************************************************/
+void iccom_conflate_destroy(struct iccom_conflate_t *conflate)
+{
+	if (conflate != NULL) {
+		(void)pthread_mutex_lock(&conflate->mutex);
+		conflate->stop = ICCOM_LIB_ON;
+		(void)pthread_cond_broadcast(&conflate->cond);
+		(void)pthread_mutex_unlock(&conflate->mutex);
+		(void)pthread_join(conflate->send_thread_id, NULL);
+
+		(void)pthread_cond_destroy(&conflate->cond);
+		(void)pthread_mutex_destroy(&conflate->mutex);
+		free(conflate->topic);
+		free(conflate->area);
+		free(conflate->order);
+		free(conflate->buf);
+		free(conflate);
+	}
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_conflate_put                                            */
+/*  Function : Put send data to the topic of its topic ID.                   */
+/*             When the data of the topic is not sent yet, it is replaced    */
+/*             in place (conflated); otherwise the topic is queued behind    */
+/*             the other pending topics.                                     */
+/*  Callinq seq.                                                             */
+/*           iccom_conflate_put(struct iccom_conflate_t *conflate,           */
+/*                              const uint8_t *buf, uint32_t size)           */
+/*  Input    : *conflate       : Conflation queue pointer.                   */
+/*             *buf            : Send data pointer.                          */
+/*             size            : Send data size.                             */
+/*  Return   : 1. ICCOM_OK           (0)  : Normal                           */
+/*             2. ICCOM_ERR_BUF_FULL (-3) : Topics over topic_max            */
+/*  Caller   : Iccom_lib_Send                                                */
+/*                                                                           */
+/*****************************************************************************/
+int32_t iccom_conflate_put(struct iccom_conflate_t *conflate,
+			const uint8_t *buf, uint32_t size)
+{
+	struct iccom_conflate_topic_t *l_topic;	/* topic of data             */
+	int32_t retcode = ICCOM_OK;		/* return code               */
+	uint32_t l_topic_id;			/* topic ID                  */
+
+	/* get topic ID (0 : one topic, or data shorter than the ID) */
+	(void)iccom_lib_get_id(buf, size, conflate->id_offset,
+		conflate->id_width, conflate->id_order, &l_topic_id);
+
+	(void)pthread_mutex_lock(&conflate->mutex);
+
+	l_topic = iccom_conflate_find_topic(conflate, l_topic_id);
+	if (l_topic == NULL) {
+		LIBPRT_ERR("topic count over : topic ID = %u, max = %u",
+			l_topic_id, conflate->topic_max);
+		conflate->stats.overflow_count++;
+		retcode = ICCOM_ERR_BUF_FULL;
+	}
+
+	if (retcode == ICCOM_OK) {
+		(void)memcpy((void *)l_topic->data, (const void *)buf,
+			(size_t)size);
+		l_topic->size = size;
+		l_topic->put_time = iccom_lib_get_time();
+		conflate->stats.put_count++;
+		if (l_topic->pending == ICCOM_LIB_ON) {
+			/* replace the data not sent yet */
+			conflate->stats.conflate_count++;
+		} else {
+			l_topic->pending = ICCOM_LIB_ON;
+			conflate->order[(conflate->head + conflate->count) %
+				conflate->topic_max] =
+				(uint32_t)(l_topic - conflate->topic);
+			conflate->count++;
+			__atomic_store_n(
+				&conflate->channel_info->metrics.conflate_depth,
+				(uint64_t)conflate->count, __ATOMIC_RELAXED);
+			if (conflate->count == 1U) {
+				/* wake up send thread waiting for data */
+				(void)pthread_cond_signal(&conflate->cond);
+			}
+		}
+	}
+
+	(void)pthread_mutex_unlock(&conflate->mutex);
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_conflate_get_stats                                      */
+/*  Function : Get statistics of conflation queue.                           */
+/*  Callinq seq.                                                             */
+/*           iccom_conflate_get_stats(struct iccom_conflate_t *conflate,     */
+/*                                    Iccom_conflate_stats *stats)           */
+/*  Input    : *conflate       : Conflation queue pointer.                   */
+/*  Output   : *stats          : Statistics.                                 */
+/*  Return   : NON                                                           */
+/*  Caller   : Iccom_lib_GetConflateStats                                    */
+/*                                                                           */
+/*****************************************************************************/
+void iccom_conflate_get_stats(struct iccom_conflate_t *conflate,
+			Iccom_conflate_stats *stats)
+{
+	(void)pthread_mutex_lock(&conflate->mutex);
+	*stats = conflate->stats;
+	stats->topic_count = conflate->topic_cnt;
+	stats->depth_count = conflate->count;
+	(void)pthread_mutex_unlock(&conflate->mutex);
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_conflate_send_thread                                    */
+/*  Function : Send the newest data of pending topics in queued order.       */
+/*             When the send fails because CR7 side is not ready, the topic  */
+/*             is sent first again after the retry interval, unless newer    */
+/*             data has been put meanwhile.                                  */
+/*  Callinq seq.                                                             */
+/*           iccom_conflate_send_thread(void *arg)                           */
+/*  Input    : *arg            : Conflation queue pointer                    */
+/*  return   : NULL                                                          */
+/*  Note     : This thread is created in iccom_conflate_create and ends in   */
+/*             iccom_conflate_destroy.                                       */
+/*                                                                           */
+/*****************************************************************************/
+static void *iccom_conflate_send_thread(void *arg)
+{
+	struct iccom_conflate_t *l_conflate;	/* conflation queue          */
+	struct iccom_conflate_topic_t *l_topic;	/* topic to send             */
+	struct timespec l_wake;			/* retry time                */
+	int32_t ret;				/* call function return code */
+	uint32_t l_size;			/* send data size            */
+	uint64_t l_put_time;			/* data put time (ns)        */
+	uint64_t l_time;			/* current time (ns)         */
+
+	l_conflate = (struct iccom_conflate_t *)arg;
+
+	(void)pthread_mutex_lock(&l_conflate->mutex);
+	while (l_conflate->stop == ICCOM_LIB_OFF) {
+		if (l_conflate->count == 0U) {
+			(void)pthread_cond_wait(&l_conflate->cond,
+				&l_conflate->mutex);
+			continue;
+		}
+
+		/* take the oldest pending topic (put may replace it again) */
+		l_topic = &l_conflate->topic[
+			l_conflate->order[l_conflate->head]];
+		l_conflate->head = (l_conflate->head + 1U) %
+			l_conflate->topic_max;
+		l_conflate->count--;
+		__atomic_store_n(
+			&l_conflate->channel_info->metrics.conflate_depth,
+			(uint64_t)l_conflate->count, __ATOMIC_RELAXED);
+		l_topic->pending = ICCOM_LIB_OFF;
+		l_size = l_topic->size;
+		l_put_time = l_topic->put_time;
+		(void)memcpy((void *)l_conflate->buf,
+			(const void *)l_topic->data, (size_t)l_size);
+		(void)pthread_mutex_unlock(&l_conflate->mutex);
+
+		ret = iccom_lib_send_shaped(l_conflate->channel_info,
+			l_conflate->buf, l_size);
+
+		(void)pthread_mutex_lock(&l_conflate->mutex);
+		if ((ret == ICCOM_ERR_TO_SEND) || (ret == ICCOM_ERR_TO_ACK) ||
+		    (ret == ICCOM_ERR_BUF_FULL) || (ret == ICCOM_ERR_RATE) ||
+		    (ret == ICCOM_NG)) {
+			/* link not ready : retry the topic first */
+			l_conflate->stats.retry_count++;
+			if (l_topic->pending == ICCOM_LIB_OFF) {
+				l_topic->pending = ICCOM_LIB_ON;
+				l_conflate->head = (l_conflate->head +
+					l_conflate->topic_max - 1U) %
+					l_conflate->topic_max;
+				l_conflate->order[l_conflate->head] =
+					(uint32_t)(l_topic - l_conflate->topic);
+				l_conflate->count++;
+				__atomic_store_n(&l_conflate->channel_info->
+					metrics.conflate_depth,
+					(uint64_t)l_conflate->count,
+					__ATOMIC_RELAXED);
+			}
+			l_time = iccom_lib_get_time() + l_conflate->retry_time;
+			l_wake.tv_sec = (time_t)(l_time / 1000000000U);
+			l_wake.tv_nsec = (long)(l_time % 1000000000U);
+			if (l_conflate->stop == ICCOM_LIB_OFF) {
+				(void)pthread_cond_timedwait(&l_conflate->cond,
+					&l_conflate->mutex, &l_wake);
+			}
+		} else if (ret == ICCOM_OK) {
+			/* latency : newest data put to sent */
+			l_time = iccom_lib_get_time() - l_put_time;
+			l_conflate->stats.send_count++;
+			l_conflate->stats.latency_total += l_time;
+			if (l_time > l_conflate->stats.latency_max) {
+				l_conflate->stats.latency_max = l_time;
+			}
+		} else {
+			/* data not sendable (not retried) */
+			LIBPRT_ERR("conflated data dropped : size = %u,"
+				" ret = %d", l_size, ret);
+			l_conflate->stats.drop_count++;
+		}
+	}
+	(void)pthread_mutex_unlock(&l_conflate->mutex);
+	return NULL;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_conflate_find_topic                                     */
+/*  Function : Search the topic of topic ID, and add it when unknown         */
+/*             (linear search; a channel has a few status topics).           */
+/*  Callinq seq.                                                             */
+/*           iccom_conflate_find_topic(struct iccom_conflate_t *conflate,    */
+/*                                     uint32_t topic_id)                    */
+/*  Input    : *conflate       : Conflation queue pointer.                   */
+/*             topic_id        : Topic ID.                                   */
+/*  Return   : Topic (NULL: topic table full)                                */
+/*  Caller   : iccom_conflate_put                                            */
+/*  Note     : Called with conflation queue mutex.                           */
+/*                                                                           */
+/*****************************************************************************/
+static struct iccom_conflate_topic_t *iccom_conflate_find_topic(
+			struct iccom_conflate_t *conflate, uint32_t topic_id)
+{
+	struct iccom_conflate_topic_t *l_topic = NULL; /* found topic        */
+	uint32_t l_cnt;				/* loop counter              */
+
+	for (l_cnt = 0U; (l_cnt < conflate->topic_cnt) && (l_topic == NULL);
+	     l_cnt++) {
+		if (conflate->topic[l_cnt].topic_id == topic_id) {
+			l_topic = &conflate->topic[l_cnt];
+		}
+	}
+
+	if ((l_topic == NULL) && (conflate->topic_cnt < conflate->topic_max)) {
+		l_topic = &conflate->topic[conflate->topic_cnt];
+		l_topic->topic_id = topic_id;
+		l_topic->pending = ICCOM_LIB_OFF;
+		conflate->topic_cnt++;
+	}
+	return l_topic;
+}
@@ -0,0 +1,460 @@
+/*
+ * Copyright (c) 2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "iccom.h"
+#include "iccom_library.h"
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#define ICCOM_CRC32C_SSE42		/* SSE4.2 crc32 instruction      */
+#elif defined(__aarch64__)
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#define ICCOM_CRC32C_ARMV8		/* ARMv8 CRC32 instructions      */
+#ifndef HWCAP_CRC32
+#define HWCAP_CRC32 (1UL << 7)
+#endif
+#endif
+
+/*****************************************************************************/
+/* define definition                                                         */
+/*****************************************************************************/
+#define ICCOM_CRC32C_POLY (0x82F63B78U)	/* CRC32C polynomial (reflected) */
+#define ICCOM_CRC32C_SLICE (8U)		/* table slice count             */
+#define ICCOM_CRC32C_LONG (4096U)	/* long stream length (2^n)      */
+#define ICCOM_CRC32C_SHORT (128U)	/* short stream length (2^n)     */
+
+/*****************************************************************************/
+/* typedef definition                                                        */
+/*****************************************************************************/
+/* CRC32C update function (crc : not inverted) */
+typedef uint32_t (*iccom_crc32c_func_t)(uint32_t crc, const uint8_t *buf,
+	uint32_t size);
+
+/*****************************************************************************/
+/* internal function prototype definition                                    */
+/*****************************************************************************/
+/* kernel selection function */
+static void iccom_crc32c_select(void);
+/* table driven (slicing-by-8) kernel */
+static uint32_t iccom_crc32c_table(uint32_t crc, const uint8_t *buf,
+	uint32_t size);
+#ifdef ICCOM_CRC32C_SSE42
+/* zero bytes operator table make function */
+static void iccom_crc32c_zeros(uint32_t zeros[4][256], uint32_t len);
+/* GF(2) 32x32 matrix times vector function */
+static uint32_t iccom_crc32c_gf2_times(const uint32_t *mat, uint32_t vec);
+/* GF(2) 32x32 matrix square function */
+static void iccom_crc32c_gf2_square(uint32_t *square, const uint32_t *mat);
+/* CRC shift over zero bytes function */
+static inline uint32_t iccom_crc32c_shift(const uint32_t zeros[4][256],
+	uint32_t crc);
+/* SSE4.2 kernel */
+static uint32_t iccom_crc32c_sse42(uint32_t crc, const uint8_t *buf,
+	uint32_t size) __attribute__((target("sse4.2")));
+#endif
+#ifdef ICCOM_CRC32C_ARMV8
+/* ARMv8 CRC32 kernel */
+static uint32_t iccom_crc32c_armv8(uint32_t crc, const uint8_t *buf,
+	uint32_t size) __attribute__((target("+crc")));
+#endif
+
+/*****************************************************************************/
+/* global variable                                                           */
+/*****************************************************************************/
+static pthread_once_t g_crc32c_once = PTHREAD_ONCE_INIT;  /* select once */
+static iccom_crc32c_func_t g_crc32c_func;		/* selected kernel   */
+static const char *g_crc32c_name;			/* kernel name       */
+static uint32_t g_crc32c_tbl[ICCOM_CRC32C_SLICE][256];	/* slicing tables    */
+#ifdef ICCOM_CRC32C_SSE42
+static uint32_t g_crc32c_long[4][256];	/* ICCOM_CRC32C_LONG zeros operator  */
+static uint32_t g_crc32c_short[4][256];	/* ICCOM_CRC32C_SHORT zeros operator */
+#endif
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_crc32c                                                  */
+/*  Function : Calculate CRC32C (Castagnoli) of data.                        */
+/*             The fastest kernel of the CPU is selected at the first call.  */
+/*  Callinq seq.                                                             */
+/*           iccom_crc32c(const uint8_t *buf, uint32_t size)                 */
+/*  Input    : *buf            : Data pointer.                               */
+/*             size            : Data size.                                  */
+/*  Return   : CRC32C                                                        */
+/*  Caller   : iccom_lib_send_data, iccom_lib_check_frame                    */
+/*                                                                           */
+/*****************************************************************************/
+uint32_t iccom_crc32c(const uint8_t *buf, uint32_t size)
+{
+	(void)pthread_once(&g_crc32c_once, iccom_crc32c_select);
+	return ~g_crc32c_func(0xFFFFFFFFU, buf, size);
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_crc32c_kernel                                           */
+/*  Function : Get the name of the selected CRC32C kernel.                   */
+/*  Callinq seq.                                                             */
+/*           iccom_crc32c_kernel(void)                                       */
+/*  Input    : NON                                                           */
+/*  Return   : Kernel name ("sse4.2", "armv8" or "table")                    */
+/*  Caller   : Benchmark                                                     */
+/*                                                                           */
+/*****************************************************************************/
+const char *iccom_crc32c_kernel(void)
+{
+	(void)pthread_once(&g_crc32c_once, iccom_crc32c_select);
+	return g_crc32c_name;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_crc32c_select                                           */
+/*  Function : Make the slicing tables and select the CRC32C kernel.         */
+/*  Callinq seq.                                                             */
+/*           iccom_crc32c_select(void)                                       */
+/*  Input    : NON                                                           */
+/*  Return   : NON                                                           */
+/*  Caller   : iccom_crc32c, iccom_crc32c_kernel (pthread_once)              */
+/*                                                                           */
+/*****************************************************************************/
+static void iccom_crc32c_select(void)
+{
+	uint32_t l_crc;				/* CRC value                 */
+	uint32_t l_cnt;				/* loop counter              */
+	uint32_t l_bit;				/* bit loop counter          */
+	uint32_t l_slice;			/* slice loop counter        */
+
+	/* g_crc32c_tbl[0] : CRC of one byte */
+	for (l_cnt = 0U; l_cnt < 256U; l_cnt++) {
+		l_crc = l_cnt;
+		for (l_bit = 0U; l_bit < 8U; l_bit++) {
+			l_crc = ((l_crc & 1U) != 0U) ?
+				((l_crc >> 1) ^ ICCOM_CRC32C_POLY) :
+				(l_crc >> 1);
+		}
+		g_crc32c_tbl[0][l_cnt] = l_crc;
+	}
+	/* g_crc32c_tbl[n] : CRC of one byte followed by n zero bytes */
+	for (l_cnt = 0U; l_cnt < 256U; l_cnt++) {
+		l_crc = g_crc32c_tbl[0][l_cnt];
+		for (l_slice = 1U; l_slice < ICCOM_CRC32C_SLICE; l_slice++) {
+			l_crc = (l_crc >> 8) ^ g_crc32c_tbl[0][l_crc & 0xFFU];
+			g_crc32c_tbl[l_slice][l_cnt] = l_crc;
+		}
+	}
+
+	g_crc32c_func = iccom_crc32c_table;
+	g_crc32c_name = "table";
+#ifdef ICCOM_CRC32C_SSE42
+	if (__builtin_cpu_supports("sse4.2") != 0) {
+		iccom_crc32c_zeros(g_crc32c_long, ICCOM_CRC32C_LONG);
+		iccom_crc32c_zeros(g_crc32c_short, ICCOM_CRC32C_SHORT);
+		g_crc32c_func = iccom_crc32c_sse42;
+		g_crc32c_name = "sse4.2";
+	}
+#endif
+#ifdef ICCOM_CRC32C_ARMV8
+	if ((getauxval(AT_HWCAP) & HWCAP_CRC32) != 0UL) {
+		g_crc32c_func = iccom_crc32c_armv8;
+		g_crc32c_name = "armv8";
+	}
+#endif
+	LIBPRT_DBG("CRC32C kernel : %s", g_crc32c_name);
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_crc32c_table                                            */
+/*  Function : Update CRC32C with slicing-by-8 tables (any CPU).             */
+/*  Callinq seq.                                                             */
+/*           iccom_crc32c_table(uint32_t crc, const uint8_t *buf,            */
+/*                              uint32_t size)                               */
+/*  Input    : crc             : CRC value.                                  */
+/*             *buf            : Data pointer.                               */
+/*             size            : Data size.                                  */
+/*  Return   : Updated CRC value                                             */
+/*  Caller   : iccom_crc32c                                                  */
+/*                                                                           */
+/*****************************************************************************/
+static uint32_t iccom_crc32c_table(uint32_t crc, const uint8_t *buf,
+			uint32_t size)
+{
+	uint32_t l_crc = crc;			/* CRC value                 */
+	uint32_t l_lo;				/* low 4 bytes of block      */
+	uint32_t l_hi;				/* high 4 bytes of block     */
+
+	while (size >= ICCOM_CRC32C_SLICE) {
+		l_lo = l_crc ^ ((uint32_t)buf[0] | ((uint32_t)buf[1] << 8) |
+			((uint32_t)buf[2] << 16) | ((uint32_t)buf[3] << 24));
+		l_hi = (uint32_t)buf[4] | ((uint32_t)buf[5] << 8) |
+			((uint32_t)buf[6] << 16) | ((uint32_t)buf[7] << 24);
+		l_crc = g_crc32c_tbl[7][l_lo & 0xFFU] ^
+			g_crc32c_tbl[6][(l_lo >> 8) & 0xFFU] ^
+			g_crc32c_tbl[5][(l_lo >> 16) & 0xFFU] ^
+			g_crc32c_tbl[4][l_lo >> 24] ^
+			g_crc32c_tbl[3][l_hi & 0xFFU] ^
+			g_crc32c_tbl[2][(l_hi >> 8) & 0xFFU] ^
+			g_crc32c_tbl[1][(l_hi >> 16) & 0xFFU] ^
+			g_crc32c_tbl[0][l_hi >> 24];
+		buf = &buf[ICCOM_CRC32C_SLICE];
+		size -= ICCOM_CRC32C_SLICE;
+	}
+	while (size > 0U) {
+		l_crc = (l_crc >> 8) ^ g_crc32c_tbl[0][(l_crc ^ *buf) & 0xFFU];
+		buf = &buf[1];
+		size--;
+	}
+	return l_crc;
+}
+
+#ifdef ICCOM_CRC32C_SSE42
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_crc32c_zeros                                            */
+/*  Function : Make the table of the operator which applies len zero bytes   */
+/*             to a CRC (iccom_crc32c_shift).                                */
+/*  Callinq seq.                                                             */
+/*           iccom_crc32c_zeros(uint32_t zeros[4][256], uint32_t len)        */
+/*  Input    : len             : Zero byte count (power of 2).               */
+/*  Output   : zeros           : Operator table (one per CRC byte).          */
+/*  Return   : NON                                                           */
+/*  Caller   : iccom_crc32c_select                                           */
+/*                                                                           */
+/*****************************************************************************/
+static void iccom_crc32c_zeros(uint32_t zeros[4][256], uint32_t len)
+{
+	uint32_t l_even[32];			/* operator of 2^(2n) bits   */
+	uint32_t l_odd[32];			/* operator of 2^(2n+1) bits */
+	const uint32_t *l_op = l_even;		/* operator of len bytes     */
+	uint32_t l_row = 1U;			/* matrix row                */
+	uint32_t l_cnt;				/* loop counter              */
+
+	/* l_odd : one zero bit */
+	l_odd[0] = ICCOM_CRC32C_POLY;
+	for (l_cnt = 1U; l_cnt < 32U; l_cnt++) {
+		l_odd[l_cnt] = l_row;
+		l_row <<= 1;
+	}
+	/* square up to 8 x len zero bits */
+	iccom_crc32c_gf2_square(l_even, l_odd);	/* 2 bits  */
+	iccom_crc32c_gf2_square(l_odd, l_even);	/* 4 bits  */
+	while (1) {
+		iccom_crc32c_gf2_square(l_even, l_odd);
+		len >>= 1;
+		if (len == 0U) {
+			l_op = l_even;
+			break;
+		}
+		iccom_crc32c_gf2_square(l_odd, l_even);
+		len >>= 1;
+		if (len == 0U) {
+			l_op = l_odd;
+			break;
+		}
+	}
+
+	for (l_cnt = 0U; l_cnt < 256U; l_cnt++) {
+		zeros[0][l_cnt] = iccom_crc32c_gf2_times(l_op, l_cnt);
+		zeros[1][l_cnt] = iccom_crc32c_gf2_times(l_op, l_cnt << 8);
+		zeros[2][l_cnt] = iccom_crc32c_gf2_times(l_op, l_cnt << 16);
+		zeros[3][l_cnt] = iccom_crc32c_gf2_times(l_op, l_cnt << 24);
+	}
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_crc32c_gf2_times                                        */
+/*  Function : Multiply GF(2) 32x32 matrix by vector.                        */
+/*  Callinq seq.                                                             */
+/*           iccom_crc32c_gf2_times(const uint32_t *mat, uint32_t vec)       */
+/*  Input    : *mat            : Matrix (32 columns).                        */
+/*             vec             : Vector.                                     */
+/*  Return   : Product                                                       */
+/*  Caller   : iccom_crc32c_zeros, iccom_crc32c_gf2_square                   */
+/*                                                                           */
+/*****************************************************************************/
+static uint32_t iccom_crc32c_gf2_times(const uint32_t *mat, uint32_t vec)
+{
+	uint32_t l_sum = 0U;			/* product                   */
+
+	while (vec != 0U) {
+		if ((vec & 1U) != 0U) {
+			l_sum ^= *mat;
+		}
+		vec >>= 1;
+		mat = &mat[1];
+	}
+	return l_sum;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_crc32c_gf2_square                                       */
+/*  Function : Square GF(2) 32x32 matrix.                                    */
+/*  Callinq seq.                                                             */
+/*           iccom_crc32c_gf2_square(uint32_t *square, const uint32_t *mat)  */
+/*  Input    : *mat            : Matrix (32 columns).                        */
+/*  Output   : *square         : Square of matrix (32 columns).              */
+/*  Return   : NON                                                           */
+/*  Caller   : iccom_crc32c_zeros                                            */
+/*                                                                           */
+/*****************************************************************************/
+static void iccom_crc32c_gf2_square(uint32_t *square, const uint32_t *mat)
+{
+	uint32_t l_cnt;				/* loop counter              */
+
+	for (l_cnt = 0U; l_cnt < 32U; l_cnt++) {
+		square[l_cnt] = iccom_crc32c_gf2_times(mat, mat[l_cnt]);
+	}
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_crc32c_shift                                            */
+/*  Function : Apply the zero bytes of operator table to CRC.                */
+/*  Callinq seq.                                                             */
+/*           iccom_crc32c_shift(const uint32_t zeros[4][256], uint32_t crc)  */
+/*  Input    : zeros           : Operator table (iccom_crc32c_zeros).        */
+/*             crc             : CRC value.                                  */
+/*  Return   : CRC value after the zero bytes                                */
+/*  Caller   : iccom_crc32c_sse42                                            */
+/*                                                                           */
+/*****************************************************************************/
+static inline uint32_t iccom_crc32c_shift(const uint32_t zeros[4][256],
+			uint32_t crc)
+{
+	return zeros[0][crc & 0xFFU] ^ zeros[1][(crc >> 8) & 0xFFU] ^
+		zeros[2][(crc >> 16) & 0xFFU] ^ zeros[3][crc >> 24];
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_crc32c_sse42                                            */
+/*  Function : Update CRC32C with SSE4.2 crc32 instruction (8 bytes/step).   */
+/*             Blocks of 3 x ICCOM_CRC32C_LONG (or SHORT) bytes are          */
+/*             calculated as three interleaved streams, so that the          */
+/*             latency of the instruction is hidden, and the CRCs of the     */
+/*             streams are combined with the zero bytes operators.           */
+/*  Callinq seq.                                                             */
+/*           iccom_crc32c_sse42(uint32_t crc, const uint8_t *buf,            */
+/*                              uint32_t size)                               */
+/*  Input    : crc             : CRC value.                                  */
+/*             *buf            : Data pointer.                               */
+/*             size            : Data size.                                  */
+/*  Return   : Updated CRC value                                             */
+/*  Caller   : iccom_crc32c                                                  */
+/*                                                                           */
+/*****************************************************************************/
+static uint32_t iccom_crc32c_sse42(uint32_t crc, const uint8_t *buf,
+			uint32_t size)
+{
+	uint64_t l_crc0 = crc;			/* CRC value (1st stream)    */
+	uint64_t l_crc1;			/* CRC of 2nd stream         */
+	uint64_t l_crc2;			/* CRC of 3rd stream         */
+	uint64_t l_data0;			/* 8 bytes of 1st stream     */
+	uint64_t l_data1;			/* 8 bytes of 2nd stream     */
+	uint64_t l_data2;			/* 8 bytes of 3rd stream     */
+	const uint8_t *l_end;			/* end of 1st stream         */
+
+	while (size >= (3U * ICCOM_CRC32C_LONG)) {
+		l_crc1 = 0U;
+		l_crc2 = 0U;
+		l_end = &buf[ICCOM_CRC32C_LONG];
+		do {
+			(void)memcpy((void *)&l_data0, (const void *)buf, 8U);
+			(void)memcpy((void *)&l_data1,
+				(const void *)&buf[ICCOM_CRC32C_LONG], 8U);
+			(void)memcpy((void *)&l_data2,
+				(const void *)&buf[2U * ICCOM_CRC32C_LONG], 8U);
+			l_crc0 = _mm_crc32_u64(l_crc0, l_data0);
+			l_crc1 = _mm_crc32_u64(l_crc1, l_data1);
+			l_crc2 = _mm_crc32_u64(l_crc2, l_data2);
+			buf = &buf[8];
+		} while (buf < l_end);
+		l_crc0 = iccom_crc32c_shift(g_crc32c_long,
+			(uint32_t)l_crc0) ^ l_crc1;
+		l_crc0 = iccom_crc32c_shift(g_crc32c_long,
+			(uint32_t)l_crc0) ^ l_crc2;
+		buf = &buf[2U * ICCOM_CRC32C_LONG];
+		size -= 3U * ICCOM_CRC32C_LONG;
+	}
+	while (size >= (3U * ICCOM_CRC32C_SHORT)) {
+		l_crc1 = 0U;
+		l_crc2 = 0U;
+		l_end = &buf[ICCOM_CRC32C_SHORT];
+		do {
+			(void)memcpy((void *)&l_data0, (const void *)buf, 8U);
+			(void)memcpy((void *)&l_data1,
+				(const void *)&buf[ICCOM_CRC32C_SHORT], 8U);
+			(void)memcpy((void *)&l_data2,
+				(const void *)&buf[2U * ICCOM_CRC32C_SHORT],
+				8U);
+			l_crc0 = _mm_crc32_u64(l_crc0, l_data0);
+			l_crc1 = _mm_crc32_u64(l_crc1, l_data1);
+			l_crc2 = _mm_crc32_u64(l_crc2, l_data2);
+			buf = &buf[8];
+		} while (buf < l_end);
+		l_crc0 = iccom_crc32c_shift(g_crc32c_short,
+			(uint32_t)l_crc0) ^ l_crc1;
+		l_crc0 = iccom_crc32c_shift(g_crc32c_short,
+			(uint32_t)l_crc0) ^ l_crc2;
+		buf = &buf[2U * ICCOM_CRC32C_SHORT];
+		size -= 3U * ICCOM_CRC32C_SHORT;
+	}
+	while (size >= 8U) {
+		(void)memcpy((void *)&l_data0, (const void *)buf, 8U);
+		l_crc0 = _mm_crc32_u64(l_crc0, l_data0);
+		buf = &buf[8];
+		size -= 8U;
+	}
+	while (size > 0U) {
+		l_crc0 = _mm_crc32_u8((uint32_t)l_crc0, *buf);
+		buf = &buf[1];
+		size--;
+	}
+	return (uint32_t)l_crc0;
+}
+#endif
+
+#ifdef ICCOM_CRC32C_ARMV8
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_crc32c_armv8                                            */
+/*  Function : Update CRC32C with ARMv8 crc32c instructions (8 bytes/step).  */
+/*  Callinq seq.                                                             */
+/*           iccom_crc32c_armv8(uint32_t crc, const uint8_t *buf,            */
+/*                              uint32_t size)                               */
+/*  Input    : crc             : CRC value.                                  */
+/*             *buf            : Data pointer.                               */
+/*             size            : Data size.                                  */
+/*  Return   : Updated CRC value                                             */
+/*  Caller   : iccom_crc32c                                                  */
+/*                                                                           */
+/*****************************************************************************/
+static uint32_t iccom_crc32c_armv8(uint32_t crc, const uint8_t *buf,
+			uint32_t size)
+{
+	uint32_t l_crc = crc;			/* CRC value                 */
+	uint64_t l_data;			/* 8 bytes of data           */
+
+	while (size >= 8U) {
+		(void)memcpy((void *)&l_data, (const void *)buf, 8U);
+		l_crc = __crc32cd(l_crc, l_data);
+		buf = &buf[8];
+		size -= 8U;
+	}
+	while (size > 0U) {
+		l_crc = __crc32cb(l_crc, *buf);
+		buf = &buf[1];
+		size--;
+	}
+	return l_crc;
+}
+#endif
@@ -0,0 +1,843 @@
+/*
+ * Copyright (c) 2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "iccom.h"
+#include "iccom_library.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define ICCOM_DELTA_SSE2		/* SSE2 compare (x86 baseline)   */
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define ICCOM_DELTA_NEON		/* NEON compare (ARMv8 baseline) */
+#endif
+
+/*****************************************************************************/
+/* define definition                                                         */
+/*****************************************************************************/
+#define ICCOM_DELTA_KEY_INTERVAL (64U)	/* keyframe interval default     */
+#define ICCOM_DELTA_VEC_SIZE (16U)	/* vector compare block size     */
+
+/*****************************************************************************/
+/* structure definition                                                      */
+/*****************************************************************************/
+/* stream state (last sent frame or reference frame of receiver) */
+struct iccom_delta_stream_t {
+	uint32_t stream_id;			/* stream ID                 */
+	uint32_t valid;				/* frame valid (ICCOM_LIB_ON)*/
+	uint32_t size;				/* frame size                */
+	uint32_t seq;				/* delta sequence number     */
+	uint32_t diff_cnt;			/* delta frames after key    */
+	uint8_t *frame;				/* frame area                */
+};
+
+/* stream table */
+struct iccom_delta_table_t {
+	struct iccom_delta_stream_t *stream;	/* stream table              */
+	uint8_t *area;				/* frame area of all streams */
+	uint32_t count;				/* used stream count         */
+	uint32_t max;				/* stream max count          */
+};
+
+/* delta encoder and decoder of a channel */
+struct iccom_delta_t {
+	uint32_t frame_max;			/* frame maximum size        */
+	uint32_t key_interval;			/* keyframe interval         */
+	uint32_t id_offset;			/* stream ID byte offset     */
+	uint32_t id_width;			/* stream ID byte width      */
+	uint32_t id_order;			/* stream ID byte order      */
+	struct iccom_delta_table_t tx;		/* sender streams            */
+	struct iccom_delta_table_t rx;		/* receiver streams          */
+	struct iccom_delta_stream_t *tx_stream;	/* stream of frame in send   */
+	const uint8_t *tx_coded;		/* coded data of frame       */
+	Iccom_delta_header tx_header;		/* delta header of frame     */
+	Iccom_delta_stats stats;		/* statistics                */
+	pthread_mutex_t tx_mutex;		/* mutex of sender           */
+	pthread_mutex_t rx_mutex;		/* mutex of receiver         */
+};
+
+/*****************************************************************************/
+/* internal function prototype definition                                    */
+/*****************************************************************************/
+/* stream table creation function */
+static int32_t iccom_delta_table_create(struct iccom_delta_table_t *table,
+	uint32_t stream_max, uint32_t frame_max);
+/* stream table release function */
+static void iccom_delta_table_destroy(struct iccom_delta_table_t *table);
+/* stream search function */
+static struct iccom_delta_stream_t *iccom_delta_find_stream(
+	struct iccom_delta_table_t *table, uint32_t stream_id,
+	uint32_t add);
+/* changed byte ranges encode function */
+static uint32_t iccom_delta_diff(const uint8_t *old_frame,
+	const uint8_t *new_frame, uint32_t size, uint8_t *out,
+	uint32_t *run_count);
+/* changed byte ranges apply function */
+static int32_t iccom_delta_patch(const uint8_t *runs, uint32_t runs_size,
+	uint32_t run_count, uint8_t *frame, uint32_t size);
+/* first changed byte search function */
+static uint32_t iccom_delta_find(const uint8_t *old_frame,
+	const uint8_t *new_frame, uint32_t pos, uint32_t size);
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_delta_create                                            */
+/*  Function : Create delta encoder and decoder of a channel                 */
+/*             (one stream, keyframe every 64 frames).                       */
+/*  Callinq seq.                                                             */
+/*           iccom_delta_create(uint32_t frame_max,                          */
+/*                              struct iccom_delta_t **delta)                */
+/*  Input    : frame_max       : Data maximum size of channel.               */
+/*  Output   : **delta         : Delta encoder pointer.                      */
+/*  Return   : 1. ICCOM_OK           (0)  : Normal                           */
+/*             2. ICCOM_NG           (-1) : Other error                      */
+/*  Caller   : iccom_lib_init_common                                         */
+/*                                                                           */
+/*****************************************************************************/
+int32_t iccom_delta_create(uint32_t frame_max, struct iccom_delta_t **delta)
+{
+	struct iccom_delta_t *l_delta;		/* delta encoder             */
+	int32_t retcode = ICCOM_OK;		/* return code               */
+
+	l_delta = (struct iccom_delta_t *)calloc(1U, sizeof(*l_delta));
+	if (l_delta == NULL) {
+		LIBPRT_ERR("cannot get delta encoder area");
+		retcode = ICCOM_NG;
+	}
+
+	if (retcode == ICCOM_OK) {
+		l_delta->frame_max = frame_max;
+		l_delta->key_interval = ICCOM_DELTA_KEY_INTERVAL;
+		retcode = iccom_delta_table_create(&l_delta->tx, 1U,
+				frame_max);
+		if (retcode == ICCOM_OK) {
+			retcode = iccom_delta_table_create(&l_delta->rx, 1U,
+					frame_max);
+		}
+		if (retcode != ICCOM_OK) {
+			iccom_delta_table_destroy(&l_delta->tx);
+			free(l_delta);
+		}
+	}
+
+	if (retcode == ICCOM_OK) {
+		(void)pthread_mutex_init(&l_delta->tx_mutex, NULL);
+		(void)pthread_mutex_init(&l_delta->rx_mutex, NULL);
+		*delta = l_delta;
+	}
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_delta_destroy                                           */
+/*  Function : Release delta encoder and decoder.                            */
+/*  Callinq seq.                                                             */
+/*           iccom_delta_destroy(struct iccom_delta_t *delta)                */
+/*  Input    : *delta          : Delta encoder pointer (NULL: nothing).      */
+/*  Return   : NON                                                           */
+/*  Caller   : Iccom_lib_Final, iccom_lib_init_common                        */
+/*                                                                           */
+/*****************************************************************************/
+void iccom_delta_destroy(struct iccom_delta_t *delta)
+{
+	if (delta != NULL) {
+		iccom_delta_table_destroy(&delta->tx);
+		iccom_delta_table_destroy(&delta->rx);
+		(void)pthread_mutex_destroy(&delta->tx_mutex);
+		(void)pthread_mutex_destroy(&delta->rx_mutex);
+		free(delta);
+	}
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_delta_config                                            */
+/*  Function : Set keyframe interval and stream ID of delta encoder.         */
+/*             The streams are reset, so the next frame of every stream is   */
+/*             sent as keyframe.                                             */
+/*  Callinq seq.                                                             */
+/*           iccom_delta_config(struct iccom_delta_t *delta,                 */
+/*                              const Iccom_delta_param *param)              */
+/*  Input    : *delta          : Delta encoder pointer.                      */
+/*             *param          : Delta parameter pointer.                    */
+/*  Return   : 1. ICCOM_OK           (0)  : Normal                           */
+/*             2. ICCOM_ERR_PARAM    (-2) : Parameter error                  */
+/*             3. ICCOM_NG           (-1) : Other error                      */
+/*  Caller   : Iccom_lib_DeltaConfig                                         */
+/*                                                                           */
+/*****************************************************************************/
+int32_t iccom_delta_config(struct iccom_delta_t *delta,
+			const Iccom_delta_param *param)
+{
+	struct iccom_delta_table_t l_tx;	/* new sender streams        */
+	struct iccom_delta_table_t l_rx;	/* new receiver streams      */
+	struct iccom_delta_table_t l_old;	/* old streams               */
+	int32_t retcode = ICCOM_OK;		/* return code               */
+	uint32_t l_stream_max;			/* stream max count          */
+
+	l_stream_max = (param->stream_max == 0U) ? 1U : param->stream_max;
+
+	/* check delta parameter contents */
+	if (((param->id_width != 0U) && (param->id_width != 1U) &&
+	     (param->id_width != 2U) && (param->id_width != 4U)) ||
+	    ((param->id_width != 0U) &&
+	     (param->id_offset > (delta->frame_max - param->id_width))) ||
+	    (param->id_order > ICCOM_ID_BIG_ENDIAN) ||
+	    (l_stream_max > ICCOM_DELTA_STREAM_MAX)) {
+		LIBPRT_ERR("parameter err : id_offset = %u, id_width = %u,"
+			" id_order = %u, stream_max = %u",
+			param->id_offset, param->id_width, param->id_order,
+			param->stream_max);
+		retcode = ICCOM_ERR_PARAM;
+	}
+
+	if (retcode == ICCOM_OK) {
+		(void)memset((void *)&l_tx, 0, sizeof(l_tx));
+		(void)memset((void *)&l_rx, 0, sizeof(l_rx));
+		retcode = iccom_delta_table_create(&l_tx, l_stream_max,
+				delta->frame_max);
+		if (retcode == ICCOM_OK) {
+			retcode = iccom_delta_table_create(&l_rx,
+					l_stream_max, delta->frame_max);
+		}
+		if (retcode != ICCOM_OK) {
+			iccom_delta_table_destroy(&l_tx);
+		}
+	}
+
+	if (retcode == ICCOM_OK) {
+		(void)pthread_mutex_lock(&delta->tx_mutex);
+		delta->key_interval = (param->key_interval == 0U) ?
+			ICCOM_DELTA_KEY_INTERVAL : param->key_interval;
+		delta->id_offset = param->id_offset;
+		delta->id_width = param->id_width;
+		delta->id_order = param->id_order;
+		l_old = delta->tx;
+		delta->tx = l_tx;
+		(void)pthread_mutex_unlock(&delta->tx_mutex);
+		iccom_delta_table_destroy(&l_old);
+
+		(void)pthread_mutex_lock(&delta->rx_mutex);
+		l_old = delta->rx;
+		delta->rx = l_rx;
+		(void)pthread_mutex_unlock(&delta->rx_mutex);
+		iccom_delta_table_destroy(&l_old);
+	}
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_delta_encode                                            */
+/*  Function : Encode send data to a keyframe or a delta frame.              */
+/*             A delta frame has the byte ranges changed from the last       */
+/*             frame sent of the stream.  A keyframe is made for the first   */
+/*             frame, a frame of other size, every key_interval frames,      */
+/*             after a send error, or when the delta frame is not smaller.   */
+/*             The sender is locked until iccom_delta_encode_end.            */
+/*  Callinq seq.                                                             */
+/*           iccom_delta_encode(struct iccom_delta_t *delta,                 */
+/*                              const uint8_t *data, uint32_t size,          */
+/*                              uint8_t *out)                                */
+/*  Input    : *delta          : Delta encoder pointer.                      */
+/*             *data           : Send data pointer.                          */
+/*             size            : Send data size.                             */
+/*  Output   : *out            : Coded frame                                 */
+/*                               (ICCOM_DELTA_HEADER_SIZE + size bytes max.) */
+/*  Return   : Coded frame size                                              */
+/*  Caller   : iccom_lib_send_data                                           */
+/*                                                                           */
+/*****************************************************************************/
+uint32_t iccom_delta_encode(struct iccom_delta_t *delta, const uint8_t *data,
+			uint32_t size, uint8_t *out)
+{
+	struct iccom_delta_stream_t *l_stream;	/* stream of data            */
+	uint8_t *l_coded;			/* coded data area           */
+	uint32_t l_coded_size = size;		/* coded data size           */
+	uint32_t l_run_count = 0U;		/* changed byte range count  */
+	uint32_t l_stream_id;			/* stream ID                 */
+
+	(void)pthread_mutex_lock(&delta->tx_mutex);
+
+	/* stream ID (0: one stream, or data shorter than the ID) */
+	(void)iccom_lib_get_id(data, size, delta->id_offset, delta->id_width,
+		delta->id_order, &l_stream_id);
+	l_stream = iccom_delta_find_stream(&delta->tx, l_stream_id,
+			ICCOM_LIB_ON);
+	if (l_stream == NULL) {
+		/* stream table full : keyframe without stream state */
+		delta->stats.stream_over_count++;
+	}
+
+	l_coded = &out[ICCOM_DELTA_HEADER_SIZE];
+	if ((l_stream != NULL) && (l_stream->valid == ICCOM_LIB_ON) &&
+	    (l_stream->size == size) &&
+	    ((l_stream->diff_cnt + 1U) < delta->key_interval)) {
+		l_coded_size = iccom_delta_diff(l_stream->frame, data, size,
+				l_coded, &l_run_count);
+	}
+
+	delta->tx_header.stream_id = l_stream_id;
+	delta->tx_header.seq = (l_stream != NULL) ? (l_stream->seq + 1U) : 0U;
+	delta->tx_header.size = size;
+	if (l_coded_size < size) {
+		delta->tx_header.type = ICCOM_DELTA_DIFF;
+		delta->tx_header.run_count = (uint16_t)l_run_count;
+	} else {
+		/* keyframe */
+		delta->tx_header.type = ICCOM_DELTA_KEY;
+		delta->tx_header.run_count = 0U;
+		(void)memcpy((void *)l_coded, (const void *)data,
+			(size_t)size);
+		l_coded_size = size;
+	}
+	(void)memcpy((void *)out, (const void *)&delta->tx_header,
+		ICCOM_DELTA_HEADER_SIZE);
+
+	delta->tx_stream = l_stream;
+	delta->tx_coded = l_coded;
+	return ICCOM_DELTA_HEADER_SIZE + l_coded_size;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_delta_encode_end                                        */
+/*  Function : Update the last frame of the stream with the send result of   */
+/*             the frame of iccom_delta_encode, and unlock the sender.       */
+/*  Callinq seq.                                                             */
+/*           iccom_delta_encode_end(struct iccom_delta_t *delta,             */
+/*                                  uint32_t coded_size, int32_t result)     */
+/*  Input    : *delta          : Delta encoder pointer.                      */
+/*             coded_size      : Coded frame size.                           */
+/*             result          : Send result (ICCOM_OK: sent).               */
+/*  Return   : NON                                                           */
+/*  Caller   : iccom_lib_send_data                                           */
+/*  Note     : After a send error the peer may not have the frame, so the    */
+/*             next frame of the stream is sent as keyframe.                 */
+/*                                                                           */
+/*****************************************************************************/
+void iccom_delta_encode_end(struct iccom_delta_t *delta, uint32_t coded_size,
+			int32_t result)
+{
+	struct iccom_delta_stream_t *l_stream;	/* stream of frame           */
+	const Iccom_delta_header *l_header;	/* delta header of frame     */
+
+	l_stream = delta->tx_stream;
+	l_header = &delta->tx_header;
+
+	if (result == ICCOM_OK) {
+		if (l_header->type == ICCOM_DELTA_KEY) {
+			delta->stats.key_count++;
+		} else {
+			delta->stats.diff_count++;
+		}
+		delta->stats.data_bytes += l_header->size;
+		delta->stats.coded_bytes += coded_size;
+	}
+
+	if ((l_stream != NULL) && (result == ICCOM_OK)) {
+		if (l_header->type == ICCOM_DELTA_KEY) {
+			(void)memcpy((void *)l_stream->frame,
+				(const void *)delta->tx_coded,
+				(size_t)l_header->size);
+			l_stream->size = l_header->size;
+			l_stream->diff_cnt = 0U;
+		} else {
+			/* the last frame differs only by the ranges */
+			(void)iccom_delta_patch(delta->tx_coded,
+				coded_size - ICCOM_DELTA_HEADER_SIZE,
+				l_header->run_count, l_stream->frame,
+				l_stream->size);
+			l_stream->diff_cnt++;
+		}
+		l_stream->seq = l_header->seq;
+		l_stream->valid = ICCOM_LIB_ON;
+	} else if (l_stream != NULL) {
+		l_stream->seq = l_header->seq;
+		l_stream->valid = ICCOM_LIB_OFF;
+	} else {
+		/* keyframe without stream state */
+	}
+
+	delta->tx_stream = NULL;
+	delta->tx_coded = NULL;
+	(void)pthread_mutex_unlock(&delta->tx_mutex);
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_delta_decode                                            */
+/*  Function : Reconstruct the data of a received keyframe or delta frame.   */
+/*  Callinq seq.                                                             */
+/*           iccom_delta_decode(struct iccom_delta_t *delta,                 */
+/*                              const uint8_t *in, uint32_t in_size,         */
+/*                              uint8_t *out, uint32_t *out_size)            */
+/*  Input    : *delta          : Delta encoder pointer.                      */
+/*             *in             : Coded frame pointer.                        */
+/*             in_size         : Coded frame size.                           */
+/*  Output   : *out            : Data (may overlap the coded frame).         */
+/*             *out_size       : Data size.                                  */
+/*  Return   : 1. ICCOM_OK           (0)  : Normal                           */
+/*             2. ICCOM_ERR_SIZE     (-9) : Malformed frame                  */
+/*             3. ICCOM_ERR_DELTA    (-12): No reference frame               */
+/*  Caller   : iccom_lib_check_frame                                         */
+/*  Note     : A delta frame needs the previous frame of its stream; after   */
+/*             a lost frame the stream is not delivered until a keyframe.    */
+/*                                                                           */
+/*****************************************************************************/
+int32_t iccom_delta_decode(struct iccom_delta_t *delta, const uint8_t *in,
+			uint32_t in_size, uint8_t *out, uint32_t *out_size)
+{
+	struct iccom_delta_stream_t *l_stream;	/* stream of frame           */
+	Iccom_delta_header l_header;		/* delta header              */
+	int32_t retcode = ICCOM_OK;		/* return code               */
+	uint32_t l_add;				/* stream add flag           */
+
+	(void)memcpy((void *)&l_header, (const void *)in,
+		ICCOM_DELTA_HEADER_SIZE);
+
+	(void)pthread_mutex_lock(&delta->rx_mutex);
+
+	if ((l_header.size > delta->frame_max) ||
+	    ((l_header.type != ICCOM_DELTA_KEY) &&
+	     (l_header.type != ICCOM_DELTA_DIFF)) ||
+	    ((l_header.type == ICCOM_DELTA_KEY) &&
+	     ((in_size != (ICCOM_DELTA_HEADER_SIZE + l_header.size)) ||
+	      (l_header.run_count != 0U)))) {
+		LIBPRT_ERR("malformed delta frame : type = %u, size = %u,"
+			" frame size = %u", l_header.type, l_header.size,
+			in_size);
+		delta->stats.format_error_count++;
+		retcode = ICCOM_ERR_SIZE;
+	}
+
+	l_stream = NULL;
+	if (retcode == ICCOM_OK) {
+		/* a keyframe starts a stream */
+		l_add = (l_header.type == ICCOM_DELTA_KEY) ?
+			ICCOM_LIB_ON : ICCOM_LIB_OFF;
+		l_stream = iccom_delta_find_stream(&delta->rx,
+				l_header.stream_id, l_add);
+	}
+
+	if ((retcode == ICCOM_OK) && (l_header.type == ICCOM_DELTA_KEY)) {
+		if (l_stream != NULL) {
+			(void)memcpy((void *)l_stream->frame,
+				(const void *)&in[ICCOM_DELTA_HEADER_SIZE],
+				(size_t)l_header.size);
+			l_stream->size = l_header.size;
+			l_stream->seq = l_header.seq;
+			l_stream->valid = ICCOM_LIB_ON;
+		} else {
+			delta->stats.stream_over_count++;
+		}
+		(void)memmove((void *)out,
+			(const void *)&in[ICCOM_DELTA_HEADER_SIZE],
+			(size_t)l_header.size);
+		delta->stats.recv_key_count++;
+	} else if (retcode == ICCOM_OK) {
+		if ((l_stream == NULL) || (l_stream->valid != ICCOM_LIB_ON) ||
+		    (l_stream->size != l_header.size) ||
+		    (l_stream->seq != (l_header.seq - 1U))) {
+			LIBPRT_ERR("no reference frame : stream ID = %u,"
+				" seq = %u", l_header.stream_id,
+				l_header.seq);
+			delta->stats.desync_count++;
+			retcode = ICCOM_ERR_DELTA;
+		} else {
+			retcode = iccom_delta_patch(
+				&in[ICCOM_DELTA_HEADER_SIZE],
+				in_size - ICCOM_DELTA_HEADER_SIZE,
+				l_header.run_count, l_stream->frame,
+				l_stream->size);
+			if (retcode != ICCOM_OK) {
+				LIBPRT_ERR("malformed delta frame :"
+					" run count = %u, frame size = %u",
+					l_header.run_count, in_size);
+				delta->stats.format_error_count++;
+			}
+		}
+		if (retcode == ICCOM_OK) {
+			l_stream->seq = l_header.seq;
+			(void)memcpy((void *)out,
+				(const void *)l_stream->frame,
+				(size_t)l_header.size);
+			delta->stats.recv_diff_count++;
+		} else if (l_stream != NULL) {
+			/* wait for keyframe */
+			l_stream->valid = ICCOM_LIB_OFF;
+		} else {
+			/* unknown stream */
+		}
+	} else {
+		/* malformed frame */
+	}
+
+	(void)pthread_mutex_unlock(&delta->rx_mutex);
+
+	if (retcode == ICCOM_OK) {
+		*out_size = l_header.size;
+	}
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_delta_get_stats                                         */
+/*  Function : Get statistics of delta encoder and decoder.                  */
+/*  Callinq seq.                                                             */
+/*           iccom_delta_get_stats(struct iccom_delta_t *delta,              */
+/*                                 Iccom_delta_stats *stats)                 */
+/*  Input    : *delta          : Delta encoder pointer.                      */
+/*  Output   : *stats          : Statistics.                                 */
+/*  Return   : NON                                                           */
+/*  Caller   : Iccom_lib_GetDeltaStats                                       */
+/*                                                                           */
+/*****************************************************************************/
+void iccom_delta_get_stats(struct iccom_delta_t *delta,
+			Iccom_delta_stats *stats)
+{
+	(void)pthread_mutex_lock(&delta->tx_mutex);
+	(void)pthread_mutex_lock(&delta->rx_mutex);
+	*stats = delta->stats;
+	(void)pthread_mutex_unlock(&delta->rx_mutex);
+	(void)pthread_mutex_unlock(&delta->tx_mutex);
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_delta_kernel                                            */
+/*  Function : Get the name of the changed byte search kernel.               */
+/*  Callinq seq.                                                             */
+/*           iccom_delta_kernel(void)                                        */
+/*  Input    : NON                                                           */
+/*  Return   : Kernel name ("sse2", "neon" or "scalar")                      */
+/*  Caller   : Benchmark                                                     */
+/*                                                                           */
+/*****************************************************************************/
+const char *iccom_delta_kernel(void)
+{
+#if defined(ICCOM_DELTA_SSE2)
+	return "sse2";
+#elif defined(ICCOM_DELTA_NEON)
+	return "neon";
+#else
+	return "scalar";
+#endif
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_delta_table_create                                      */
+/*  Function : Get stream table and frame area of the streams.               */
+/*  Callinq seq.                                                             */
+/*           iccom_delta_table_create(struct iccom_delta_table_t *table,     */
+/*                                    uint32_t stream_max,                   */
+/*                                    uint32_t frame_max)                    */
+/*  Input    : stream_max      : Stream max count.                           */
+/*             frame_max       : Frame maximum size.                         */
+/*  Output   : *table          : Stream table.                               */
+/*  Return   : 1. ICCOM_OK           (0)  : Normal                           */
+/*             2. ICCOM_NG           (-1) : Other error                      */
+/*  Caller   : iccom_delta_create, iccom_delta_config                        */
+/*                                                                           */
+/*****************************************************************************/
+static int32_t iccom_delta_table_create(struct iccom_delta_table_t *table,
+			uint32_t stream_max, uint32_t frame_max)
+{
+	int32_t retcode = ICCOM_OK;		/* return code               */
+	uint32_t l_cnt;				/* loop counter              */
+
+	table->count = 0U;
+	table->max = stream_max;
+	table->stream = (struct iccom_delta_stream_t *)calloc(
+		(size_t)stream_max, sizeof(*table->stream));
+	table->area = (uint8_t *)malloc((size_t)stream_max *
+		(size_t)frame_max);
+	if ((table->stream == NULL) || (table->area == NULL)) {
+		LIBPRT_ERR("cannot get delta stream area : stream_max = %u",
+			stream_max);
+		iccom_delta_table_destroy(table);
+		retcode = ICCOM_NG;
+	}
+
+	if (retcode == ICCOM_OK) {
+		for (l_cnt = 0U; l_cnt < stream_max; l_cnt++) {
+			table->stream[l_cnt].frame =
+				&table->area[(size_t)l_cnt * frame_max];
+		}
+	}
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_delta_table_destroy                                     */
+/*  Function : Release stream table.                                         */
+/*  Callinq seq.                                                             */
+/*           iccom_delta_table_destroy(struct iccom_delta_table_t *table)    */
+/*  Input    : *table          : Stream table.                               */
+/*  Return   : NON                                                           */
+/*  Caller   : iccom_delta_destroy, iccom_delta_config,                      */
+/*             iccom_delta_table_create                                      */
+/*                                                                           */
+/*****************************************************************************/
+static void iccom_delta_table_destroy(struct iccom_delta_table_t *table)
+{
+	free(table->stream);
+	free(table->area);
+	table->stream = NULL;
+	table->area = NULL;
+	table->count = 0U;
+	table->max = 0U;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_delta_find_stream                                       */
+/*  Function : Search the stream of stream ID (linear search; a channel      */
+/*             has a few streams).                                           */
+/*  Callinq seq.                                                             */
+/*           iccom_delta_find_stream(struct iccom_delta_table_t *table,      */
+/*                                   uint32_t stream_id, uint32_t add)       */
+/*  Input    : *table          : Stream table.                               */
+/*             stream_id       : Stream ID.                                  */
+/*             add             : ICCOM_LIB_ON : add unknown stream.          */
+/*  Return   : Stream (NULL: unknown stream or table full)                   */
+/*  Caller   : iccom_delta_encode, iccom_delta_decode                        */
+/*                                                                           */
+/*****************************************************************************/
+static struct iccom_delta_stream_t *iccom_delta_find_stream(
+			struct iccom_delta_table_t *table, uint32_t stream_id,
+			uint32_t add)
+{
+	struct iccom_delta_stream_t *l_stream = NULL; /* found stream        */
+	uint32_t l_cnt;				/* loop counter              */
+
+	for (l_cnt = 0U; (l_cnt < table->count) && (l_stream == NULL);
+	     l_cnt++) {
+		if (table->stream[l_cnt].stream_id == stream_id) {
+			l_stream = &table->stream[l_cnt];
+		}
+	}
+
+	if ((l_stream == NULL) && (add == ICCOM_LIB_ON) &&
+	    (table->count < table->max)) {
+		l_stream = &table->stream[table->count];
+		l_stream->stream_id = stream_id;
+		l_stream->valid = ICCOM_LIB_OFF;
+		l_stream->size = 0U;
+		l_stream->seq = 0U;
+		l_stream->diff_cnt = 0U;
+		table->count++;
+	}
+	return l_stream;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_delta_diff                                              */
+/*  Function : Encode the byte ranges of new frame changed from old frame.   */
+/*             Each range is ICCOM_DELTA_RUN_SIZE bytes of offset and        */
+/*             length (16 bits, little endian) followed by the new bytes.    */
+/*             Ranges separated by ICCOM_DELTA_RUN_SIZE unchanged bytes or   */
+/*             less are merged, because the range header is not smaller.    */
+/*  Callinq seq.                                                             */
+/*           iccom_delta_diff(const uint8_t *old_frame,                      */
+/*                            const uint8_t *new_frame, uint32_t size,       */
+/*                            uint8_t *out, uint32_t *run_count)             */
+/*  Input    : *old_frame      : Last frame sent.                            */
+/*             *new_frame      : Frame to send.                              */
+/*             size            : Frame size.                                 */
+/*  Output   : *out            : Changed byte ranges (size bytes max.)       */
+/*             *run_count      : Range count.                                */
+/*  Return   : Encoded size (size : not smaller than the frame)              */
+/*  Caller   : iccom_delta_encode                                            */
+/*                                                                           */
+/*****************************************************************************/
+static uint32_t iccom_delta_diff(const uint8_t *old_frame,
+			const uint8_t *new_frame, uint32_t size, uint8_t *out,
+			uint32_t *run_count)
+{
+	uint32_t l_out_size = 0U;		/* encoded size              */
+	uint32_t l_run_count = 0U;		/* range count               */
+	uint32_t l_pos;				/* range start               */
+	uint32_t l_end;				/* range end                 */
+	uint32_t l_next;			/* next changed byte         */
+	uint32_t l_len;				/* range length              */
+
+	l_pos = iccom_delta_find(old_frame, new_frame, 0U, size);
+	while ((l_pos < size) && (l_out_size < size)) {
+		/* extend range over short unchanged gaps */
+		l_end = l_pos + 1U;
+		l_next = iccom_delta_find(old_frame, new_frame, l_end, size);
+		while ((l_next < size) &&
+		       ((l_next - l_end) <= ICCOM_DELTA_RUN_SIZE)) {
+			l_end = l_next + 1U;
+			l_next = iccom_delta_find(old_frame, new_frame,
+					l_end, size);
+		}
+		l_len = l_end - l_pos;
+
+		if ((l_out_size + ICCOM_DELTA_RUN_SIZE + l_len) >= size) {
+			/* not smaller than keyframe */
+			l_out_size = size;
+		} else {
+			out[l_out_size] = (uint8_t)l_pos;
+			out[l_out_size + 1U] = (uint8_t)(l_pos >> 8);
+			out[l_out_size + 2U] = (uint8_t)l_len;
+			out[l_out_size + 3U] = (uint8_t)(l_len >> 8);
+			(void)memcpy((void *)&out[l_out_size +
+				ICCOM_DELTA_RUN_SIZE],
+				(const void *)&new_frame[l_pos],
+				(size_t)l_len);
+			l_out_size += ICCOM_DELTA_RUN_SIZE + l_len;
+			l_run_count++;
+		}
+		l_pos = l_next;
+	}
+
+	*run_count = l_run_count;
+	return l_out_size;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_delta_patch                                             */
+/*  Function : Apply changed byte ranges to frame.                           */
+/*  Callinq seq.                                                             */
+/*           iccom_delta_patch(const uint8_t *runs, uint32_t runs_size,      */
+/*                             uint32_t run_count, uint8_t *frame,           */
+/*                             uint32_t size)                                */
+/*  Input    : *runs           : Changed byte ranges.                        */
+/*             runs_size       : Changed byte ranges size.                   */
+/*             run_count       : Range count.                                */
+/*             *frame          : Frame.                                      */
+/*             size            : Frame size.                                 */
+/*  Output   : *frame          : Updated frame.                              */
+/*  Return   : 1. ICCOM_OK           (0)  : Normal                           */
+/*             2. ICCOM_ERR_SIZE     (-9) : Range out of frame                */
+/*  Caller   : iccom_delta_encode_end, iccom_delta_decode                    */
+/*  Note     : The frame may be partly updated when ICCOM_ERR_SIZE.          */
+/*                                                                           */
+/*****************************************************************************/
+static int32_t iccom_delta_patch(const uint8_t *runs, uint32_t runs_size,
+			uint32_t run_count, uint8_t *frame, uint32_t size)
+{
+	int32_t retcode = ICCOM_OK;		/* return code               */
+	uint32_t l_pos = 0U;			/* read position of ranges   */
+	uint32_t l_cnt;				/* loop counter              */
+	uint32_t l_offset;			/* range offset              */
+	uint32_t l_len;				/* range length              */
+
+	for (l_cnt = 0U; (l_cnt < run_count) && (retcode == ICCOM_OK);
+	     l_cnt++) {
+		if ((runs_size - l_pos) < ICCOM_DELTA_RUN_SIZE) {
+			retcode = ICCOM_ERR_SIZE;
+		} else {
+			l_offset = (uint32_t)runs[l_pos] |
+				((uint32_t)runs[l_pos + 1U] << 8);
+			l_len = (uint32_t)runs[l_pos + 2U] |
+				((uint32_t)runs[l_pos + 3U] << 8);
+			l_pos += ICCOM_DELTA_RUN_SIZE;
+			if ((l_offset > size) || (l_len > (size - l_offset)) ||
+			    (l_len > (runs_size - l_pos))) {
+				retcode = ICCOM_ERR_SIZE;
+			} else {
+				(void)memcpy((void *)&frame[l_offset],
+					(const void *)&runs[l_pos],
+					(size_t)l_len);
+				l_pos += l_len;
+			}
+		}
+	}
+
+	if ((retcode == ICCOM_OK) && (l_pos != runs_size)) {
+		retcode = ICCOM_ERR_SIZE;
+	}
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_delta_find                                              */
+/*  Function : Search the first byte changed from old frame.                 */
+/*             16 bytes are compared at a time with SSE2 or NEON.            */
+/*  Callinq seq.                                                             */
+/*           iccom_delta_find(const uint8_t *old_frame,                      */
+/*                            const uint8_t *new_frame, uint32_t pos,        */
+/*                            uint32_t size)                                 */
+/*  Input    : *old_frame      : Last frame sent.                            */
+/*             *new_frame      : Frame to send.                              */
+/*             pos             : Search start position.                      */
+/*             size            : Frame size.                                 */
+/*  Return   : Position of changed byte (size: not found)                    */
+/*  Caller   : iccom_delta_diff                                              */
+/*                                                                           */
+/*****************************************************************************/
+static uint32_t iccom_delta_find(const uint8_t *old_frame,
+			const uint8_t *new_frame, uint32_t pos, uint32_t size)
+{
+	uint32_t l_pos = pos;			/* search position           */
+#if defined(ICCOM_DELTA_SSE2)
+	__m128i l_old;				/* 16 bytes of old frame     */
+	__m128i l_new;				/* 16 bytes of new frame     */
+	uint32_t l_mask = 0U;			/* changed byte bit mask     */
+
+	while (((l_pos + ICCOM_DELTA_VEC_SIZE) <= size) && (l_mask == 0U)) {
+		l_old = _mm_loadu_si128((const __m128i *)&old_frame[l_pos]);
+		l_new = _mm_loadu_si128((const __m128i *)&new_frame[l_pos]);
+		l_mask = (uint32_t)_mm_movemask_epi8(
+			_mm_cmpeq_epi8(l_old, l_new)) ^ 0xFFFFU;
+		if (l_mask == 0U) {
+			l_pos += ICCOM_DELTA_VEC_SIZE;
+		}
+	}
+	if (l_mask != 0U) {
+		l_pos += (uint32_t)__builtin_ctz(l_mask);
+	}
+#elif defined(ICCOM_DELTA_NEON)
+	uint8x16_t l_xor;			/* changed bits of 16 bytes  */
+	uint32_t l_found = ICCOM_LIB_OFF;	/* changed block found       */
+
+	while (((l_pos + ICCOM_DELTA_VEC_SIZE) <= size) &&
+	       (l_found == ICCOM_LIB_OFF)) {
+		l_xor = veorq_u8(vld1q_u8(&old_frame[l_pos]),
+			vld1q_u8(&new_frame[l_pos]));
+		if (vmaxvq_u8(l_xor) != 0U) {
+			l_found = ICCOM_LIB_ON;
+		} else {
+			l_pos += ICCOM_DELTA_VEC_SIZE;
+		}
+	}
+#else
+	uint64_t l_old;				/* 8 bytes of old frame      */
+	uint64_t l_new;				/* 8 bytes of new frame      */
+	uint32_t l_found = ICCOM_LIB_OFF;	/* changed word found        */
+
+	while (((l_pos + 8U) <= size) && (l_found == ICCOM_LIB_OFF)) {
+		(void)memcpy((void *)&l_old, (const void *)&old_frame[l_pos],
+			8U);
+		(void)memcpy((void *)&l_new, (const void *)&new_frame[l_pos],
+			8U);
+		if (l_old != l_new) {
+			l_found = ICCOM_LIB_ON;
+		} else {
+			l_pos += 8U;
+		}
+	}
+#endif
+	/* changed byte in the block, or the tail */
+	while ((l_pos < size) && (old_frame[l_pos] == new_frame[l_pos])) {
+		l_pos++;
+	}
+	return l_pos;
+}
@@ -0,0 +1,487 @@
+/*
+ * Copyright (c) 2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <string.h>
+#include "iccom.h"
+#include "iccom_library.h"
+
+/*****************************************************************************/
+/* define definition                                                         */
+/*****************************************************************************/
+#define ICCOM_DISPATCH_HASH_MUL (0x9E3779B1U)	/* Fibonacci hash multiplier */
+#define ICCOM_DISPATCH_SLOT_MIN (8U)		/* hash slot minimum count   */
+
+/*****************************************************************************/
+/* structure definition                                                      */
+/*****************************************************************************/
+/* message handler statistics entry */
+struct iccom_dispatch_entry_t {
+	uint32_t msg_id;			/* message ID                */
+	uint64_t count;				/* handler call count        */
+	uint64_t total_time;			/* handler total time (ns)   */
+	uint64_t max_time;			/* handler maximum time (ns) */
+};
+
+/* message handler (updated in place, read under its sequence count) */
+struct iccom_dispatch_handler_t {
+	uint32_t seq;				/* update count (odd: update)*/
+	Iccom_msg_handler_t handler;		/* handler (NULL: not regist)*/
+	void *user_data;			/* handler user data         */
+};
+
+/* hash slot (8 bytes, probed linearly, never emptied once used) */
+struct iccom_dispatch_slot_t {
+	uint32_t msg_id;			/* message ID                */
+	uint32_t entry_no;			/* entry index + 1 (0: empty)*/
+};
+
+/* message ID dispatch table */
+struct iccom_dispatch_t {
+	uint32_t id_offset;			/* message ID byte offset    */
+	uint32_t id_width;			/* message ID byte width     */
+	uint32_t id_order;			/* message ID byte order     */
+	uint32_t slot_mask;			/* hash slot count - 1       */
+	uint32_t hash_shift;			/* hash value shift count    */
+	uint32_t entry_max;			/* entry count (with default)*/
+	uint32_t entry_cnt;			/* used entry count          */
+	struct iccom_dispatch_slot_t *slot;	/* hash slot table           */
+	struct iccom_dispatch_handler_t *handler; /* handler ([0]: default)  */
+	struct iccom_dispatch_entry_t *entry;	/* statistics ([0]: default) */
+	pthread_mutex_t mutex;			/* mutex of table update     */
+};
+
+/*****************************************************************************/
+/* internal function prototype definition                                    */
+/*****************************************************************************/
+/* hash slot search function */
+static struct iccom_dispatch_slot_t *iccom_dispatch_find_slot(
+	const struct iccom_dispatch_t *dispatch, uint32_t msg_id);
+/* message handler update function */
+static void iccom_dispatch_set_handler(
+	struct iccom_dispatch_handler_t *handler,
+	Iccom_msg_handler_t func, void *user_data);
+/* message handler read function */
+static void iccom_dispatch_get_handler(
+	struct iccom_dispatch_handler_t *handler,
+	Iccom_msg_handler_t *func, void **user_data);
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_dispatch_create                                         */
+/*  Function : Create message ID dispatch table.                             */
+/*             The hash slot table has at least twice as many slots as       */
+/*             registrable IDs, so that a lookup usually needs one probe.    */
+/*  Callinq seq.                                                             */
+/*           iccom_dispatch_create(const Iccom_dispatch_param *param,        */
+/*                                 struct iccom_dispatch_t **dispatch)       */
+/*  Input    : *param          : Dispatch parameter pointer.                 */
+/*  Output   : **dispatch      : Dispatch table pointer.                     */
+/*  Return   : 1. ICCOM_OK           (0)  : Normal                           */
+/*             2. ICCOM_ERR_PARAM    (-2) : Parameter error                  */
+/*             3. ICCOM_NG           (-1) : Other error                      */
+/*  Caller   : Iccom_lib_DispatchConfig                                      */
+/*                                                                           */
+/*****************************************************************************/
+int32_t iccom_dispatch_create(const Iccom_dispatch_param *param,
+			struct iccom_dispatch_t **dispatch)
+{
+	struct iccom_dispatch_t *l_dispatch = NULL; /* dispatch table        */
+	int32_t retcode = ICCOM_OK;		/* return code               */
+	uint32_t l_slot_cnt;			/* hash slot count           */
+	uint32_t l_bits;			/* hash slot count bits      */
+
+	/* check dispatch parameter contents */
+	if (((param->id_width != 1U) && (param->id_width != 2U) &&
+	     (param->id_width != 4U)) ||
+	    (param->id_offset > (ICCOM_FRAME_MAX_SIZE - param->id_width)) ||
+	    (param->id_order > ICCOM_ID_BIG_ENDIAN) ||
+	    (param->id_max_count == 0U) ||
+	    (param->id_max_count > ICCOM_DISPATCH_ID_MAX)) {
+		LIBPRT_ERR("parameter err : id_offset = %u, id_width = %u,"
+			" id_order = %u, id_max_count = %u",
+			param->id_offset, param->id_width, param->id_order,
+			param->id_max_count);
+		retcode = ICCOM_ERR_PARAM;
+	}
+
+	if (retcode == ICCOM_OK) {
+		l_dispatch = (struct iccom_dispatch_t *)calloc(1U,
+			sizeof(*l_dispatch));
+		if (l_dispatch == NULL) {
+			LIBPRT_ERR("cannot get dispatch table area");
+			retcode = ICCOM_NG;
+		}
+	}
+
+	if (retcode == ICCOM_OK) {
+		/* hash slot count : power of 2, 2 times of ID count or more */
+		l_slot_cnt = ICCOM_DISPATCH_SLOT_MIN;
+		l_bits = 3U;
+		while (l_slot_cnt < (param->id_max_count * 2U)) {
+			l_slot_cnt <<= 1;
+			l_bits++;
+		}
+		l_dispatch->id_offset = param->id_offset;
+		l_dispatch->id_width = param->id_width;
+		l_dispatch->id_order = param->id_order;
+		l_dispatch->slot_mask = l_slot_cnt - 1U;
+		l_dispatch->hash_shift = 32U - l_bits;
+		l_dispatch->entry_max = param->id_max_count + 1U;
+		l_dispatch->slot = (struct iccom_dispatch_slot_t *)calloc(
+			(size_t)l_slot_cnt, sizeof(*l_dispatch->slot));
+		l_dispatch->handler = (struct iccom_dispatch_handler_t *)
+			calloc((size_t)l_dispatch->entry_max,
+			sizeof(*l_dispatch->handler));
+		l_dispatch->entry = (struct iccom_dispatch_entry_t *)calloc(
+			(size_t)l_dispatch->entry_max,
+			sizeof(*l_dispatch->entry));
+		if ((l_dispatch->slot == NULL) ||
+		    (l_dispatch->handler == NULL) ||
+		    (l_dispatch->entry == NULL)) {
+			LIBPRT_ERR("cannot get dispatch table area");
+			retcode = ICCOM_NG;
+		}
+	}
+
+	if (retcode == ICCOM_OK) {
+		/* entry[0] : default handler */
+		l_dispatch->entry_cnt = 1U;
+		l_dispatch->handler[0].handler = param->default_handler;
+		l_dispatch->handler[0].user_data = param->default_user_data;
+		(void)pthread_mutex_init(&l_dispatch->mutex, NULL);
+		*dispatch = l_dispatch;
+	} else {
+		if (l_dispatch != NULL) {
+			free(l_dispatch->slot);
+			free(l_dispatch->handler);
+			free(l_dispatch->entry);
+			free(l_dispatch);
+		}
+	}
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_dispatch_destroy                                        */
+/*  Function : Release message ID dispatch table.                            */
+/*  Callinq seq.                                                             */
+/*           iccom_dispatch_destroy(struct iccom_dispatch_t *dispatch)       */
+/*  Input    : *dispatch       : Dispatch table pointer.                     */
+/*  Return   : NON                                                           */
+/*  Caller   : Iccom_lib_Final                                               */
+/*                                                                           */
+/*****************************************************************************/
+void iccom_dispatch_destroy(struct iccom_dispatch_t *dispatch)
+{
+	if (dispatch != NULL) {
+		(void)pthread_mutex_destroy(&dispatch->mutex);
+		free(dispatch->slot);
+		free(dispatch->handler);
+		free(dispatch->entry);
+		free(dispatch);
+	}
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_dispatch_register                                       */
+/*  Function : Register (or unregister) message handler of message ID.       */
+/*             An unregistered ID keeps its entry, so that its statistics    */
+/*             remain and registering it again needs no new entry.           */
+/*             The receive thread reads the tables without lock: a new slot  */
+/*             is published by the release store of its entry number, after  */
+/*             its handler, and a handler is updated in place under its      */
+/*             sequence count (iccom_dispatch_set_handler).                  */
+/*  Callinq seq.                                                             */
+/*           iccom_dispatch_register(struct iccom_dispatch_t *dispatch,      */
+/*                                   uint32_t msg_id,                        */
+/*                                   Iccom_msg_handler_t handler,            */
+/*                                   void *user_data)                        */
+/*  Input    : *dispatch       : Dispatch table pointer.                     */
+/*             msg_id          : Message ID.                                 */
+/*             handler         : Message handler (NULL: unregister).         */
+/*             *user_data      : Handler user data.                          */
+/*  Return   : 1. ICCOM_OK           (0)  : Normal                           */
+/*             2. ICCOM_ERR_PARAM    (-2) : Registered ID count over         */
+/*  Caller   : Iccom_lib_DispatchRegister                                    */
+/*                                                                           */
+/*****************************************************************************/
+int32_t iccom_dispatch_register(struct iccom_dispatch_t *dispatch,
+			uint32_t msg_id, Iccom_msg_handler_t handler,
+			void *user_data)
+{
+	struct iccom_dispatch_slot_t *l_slot;	/* hash slot                 */
+	uint32_t l_entry_no = 0U;		/* entry index + 1           */
+	int32_t retcode = ICCOM_OK;		/* return code               */
+
+	(void)pthread_mutex_lock(&dispatch->mutex);
+
+	/* only this function (with the mutex) writes the tables */
+	l_slot = iccom_dispatch_find_slot(dispatch, msg_id);
+	if (l_slot->entry_no != 0U) {
+		/* registered already */
+		l_entry_no = l_slot->entry_no;
+		iccom_dispatch_set_handler(&dispatch->handler[l_entry_no - 1U],
+			handler, user_data);
+	} else if (handler == NULL) {
+		/* unregister of unknown ID : nothing to do */
+	} else if (dispatch->entry_cnt >= dispatch->entry_max) {
+		LIBPRT_ERR("registered ID count over : msg_id = %u, max = %u",
+			msg_id, dispatch->entry_max - 1U);
+		retcode = ICCOM_ERR_PARAM;
+	} else {
+		/* use new entry (not read by the receive thread yet) */
+		l_entry_no = dispatch->entry_cnt + 1U;
+		dispatch->entry[l_entry_no - 1U].msg_id = msg_id;
+		dispatch->handler[l_entry_no - 1U].handler = handler;
+		dispatch->handler[l_entry_no - 1U].user_data = user_data;
+		dispatch->entry_cnt = l_entry_no;
+		l_slot->msg_id = msg_id;
+		__atomic_store_n(&l_slot->entry_no, l_entry_no,
+			__ATOMIC_RELEASE);
+	}
+
+	(void)pthread_mutex_unlock(&dispatch->mutex);
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_dispatch_lookup                                         */
+/*  Function : Get message ID of received data and its message handler.     */
+/*  Callinq seq.                                                             */
+/*           iccom_dispatch_lookup(struct iccom_dispatch_t *dispatch,        */
+/*                                 const uint8_t *recv_buf,                  */
+/*                                 uint32_t recv_size,                       */
+/*                                 uint32_t *msg_id,                         */
+/*                                 Iccom_msg_handler_t *handler,             */
+/*                                 void **user_data)                         */
+/*  Input    : *dispatch       : Dispatch table pointer.                     */
+/*             *recv_buf       : Received data pointer.                      */
+/*             recv_size       : Received data size.                         */
+/*  Output   : *msg_id         : Message ID (0: data too short).             */
+/*             *handler        : Message handler (NULL: callback function).  */
+/*             **user_data     : Handler user data.                          */
+/*  Return   : Entry of statistics (iccom_dispatch_account)                  */
+/*  Caller   : iccom_lib_deliver                                             */
+/*  Note     : The tables are read without lock (see                         */
+/*             iccom_dispatch_register).                                     */
+/*                                                                           */
+/*****************************************************************************/
+struct iccom_dispatch_entry_t *iccom_dispatch_lookup(
+			struct iccom_dispatch_t *dispatch,
+			const uint8_t *recv_buf, uint32_t recv_size,
+			uint32_t *msg_id, Iccom_msg_handler_t *handler,
+			void **user_data)
+{
+	const struct iccom_dispatch_slot_t *l_slot; /* hash slot             */
+	Iccom_msg_handler_t l_func;		/* message handler           */
+	void *l_user_data;			/* handler user data         */
+	uint32_t l_idx = 0U;			/* entry index (0: default)  */
+	uint32_t l_msg_id;			/* message ID                */
+	uint32_t l_entry_no;			/* entry index + 1           */
+
+	/* get message ID */
+	if (iccom_lib_get_id(recv_buf, recv_size, dispatch->id_offset,
+		dispatch->id_width, dispatch->id_order, &l_msg_id) ==
+	    ICCOM_OK) {
+		l_slot = iccom_dispatch_find_slot(dispatch, l_msg_id);
+		l_entry_no = __atomic_load_n(&l_slot->entry_no,
+			__ATOMIC_ACQUIRE);
+		if (l_entry_no != 0U) {
+			l_idx = l_entry_no - 1U;
+		}
+	}
+
+	iccom_dispatch_get_handler(&dispatch->handler[l_idx], &l_func,
+		&l_user_data);
+	if ((l_func == NULL) && (l_idx != 0U)) {
+		/* unregistered ID : default handler */
+		l_idx = 0U;
+		iccom_dispatch_get_handler(&dispatch->handler[0], &l_func,
+			&l_user_data);
+	}
+
+	*msg_id = l_msg_id;
+	*handler = l_func;
+	*user_data = l_user_data;
+
+	return &dispatch->entry[l_idx];
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_dispatch_account                                        */
+/*  Function : Add one handler call to statistics of entry.                  */
+/*  Callinq seq.                                                             */
+/*           iccom_dispatch_account(struct iccom_dispatch_entry_t *entry,    */
+/*                                  uint64_t time)                           */
+/*  Input    : *entry          : Entry of iccom_dispatch_lookup.             */
+/*             time            : Handler time (ns).                          */
+/*  Return   : NON                                                           */
+/*  Caller   : iccom_lib_deliver                                             */
+/*  Note     : Only the receive thread updates statistics, so they are       */
+/*             updated without lock (atomic for iccom_dispatch_get_stats).   */
+/*                                                                           */
+/*****************************************************************************/
+void iccom_dispatch_account(struct iccom_dispatch_entry_t *entry,
+			uint64_t time)
+{
+	__atomic_store_n(&entry->count, entry->count + 1U, __ATOMIC_RELAXED);
+	__atomic_store_n(&entry->total_time, entry->total_time + time,
+		__ATOMIC_RELAXED);
+	if (time > entry->max_time) {
+		__atomic_store_n(&entry->max_time, time, __ATOMIC_RELAXED);
+	}
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_dispatch_get_stats                                      */
+/*  Function : Get statistics of message handlers.                           */
+/*             The first statistics is the one of unknown message IDs.       */
+/*  Callinq seq.                                                             */
+/*           iccom_dispatch_get_stats(struct iccom_dispatch_t *dispatch,     */
+/*                                    Iccom_dispatch_stats *stats,           */
+/*                                    uint32_t stats_num)                    */
+/*  Input    : *dispatch       : Dispatch table pointer.                     */
+/*             stats_num       : Element count of stats.                     */
+/*  Output   : *stats          : Statistics array.                           */
+/*  Return   : Statistics count (may be greater than stats_num)              */
+/*  Caller   : Iccom_lib_DispatchGetStats                                    */
+/*                                                                           */
+/*****************************************************************************/
+uint32_t iccom_dispatch_get_stats(struct iccom_dispatch_t *dispatch,
+			Iccom_dispatch_stats *stats, uint32_t stats_num)
+{
+	const struct iccom_dispatch_entry_t *l_entry; /* handler entry       */
+	uint32_t l_cnt;				/* loop counter              */
+	uint32_t l_entry_cnt;			/* used entry count          */
+
+	(void)pthread_mutex_lock(&dispatch->mutex);
+
+	l_entry_cnt = dispatch->entry_cnt;
+	for (l_cnt = 0U; (l_cnt < l_entry_cnt) && (l_cnt < stats_num);
+	     l_cnt++) {
+		l_entry = &dispatch->entry[l_cnt];
+		stats[l_cnt].msg_id = l_entry->msg_id;
+		stats[l_cnt].flags = (l_cnt == 0U) ?
+			ICCOM_DISPATCH_STATS_DEFAULT : 0U;
+		stats[l_cnt].count = __atomic_load_n(&l_entry->count,
+			__ATOMIC_RELAXED);
+		stats[l_cnt].total_time = __atomic_load_n(
+			&l_entry->total_time, __ATOMIC_RELAXED);
+		stats[l_cnt].max_time = __atomic_load_n(&l_entry->max_time,
+			__ATOMIC_RELAXED);
+	}
+
+	(void)pthread_mutex_unlock(&dispatch->mutex);
+	return l_entry_cnt;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_dispatch_find_slot                                      */
+/*  Function : Search hash slot of message ID (linear probing).              */
+/*  Callinq seq.                                                             */
+/*           iccom_dispatch_find_slot(                                       */
+/*                           const struct iccom_dispatch_t *dispatch,        */
+/*                           uint32_t msg_id)                                */
+/*  Input    : *dispatch       : Dispatch table pointer.                     */
+/*             msg_id          : Message ID.                                 */
+/*  Return   : Slot of message ID, or empty slot to register it              */
+/*  Caller   : The function in iccom_dispatch.c                              */
+/*  Note     : The table is never full (slot count is 2 times of ID count).  */
+/*             The message ID of a used slot is read after the acquire load  */
+/*             of its entry number (published by iccom_dispatch_register).   */
+/*                                                                           */
+/*****************************************************************************/
+static struct iccom_dispatch_slot_t *iccom_dispatch_find_slot(
+			const struct iccom_dispatch_t *dispatch,
+			uint32_t msg_id)
+{
+	struct iccom_dispatch_slot_t *l_slot;	/* hash slot                 */
+	uint32_t l_idx;				/* slot index                */
+
+	l_idx = (msg_id * ICCOM_DISPATCH_HASH_MUL) >> dispatch->hash_shift;
+	l_slot = &dispatch->slot[l_idx];
+	while ((__atomic_load_n(&l_slot->entry_no, __ATOMIC_ACQUIRE) != 0U) &&
+	       (l_slot->msg_id != msg_id)) {
+		l_idx = (l_idx + 1U) & dispatch->slot_mask;
+		l_slot = &dispatch->slot[l_idx];
+	}
+	return l_slot;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_dispatch_set_handler                                    */
+/*  Function : Update message handler and its user data in place.            */
+/*             The sequence count is odd during the update, so that          */
+/*             iccom_dispatch_lookup retries a read overlapping it and never */
+/*             pairs a handler with the user data of another one.            */
+/*  Callinq seq.                                                             */
+/*           iccom_dispatch_set_handler(                                     */
+/*                           struct iccom_dispatch_handler_t *handler,       */
+/*                           Iccom_msg_handler_t func, void *user_data)      */
+/*  Input    : *handler        : Message handler entry.                      */
+/*             func            : Message handler (NULL: unregister).         */
+/*             *user_data      : Handler user data.                          */
+/*  Return   : NON                                                           */
+/*  Caller   : iccom_dispatch_register                                       */
+/*  Note     : Called with the mutex of the dispatch table.                  */
+/*                                                                           */
+/*****************************************************************************/
+static void iccom_dispatch_set_handler(
+			struct iccom_dispatch_handler_t *handler,
+			Iccom_msg_handler_t func, void *user_data)
+{
+	uint32_t l_seq;				/* handler sequence count    */
+
+	l_seq = handler->seq;
+	__atomic_store_n(&handler->seq, l_seq + 1U, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	__atomic_store_n(&handler->handler, func, __ATOMIC_RELAXED);
+	__atomic_store_n(&handler->user_data, user_data, __ATOMIC_RELAXED);
+	__atomic_store_n(&handler->seq, l_seq + 2U, __ATOMIC_RELEASE);
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_dispatch_get_handler                                    */
+/*  Function : Read message handler and its user data of one update.         */
+/*             The read is retried while iccom_dispatch_set_handler updates  */
+/*             the entry (odd or changed sequence count).                    */
+/*  Callinq seq.                                                             */
+/*           iccom_dispatch_get_handler(                                     */
+/*                           struct iccom_dispatch_handler_t *handler,       */
+/*                           Iccom_msg_handler_t *func, void **user_data)    */
+/*  Input    : *handler        : Message handler entry.                      */
+/*  Output   : *func           : Message handler.                            */
+/*             **user_data     : Handler user data.                          */
+/*  Return   : NON                                                           */
+/*  Caller   : iccom_dispatch_lookup                                         */
+/*                                                                           */
+/*****************************************************************************/
+static void iccom_dispatch_get_handler(
+			struct iccom_dispatch_handler_t *handler,
+			Iccom_msg_handler_t *func, void **user_data)
+{
+	uint32_t l_seq;				/* handler sequence count    */
+
+	do {
+		l_seq = __atomic_load_n(&handler->seq, __ATOMIC_ACQUIRE);
+		*func = __atomic_load_n(&handler->handler, __ATOMIC_RELAXED);
+		*user_data = __atomic_load_n(&handler->user_data,
+			__ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	} while (((l_seq & 1U) != 0U) ||
+		 (__atomic_load_n(&handler->seq, __ATOMIC_RELAXED) != l_seq));
+}
@@ -0,0 +1,545 @@
+/*
+ * Copyright (c) 2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "iccom.h"
+#include "iccom_library.h"
+
+/*****************************************************************************/
+/* define definition                                                         */
+/*****************************************************************************/
+#define ICCOM_HEALTH_INTERVAL_DEFAULT (100U)	/* interval default (ms)     */
+#define ICCOM_HEALTH_TIMEOUT_DEFAULT (1000U)	/* timeout default (ms)      */
+#define ICCOM_HEALTH_PENDING	(64U)		/* probes waiting for echo   */
+#define ICCOM_HEALTH_EWMA_SHIFT	(3U)		/* EWMA weight (1/8)         */
+
+/*****************************************************************************/
+/* structure definition                                                      */
+/*****************************************************************************/
+/* probe waiting for echo */
+struct iccom_health_pending_t {
+	uint32_t seq;				/* probe sequence number     */
+	uint32_t active;			/* waiting for echo          */
+	uint64_t send_time;			/* probe send time (ns)      */
+};
+
+/* latency samples (last ICCOM_HEALTH_WINDOW samples and average) */
+struct iccom_health_sample_t {
+	uint64_t window[ICCOM_HEALTH_WINDOW];	/* samples (ring)            */
+	uint64_t count;				/* samples added             */
+	uint64_t last;				/* last sample               */
+	uint64_t ewma;				/* average (EWMA)            */
+	uint64_t min;				/* minimum                   */
+	uint64_t max;				/* maximum                   */
+};
+
+/* link health prober */
+struct iccom_health_t {
+	struct iccom_channel_info_t *channel_info; /* channel of probes      */
+	Iccom_health_callback_t health_cb;	/* state change callback     */
+	void *user_data;			/* user data of health_cb    */
+	uint64_t interval;			/* probe interval (ns)       */
+	uint64_t timeout;			/* probe echo timeout (ns)   */
+	uint64_t rtt_threshold;			/* rtt_ewma threshold (ns)   */
+	uint64_t ack_threshold;			/* ack_ewma threshold (ns)   */
+	uint32_t next_seq;			/* next probe sequence       */
+	uint32_t lost_flag;			/* probe lost since echo     */
+	int32_t send_error;			/* last probe send result    */
+	uint32_t stop;				/* probe thread stop request */
+	struct iccom_health_pending_t pending[ICCOM_HEALTH_PENDING];
+						/* probes waiting for echo   */
+	struct iccom_health_sample_t rtt;	/* round trip time samples   */
+	struct iccom_health_sample_t ack;	/* ack latency samples       */
+	Iccom_health_stats stats;		/* statistics (counters)     */
+	pthread_mutex_t mutex;			/* mutex of prober           */
+	pthread_cond_t cond;			/* stop                      */
+	pthread_t probe_thread_id;		/* probe thread ID           */
+};
+
+/*****************************************************************************/
+/* internal function prototype definition                                    */
+/*****************************************************************************/
+/* probe thread function */
+static void *iccom_health_probe_thread(void *arg);
+/* latency sample add function */
+static void iccom_health_add_sample(struct iccom_health_sample_t *sample,
+			uint64_t value);
+/* latency percentile function */
+static uint64_t iccom_health_percentile(const uint64_t *sorted,
+			uint32_t num, uint32_t percent);
+/* sample compare function (qsort) */
+static int iccom_health_compare(const void *a, const void *b);
+/* degraded reason function */
+static uint32_t iccom_health_reason(const struct iccom_health_t *health);
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_health_create                                           */
+/*  Function : Create link health prober and its probe thread.               */
+/*  Callinq seq.                                                             */
+/*           iccom_health_create(const Iccom_health_param *param,            */
+/*                       struct iccom_channel_info_t *channel_info,          */
+/*                       struct iccom_health_t **health)                     */
+/*  Input    : *param          : Health parameter pointer.                   */
+/*             *channel_info   : Channel handle information pointer.         */
+/*  Output   : **health        : Link health prober pointer.                 */
+/*  Return   : 1. ICCOM_OK           (0)  : Normal                           */
+/*             2. ICCOM_ERR_PARAM    (-2) : Parameter error                  */
+/*             3. ICCOM_NG           (-1) : Other error                      */
+/*  Caller   : Iccom_lib_HealthConfig                                        */
+/*                                                                           */
+/*****************************************************************************/
+int32_t iccom_health_create(const Iccom_health_param *param,
+			struct iccom_channel_info_t *channel_info,
+			struct iccom_health_t **health)
+{
+	struct iccom_health_t *l_health = NULL;	/* link health prober        */
+	pthread_condattr_t l_condattr;		/* condition attribute       */
+	int32_t retcode = ICCOM_OK;		/* return code               */
+	int ret;				/* call function return code */
+	uint32_t l_interval;			/* probe interval (ms)       */
+	uint32_t l_timeout;			/* probe echo timeout (ms)   */
+
+	l_interval = (param->interval == 0U) ?
+		ICCOM_HEALTH_INTERVAL_DEFAULT : param->interval;
+	l_timeout = (param->timeout == 0U) ?
+		ICCOM_HEALTH_TIMEOUT_DEFAULT : param->timeout;
+
+	/* check health parameter contents */
+	if ((l_interval > ICCOM_HEALTH_TIME_MAX) ||
+	    (l_timeout > ICCOM_HEALTH_TIME_MAX)) {
+		LIBPRT_ERR("parameter err : interval = %u, timeout = %u",
+			param->interval, param->timeout);
+		retcode = ICCOM_ERR_PARAM;
+	}
+
+	if (retcode == ICCOM_OK) {
+		l_health = (struct iccom_health_t *)calloc(1U,
+			sizeof(*l_health));
+		if (l_health == NULL) {
+			LIBPRT_ERR("cannot get link health prober area");
+			retcode = ICCOM_NG;
+		}
+	}
+
+	if (retcode == ICCOM_OK) {
+		l_health->channel_info = channel_info;
+		l_health->health_cb = param->health_cb;
+		l_health->user_data = param->user_data;
+		l_health->interval = (uint64_t)l_interval * 1000000U;
+		l_health->timeout = (uint64_t)l_timeout * 1000000U;
+		l_health->rtt_threshold = (uint64_t)param->rtt_threshold *
+			1000U;
+		l_health->ack_threshold = (uint64_t)param->ack_threshold *
+			1000U;
+		l_health->send_error = ICCOM_OK;
+		l_health->stats.state = ICCOM_HEALTH_OK;
+
+		(void)pthread_mutex_init(&l_health->mutex, NULL);
+		(void)pthread_condattr_init(&l_condattr);
+		(void)pthread_condattr_setclock(&l_condattr, CLOCK_MONOTONIC);
+		(void)pthread_cond_init(&l_health->cond, &l_condattr);
+		(void)pthread_condattr_destroy(&l_condattr);
+
+		/* create probe thread */
+		ret = pthread_create(&l_health->probe_thread_id, NULL,
+			iccom_health_probe_thread, (void *)l_health);
+		if (ret != 0) {
+			LIBPRT_ERR("pthread_create : ret = %d", ret);
+			(void)pthread_cond_destroy(&l_health->cond);
+			(void)pthread_mutex_destroy(&l_health->mutex);
+			free(l_health);
+			retcode = ICCOM_NG;
+		}
+	}
+
+	if (retcode == ICCOM_OK) {
+		*health = l_health;
+	}
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_health_destroy                                          */
+/*  Function : End the probe thread and release link health prober.         */
+/*  Callinq seq.                                                             */
+/*           iccom_health_destroy(struct iccom_health_t *health)             */
+/*  Input    : *health         : Link health prober pointer (NULL: none).    */
+/*  Return   : NON                                                           */
+/*  Caller   : Iccom_lib_Final                                               */
+/*  Note     : The receive thread must be ended before.  A probe being sent  */
+/*             is waited for (up to the ack timeout of the driver).          */
+/*                                                                           */
+/*****************************************************************************/
+void iccom_health_destroy(struct iccom_health_t *health)
+{
+	if (health != NULL) {
+		(void)pthread_mutex_lock(&health->mutex);
+		health->stop = ICCOM_LIB_ON;
+		(void)pthread_cond_broadcast(&health->cond);
+		(void)pthread_mutex_unlock(&health->mutex);
+		(void)pthread_join(health->probe_thread_id, NULL);
+
+		(void)pthread_cond_destroy(&health->cond);
+		(void)pthread_mutex_destroy(&health->mutex);
+		free(health);
+	}
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_health_recv                                             */
+/*  Function : Check whether a received frame is a probe echo, and take the  */
+/*             round trip time of the probe.                                 */
+/*  Callinq seq.                                                             */
+/*           iccom_health_recv(struct iccom_health_t *health,                */
+/*                             const uint8_t *buf, uint32_t size,            */
+/*                             uint64_t recv_time)                           */
+/*  Input    : *health         : Link health prober pointer.                 */
+/*             *buf            : Received data pointer.                      */
+/*             size            : Received data size.                         */
+/*             recv_time       : Receive time (ns).                          */
+/*  Return   : 1. ICCOM_LIB_ON   : Probe echo (not passed to application)    */
+/*             2. ICCOM_LIB_OFF  : Other frame                               */
+/*  Caller   : iccom_lib_recv_thread                                         */
+/*  Note     : Echoes received after the timeout are discarded without       */
+/*             round trip time.                                              */
+/*                                                                           */
+/*****************************************************************************/
+uint32_t iccom_health_recv(struct iccom_health_t *health,
+			const uint8_t *buf, uint32_t size, uint64_t recv_time)
+{
+	struct iccom_health_pending_t *l_pending; /* probe waiting for echo */
+	Iccom_health_probe l_probe;		/* probe frame               */
+	uint32_t l_echo = ICCOM_LIB_OFF;	/* probe echo or not         */
+
+	if (size == ICCOM_HEALTH_PROBE_SIZE) {
+		(void)memcpy((void *)&l_probe, (const void *)buf,
+			sizeof(l_probe));
+		if (l_probe.magic == ICCOM_HEALTH_MAGIC) {
+			l_echo = ICCOM_LIB_ON;
+		}
+	}
+
+	if (l_echo == ICCOM_LIB_ON) {
+		(void)pthread_mutex_lock(&health->mutex);
+		l_pending = &health->pending[l_probe.seq %
+			ICCOM_HEALTH_PENDING];
+		if ((l_pending->active == ICCOM_LIB_ON) &&
+		    (l_pending->seq == l_probe.seq)) {
+			l_pending->active = ICCOM_LIB_OFF;
+			iccom_health_add_sample(&health->rtt,
+				recv_time - l_pending->send_time);
+			health->stats.echo_count++;
+			health->lost_flag = ICCOM_LIB_OFF;
+		}
+		(void)pthread_mutex_unlock(&health->mutex);
+	}
+	return l_echo;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_health_get_stats                                        */
+/*  Function : Get statistics and latency estimates of link health prober.  */
+/*  Callinq seq.                                                             */
+/*           iccom_health_get_stats(struct iccom_health_t *health,           */
+/*                                  Iccom_health_stats *stats)               */
+/*  Input    : *health         : Link health prober pointer.                 */
+/*  Output   : *stats          : Statistics.                                 */
+/*  Return   : NON                                                           */
+/*  Caller   : Iccom_lib_GetHealthStats                                      */
+/*  Note     : Percentiles are taken from a sorted copy of the samples, out  */
+/*             of the mutex (the data path is not delayed).                  */
+/*                                                                           */
+/*****************************************************************************/
+void iccom_health_get_stats(struct iccom_health_t *health,
+			Iccom_health_stats *stats)
+{
+	uint64_t l_rtt[ICCOM_HEALTH_WINDOW];	/* round trip time samples   */
+	uint64_t l_ack[ICCOM_HEALTH_WINDOW];	/* ack latency samples       */
+	uint32_t l_rtt_num;			/* round trip time sample num*/
+	uint32_t l_ack_num;			/* ack latency sample num    */
+
+	(void)pthread_mutex_lock(&health->mutex);
+	*stats = health->stats;
+	stats->rtt_last = health->rtt.last;
+	stats->rtt_ewma = health->rtt.ewma;
+	stats->rtt_min = health->rtt.min;
+	stats->rtt_max = health->rtt.max;
+	stats->ack_last = health->ack.last;
+	stats->ack_ewma = health->ack.ewma;
+	stats->ack_max = health->ack.max;
+	l_rtt_num = (health->rtt.count < ICCOM_HEALTH_WINDOW) ?
+		(uint32_t)health->rtt.count : ICCOM_HEALTH_WINDOW;
+	l_ack_num = (health->ack.count < ICCOM_HEALTH_WINDOW) ?
+		(uint32_t)health->ack.count : ICCOM_HEALTH_WINDOW;
+	(void)memcpy((void *)l_rtt, (const void *)health->rtt.window,
+		sizeof(l_rtt[0]) * l_rtt_num);
+	(void)memcpy((void *)l_ack, (const void *)health->ack.window,
+		sizeof(l_ack[0]) * l_ack_num);
+	(void)pthread_mutex_unlock(&health->mutex);
+
+	qsort((void *)l_rtt, (size_t)l_rtt_num, sizeof(l_rtt[0]),
+		iccom_health_compare);
+	qsort((void *)l_ack, (size_t)l_ack_num, sizeof(l_ack[0]),
+		iccom_health_compare);
+	stats->rtt_p50 = iccom_health_percentile(l_rtt, l_rtt_num, 50U);
+	stats->rtt_p90 = iccom_health_percentile(l_rtt, l_rtt_num, 90U);
+	stats->rtt_p99 = iccom_health_percentile(l_rtt, l_rtt_num, 99U);
+	stats->ack_p50 = iccom_health_percentile(l_ack, l_ack_num, 50U);
+	stats->ack_p90 = iccom_health_percentile(l_ack, l_ack_num, 90U);
+	stats->ack_p99 = iccom_health_percentile(l_ack, l_ack_num, 99U);
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_health_probe_thread                                     */
+/*  Function : Send a probe frame every interval, and take its ack latency   */
+/*             (write time, until CR7 acknowledges the frame).  Probes not   */
+/*             echoed within the timeout are counted as lost.  The health    */
+/*             callback function is called when the state changes.           */
+/*  Callinq seq.                                                             */
+/*           iccom_health_probe_thread(void *arg)                            */
+/*  Input    : *arg            : Link health prober pointer                  */
+/*  return   : NULL                                                          */
+/*  Note     : This thread is created in iccom_health_create and ends in     */
+/*             iccom_health_destroy.                                         */
+/*                                                                           */
+/*****************************************************************************/
+static void *iccom_health_probe_thread(void *arg)
+{
+	struct iccom_health_t *l_health;	/* link health prober        */
+	struct iccom_health_pending_t *l_pending; /* probe waiting for echo */
+	Iccom_health_probe l_probe;		/* probe frame               */
+	Iccom_health_event l_event;		/* state change information  */
+	struct timespec l_wake;			/* next probe time           */
+	uint64_t l_now;				/* current time (ns)         */
+	uint64_t l_time;			/* next probe time (ns)      */
+	int32_t ret;				/* call function return code */
+	uint32_t l_cnt;				/* loop counter              */
+	uint32_t l_state;			/* health state              */
+	uint8_t l_buf[ICCOM_HEALTH_PROBE_SIZE];	/* probe frame data          */
+
+	l_health = (struct iccom_health_t *)arg;
+
+	(void)pthread_mutex_lock(&l_health->mutex);
+	while (l_health->stop == ICCOM_LIB_OFF) {
+		/* count probes without echo within timeout as lost */
+		l_now = iccom_lib_get_time();
+		for (l_cnt = 0U; l_cnt < ICCOM_HEALTH_PENDING; l_cnt++) {
+			l_pending = &l_health->pending[l_cnt];
+			if ((l_pending->active == ICCOM_LIB_ON) &&
+			    ((l_now - l_pending->send_time) >=
+			     l_health->timeout)) {
+				l_pending->active = ICCOM_LIB_OFF;
+				l_health->stats.lost_count++;
+				l_health->lost_flag = ICCOM_LIB_ON;
+			}
+		}
+
+		/* register the probe before sending (echo may come first) */
+		l_probe.magic = ICCOM_HEALTH_MAGIC;
+		l_probe.seq = l_health->next_seq;
+		l_probe.send_time = l_now;
+		l_health->next_seq++;
+		l_pending = &l_health->pending[l_probe.seq %
+			ICCOM_HEALTH_PENDING];
+		if (l_pending->active == ICCOM_LIB_ON) {
+			l_health->stats.lost_count++;
+			l_health->lost_flag = ICCOM_LIB_ON;
+		}
+		l_pending->seq = l_probe.seq;
+		l_pending->active = ICCOM_LIB_ON;
+		l_pending->send_time = l_now;
+		(void)pthread_mutex_unlock(&l_health->mutex);
+
+		(void)memcpy((void *)l_buf, (const void *)&l_probe,
+			sizeof(l_buf));
+		ret = iccom_lib_send_frame(l_health->channel_info, l_buf,
+			ICCOM_HEALTH_PROBE_SIZE);
+		l_time = iccom_lib_get_time();
+
+		(void)pthread_mutex_lock(&l_health->mutex);
+		l_health->stats.probe_count++;
+		l_health->send_error = ret;
+		if (ret == ICCOM_OK) {
+			iccom_health_add_sample(&l_health->ack,
+				l_time - l_now);
+		} else {
+			l_health->stats.send_error_count++;
+			if ((l_pending->active == ICCOM_LIB_ON) &&
+			    (l_pending->seq == l_probe.seq)) {
+				/* no echo of the probe not sent */
+				l_pending->active = ICCOM_LIB_OFF;
+			}
+		}
+
+		/* check state change */
+		l_health->stats.reason = iccom_health_reason(l_health);
+		l_state = (l_health->stats.reason == 0U) ?
+			ICCOM_HEALTH_OK : ICCOM_HEALTH_DEGRADED;
+		if (l_state != l_health->stats.state) {
+			l_health->stats.state = l_state;
+			l_event.state = l_state;
+			l_event.reason = l_health->stats.reason;
+			l_event.rtt_ewma = l_health->rtt.ewma;
+			l_event.ack_ewma = l_health->ack.ewma;
+			l_event.send_error = l_health->send_error;
+			l_event.reserved = 0U;
+			LIBPRT_NRL("link health : channel No. = %d,"
+				" state = %u, reason = %x",
+				(int32_t)l_health->channel_info->channel_no,
+				l_state, l_event.reason);
+			if (l_health->health_cb != NULL) {
+				(void)pthread_mutex_unlock(&l_health->mutex);
+				(*l_health->health_cb)(l_health->user_data,
+					l_health->channel_info->channel_no,
+					&l_event);
+				(void)pthread_mutex_lock(&l_health->mutex);
+			}
+		}
+
+		/* wait for next probe time */
+		l_time = l_now + l_health->interval;
+		l_wake.tv_sec = (time_t)(l_time / 1000000000U);
+		l_wake.tv_nsec = (long)(l_time % 1000000000U);
+		ret = 0;
+		while ((ret == 0) && (l_health->stop == ICCOM_LIB_OFF)) {
+			ret = pthread_cond_timedwait(&l_health->cond,
+				&l_health->mutex, &l_wake);
+		}
+	}
+	(void)pthread_mutex_unlock(&l_health->mutex);
+	return NULL;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_health_add_sample                                       */
+/*  Function : Add a latency sample to the window and the estimates.         */
+/*             (EWMA : ewma += (sample - ewma) / 8, first sample as is)      */
+/*  Callinq seq.                                                             */
+/*           iccom_health_add_sample(struct iccom_health_sample_t *sample,   */
+/*                                   uint64_t value)                         */
+/*  Input    : *sample         : Latency samples pointer.                    */
+/*             value           : Sample (ns).                                */
+/*  Return   : NON                                                           */
+/*  Caller   : iccom_health_recv, iccom_health_probe_thread                  */
+/*  Note     : The mutex of the prober must be locked.                       */
+/*                                                                           */
+/*****************************************************************************/
+static void iccom_health_add_sample(struct iccom_health_sample_t *sample,
+			uint64_t value)
+{
+	int64_t l_diff;				/* difference from average   */
+
+	sample->window[sample->count % ICCOM_HEALTH_WINDOW] = value;
+	if (sample->count == 0U) {
+		sample->ewma = value;
+		sample->min = value;
+		sample->max = value;
+	} else {
+		l_diff = (int64_t)value - (int64_t)sample->ewma;
+		sample->ewma = (uint64_t)((int64_t)sample->ewma +
+			(l_diff / (int64_t)(1U << ICCOM_HEALTH_EWMA_SHIFT)));
+		if (value < sample->min) {
+			sample->min = value;
+		}
+		if (value > sample->max) {
+			sample->max = value;
+		}
+	}
+	sample->last = value;
+	sample->count++;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_health_percentile                                       */
+/*  Function : Get percentile of sorted samples (nearest rank).              */
+/*  Callinq seq.                                                             */
+/*           iccom_health_percentile(const uint64_t *sorted, uint32_t num,   */
+/*                                   uint32_t percent)                       */
+/*  Input    : *sorted         : Samples sorted in ascending order.          */
+/*             num             : Sample number.                              */
+/*             percent         : Percent (1 - 100).                          */
+/*  Return   : Percentile (0: no sample)                                     */
+/*  Caller   : iccom_health_get_stats                                        */
+/*                                                                           */
+/*****************************************************************************/
+static uint64_t iccom_health_percentile(const uint64_t *sorted,
+			uint32_t num, uint32_t percent)
+{
+	uint64_t l_value = 0U;			/* percentile                */
+	uint32_t l_rank;			/* nearest rank (1 - num)    */
+
+	if (num != 0U) {
+		l_rank = ((num * percent) + 99U) / 100U;
+		if (l_rank == 0U) {
+			l_rank = 1U;
+		}
+		l_value = sorted[l_rank - 1U];
+	}
+	return l_value;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_health_compare                                          */
+/*  Function : Compare two samples for qsort.                                */
+/*  Callinq seq.                                                             */
+/*           iccom_health_compare(const void *a, const void *b)              */
+/*  Input    : *a, *b          : Sample pointers.                            */
+/*  Return   : -1, 0, 1 : a < b, a == b, a > b                               */
+/*  Caller   : iccom_health_get_stats (qsort)                                */
+/*                                                                           */
+/*****************************************************************************/
+static int iccom_health_compare(const void *a, const void *b)
+{
+	uint64_t l_a = *(const uint64_t *)a;	/* sample a                  */
+	uint64_t l_b = *(const uint64_t *)b;	/* sample b                  */
+
+	return (l_a > l_b) - (l_a < l_b);
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_health_reason                                           */
+/*  Function : Get reasons of degraded state.                                */
+/*  Callinq seq.                                                             */
+/*           iccom_health_reason(const struct iccom_health_t *health)        */
+/*  Input    : *health         : Link health prober pointer.                 */
+/*  Return   : ICCOM_HEALTH_REASON_xxx (0: healthy)                          */
+/*  Caller   : iccom_health_probe_thread                                     */
+/*  Note     : The mutex of the prober must be locked.                       */
+/*                                                                           */
+/*****************************************************************************/
+static uint32_t iccom_health_reason(const struct iccom_health_t *health)
+{
+	uint32_t l_reason = 0U;			/* degraded reasons          */
+
+	if ((health->rtt_threshold != 0U) && (health->rtt.count != 0U) &&
+	    (health->rtt.ewma > health->rtt_threshold)) {
+		l_reason |= ICCOM_HEALTH_REASON_RTT;
+	}
+	if ((health->ack_threshold != 0U) && (health->ack.count != 0U) &&
+	    (health->ack.ewma > health->ack_threshold)) {
+		l_reason |= ICCOM_HEALTH_REASON_ACK;
+	}
+	if (health->lost_flag == ICCOM_LIB_ON) {
+		l_reason |= ICCOM_HEALTH_REASON_LOST;
+	}
+	if (health->send_error != ICCOM_OK) {
+		l_reason |= ICCOM_HEALTH_REASON_SEND;
+	}
+	return l_reason;
+}
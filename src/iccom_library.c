@@ -14,19 +14,62 @@
 #include <sys/stat.h>
 #include <sys/ioctl.h>
 #include <errno.h>
+#include <time.h>
 #include "iccom.h"
 #include "iccom_library.h"
 
 /*****************************************************************************/
 /* internal function prototype definition                                    */
 /*****************************************************************************/
+/* common channel initialization function */
+static int32_t iccom_lib_init_common(struct iccom_ctx_t *ctx,
+	const Iccom_init_param_ex *pIccomInit,
+	Iccom_recv_callback_t recv_cb, Iccom_channel_t *pChannelHandle);
+
+/* device file path template parse function */
+static int32_t iccom_lib_parse_dev_path(struct iccom_ctx_t *ctx,
+	const char *dev_path);
+
+/* context check function */
+static int32_t iccom_lib_check_ctx(const struct iccom_ctx_t *ctx);
+
 /* data receive thread  */
 static void *iccom_lib_recv_thread(void *arg);
 
+/* data send function (frame making) */
+static int32_t iccom_lib_send_data(struct iccom_channel_info_t *channel_info,
+	uint32_t channel_no, const uint8_t *send_buf, uint32_t send_size,
+	uint32_t send_seq);
+
+/* frame write function */
+static int32_t iccom_lib_write_frame(
+	struct iccom_channel_info_t *channel_info, uint32_t channel_no,
+	const uint8_t *frame, uint32_t frame_size);
+
+/* received frame check function */
+static int32_t iccom_lib_check_frame(struct iccom_channel_info_t *channel_info,
+	uint8_t **data, uint32_t *size, Iccom_recv_info *recv_info);
+
+/* received data delivery function */
+static void iccom_lib_deliver(const struct iccom_channel_info_t *channel_info,
+	uint8_t *recv_buf, uint32_t recv_size,
+	const Iccom_recv_info *recv_info);
+
+/* callback function call function */
+static void iccom_lib_call_callback(
+	const struct iccom_channel_info_t *channel_info,
+	uint8_t *recv_buf, uint32_t recv_size,
+	const Iccom_recv_info *recv_info);
+
+/* channel handle check & lock function */
+static int32_t iccom_lib_lock_handle(Iccom_channel_t ChannelHandle,
+	struct iccom_channel_info_t **channel_info,
+	struct iccom_channel_global_t **channel_global);
+
 /* channel handle check function */
 static int32_t
 	iccom_lib_check_handle(const struct iccom_channel_info_t *channel_info,
-	uint32_t *channel_no);
+	struct iccom_ctx_t **ctx, uint32_t *channel_no);
 
 #ifdef ICCOM_API_DEBUG
 /* channel handle information log function */
@@ -38,11 +81,20 @@ static void iccom_lib_handle_log(const int8_t *func_name, int32_t func_line,
 /*****************************************************************************/
 /* "ICCOM library" global information                                        */
 /*****************************************************************************/
-/* each channel information */
+/* each channel information of default context */
 static struct iccom_channel_global_t
 	g_lib_channel_global[ICCOM_CHANNEL_MAX] = {NULL};
-/* global mutex information */
-static pthread_mutex_t g_lib_mutex_global = PTHREAD_MUTEX_INITIALIZER;
+/* default context (Iccom_lib_Init, Iccom_lib_InitEx) */
+static struct iccom_ctx_t g_lib_ctx_default = {
+	g_lib_channel_global,			/* channel table             */
+	(uint32_t)ICCOM_CHANNEL_MAX,		/* channel count             */
+	ICCOM_DEVFILENAME,			/* device file name (prefix) */
+	"",					/* device file name (suffix) */
+	PTHREAD_MUTEX_INITIALIZER,		/* context mutex             */
+	NULL					/* next context              */
+};
+/* context list lock (list head : g_lib_ctx_default) */
+static pthread_rwlock_t g_lib_ctx_lock = PTHREAD_RWLOCK_INITIALIZER;
 
 /*****************************************************************************/
 /*                                                                           */
@@ -67,6 +119,306 @@ static pthread_mutex_t g_lib_mutex_global = PTHREAD_MUTEX_INITIALIZER;
 /*****************************************************************************/
 int32_t Iccom_lib_Init(const Iccom_init_param *pIccomInit,
 			Iccom_channel_t *pChannelHandle)
+{
+	Iccom_init_param_ex l_init_ex;		/* extended init parameter   */
+	int32_t retcode = ICCOM_OK;		/* return code               */
+
+	LIBPRT_DBG("start : pIccomInit   = %p", (const void *)pIccomInit);
+
+	/* check parameter pointer */
+	if (pIccomInit == NULL) {
+		LIBPRT_ERR("parameter none");
+		retcode = ICCOM_ERR_PARAM;
+	}
+
+	if (retcode == ICCOM_OK) {
+		/* convert to extended parameter (without user data callback) */
+		(void)memset((void *)&l_init_ex, 0, sizeof(l_init_ex));
+		l_init_ex.channel_no = pIccomInit->channel_no;
+		l_init_ex.recv_buf = pIccomInit->recv_buf;
+
+		retcode = iccom_lib_init_common(&g_lib_ctx_default,
+				&l_init_ex, pIccomInit->recv_cb,
+				pChannelHandle);
+	}
+	LIBPRT_DBG("end : retcode = %d", retcode);
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : Iccom_lib_InitEx                                              */
+/*  Function : Execute initialization processing of channel communicate.     */
+/*             Same as Iccom_lib_Init, but the callback function receives    */
+/*             the user data specified in the parameter.                     */
+/*             With frame_max over ICCOM_BUF_MAX_SIZE, the frame maximum     */
+/*             size is negotiated with the driver (Iccom_lib_GetFrameSize);  */
+/*             ICCOM_BUF_MAX_SIZE is used when the driver does not support   */
+/*             it.  recv_buf must have frame_max bytes.                      */
+/*  Callinq seq.                                                             */
+/*           Iccom_lib_InitEx(const Iccom_init_param_ex *pIccomInit,         */
+/*                            Iccom_channel_t	     *pChannelHandle)        */
+/*  Input    : *pIccomInit     : Channel initialization parameter pointer.   */
+/*  Output   : *pChannelHandle : Channel handle pointer.                     */
+/*  Return   : Same as Iccom_lib_Init                                        */
+/*  Caller   : Application                                                   */
+/*                                                                           */
+/*****************************************************************************/
+int32_t Iccom_lib_InitEx(const Iccom_init_param_ex *pIccomInit,
+			Iccom_channel_t *pChannelHandle)
+{
+	int32_t retcode = ICCOM_OK;		/* return code               */
+
+	LIBPRT_DBG("start : pIccomInit   = %p", (const void *)pIccomInit);
+
+	/* check parameter pointer */
+	if (pIccomInit == NULL) {
+		LIBPRT_ERR("parameter none");
+		retcode = ICCOM_ERR_PARAM;
+	}
+
+	if (retcode == ICCOM_OK) {
+		retcode = iccom_lib_init_common(&g_lib_ctx_default,
+				pIccomInit, NULL, pChannelHandle);
+	}
+	LIBPRT_DBG("end : retcode = %d", retcode);
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : Iccom_lib_CtxCreate                                           */
+/*  Function : Create context of ICCOM device.                               */
+/*             A context has its own channel table, device file path and     */
+/*             mutex, so that one process can use several ICCOM devices.     */
+/*  Callinq seq.                                                             */
+/*           Iccom_lib_CtxCreate(const Iccom_ctx_param *pCtxParam,           */
+/*                               Iccom_ctx_t *pCtx)                          */
+/*  Input    : *pCtxParam      : Context parameter pointer.                  */
+/*  Output   : *pCtx           : Context handle pointer.                     */
+/*  Return   : 1. ICCOM_OK           (0)  : Normal                           */
+/*             2. ICCOM_ERR_PARAM    (-2) : Parameter error                  */
+/*             3. ICCOM_NG           (-1) : Other error                      */
+/*  Caller   : Application                                                   */
+/*                                                                           */
+/*****************************************************************************/
+int32_t Iccom_lib_CtxCreate(const Iccom_ctx_param *pCtxParam, Iccom_ctx_t *pCtx)
+{
+	struct iccom_ctx_t *l_ctx = NULL;	/* context pointer           */
+	int32_t retcode = ICCOM_OK;		/* return code               */
+	uint32_t l_channel_max = 0U;		/* channel count             */
+
+	LIBPRT_DBG("start : pCtxParam = %p", (const void *)pCtxParam);
+
+	/* check parameter pointer */
+	if ((pCtxParam == NULL) || (pCtx == NULL)) {
+		LIBPRT_ERR("parameter none");
+		retcode = ICCOM_ERR_PARAM;
+	}
+
+	if (retcode == ICCOM_OK) {
+		l_channel_max = pCtxParam->channel_max;
+		if (l_channel_max == 0U) {
+			l_channel_max = (uint32_t)ICCOM_CHANNEL_MAX;
+		}
+		if (l_channel_max > ICCOM_CTX_CHANNEL_MAX) {
+			LIBPRT_ERR("parameter err : channel_max = %u",
+				l_channel_max);
+			retcode = ICCOM_ERR_PARAM;
+		}
+	}
+
+	if (retcode == ICCOM_OK) {
+		/* get context area */
+		l_ctx = (struct iccom_ctx_t *)calloc(1U, sizeof(*l_ctx));
+		if (l_ctx == NULL) {
+			LIBPRT_ERR("cannot get context area");
+			retcode = ICCOM_NG;
+		}
+	}
+
+	if (retcode == ICCOM_OK) {
+		/* set device file path template */
+		retcode = iccom_lib_parse_dev_path(l_ctx,
+				pCtxParam->dev_path);
+	}
+
+	if (retcode == ICCOM_OK) {
+		/* get channel table area */
+		l_ctx->channel_global = (struct iccom_channel_global_t *)
+			calloc((size_t)l_channel_max,
+				sizeof(*l_ctx->channel_global));
+		if (l_ctx->channel_global == NULL) {
+			LIBPRT_ERR("cannot get channel table area");
+			retcode = ICCOM_NG;
+		}
+	}
+
+	if (retcode == ICCOM_OK) {
+		l_ctx->channel_max = l_channel_max;
+		(void)pthread_mutex_init(&l_ctx->mutex_global, NULL);
+
+		/* add to context list (after default context) */
+		(void)pthread_rwlock_wrlock(&g_lib_ctx_lock);
+		l_ctx->next = g_lib_ctx_default.next;
+		g_lib_ctx_default.next = l_ctx;
+		(void)pthread_rwlock_unlock(&g_lib_ctx_lock);
+
+		*pCtx = (Iccom_ctx_t)l_ctx;
+	} else {
+		if (l_ctx != NULL) {
+			free(l_ctx->channel_global);
+			free(l_ctx);
+		}
+	}
+	LIBPRT_DBG("end : retcode = %d", retcode);
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : Iccom_lib_CtxDestroy                                          */
+/*  Function : Release context of ICCOM device.                              */
+/*  Callinq seq.                                                             */
+/*           Iccom_lib_CtxDestroy(Iccom_ctx_t Ctx)                           */
+/*  Input    : Ctx             : Context handle                              */
+/*  Return   : 1. ICCOM_OK           (0)  : Normal                           */
+/*             2. ICCOM_ERR_PARAM    (-2) : Parameter error                  */
+/*             3. ICCOM_ERR_BUSY     (-5) : Channel of context open          */
+/*  Caller   : Application                                                   */
+/*                                                                           */
+/*****************************************************************************/
+int32_t Iccom_lib_CtxDestroy(Iccom_ctx_t Ctx)
+{
+	struct iccom_ctx_t *l_ctx;		/* context pointer           */
+	struct iccom_ctx_t *l_prev;		/* previous context pointer  */
+	int32_t retcode = ICCOM_OK;		/* return code               */
+	uint32_t l_cnt;				/* loop counter              */
+
+	LIBPRT_DBG("start : Ctx = %p", Ctx);
+
+	l_ctx = (struct iccom_ctx_t *)Ctx;
+
+	/* lock context list */
+	(void)pthread_rwlock_wrlock(&g_lib_ctx_lock);
+
+	/* search context (default context can not be released) */
+	l_prev = &g_lib_ctx_default;
+	while ((l_prev->next != NULL) && (l_prev->next != l_ctx)) {
+		l_prev = l_prev->next;
+	}
+	if ((l_ctx == NULL) || (l_prev->next != l_ctx)) {
+		LIBPRT_ERR("not found context : Ctx = %p", Ctx);
+		retcode = ICCOM_ERR_PARAM;
+	}
+
+	if (retcode == ICCOM_OK) {
+		/* check open channel */
+		(void)pthread_mutex_lock(&l_ctx->mutex_global);
+		for (l_cnt = 0U; l_cnt < l_ctx->channel_max; l_cnt++) {
+			if (l_ctx->channel_global[l_cnt].channel_info != NULL) {
+				LIBPRT_ERR("channel open : channel No. = %u",
+					l_cnt);
+				retcode = ICCOM_ERR_BUSY;
+				break;
+			}
+		}
+		(void)pthread_mutex_unlock(&l_ctx->mutex_global);
+	}
+
+	if (retcode == ICCOM_OK) {
+		/* remove from context list */
+		l_prev->next = l_ctx->next;
+	}
+
+	/* unlock context list */
+	(void)pthread_rwlock_unlock(&g_lib_ctx_lock);
+
+	if (retcode == ICCOM_OK) {
+		(void)pthread_mutex_destroy(&l_ctx->mutex_global);
+		free(l_ctx->channel_global);
+		free(l_ctx);
+	}
+	LIBPRT_DBG("end : retcode = %d", retcode);
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : Iccom_lib_CtxInit                                             */
+/*  Function : Execute initialization processing of channel communicate      */
+/*             of the context.  Same as Iccom_lib_InitEx otherwise.          */
+/*  Callinq seq.                                                             */
+/*           Iccom_lib_CtxInit(Iccom_ctx_t Ctx,                              */
+/*                             const Iccom_init_param_ex *pIccomInit,        */
+/*                             Iccom_channel_t	      *pChannelHandle)       */
+/*  Input    : Ctx             : Context handle (NULL: default context)      */
+/*             *pIccomInit     : Channel initialization parameter pointer.   */
+/*  Output   : *pChannelHandle : Channel handle pointer.                     */
+/*  Return   : Same as Iccom_lib_Init                                        */
+/*  Caller   : Application                                                   */
+/*                                                                           */
+/*****************************************************************************/
+int32_t Iccom_lib_CtxInit(Iccom_ctx_t Ctx,
+			const Iccom_init_param_ex *pIccomInit,
+			Iccom_channel_t *pChannelHandle)
+{
+	struct iccom_ctx_t *l_ctx;		/* context pointer           */
+	int32_t retcode = ICCOM_OK;		/* return code               */
+
+	LIBPRT_DBG("start : Ctx = %p, pIccomInit = %p", Ctx,
+		(const void *)pIccomInit);
+
+	l_ctx = (struct iccom_ctx_t *)Ctx;
+	if (l_ctx == NULL) {
+		l_ctx = &g_lib_ctx_default;
+	}
+
+	/* check parameter pointer */
+	if (pIccomInit == NULL) {
+		LIBPRT_ERR("parameter none");
+		retcode = ICCOM_ERR_PARAM;
+	}
+
+	if (retcode == ICCOM_OK) {
+		retcode = iccom_lib_check_ctx(l_ctx);
+	}
+
+	if (retcode == ICCOM_OK) {
+		retcode = iccom_lib_init_common(l_ctx, pIccomInit, NULL,
+				pChannelHandle);
+	}
+	LIBPRT_DBG("end : retcode = %d", retcode);
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_lib_init_common                                         */
+/*  Function : Common initialization processing of Iccom_lib_Init,           */
+/*             Iccom_lib_InitEx and Iccom_lib_CtxInit.                       */
+/*             1. Open the channel of Linux ICCOM driver.                    */
+/*             2. Negotiate the frame maximum size with the driver.          */
+/*             3. Create the receive thread.                                 */
+/*             4. Create channel handle.                                     */
+/*  Callinq seq.                                                             */
+/*           iccom_lib_init_common(struct iccom_ctx_t *ctx,                  */
+/*                                 const Iccom_init_param_ex *pIccomInit,    */
+/*                                 Iccom_recv_callback_t recv_cb,            */
+/*                                 Iccom_channel_t	 *pChannelHandle)    */
+/*  Input    : *ctx            : Context pointer.                            */
+/*             *pIccomInit     : Channel initialization parameter pointer.   */
+/*             recv_cb         : Callback function without user data         */
+/*                               (NULL : use pIccomInit->recv_cb)            */
+/*  Output   : *pChannelHandle : Channel handle pointer.                     */
+/*  Return   : Same as Iccom_lib_Init                                        */
+/*  Caller   : Iccom_lib_Init, Iccom_lib_InitEx, Iccom_lib_CtxInit           */
+/*                                                                           */
+/*****************************************************************************/
+static int32_t iccom_lib_init_common(struct iccom_ctx_t *ctx,
+			const Iccom_init_param_ex *pIccomInit,
+			Iccom_recv_callback_t recv_cb,
+			Iccom_channel_t *pChannelHandle)
 {
 	struct iccom_channel_info_t *l_channel_info = NULL; /* channel handle*/
 	struct iccom_channel_global_t *channel_global; /* ch. global pointer */
@@ -74,45 +426,76 @@ int32_t Iccom_lib_Init(const Iccom_init_param *pIccomInit,
 	int32_t retcode = ICCOM_OK;		/* return code               */
 	int32_t ret;				/* call function return code */
 	uint32_t l_channel_no;			/* channel number            */
+	uint32_t l_cb_cnt;			/* callback function count   */
+	uint32_t l_frame_max;			/* frame maximum size        */
+	uint32_t l_frame_size;			/* frame size of driver      */
 	int8_t devname[ICCOM_DEVFILE_LEN] = {'\0'};  /* device file name area*/
 	uint8_t  mutexflg = ICCOM_LIB_OFF;      /* mutex initialized flag    */
 
 	LIBPRT_DBG("start : pIccomInit   = %p", (const void *)pIccomInit);
 
-	/* check parameter pointer */
-	if (pIccomInit == NULL) {
-		LIBPRT_ERR("parameter none");
-		retcode = ICCOM_ERR_PARAM;
-	}
+	/* metrics page by environment variable ICCOM_METRICS */
+	iccom_metrics_env_start();
 
 	if (retcode == ICCOM_OK) {
 		LIBPRT_DBG("channel_no = %d",
 			(int32_t)pIccomInit->channel_no);
 		LIBPRT_DBG("recv_buf   = %p", (void *)pIccomInit->recv_buf);
-		LIBPRT_DBG("recv_cb    = %p", (void *)pIccomInit->recv_cb);
+		LIBPRT_DBG("recv_cb    = %p", (void *)recv_cb);
+		LIBPRT_DBG("recv_cb_ex = %p", (void *)pIccomInit->recv_cb);
+		LIBPRT_DBG("user_data  = %p", pIccomInit->user_data);
+		LIBPRT_DBG("recv_info_cb = %p",
+			(void *)pIccomInit->recv_info_cb);
+		LIBPRT_DBG("flags      = 0x%08x", pIccomInit->flags);
+		LIBPRT_DBG("error_cb   = %p", (void *)pIccomInit->error_cb);
+		LIBPRT_DBG("frame_max  = %u", pIccomInit->frame_max);
 		LIBPRT_DBG("recv_thread = %p", (void *)iccom_lib_recv_thread);
 
 		l_channel_no = (uint32_t)pIccomInit->channel_no;
+		l_frame_max = (pIccomInit->frame_max == 0U) ?
+			ICCOM_BUF_MAX_SIZE : pIccomInit->frame_max;
+		/* count callback functions */
+		l_cb_cnt = 0U;
+		if (recv_cb != NULL) {
+			l_cb_cnt++;
+		}
+		if (pIccomInit->recv_cb != NULL) {
+			l_cb_cnt++;
+		}
+		if (pIccomInit->recv_info_cb != NULL) {
+			l_cb_cnt++;
+		}
 		/* check initialization parameter contents */
-		if ((pIccomInit->recv_buf == NULL) ||
-		    (pIccomInit->recv_cb == NULL) ||
-		    (l_channel_no >= (uint32_t)ICCOM_CHANNEL_MAX)) {
+		/* (exactly one of the callback functions is necessary) */
+		if ((pIccomInit->recv_buf == NULL) || (l_cb_cnt != 1U) ||
+		    ((pIccomInit->flags & ~ICCOM_INIT_FLAGS_ALL) != 0U) ||
+		    (l_channel_no >= ctx->channel_max) ||
+		    (l_frame_max < ICCOM_BUF_MAX_SIZE) ||
+		    (l_frame_max > ICCOM_FRAME_MAX_SIZE)) {
 			LIBPRT_ERR(
 				"parameter err : recv_buf = %p, recv_cb = %p,"
-				" channel No. = %d",
+				" recv_cb_ex = %p, recv_info_cb = %p,"
+				" flags = 0x%08x, channel No. = %d,"
+				" frame_max = %u",
 				(void *)pIccomInit->recv_buf,
-				(void *)pIccomInit->recv_cb, l_channel_no);
+				(void *)recv_cb, (void *)pIccomInit->recv_cb,
+				(void *)pIccomInit->recv_info_cb,
+				pIccomInit->flags, l_channel_no,
+				pIccomInit->frame_max);
 			retcode = ICCOM_ERR_PARAM;
 		}
 	}
 
 	if (retcode == ICCOM_OK) {
 		/* create device file name */
-		LIBPRT_DBG("snprintf para : 2nd = %u, 4th = %s, 5th = %u",
-			ICCOM_DEVFILE_LEN, ICCOM_DEVFILENAME, l_channel_no);
+		LIBPRT_DBG("snprintf para : 2nd = %u, 4th = %s, 5th = %u,"
+			" 6th = %s", ICCOM_DEVFILE_LEN,
+			(const char *)ctx->dev_prefix, l_channel_no,
+			(const char *)ctx->dev_suffix);
 		ret = snprintf((char *)devname, ICCOM_DEVFILE_LEN,
-			"%s%d", ICCOM_DEVFILENAME, l_channel_no);
-		if (ret < 0) {
+			"%s%u%s", (const char *)ctx->dev_prefix, l_channel_no,
+			(const char *)ctx->dev_suffix);
+		if ((ret < 0) || (ret >= (int32_t)ICCOM_DEVFILE_LEN)) {
 			LIBPRT_ERR(
 				"cannot create device file name : err = %d",
 				ret);
@@ -150,8 +533,27 @@ int32_t Iccom_lib_Init(const Iccom_init_param *pIccomInit,
 		}
 	}
 
+	if ((retcode == ICCOM_OK) && (l_frame_max > ICCOM_BUF_MAX_SIZE)) {
+		/* request frame maximum size to driver               */
+		/* (driver may accept less; ICCOM_BUF_MAX_SIZE frames */
+		/*  with driver without frame size negotiation)       */
+		l_frame_size = l_frame_max;
+		ret = ioctl(l_fd, ICCOM_IOC_SET_FRAME_SIZE, &l_frame_size);
+		if ((ret == 0) && (l_frame_size >= ICCOM_BUF_MAX_SIZE) &&
+		    (l_frame_size <= l_frame_max)) {
+			l_frame_max = l_frame_size;
+		} else {
+			LIBPRT_NRL("frame size not negotiated :"
+				" channel No. = %u, ret = %d, errno = %d,"
+				" size = %u", l_channel_no, ret,
+				(ret == 0) ? 0 : errno, l_frame_size);
+			l_frame_max = ICCOM_BUF_MAX_SIZE;
+		}
+		LIBPRT_NRL("frame maximum size = %u", l_frame_max);
+	}
+
 	if (retcode == ICCOM_OK) {
-		channel_global = &g_lib_channel_global[l_channel_no];
+		channel_global = &ctx->channel_global[l_channel_no];
 		/* get channel handle information area */
 		LIBPRT_DBG("malloc para = %lu", sizeof(*l_channel_info));
 		l_channel_info = (struct iccom_channel_info_t *)malloc(
@@ -172,11 +574,56 @@ int32_t Iccom_lib_Init(const Iccom_init_param *pIccomInit,
 
 		/* initial setting channel handle information */
 		l_channel_info->channel_no = pIccomInit->channel_no;
+		l_channel_info->ctx = ctx;
 		l_channel_info->send_req_cnt = 0U;
 		l_channel_info->recv_buf = pIccomInit->recv_buf;
-		l_channel_info->recv_cb = pIccomInit->recv_cb;
+		l_channel_info->recv_cb = recv_cb;
+		l_channel_info->recv_cb_ex = pIccomInit->recv_cb;
+		l_channel_info->user_data = pIccomInit->user_data;
+		l_channel_info->recv_info_cb = pIccomInit->recv_info_cb;
+		l_channel_info->flags = pIccomInit->flags;
+		l_channel_info->error_cb = pIccomInit->error_cb;
+		l_channel_info->frame_max = l_frame_max;
+		l_channel_info->data_max_size = l_frame_max;
+		if ((l_channel_info->flags & ICCOM_INIT_STAMP) != 0U) {
+			l_channel_info->data_max_size -=
+				ICCOM_STAMP_HEADER_SIZE;
+		}
+		if ((l_channel_info->flags & ICCOM_INIT_CRC32C) != 0U) {
+			l_channel_info->data_max_size -= ICCOM_CRC32C_SIZE;
+		}
+		if ((l_channel_info->flags & ICCOM_INIT_DELTA) != 0U) {
+			l_channel_info->data_max_size -=
+				ICCOM_DELTA_HEADER_SIZE;
+		}
+		l_channel_info->send_seq = 0U;
+		l_channel_info->recv_seq = 0U;
 		l_channel_info->fd = l_fd;
+		(void)pthread_mutex_init(&l_channel_info->send_mutex, NULL);
+
+		if ((l_channel_info->flags & ICCOM_INIT_DELTA) != 0U) {
+			/* create delta encoder */
+			retcode = iccom_delta_create(
+					l_channel_info->data_max_size,
+					&l_channel_info->delta);
+		}
+	}
+
+	if ((retcode == ICCOM_OK) &&
+	    ((l_channel_info->flags & ICCOM_INIT_FLAGS_ALL) != 0U) &&
+	    (l_frame_max > ICCOM_BUF_MAX_SIZE)) {
+		/* get send frame area (frames up to ICCOM_BUF_MAX_SIZE */
+		/* are made on the stack of the sender)                */
+		l_channel_info->send_frame = (uint8_t *)malloc(
+			(size_t)l_frame_max);
+		if (l_channel_info->send_frame == NULL) {
+			LIBPRT_ERR("cannot get send frame area : size = %u",
+				l_frame_max);
+			retcode = ICCOM_NG;
+		}
+	}
 
+	if (retcode == ICCOM_OK) {
 		/* initialize channel mutex information */
 		LIBPRT_DBG("channel pthread_mutex_init para = %p",
 			(void *)&channel_global->mutex_channel_info);
@@ -200,16 +647,19 @@ int32_t Iccom_lib_Init(const Iccom_init_param *pIccomInit,
 	}
 
 	if (retcode == ICCOM_OK) {
-		/* lock global mutex */
+		/* lock channel handle & context mutex */
+		/* (same order as Iccom_lib_Final)     */
+		(void)pthread_mutex_lock(&channel_global->mutex_channel_info);
 		LIBPRT_DBG("pthread_mutex_lock para = %p",
-			(void *)&g_lib_mutex_global);
-		(void)pthread_mutex_lock(&g_lib_mutex_global);
+			(void *)&ctx->mutex_global);
+		(void)pthread_mutex_lock(&ctx->mutex_global);
 		/* set channel handle pointer */
 		channel_global->channel_info = l_channel_info;
-		/* unlock global mutex */
+		/* unlock context mutex & channel handle */
 		LIBPRT_DBG("pthread_mutex_unlock para = %p",
-			&g_lib_mutex_global);
-		(void)pthread_mutex_unlock(&g_lib_mutex_global);
+			(void *)&ctx->mutex_global);
+		(void)pthread_mutex_unlock(&ctx->mutex_global);
+		(void)pthread_mutex_unlock(&channel_global->mutex_channel_info);
 
 		/* set channel handle for application */
 		*pChannelHandle = (Iccom_channel_t)l_channel_info;
@@ -233,6 +683,10 @@ int32_t Iccom_lib_Init(const Iccom_init_param *pIccomInit,
 		}
 		/* memory allocated already */
 		if (l_channel_info != NULL) {
+			iccom_delta_destroy(l_channel_info->delta);
+			free(l_channel_info->send_frame);
+			(void)pthread_mutex_destroy(
+				&l_channel_info->send_mutex);
 			LIBPRT_DBG("free para = %p", (void *)l_channel_info);
 			free(l_channel_info);
 		}
@@ -255,17 +709,30 @@ int32_t Iccom_lib_Init(const Iccom_init_param *pIccomInit,
 /*             4. ICCOM_ERR_TO_ACK   (-4) : Acknowledgement timeout erorr    */
 /*             5. ICCOM_ERR_TO_SEND  (-7) : Data send timeout error          */
 /*             6: ICCOM_ERR_SIZE     (-9) : Send size illegal                */
-/*             7. ICCOM_NG           (-1) : Other error                      */
+/*             7. ICCOM_ERR_RATE     (-10): Send rate exceeded               */
+/*                                          (ICCOM_SHAPER_NONBLOCK)          */
+/*             8. ICCOM_NG           (-1) : Other error                      */
+/*             (ICCOM_ERR_BUF_FULL : also topics over topic_max of the       */
+/*              conflation queue)                                            */
 /*  Caller   : Application                                                   */
 /*  Note     : Use of channel number in this function is necessary to use    */
 /*             value obtained in call of iccom_lib_check_handle function.    */
+/*             With the send rate shaper (Iccom_lib_SetShaper), the data     */
+/*             may wait for the rate (ICCOM_SHAPER_BLOCK) or be dropped      */
+/*             returning ICCOM_OK (ICCOM_SHAPER_DROP).                       */
+/*             With the spill queue (Iccom_lib_SpillConfig), the data which  */
+/*             cannot be sent is queued returning ICCOM_OK.                  */
+/*             With the conflation queue (Iccom_lib_ConflateConfig), the     */
+/*             data is queued per topic returning ICCOM_OK, and replaces     */
+/*             the data of its topic not sent yet.                           */
 /*                                                                           */
 /*****************************************************************************/
 int32_t Iccom_lib_Send(const Iccom_send_param *pIccomSend)
 {
 	struct iccom_channel_info_t *l_channel_info;   /* channel handle inf.*/
 	struct iccom_channel_global_t *channel_global; /* ch. global pointer */
-	ssize_t write_count;			/* send size(result)         */
+	struct iccom_ctx_t *l_ctx;		/* context pointer           */
+	struct iccom_conflate_t *l_conflate;	/* conflation queue          */
 	int32_t retcode = ICCOM_OK;		/* return code               */
 	int32_t ret;				/* call function return code */
 	uint32_t l_channel_no;			/* channel number            */
@@ -284,7 +751,7 @@ int32_t Iccom_lib_Send(const Iccom_send_param *pIccomSend)
 		LIBPRT_DBG("send_buf   = %p", (void *)pIccomSend->send_buf);
 
 		/* check send parameter contents */
-		if ((pIccomSend->send_size > ICCOM_BUF_MAX_SIZE) ||
+		if ((pIccomSend->send_size > ICCOM_FRAME_MAX_SIZE) ||
 		    (pIccomSend->send_buf == NULL)) {
 			LIBPRT_ERR(
 				"parameter err : send_size = %u,"
@@ -300,9 +767,10 @@ int32_t Iccom_lib_Send(const Iccom_send_param *pIccomSend)
 		l_channel_info = (struct iccom_channel_info_t *)
 			 pIccomSend->channel_handle;
 		/* check channel handle & get channel number */
-		LIBPRT_DBG("iccom_lib_check_handle para  1st = %p, 2nd = %p",
+		LIBPRT_DBG("iccom_lib_check_handle para  1st = %p, 3rd = %p",
 				(void *)l_channel_info, (void *)&l_channel_no);
-		ret = iccom_lib_check_handle(l_channel_info, &l_channel_no);
+		ret = iccom_lib_check_handle(l_channel_info, &l_ctx,
+				&l_channel_no);
 		LIBPRT_DBG("iccom_lib_check_handle ret= %d ,l_channel_no = %u",
 			    ret, l_channel_no);
 		if (ret != ICCOM_OK) {
@@ -312,7 +780,7 @@ int32_t Iccom_lib_Send(const Iccom_send_param *pIccomSend)
 	}
 
 	if (retcode == ICCOM_OK) {
-		channel_global = &g_lib_channel_global[l_channel_no];
+		channel_global = &l_ctx->channel_global[l_channel_no];
 
 		/* lock channel handle */
 		LIBPRT_DBG("pthread_mutex_lock para = %p",
@@ -323,14 +791,27 @@ int32_t Iccom_lib_Send(const Iccom_send_param *pIccomSend)
 		LIB_CANANEL_HANDLE_DBGLOG(l_channel_info, l_channel_no);
 
 		/* check channel handle pointer of global */
-		if (channel_global->channel_info == NULL) {
+		if (channel_global->channel_info != l_channel_info) {
 			LIBPRT_ERR("channel not open : channel No. = %u",
 				l_channel_no);
+			retcode = ICCOM_ERR_PARAM;
+		} else if (pIccomSend->send_size >
+			   l_channel_info->data_max_size) {
+			/* check send size of channel (frame header excluded) */
+			LIBPRT_ERR(
+				"parameter err : send_size = %u,"
+				" channel maximum = %u",
+				pIccomSend->send_size,
+				l_channel_info->data_max_size);
+			retcode = ICCOM_ERR_PARAM;
+		} else {
+			/* channel open, size within frame */
+		}
+		if (retcode != ICCOM_OK) {
 			LIBPRT_DBG("pthread_mutex_unlock para = %p",
 				(void *)&channel_global->mutex_channel_info);
 			(void)pthread_mutex_unlock(
 				&channel_global->mutex_channel_info);
-			retcode = ICCOM_ERR_PARAM;
 		}
 	}
 
@@ -345,52 +826,25 @@ int32_t Iccom_lib_Send(const Iccom_send_param *pIccomSend)
 		(void)pthread_mutex_unlock(
 			&channel_global->mutex_channel_info);
 
-		/* send data */
-		LIBPRT_DBG("write function para : 1st = %d, 2nd = %p, 3rd = %u",
-			    l_channel_info->fd, (void *)pIccomSend->send_buf,
-			    pIccomSend->send_size);
-		write_count = write(l_channel_info->fd, pIccomSend->send_buf,
-				(size_t)pIccomSend->send_size);
-		/* output channel handle debug log */
-		LIB_CANANEL_HANDLE_DBGLOG(l_channel_info, l_channel_no);
-		LIBPRT_NRL("send data : send size(result) = %ld", write_count);
-		if (write_count != (ssize_t)pIccomSend->send_size) {
-			if (write_count < 0)  {
-				/* abnormal end */
-				switch (errno) {
-				case ENOSPC:
-					retcode = ICCOM_ERR_BUF_FULL;
-					break;
-				case ETIMEDOUT:
-					retcode = ICCOM_ERR_TO_ACK;
-					break;
-				case EDEADLK:
-					retcode = ICCOM_ERR_TO_SEND;
-					break;
-				default:
-					retcode = ICCOM_NG;
-				break;
-				}
-				LIBPRT_ERR(
-					"send err : channel No. = %d,"
-					" errno = %d:%s, return code = %d",
-					l_channel_no, errno, strerror(errno),
-					retcode);
-			}
-			/* illegal send size */
-			else {
-				LIBPRT_ERR(
-					"send size mismatch : channel No. = %d,"
-					"request size = %d, result size = %ld",
-					l_channel_no, pIccomSend->send_size,
-					write_count);
-				retcode = ICCOM_ERR_SIZE;
-			}
+		/* conflation queue is set by Iccom_lib_ConflateConfig */
+		l_conflate = __atomic_load_n(&l_channel_info->conflate,
+			__ATOMIC_ACQUIRE);
+		if (l_conflate != NULL) {
+			/* the send thread sends the newest data of topic */
+			retcode = iccom_conflate_put(l_conflate,
+				pIccomSend->send_buf, pIccomSend->send_size);
+		} else {
+			retcode = iccom_lib_send_shaped(l_channel_info,
+				pIccomSend->send_buf, pIccomSend->send_size);
 		}
 	}
 
 	/* check send request counter increment */
 	if (req_update_flag == ICCOM_LIB_ON) {
+		if (retcode != ICCOM_OK) {
+			iccom_metrics_error(&l_channel_info->metrics, retcode,
+				ICCOM_LIB_OFF);
+		}
 		LIBPRT_DBG("send count decrement");
 
 		/* lock channel handle */
@@ -415,63 +869,1419 @@ int32_t Iccom_lib_Send(const Iccom_send_param *pIccomSend)
 
 /*****************************************************************************/
 /*                                                                           */
-/*  Name     : Iccom_lib_Final                                               */
-/*  Function : Execute finalization processing of channel communication.     */
-/*             1. End the receive thread.                                    */
-/*             2. Close the channel of Linux ICCOM driver.                   */
-/*             3. Release channel handle.                                    */
+/*  Name     : Iccom_lib_DispatchConfig                                      */
+/*  Function : Enable message ID dispatch of the channel.                    */
+/*             The received data is passed to the message handler            */
+/*             registered for the message ID at id_offset of the data.       */
+/*             Data of unknown message ID (or shorter than the message ID)   */
+/*             is passed to default_handler, or to the callback function     */
+/*             when default_handler is NULL.                                 */
 /*  Callinq seq.                                                             */
-/*           Iccom_lib_Final(Iccom_channel_t ChannelHandle)                  */
-/*  Input    : *ChannelHandle  : Channel handle                              */
+/*           Iccom_lib_DispatchConfig(Iccom_channel_t ChannelHandle,         */
+/*                    const Iccom_dispatch_param *pDispatchParam)            */
+/*  Input    : ChannelHandle   : Channel handle                              */
+/*             *pDispatchParam : Dispatch parameter pointer.                 */
 /*  Return   : 1. ICCOM_OK           (0)  : Normal                           */
 /*             2. ICCOM_ERR_PARAM    (-2) : Parameter error                  */
-/*             3. ICCOM_NG           (-1) : 1 Data sending                   */
-/*                                        : 2 data receiving                 */
-/*                                          3 other                          */
+/*                                          (or configured already)          */
+/*             3. ICCOM_NG           (-1) : Other error                      */
 /*  Caller   : Application                                                   */
-/*  Note     : Use of channel number in this function is necessary to use    */
-/*             value obtained in call of iccom_lib_check_handle function.    */
 /*                                                                           */
 /*****************************************************************************/
-int32_t Iccom_lib_Final(Iccom_channel_t ChannelHandle)
+int32_t Iccom_lib_DispatchConfig(Iccom_channel_t ChannelHandle,
+			const Iccom_dispatch_param *pDispatchParam)
 {
 	struct iccom_channel_info_t *l_channel_info;   /* channel handle inf.*/
 	struct iccom_channel_global_t *channel_global; /* ch. global pointer */
+	struct iccom_dispatch_t *l_dispatch = NULL;    /* dispatch table     */
 	int32_t retcode = ICCOM_OK;		/* return code               */
-	int32_t ret;				/* call function return code */
-	uint32_t l_channel_no;			/* channel number            */
-	uint8_t channel_mutex_flag = ICCOM_LIB_OFF; /* channel mutex flag    */
 
-	LIBPRT_DBG("start : ChannelHandle = %p", ChannelHandle);
+	LIBPRT_DBG("start : ChannelHandle = %p, pDispatchParam = %p",
+		ChannelHandle, (const void *)pDispatchParam);
 
-	l_channel_info = (struct iccom_channel_info_t *)ChannelHandle;
-	/* check channel handle & get channel number */
-	LIBPRT_DBG("iccom_lib_check_handle para  1st = %p, 2nd = %p",
-		   (void *)l_channel_info, (void *)&l_channel_no);
-	ret = iccom_lib_check_handle(l_channel_info, &l_channel_no);
-	LIBPRT_DBG("iccom_lib_check_handle ret = %d ,l_channel_no = %u",
-		    ret, l_channel_no);
-	if (ret != ICCOM_OK) {
-		LIBPRT_ERR("channel handle err : err = %d", ret);
-		retcode = ret;
+	/* check parameter pointer */
+	if (pDispatchParam == NULL) {
+		LIBPRT_ERR("parameter none");
+		retcode = ICCOM_ERR_PARAM;
 	}
 
 	if (retcode == ICCOM_OK) {
-		channel_global = &g_lib_channel_global[l_channel_no];
-
-		/* lock channel handle */
-		LIBPRT_DBG("pthread_mutex_lock para = %p",
-			(void *)&channel_global->mutex_channel_info);
-		(void)pthread_mutex_lock(&channel_global->mutex_channel_info);
-		channel_mutex_flag = ICCOM_LIB_ON;
+		/* create dispatch table */
+		retcode = iccom_dispatch_create(pDispatchParam, &l_dispatch);
+	}
 
-		/* output channel handle debug log */
-		LIB_CANANEL_HANDLE_DBGLOG(l_channel_info, l_channel_no);
+	if (retcode == ICCOM_OK) {
+		retcode = iccom_lib_lock_handle(ChannelHandle,
+				&l_channel_info, &channel_global);
+	}
 
-		/* check channel handle pointer of global */
-		if (channel_global->channel_info == NULL) {
-			LIBPRT_ERR("channel not open : channel No. = %u",
-				l_channel_no);
+	if (retcode == ICCOM_OK) {
+		if (l_channel_info->dispatch != NULL) {
+			LIBPRT_ERR("dispatch configured already");
+			retcode = ICCOM_ERR_PARAM;
+		} else {
+			/* publish to receive thread */
+			__atomic_store_n(&l_channel_info->dispatch,
+				l_dispatch, __ATOMIC_RELEASE);
+		}
+		(void)pthread_mutex_unlock(
+			&channel_global->mutex_channel_info);
+	}
+
+	if (retcode != ICCOM_OK) {
+		iccom_dispatch_destroy(l_dispatch);
+	}
+	LIBPRT_DBG("end : retcode = %d", retcode);
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : Iccom_lib_DispatchRegister                                    */
+/*  Function : Register message handler of message ID.                       */
+/*             (handler NULL : unregister message handler)                   */
+/*  Callinq seq.                                                             */
+/*           Iccom_lib_DispatchRegister(Iccom_channel_t ChannelHandle,       */
+/*                                      uint32_t msg_id,                     */
+/*                                      Iccom_msg_handler_t handler,         */
+/*                                      void *user_data)                     */
+/*  Input    : ChannelHandle   : Channel handle                              */
+/*             msg_id          : Message ID                                  */
+/*             handler         : Message handler                             */
+/*             *user_data      : Handler user data                           */
+/*  Return   : 1. ICCOM_OK           (0)  : Normal                           */
+/*             2. ICCOM_ERR_PARAM    (-2) : Parameter error                  */
+/*                                          (dispatch not configured,        */
+/*                                           registered ID count over)       */
+/*             3. ICCOM_NG           (-1) : Other error                      */
+/*  Caller   : Application                                                   */
+/*                                                                           */
+/*****************************************************************************/
+int32_t Iccom_lib_DispatchRegister(Iccom_channel_t ChannelHandle,
+			uint32_t msg_id, Iccom_msg_handler_t handler,
+			void *user_data)
+{
+	struct iccom_channel_info_t *l_channel_info;   /* channel handle inf.*/
+	struct iccom_channel_global_t *channel_global; /* ch. global pointer */
+	int32_t retcode;			/* return code               */
+
+	LIBPRT_DBG("start : ChannelHandle = %p, msg_id = %u, handler = %p",
+		ChannelHandle, msg_id, (void *)handler);
+
+	retcode = iccom_lib_lock_handle(ChannelHandle, &l_channel_info,
+			&channel_global);
+
+	if (retcode == ICCOM_OK) {
+		if (l_channel_info->dispatch == NULL) {
+			LIBPRT_ERR("dispatch not configured");
+			retcode = ICCOM_ERR_PARAM;
+		} else {
+			retcode = iccom_dispatch_register(
+				l_channel_info->dispatch, msg_id,
+				handler, user_data);
+		}
+		(void)pthread_mutex_unlock(
+			&channel_global->mutex_channel_info);
+	}
+	LIBPRT_DBG("end : retcode = %d", retcode);
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : Iccom_lib_DispatchGetStats                                    */
+/*  Function : Get call count and time of message handlers.                  */
+/*             pStats[0] is the statistics of unknown message IDs            */
+/*             (ICCOM_DISPATCH_STATS_DEFAULT), followed by registered        */
+/*             message IDs in registration order.                            */
+/*  Callinq seq.                                                             */
+/*           Iccom_lib_DispatchGetStats(Iccom_channel_t ChannelHandle,       */
+/*                                      Iccom_dispatch_stats *pStats,        */
+/*                                      uint32_t stats_num,                  */
+/*                                      uint32_t *pStatsCount)               */
+/*  Input    : ChannelHandle   : Channel handle                              */
+/*             stats_num       : Element count of pStats                     */
+/*  Output   : *pStats         : Statistics array                            */
+/*             *pStatsCount    : Statistics count of the channel             */
+/*                               (may be greater than stats_num)             */
+/*  Return   : 1. ICCOM_OK           (0)  : Normal                           */
+/*             2. ICCOM_ERR_PARAM    (-2) : Parameter error                  */
+/*                                          (dispatch not configured)        */
+/*  Caller   : Application                                                   */
+/*                                                                           */
+/*****************************************************************************/
+int32_t Iccom_lib_DispatchGetStats(Iccom_channel_t ChannelHandle,
+			Iccom_dispatch_stats *pStats, uint32_t stats_num,
+			uint32_t *pStatsCount)
+{
+	struct iccom_channel_info_t *l_channel_info;   /* channel handle inf.*/
+	struct iccom_channel_global_t *channel_global; /* ch. global pointer */
+	int32_t retcode = ICCOM_OK;		/* return code               */
+
+	LIBPRT_DBG("start : ChannelHandle = %p, pStats = %p, stats_num = %u",
+		ChannelHandle, (void *)pStats, stats_num);
+
+	/* check parameter pointer */
+	if ((pStatsCount == NULL) || ((pStats == NULL) && (stats_num != 0U))) {
+		LIBPRT_ERR("parameter none");
+		retcode = ICCOM_ERR_PARAM;
+	}
+
+	if (retcode == ICCOM_OK) {
+		retcode = iccom_lib_lock_handle(ChannelHandle,
+				&l_channel_info, &channel_global);
+	}
+
+	if (retcode == ICCOM_OK) {
+		if (l_channel_info->dispatch == NULL) {
+			LIBPRT_ERR("dispatch not configured");
+			retcode = ICCOM_ERR_PARAM;
+		} else {
+			*pStatsCount = iccom_dispatch_get_stats(
+				l_channel_info->dispatch, pStats, stats_num);
+		}
+		(void)pthread_mutex_unlock(
+			&channel_global->mutex_channel_info);
+	}
+	LIBPRT_DBG("end : retcode = %d", retcode);
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : Iccom_lib_SetShaper                                           */
+/*  Function : Set the send rate shaper (token buckets) of the channel.      */
+/*             Iccom_lib_Send takes byte tokens of the frame size and one    */
+/*             message token; the buckets are refilled at byte_rate and      */
+/*             msg_rate up to byte_burst and msg_burst.                      */
+/*             The frames of the spill queue drain and of the health probes  */
+/*             take tokens too; they wait whatever the mode.                 */
+/*             (pShaperParam NULL : disable the shaper)                      */
+/*  Callinq seq.                                                             */
+/*           Iccom_lib_SetShaper(Iccom_channel_t ChannelHandle,              */
+/*                    const Iccom_shaper_param *pShaperParam)                */
+/*  Input    : ChannelHandle   : Channel handle                              */
+/*             *pShaperParam   : Shaper parameter pointer.                   */
+/*  Return   : 1. ICCOM_OK           (0)  : Normal                           */
+/*             2. ICCOM_ERR_PARAM    (-2) : Parameter error                  */
+/*             3. ICCOM_NG           (-1) : Other error                      */
+/*  Caller   : Application                                                   */
+/*  Note     : The statistics are kept when the shaper is set again.         */
+/*                                                                           */
+/*****************************************************************************/
+int32_t Iccom_lib_SetShaper(Iccom_channel_t ChannelHandle,
+			const Iccom_shaper_param *pShaperParam)
+{
+	struct iccom_channel_info_t *l_channel_info;   /* channel handle inf.*/
+	struct iccom_channel_global_t *channel_global; /* ch. global pointer */
+	struct iccom_shaper_t *l_shaper = NULL;	/* send rate shaper          */
+	int32_t retcode;			/* return code               */
+
+	LIBPRT_DBG("start : ChannelHandle = %p, pShaperParam = %p",
+		ChannelHandle, (const void *)pShaperParam);
+
+	retcode = iccom_lib_lock_handle(ChannelHandle, &l_channel_info,
+			&channel_global);
+
+	if (retcode == ICCOM_OK) {
+		l_shaper = l_channel_info->shaper;
+		if ((l_shaper == NULL) && (pShaperParam != NULL)) {
+			/* first setting : create shaper */
+			retcode = iccom_shaper_create(&l_shaper);
+			if (retcode == ICCOM_OK) {
+				retcode = iccom_shaper_config(l_shaper,
+						pShaperParam);
+				if (retcode == ICCOM_OK) {
+					/* publish to senders */
+					__atomic_store_n(
+						&l_channel_info->shaper,
+						l_shaper, __ATOMIC_RELEASE);
+				} else {
+					iccom_shaper_destroy(l_shaper);
+				}
+			}
+		} else if (l_shaper != NULL) {
+			/* the shaper is kept until Iccom_lib_Final, */
+			/* senders may be waiting on it              */
+			retcode = iccom_shaper_config(l_shaper, pShaperParam);
+		} else {
+			/* not set, nothing to disable */
+		}
+		(void)pthread_mutex_unlock(
+			&channel_global->mutex_channel_info);
+	}
+	LIBPRT_DBG("end : retcode = %d", retcode);
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : Iccom_lib_GetShaperStats                                      */
+/*  Function : Get statistics of the send rate shaper of the channel.        */
+/*             delay_total and delay_max are the waits imposed by the        */
+/*             shaper (ICCOM_SHAPER_BLOCK).                                  */
+/*  Callinq seq.                                                             */
+/*           Iccom_lib_GetShaperStats(Iccom_channel_t ChannelHandle,         */
+/*                                    Iccom_shaper_stats *pStats)            */
+/*  Input    : ChannelHandle   : Channel handle                              */
+/*  Output   : *pStats         : Statistics                                  */
+/*  Return   : 1. ICCOM_OK           (0)  : Normal                           */
+/*             2. ICCOM_ERR_PARAM    (-2) : Parameter error                  */
+/*                                          (shaper not set)                 */
+/*  Caller   : Application                                                   */
+/*                                                                           */
+/*****************************************************************************/
+int32_t Iccom_lib_GetShaperStats(Iccom_channel_t ChannelHandle,
+			Iccom_shaper_stats *pStats)
+{
+	struct iccom_channel_info_t *l_channel_info;   /* channel handle inf.*/
+	struct iccom_channel_global_t *channel_global; /* ch. global pointer */
+	int32_t retcode = ICCOM_OK;		/* return code               */
+
+	LIBPRT_DBG("start : ChannelHandle = %p, pStats = %p",
+		ChannelHandle, (void *)pStats);
+
+	/* check parameter pointer */
+	if (pStats == NULL) {
+		LIBPRT_ERR("parameter none");
+		retcode = ICCOM_ERR_PARAM;
+	}
+
+	if (retcode == ICCOM_OK) {
+		retcode = iccom_lib_lock_handle(ChannelHandle,
+				&l_channel_info, &channel_global);
+	}
+
+	if (retcode == ICCOM_OK) {
+		if (l_channel_info->shaper == NULL) {
+			LIBPRT_ERR("shaper not set");
+			retcode = ICCOM_ERR_PARAM;
+		} else {
+			iccom_shaper_get_stats(l_channel_info->shaper,
+				pStats);
+		}
+		(void)pthread_mutex_unlock(
+			&channel_global->mutex_channel_info);
+	}
+	LIBPRT_DBG("end : retcode = %d", retcode);
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : Iccom_lib_SpillConfig                                         */
+/*  Function : Enable the spill queue of the channel.                        */
+/*             Iccom_lib_Send queues the data which cannot be sent because   */
+/*             CR7 side is not ready (ICCOM_ERR_TO_SEND, ICCOM_ERR_TO_ACK,   */
+/*             ICCOM_ERR_BUF_FULL, ICCOM_NG) in a memory-mapped segment      */
+/*             file, and the data sent while the queue is not empty behind   */
+/*             it.  A drain thread sends the queue in order at the drain     */
+/*             rate, retrying every retry_time.  When the segment is full,   */
+/*             the oldest data is dropped.                                   */
+/*  Callinq seq.                                                             */
+/*           Iccom_lib_SpillConfig(Iccom_channel_t ChannelHandle,            */
+/*                    const Iccom_spill_param *pSpillParam)                  */
+/*  Input    : ChannelHandle   : Channel handle                              */
+/*             *pSpillParam    : Spill parameter pointer.                    */
+/*  Return   : 1. ICCOM_OK           (0)  : Normal                           */
+/*             2. ICCOM_ERR_PARAM    (-2) : Parameter error                  */
+/*                                          (or configured already)          */
+/*             3. ICCOM_ERR_BUSY     (-5) : Segment file used by another     */
+/*                                          spill queue (any process)        */
+/*             4. ICCOM_NG           (-1) : Other error                      */
+/*  Caller   : Application                                                   */
+/*  Note     : Data for which ICCOM_ERR_TO_ACK was returned may have been    */
+/*             received by CR7 side, so it can be received twice.            */
+/*                                                                           */
+/*****************************************************************************/
+int32_t Iccom_lib_SpillConfig(Iccom_channel_t ChannelHandle,
+			const Iccom_spill_param *pSpillParam)
+{
+	struct iccom_channel_info_t *l_channel_info;   /* channel handle inf.*/
+	struct iccom_channel_global_t *channel_global; /* ch. global pointer */
+	struct iccom_spill_t *l_spill = NULL;	/* spill queue               */
+	int32_t retcode = ICCOM_OK;		/* return code               */
+
+	LIBPRT_DBG("start : ChannelHandle = %p, pSpillParam = %p",
+		ChannelHandle, (const void *)pSpillParam);
+
+	/* check parameter pointer */
+	if (pSpillParam == NULL) {
+		LIBPRT_ERR("parameter none");
+		retcode = ICCOM_ERR_PARAM;
+	}
+
+	if (retcode == ICCOM_OK) {
+		retcode = iccom_lib_lock_handle(ChannelHandle,
+				&l_channel_info, &channel_global);
+	}
+
+	if (retcode == ICCOM_OK) {
+		if (l_channel_info->spill != NULL) {
+			LIBPRT_ERR("spill queue configured already");
+			retcode = ICCOM_ERR_PARAM;
+		} else {
+			retcode = iccom_spill_create(pSpillParam,
+					l_channel_info, &l_spill);
+		}
+		if (retcode == ICCOM_OK) {
+			/* publish to senders */
+			__atomic_store_n(&l_channel_info->spill, l_spill,
+				__ATOMIC_RELEASE);
+		}
+		(void)pthread_mutex_unlock(
+			&channel_global->mutex_channel_info);
+	}
+	LIBPRT_DBG("end : retcode = %d", retcode);
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : Iccom_lib_GetSpillStats                                       */
+/*  Function : Get queue depth and drain statistics of the spill queue.      */
+/*             (drain throughput : drain_bytes / drain_time)                 */
+/*  Callinq seq.                                                             */
+/*           Iccom_lib_GetSpillStats(Iccom_channel_t ChannelHandle,          */
+/*                                   Iccom_spill_stats *pStats)              */
+/*  Input    : ChannelHandle   : Channel handle                              */
+/*  Output   : *pStats         : Statistics                                  */
+/*  Return   : 1. ICCOM_OK           (0)  : Normal                           */
+/*             2. ICCOM_ERR_PARAM    (-2) : Parameter error                  */
+/*                                          (spill queue not configured)     */
+/*  Caller   : Application                                                   */
+/*                                                                           */
+/*****************************************************************************/
+int32_t Iccom_lib_GetSpillStats(Iccom_channel_t ChannelHandle,
+			Iccom_spill_stats *pStats)
+{
+	struct iccom_channel_info_t *l_channel_info;   /* channel handle inf.*/
+	struct iccom_channel_global_t *channel_global; /* ch. global pointer */
+	int32_t retcode = ICCOM_OK;		/* return code               */
+
+	LIBPRT_DBG("start : ChannelHandle = %p, pStats = %p",
+		ChannelHandle, (void *)pStats);
+
+	/* check parameter pointer */
+	if (pStats == NULL) {
+		LIBPRT_ERR("parameter none");
+		retcode = ICCOM_ERR_PARAM;
+	}
+
+	if (retcode == ICCOM_OK) {
+		retcode = iccom_lib_lock_handle(ChannelHandle,
+				&l_channel_info, &channel_global);
+	}
+
+	if (retcode == ICCOM_OK) {
+		if (l_channel_info->spill == NULL) {
+			LIBPRT_ERR("spill queue not configured");
+			retcode = ICCOM_ERR_PARAM;
+		} else {
+			iccom_spill_get_stats(l_channel_info->spill, pStats);
+		}
+		(void)pthread_mutex_unlock(
+			&channel_global->mutex_channel_info);
+	}
+	LIBPRT_DBG("end : retcode = %d", retcode);
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : Iccom_lib_ConflateConfig                                      */
+/*  Function : Enable the conflation queue of the channel.                   */
+/*             Iccom_lib_Send puts the data to the topic of the topic ID at  */
+/*             id_offset of the data and returns.  While the data of a      */
+/*             topic is not sent yet, newer data of the topic replaces it    */
+/*             in place, so at most one data per topic waits and the newest  */
+/*             is sent.  A send thread sends the pending topics in order;    */
+/*             when CR7 side is not ready the topic is retried every         */
+/*             retry_time.                                                   */
+/*  Callinq seq.                                                             */
+/*           Iccom_lib_ConflateConfig(Iccom_channel_t ChannelHandle,         */
+/*                    const Iccom_conflate_param *pConflateParam)            */
+/*  Input    : ChannelHandle   : Channel handle                              */
+/*             *pConflateParam : Conflation parameter pointer.               */
+/*  Return   : 1. ICCOM_OK           (0)  : Normal                           */
+/*             2. ICCOM_ERR_PARAM    (-2) : Parameter error                  */
+/*                                          (or configured already)          */
+/*             3. ICCOM_NG           (-1) : Other error                      */
+/*  Caller   : Application                                                   */
+/*  Note     : For status data of which only the newest value matters.       */
+/*             The data not sent yet is discarded by Iccom_lib_Final.        */
+/*                                                                           */
+/*****************************************************************************/
+int32_t Iccom_lib_ConflateConfig(Iccom_channel_t ChannelHandle,
+			const Iccom_conflate_param *pConflateParam)
+{
+	struct iccom_channel_info_t *l_channel_info;   /* channel handle inf.*/
+	struct iccom_channel_global_t *channel_global; /* ch. global pointer */
+	struct iccom_conflate_t *l_conflate = NULL; /* conflation queue      */
+	int32_t retcode = ICCOM_OK;		/* return code               */
+
+	LIBPRT_DBG("start : ChannelHandle = %p, pConflateParam = %p",
+		ChannelHandle, (const void *)pConflateParam);
+
+	/* check parameter pointer */
+	if (pConflateParam == NULL) {
+		LIBPRT_ERR("parameter none");
+		retcode = ICCOM_ERR_PARAM;
+	}
+
+	if (retcode == ICCOM_OK) {
+		retcode = iccom_lib_lock_handle(ChannelHandle,
+				&l_channel_info, &channel_global);
+	}
+
+	if (retcode == ICCOM_OK) {
+		if (l_channel_info->conflate != NULL) {
+			LIBPRT_ERR("conflation queue configured already");
+			retcode = ICCOM_ERR_PARAM;
+		} else {
+			retcode = iccom_conflate_create(pConflateParam,
+					l_channel_info, &l_conflate);
+		}
+		if (retcode == ICCOM_OK) {
+			/* publish to senders */
+			__atomic_store_n(&l_channel_info->conflate, l_conflate,
+				__ATOMIC_RELEASE);
+		}
+		(void)pthread_mutex_unlock(
+			&channel_global->mutex_channel_info);
+	}
+	LIBPRT_DBG("end : retcode = %d", retcode);
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : Iccom_lib_GetConflateStats                                    */
+/*  Function : Get statistics of the conflation queue.                       */
+/*             (mean latency : latency_total / send_count)                   */
+/*  Callinq seq.                                                             */
+/*           Iccom_lib_GetConflateStats(Iccom_channel_t ChannelHandle,       */
+/*                                      Iccom_conflate_stats *pStats)        */
+/*  Input    : ChannelHandle   : Channel handle                              */
+/*  Output   : *pStats         : Statistics                                  */
+/*  Return   : 1. ICCOM_OK           (0)  : Normal                           */
+/*             2. ICCOM_ERR_PARAM    (-2) : Parameter error                  */
+/*                                          (conflation not configured)      */
+/*  Caller   : Application                                                   */
+/*                                                                           */
+/*****************************************************************************/
+int32_t Iccom_lib_GetConflateStats(Iccom_channel_t ChannelHandle,
+			Iccom_conflate_stats *pStats)
+{
+	struct iccom_channel_info_t *l_channel_info;   /* channel handle inf.*/
+	struct iccom_channel_global_t *channel_global; /* ch. global pointer */
+	int32_t retcode = ICCOM_OK;		/* return code               */
+
+	LIBPRT_DBG("start : ChannelHandle = %p, pStats = %p",
+		ChannelHandle, (void *)pStats);
+
+	/* check parameter pointer */
+	if (pStats == NULL) {
+		LIBPRT_ERR("parameter none");
+		retcode = ICCOM_ERR_PARAM;
+	}
+
+	if (retcode == ICCOM_OK) {
+		retcode = iccom_lib_lock_handle(ChannelHandle,
+				&l_channel_info, &channel_global);
+	}
+
+	if (retcode == ICCOM_OK) {
+		if (l_channel_info->conflate == NULL) {
+			LIBPRT_ERR("conflation queue not configured");
+			retcode = ICCOM_ERR_PARAM;
+		} else {
+			iccom_conflate_get_stats(l_channel_info->conflate,
+				pStats);
+		}
+		(void)pthread_mutex_unlock(
+			&channel_global->mutex_channel_info);
+	}
+	LIBPRT_DBG("end : retcode = %d", retcode);
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : Iccom_lib_BatchConfig                                         */
+/*  Function : Enable the batch callback function of the channel.            */
+/*             The data which would be passed to the callback function is    */
+/*             queued, and a deliver thread passes all frames queued at      */
+/*             that moment (up to batch_max) to batch_cb in one call.        */
+/*             With batch_time, the call waits for more frames until         */
+/*             batch_time after the oldest frame was received, unless        */
+/*             batch_max frames are queued before.                           */
+/*  Callinq seq.                                                             */
+/*           Iccom_lib_BatchConfig(Iccom_channel_t ChannelHandle,            */
+/*                    const Iccom_batch_param *pBatchParam)                  */
+/*  Input    : ChannelHandle   : Channel handle                              */
+/*             *pBatchParam    : Batch parameter pointer.                    */
+/*  Return   : 1. ICCOM_OK           (0)  : Normal                           */
+/*             2. ICCOM_ERR_PARAM    (-2) : Parameter error                  */
+/*                                          (or configured already)          */
+/*             3. ICCOM_NG           (-1) : Other error                      */
+/*  Caller   : Application                                                   */
+/*  Note     : Message handlers (Iccom_lib_DispatchConfig) and the error     */
+/*             callback function are still called for each frame.            */
+/*             The frames are copied to the queue; while the queue is full   */
+/*             (2 x batch_max frames) the receive waits for batch_cb.        */
+/*             The frames queued are delivered by Iccom_lib_Final.           */
+/*                                                                           */
+/*****************************************************************************/
+int32_t Iccom_lib_BatchConfig(Iccom_channel_t ChannelHandle,
+			const Iccom_batch_param *pBatchParam)
+{
+	struct iccom_channel_info_t *l_channel_info;   /* channel handle inf.*/
+	struct iccom_channel_global_t *channel_global; /* ch. global pointer */
+	struct iccom_batch_t *l_batch = NULL;	/* batch receive queue       */
+	int32_t retcode = ICCOM_OK;		/* return code               */
+
+	LIBPRT_DBG("start : ChannelHandle = %p, pBatchParam = %p",
+		ChannelHandle, (const void *)pBatchParam);
+
+	/* check parameter pointer */
+	if (pBatchParam == NULL) {
+		LIBPRT_ERR("parameter none");
+		retcode = ICCOM_ERR_PARAM;
+	}
+
+	if (retcode == ICCOM_OK) {
+		retcode = iccom_lib_lock_handle(ChannelHandle,
+				&l_channel_info, &channel_global);
+	}
+
+	if (retcode == ICCOM_OK) {
+		if (l_channel_info->batch != NULL) {
+			LIBPRT_ERR("batch callback configured already");
+			retcode = ICCOM_ERR_PARAM;
+		} else {
+			retcode = iccom_batch_create(pBatchParam,
+					l_channel_info, &l_batch);
+		}
+		if (retcode == ICCOM_OK) {
+			/* publish to receive thread */
+			__atomic_store_n(&l_channel_info->batch, l_batch,
+				__ATOMIC_RELEASE);
+		}
+		(void)pthread_mutex_unlock(
+			&channel_global->mutex_channel_info);
+	}
+	LIBPRT_DBG("end : retcode = %d", retcode);
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : Iccom_lib_GetBatchStats                                       */
+/*  Function : Get statistics of the batch callback function.                */
+/*             (mean frames per call : frame_count / call_count)             */
+/*  Callinq seq.                                                             */
+/*           Iccom_lib_GetBatchStats(Iccom_channel_t ChannelHandle,          */
+/*                                   Iccom_batch_stats *pStats)              */
+/*  Input    : ChannelHandle   : Channel handle                              */
+/*  Output   : *pStats         : Statistics                                  */
+/*  Return   : 1. ICCOM_OK           (0)  : Normal                           */
+/*             2. ICCOM_ERR_PARAM    (-2) : Parameter error                  */
+/*                                          (batch not configured)           */
+/*  Caller   : Application                                                   */
+/*                                                                           */
+/*****************************************************************************/
+int32_t Iccom_lib_GetBatchStats(Iccom_channel_t ChannelHandle,
+			Iccom_batch_stats *pStats)
+{
+	struct iccom_channel_info_t *l_channel_info;   /* channel handle inf.*/
+	struct iccom_channel_global_t *channel_global; /* ch. global pointer */
+	int32_t retcode = ICCOM_OK;		/* return code               */
+
+	LIBPRT_DBG("start : ChannelHandle = %p, pStats = %p",
+		ChannelHandle, (void *)pStats);
+
+	/* check parameter pointer */
+	if (pStats == NULL) {
+		LIBPRT_ERR("parameter none");
+		retcode = ICCOM_ERR_PARAM;
+	}
+
+	if (retcode == ICCOM_OK) {
+		retcode = iccom_lib_lock_handle(ChannelHandle,
+				&l_channel_info, &channel_global);
+	}
+
+	if (retcode == ICCOM_OK) {
+		if (l_channel_info->batch == NULL) {
+			LIBPRT_ERR("batch callback not configured");
+			retcode = ICCOM_ERR_PARAM;
+		} else {
+			iccom_batch_get_stats(l_channel_info->batch, pStats);
+		}
+		(void)pthread_mutex_unlock(
+			&channel_global->mutex_channel_info);
+	}
+	LIBPRT_DBG("end : retcode = %d", retcode);
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : Iccom_lib_HealthConfig                                        */
+/*  Function : Start link health probing on the channel.                     */
+/*             A probe thread sends a probe frame (Iccom_health_probe)       */
+/*             every interval, and measures its ack latency (write time      */
+/*             until CR7 acknowledges it) and its round trip time (until     */
+/*             the echo of CR7 is received).  Averages (EWMA) and            */
+/*             percentiles are got with Iccom_lib_GetHealthStats.  The       */
+/*             link is degraded while an average is over its threshold,      */
+/*             after a probe without echo within the timeout (until the      */
+/*             next echo) or after a probe send error, and health_cb is      */
+/*             called when the state changes.                                */
+/*  Callinq seq.                                                             */
+/*           Iccom_lib_HealthConfig(Iccom_channel_t ChannelHandle,           */
+/*                    const Iccom_health_param *pHealthParam)                */
+/*  Input    : ChannelHandle   : Channel handle                              */
+/*             *pHealthParam   : Health parameter pointer.                   */
+/*  Return   : 1. ICCOM_OK           (0)  : Normal                           */
+/*             2. ICCOM_ERR_PARAM    (-2) : Parameter error                  */
+/*                                          (configured already, or          */
+/*                                           ICCOM_INIT_DELTA channel)       */
+/*             3. ICCOM_NG           (-1) : Other error                      */
+/*  Caller   : Application                                                   */
+/*  Note     : CR7 must send the probe frames back unchanged.  The echoes    */
+/*             are not passed to the callback functions, so the channel      */
+/*             should be one designated for probing, or its data of          */
+/*             ICCOM_HEALTH_PROBE_SIZE bytes must not start with             */
+/*             ICCOM_HEALTH_MAGIC.  Probes are not shaped, spilled nor       */
+/*             conflated.  health_cb is called by the probe thread.          */
+/*                                                                           */
+/*****************************************************************************/
+int32_t Iccom_lib_HealthConfig(Iccom_channel_t ChannelHandle,
+			const Iccom_health_param *pHealthParam)
+{
+	struct iccom_channel_info_t *l_channel_info;   /* channel handle inf.*/
+	struct iccom_channel_global_t *channel_global; /* ch. global pointer */
+	struct iccom_health_t *l_health = NULL;	/* link health prober        */
+	int32_t retcode = ICCOM_OK;		/* return code               */
+
+	LIBPRT_DBG("start : ChannelHandle = %p, pHealthParam = %p",
+		ChannelHandle, (const void *)pHealthParam);
+
+	/* check parameter pointer */
+	if (pHealthParam == NULL) {
+		LIBPRT_ERR("parameter none");
+		retcode = ICCOM_ERR_PARAM;
+	}
+
+	if (retcode == ICCOM_OK) {
+		retcode = iccom_lib_lock_handle(ChannelHandle,
+				&l_channel_info, &channel_global);
+	}
+
+	if (retcode == ICCOM_OK) {
+		if (l_channel_info->health != NULL) {
+			LIBPRT_ERR("link health probing configured already");
+			retcode = ICCOM_ERR_PARAM;
+		} else if ((l_channel_info->flags & ICCOM_INIT_DELTA) != 0U) {
+			/* probes would take a delta stream */
+			LIBPRT_ERR("link health probing of delta channel");
+			retcode = ICCOM_ERR_PARAM;
+		} else {
+			retcode = iccom_health_create(pHealthParam,
+					l_channel_info, &l_health);
+		}
+		if (retcode == ICCOM_OK) {
+			/* publish to receive thread */
+			__atomic_store_n(&l_channel_info->health, l_health,
+				__ATOMIC_RELEASE);
+		}
+		(void)pthread_mutex_unlock(
+			&channel_global->mutex_channel_info);
+	}
+	LIBPRT_DBG("end : retcode = %d", retcode);
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : Iccom_lib_GetHealthStats                                      */
+/*  Function : Get state, statistics and latency estimates of link health    */
+/*             probing.                                                      */
+/*  Callinq seq.                                                             */
+/*           Iccom_lib_GetHealthStats(Iccom_channel_t ChannelHandle,         */
+/*                                    Iccom_health_stats *pStats)            */
+/*  Input    : ChannelHandle   : Channel handle                              */
+/*  Output   : *pStats         : Statistics                                  */
+/*  Return   : 1. ICCOM_OK           (0)  : Normal                           */
+/*             2. ICCOM_ERR_PARAM    (-2) : Parameter error                  */
+/*                                          (health not configured)          */
+/*  Caller   : Application                                                   */
+/*                                                                           */
+/*****************************************************************************/
+int32_t Iccom_lib_GetHealthStats(Iccom_channel_t ChannelHandle,
+			Iccom_health_stats *pStats)
+{
+	struct iccom_channel_info_t *l_channel_info;   /* channel handle inf.*/
+	struct iccom_channel_global_t *channel_global; /* ch. global pointer */
+	int32_t retcode = ICCOM_OK;		/* return code               */
+
+	LIBPRT_DBG("start : ChannelHandle = %p, pStats = %p",
+		ChannelHandle, (void *)pStats);
+
+	/* check parameter pointer */
+	if (pStats == NULL) {
+		LIBPRT_ERR("parameter none");
+		retcode = ICCOM_ERR_PARAM;
+	}
+
+	if (retcode == ICCOM_OK) {
+		retcode = iccom_lib_lock_handle(ChannelHandle,
+				&l_channel_info, &channel_global);
+	}
+
+	if (retcode == ICCOM_OK) {
+		if (l_channel_info->health == NULL) {
+			LIBPRT_ERR("link health probing not configured");
+			retcode = ICCOM_ERR_PARAM;
+		} else {
+			iccom_health_get_stats(l_channel_info->health,
+				pStats);
+		}
+		(void)pthread_mutex_unlock(
+			&channel_global->mutex_channel_info);
+	}
+	LIBPRT_DBG("end : retcode = %d", retcode);
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : Iccom_lib_DeltaConfig                                         */
+/*  Function : Set keyframe interval and streams of delta encoding of the    */
+/*             channel initialized with ICCOM_INIT_DELTA.                    */
+/*             The last frame sent is kept per stream, identified by the     */
+/*             stream ID field of the data (or one stream of the channel),   */
+/*             and only the changed byte ranges are sent, with a keyframe    */
+/*             every key_interval frames for resynchronization.  The         */
+/*             receiver keeps the reference frame per stream.  Both sides    */
+/*             restart with keyframes.                                       */
+/*  Callinq seq.                                                             */
+/*           Iccom_lib_DeltaConfig(Iccom_channel_t ChannelHandle,            */
+/*                    const Iccom_delta_param *pDeltaParam)                  */
+/*  Input    : ChannelHandle   : Channel handle                              */
+/*             *pDeltaParam    : Delta parameter pointer.                    */
+/*  Return   : 1. ICCOM_OK           (0)  : Normal                           */
+/*             2. ICCOM_ERR_PARAM    (-2) : Parameter error                  */
+/*                                          (or not ICCOM_INIT_DELTA)        */
+/*             3. ICCOM_NG           (-1) : Other error                      */
+/*  Caller   : Application                                                   */
+/*  Note     : Without this function, the channel has one stream with a      */
+/*             keyframe every 64 frames.                                     */
+/*                                                                           */
+/*****************************************************************************/
+int32_t Iccom_lib_DeltaConfig(Iccom_channel_t ChannelHandle,
+			const Iccom_delta_param *pDeltaParam)
+{
+	struct iccom_channel_info_t *l_channel_info;   /* channel handle inf.*/
+	struct iccom_channel_global_t *channel_global; /* ch. global pointer */
+	int32_t retcode = ICCOM_OK;		/* return code               */
+
+	LIBPRT_DBG("start : ChannelHandle = %p, pDeltaParam = %p",
+		ChannelHandle, (const void *)pDeltaParam);
+
+	/* check parameter pointer */
+	if (pDeltaParam == NULL) {
+		LIBPRT_ERR("parameter none");
+		retcode = ICCOM_ERR_PARAM;
+	}
+
+	if (retcode == ICCOM_OK) {
+		retcode = iccom_lib_lock_handle(ChannelHandle,
+				&l_channel_info, &channel_global);
+	}
+
+	if (retcode == ICCOM_OK) {
+		if (l_channel_info->delta == NULL) {
+			LIBPRT_ERR("delta encoding not initialized");
+			retcode = ICCOM_ERR_PARAM;
+		} else {
+			retcode = iccom_delta_config(l_channel_info->delta,
+					pDeltaParam);
+		}
+		(void)pthread_mutex_unlock(
+			&channel_global->mutex_channel_info);
+	}
+	LIBPRT_DBG("end : retcode = %d", retcode);
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : Iccom_lib_GetDeltaStats                                       */
+/*  Function : Get statistics of delta encoding of the channel.              */
+/*             (send ratio : coded_bytes / data_bytes)                       */
+/*  Callinq seq.                                                             */
+/*           Iccom_lib_GetDeltaStats(Iccom_channel_t ChannelHandle,          */
+/*                                   Iccom_delta_stats *pStats)              */
+/*  Input    : ChannelHandle   : Channel handle                              */
+/*  Output   : *pStats         : Statistics                                  */
+/*  Return   : 1. ICCOM_OK           (0)  : Normal                           */
+/*             2. ICCOM_ERR_PARAM    (-2) : Parameter error                  */
+/*                                          (not ICCOM_INIT_DELTA)           */
+/*  Caller   : Application                                                   */
+/*                                                                           */
+/*****************************************************************************/
+int32_t Iccom_lib_GetDeltaStats(Iccom_channel_t ChannelHandle,
+			Iccom_delta_stats *pStats)
+{
+	struct iccom_channel_info_t *l_channel_info;   /* channel handle inf.*/
+	struct iccom_channel_global_t *channel_global; /* ch. global pointer */
+	int32_t retcode = ICCOM_OK;		/* return code               */
+
+	LIBPRT_DBG("start : ChannelHandle = %p, pStats = %p",
+		ChannelHandle, (void *)pStats);
+
+	/* check parameter pointer */
+	if (pStats == NULL) {
+		LIBPRT_ERR("parameter none");
+		retcode = ICCOM_ERR_PARAM;
+	}
+
+	if (retcode == ICCOM_OK) {
+		retcode = iccom_lib_lock_handle(ChannelHandle,
+				&l_channel_info, &channel_global);
+	}
+
+	if (retcode == ICCOM_OK) {
+		if (l_channel_info->delta == NULL) {
+			LIBPRT_ERR("delta encoding not initialized");
+			retcode = ICCOM_ERR_PARAM;
+		} else {
+			iccom_delta_get_stats(l_channel_info->delta, pStats);
+		}
+		(void)pthread_mutex_unlock(
+			&channel_global->mutex_channel_info);
+	}
+	LIBPRT_DBG("end : retcode = %d", retcode);
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : Iccom_lib_GetFrameSize                                        */
+/*  Function : Get the frame maximum size of the channel (negotiated with    */
+/*             the driver in Iccom_lib_InitEx), and the send data maximum    */
+/*             size (frame maximum size less stamp header, delta header and  */
+/*             CRC32C trailer of the channel).                               */
+/*  Callinq seq.                                                             */
+/*           Iccom_lib_GetFrameSize(Iccom_channel_t ChannelHandle,           */
+/*                                  uint32_t *pFrameMax,                     */
+/*                                  uint32_t *pDataMax)                      */
+/*  Input    : ChannelHandle   : Channel handle                              */
+/*  Output   : *pFrameMax      : Frame maximum size (NULL: not got)          */
+/*             *pDataMax       : Send data maximum size (NULL: not got)      */
+/*  Return   : 1. ICCOM_OK           (0)  : Normal                           */
+/*             2. ICCOM_ERR_PARAM    (-2) : Parameter error                  */
+/*  Caller   : Application                                                   */
+/*                                                                           */
+/*****************************************************************************/
+int32_t Iccom_lib_GetFrameSize(Iccom_channel_t ChannelHandle,
+			uint32_t *pFrameMax, uint32_t *pDataMax)
+{
+	struct iccom_channel_info_t *l_channel_info;   /* channel handle inf.*/
+	struct iccom_channel_global_t *channel_global; /* ch. global pointer */
+	int32_t retcode;			/* return code               */
+
+	LIBPRT_DBG("start : ChannelHandle = %p, pFrameMax = %p,"
+		" pDataMax = %p", ChannelHandle, (void *)pFrameMax,
+		(void *)pDataMax);
+
+	retcode = iccom_lib_lock_handle(ChannelHandle, &l_channel_info,
+			&channel_global);
+
+	if (retcode == ICCOM_OK) {
+		if (pFrameMax != NULL) {
+			*pFrameMax = l_channel_info->frame_max;
+		}
+		if (pDataMax != NULL) {
+			*pDataMax = l_channel_info->data_max_size;
+		}
+		(void)pthread_mutex_unlock(
+			&channel_global->mutex_channel_info);
+	}
+	LIBPRT_DBG("end : retcode = %d", retcode);
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : Iccom_lib_GetIntegrityStats                                   */
+/*  Function : Get statistics of received frame checks of the channel.       */
+/*             Frames failing the checks are not delivered; they are passed  */
+/*             to the error callback function when it is set.                */
+/*  Callinq seq.                                                             */
+/*           Iccom_lib_GetIntegrityStats(Iccom_channel_t ChannelHandle,      */
+/*                                       Iccom_integrity_stats *pStats)      */
+/*  Input    : ChannelHandle   : Channel handle                              */
+/*  Output   : *pStats         : Statistics                                  */
+/*  Return   : 1. ICCOM_OK           (0)  : Normal                           */
+/*             2. ICCOM_ERR_PARAM    (-2) : Parameter error                  */
+/*  Caller   : Application                                                   */
+/*                                                                           */
+/*****************************************************************************/
+int32_t Iccom_lib_GetIntegrityStats(Iccom_channel_t ChannelHandle,
+			Iccom_integrity_stats *pStats)
+{
+	struct iccom_channel_info_t *l_channel_info;   /* channel handle inf.*/
+	struct iccom_channel_global_t *channel_global; /* ch. global pointer */
+	int32_t retcode = ICCOM_OK;		/* return code               */
+
+	LIBPRT_DBG("start : ChannelHandle = %p, pStats = %p",
+		ChannelHandle, (void *)pStats);
+
+	/* check parameter pointer */
+	if (pStats == NULL) {
+		LIBPRT_ERR("parameter none");
+		retcode = ICCOM_ERR_PARAM;
+	}
+
+	if (retcode == ICCOM_OK) {
+		retcode = iccom_lib_lock_handle(ChannelHandle,
+				&l_channel_info, &channel_global);
+	}
+
+	if (retcode == ICCOM_OK) {
+		/* counters are updated by receive thread */
+		pStats->check_count = __atomic_load_n(
+			&l_channel_info->check_count, __ATOMIC_RELAXED);
+		pStats->crc_error_count = __atomic_load_n(
+			&l_channel_info->crc_error_count, __ATOMIC_RELAXED);
+		pStats->short_count = __atomic_load_n(
+			&l_channel_info->short_count, __ATOMIC_RELAXED);
+		(void)pthread_mutex_unlock(
+			&channel_global->mutex_channel_info);
+	}
+	LIBPRT_DBG("end : retcode = %d", retcode);
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : Iccom_lib_MetricsStart                                        */
+/*  Function : Publish the counters of all channels of the process to the    */
+/*             metrics page (shared memory ICCOM_METRICS_SHM_PREFIX<pid>)    */
+/*             at the update interval. The page is read by other processes   */
+/*             (e.g. iccom-top) without lock of the library.                 */
+/*             When the page is published already, the update interval is   */
+/*             changed.                                                      */
+/*  Callinq seq.                                                             */
+/*           Iccom_lib_MetricsStart(uint32_t interval)                       */
+/*  Input    : interval        : Update interval (ms, 0: 100ms,              */
+/*                               maximum ICCOM_METRICS_INTERVAL_MAX)         */
+/*  Return   : 1. ICCOM_OK           (0)  : Normal                           */
+/*             2. ICCOM_ERR_PARAM    (-2) : Parameter error                  */
+/*             3. ICCOM_NG           (-1) : Other error                      */
+/*  Caller   : Application                                                   */
+/*  Note     : Environment variable ICCOM_METRICS=<interval ms> starts the   */
+/*             publication at the first channel initialization.              */
+/*             The page is removed at process exit.                          */
+/*                                                                           */
+/*****************************************************************************/
+int32_t Iccom_lib_MetricsStart(uint32_t interval)
+{
+	int32_t retcode;			/* return code               */
+
+	LIBPRT_DBG("start : interval = %u", interval);
+	retcode = iccom_metrics_start(interval);
+	LIBPRT_DBG("end : retcode = %d", retcode);
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : Iccom_lib_MetricsStop                                         */
+/*  Function : Stop publication of the metrics page and remove the page.     */
+/*  Callinq seq.                                                             */
+/*           Iccom_lib_MetricsStop(void)                                     */
+/*  Return   : 1. ICCOM_OK           (0)  : Normal                           */
+/*                                          (also not published)             */
+/*  Caller   : Application                                                   */
+/*                                                                           */
+/*****************************************************************************/
+int32_t Iccom_lib_MetricsStop(void)
+{
+	int32_t retcode;			/* return code               */
+
+	LIBPRT_DBG("start");
+	retcode = iccom_metrics_stop();
+	LIBPRT_DBG("end : retcode = %d", retcode);
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_lib_send_shaped                                         */
+/*  Function : Send data through send rate shaper and spill queue.           */
+/*  Callinq seq.                                                             */
+/*           iccom_lib_send_shaped(                                          */
+/*                           struct iccom_channel_info_t *channel_info,      */
+/*                           const uint8_t *send_buf, uint32_t send_size)    */
+/*  Input    : *channel_info   : Channel handle information pointer.         */
+/*             *send_buf       : Send data pointer.                          */
+/*             send_size       : Send data size.                             */
+/*  Return   : Same as Iccom_lib_Send                                        */
+/*  Caller   : Iccom_lib_Send, iccom_conflate_send_thread                    */
+/*                                                                           */
+/*****************************************************************************/
+int32_t iccom_lib_send_shaped(struct iccom_channel_info_t *channel_info,
+			const uint8_t *send_buf, uint32_t send_size)
+{
+	struct iccom_shaper_t *l_shaper;	/* send rate shaper          */
+	struct iccom_spill_t *l_spill = NULL;	/* spill queue               */
+	int32_t retcode = ICCOM_OK;		/* return code               */
+	uint32_t l_channel_no;			/* channel number            */
+	uint32_t l_send_seq;			/* send sequence number      */
+
+	l_channel_no = (uint32_t)channel_info->channel_no;
+
+	/* shape send rate (shaper is set by Iccom_lib_SetShaper) */
+	l_shaper = __atomic_load_n(&channel_info->shaper, __ATOMIC_ACQUIRE);
+	if (l_shaper != NULL) {
+		/* frame size : data size + frame header size */
+		retcode = iccom_shaper_acquire(l_shaper,
+			send_size + (channel_info->frame_max -
+			channel_info->data_max_size), ICCOM_LIB_OFF);
+	}
+
+	if (retcode == ICCOM_OK) {
+		/* spill queue is set by Iccom_lib_SpillConfig */
+		l_spill = __atomic_load_n(&channel_info->spill,
+			__ATOMIC_ACQUIRE);
+		if (l_spill != NULL) {
+			/* queue behind the data not sent yet (keep order) */
+			retcode = iccom_spill_put(l_spill, send_buf,
+				send_size, ICCOM_LIB_OFF);
+		} else {
+			retcode = ICCOM_LIB_EMPTY;
+		}
+	}
+
+	if (retcode == ICCOM_LIB_EMPTY) {
+		/* take send sequence number */
+		l_send_seq = __atomic_fetch_add(&channel_info->send_seq,
+			1U, __ATOMIC_RELAXED);
+
+		/* send data */
+		retcode = iccom_lib_send_data(channel_info, l_channel_no,
+				send_buf, send_size, l_send_seq);
+
+		if ((l_spill != NULL) &&
+		    ((retcode == ICCOM_ERR_TO_SEND) ||
+		     (retcode == ICCOM_ERR_TO_ACK) ||
+		     (retcode == ICCOM_ERR_BUF_FULL) ||
+		     (retcode == ICCOM_NG))) {
+			/* CR7 side not ready : spill the data */
+			LIBPRT_NRL("send data spilled : channel No. = %u,"
+				" err = %d", l_channel_no, retcode);
+			retcode = iccom_spill_put(l_spill, send_buf,
+				send_size, ICCOM_LIB_ON);
+		}
+	} else if (retcode == ICCOM_LIB_DROP) {
+		LIBPRT_NRL("send data dropped : channel No. = %u",
+			l_channel_no);
+		retcode = ICCOM_OK;
+	} else {
+		/* spilled (ICCOM_OK) or error : returned as is */
+	}
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_lib_send_frame                                          */
+/*  Function : Send data with the next send sequence number, without spill   */
+/*             queue.  The tokens of the send rate shaper of the channel are */
+/*             taken first, waiting whatever its mode, so that a drained     */
+/*             backlog and the health probes keep to the channel rate.       */
+/*  Callinq seq.                                                             */
+/*           iccom_lib_send_frame(struct iccom_channel_info_t *channel_info, */
+/*                                const uint8_t *send_buf,                   */
+/*                                uint32_t send_size)                        */
+/*  Input    : *channel_info   : Channel handle information pointer.         */
+/*             *send_buf       : Send data pointer.                          */
+/*             send_size       : Send data size.                             */
+/*  Return   : Same as iccom_lib_write_frame                                 */
+/*  Caller   : iccom_spill_drain_thread, iccom_health_probe_thread           */
+/*                                                                           */
+/*****************************************************************************/
+int32_t iccom_lib_send_frame(struct iccom_channel_info_t *channel_info,
+			const uint8_t *send_buf, uint32_t send_size)
+{
+	struct iccom_shaper_t *l_shaper;	/* send rate shaper          */
+	uint32_t l_send_seq;			/* send sequence number      */
+
+	/* shape send rate (shaper is set by Iccom_lib_SetShaper) */
+	l_shaper = __atomic_load_n(&channel_info->shaper, __ATOMIC_ACQUIRE);
+	if (l_shaper != NULL) {
+		/* frame size : data size + frame header size */
+		(void)iccom_shaper_acquire(l_shaper,
+			send_size + (channel_info->frame_max -
+			channel_info->data_max_size), ICCOM_LIB_ON);
+	}
+
+	l_send_seq = __atomic_fetch_add(&channel_info->send_seq, 1U,
+		__ATOMIC_RELAXED);
+	return iccom_lib_send_data(channel_info,
+		(uint32_t)channel_info->channel_no, send_buf, send_size,
+		l_send_seq);
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_lib_send_data                                           */
+/*  Function : Make the frame of the channel from send data and write it.    */
+/*             (send stamp header is added with ICCOM_INIT_STAMP,            */
+/*              data is delta encoded with ICCOM_INIT_DELTA,                 */
+/*              CRC32C trailer is added with ICCOM_INIT_CRC32C)              */
+/*             The frame is made on the stack up to ICCOM_BUF_MAX_SIZE, and  */
+/*             in the send frame area of the channel for larger frame sizes  */
+/*             (senders locked by send_mutex, or by the delta encoder).      */
+/*  Callinq seq.                                                             */
+/*           iccom_lib_send_data(struct iccom_channel_info_t *channel_info,  */
+/*                               uint32_t channel_no,                        */
+/*                               const uint8_t *send_buf,                    */
+/*                               uint32_t send_size,                         */
+/*                               uint32_t send_seq)                          */
+/*  Input    : *channel_info   : Channel handle information pointer.         */
+/*             channel_no      : Channel number.                             */
+/*             *send_buf       : Send data pointer.                          */
+/*             send_size       : Send data size.                             */
+/*             send_seq        : Send sequence number.                       */
+/*  Return   : Same as iccom_lib_write_frame                                 */
+/*  Caller   : iccom_lib_send_shaped, iccom_lib_send_frame                   */
+/*                                                                           */
+/*****************************************************************************/
+static int32_t iccom_lib_send_data(struct iccom_channel_info_t *channel_info,
+			uint32_t channel_no, const uint8_t *send_buf,
+			uint32_t send_size, uint32_t send_seq)
+{
+	uint8_t l_frame_area[ICCOM_BUF_MAX_SIZE]; /* frame area (stack)     */
+	uint8_t *l_frame = l_frame_area;	/* frame area                */
+	Iccom_stamp_header l_stamp;		/* send stamp header         */
+	int32_t retcode;			/* return code               */
+	uint32_t l_frame_size = 0U;		/* frame size                */
+	uint32_t l_coded_size = 0U;		/* delta coded size          */
+	uint32_t l_crc;				/* CRC32C of frame           */
+	uint8_t l_lock = ICCOM_LIB_OFF;		/* send_mutex locked flag    */
+
+	if ((channel_info->flags & ICCOM_INIT_FLAGS_ALL) != 0U) {
+		if (channel_info->send_frame != NULL) {
+			/* frame area of channel (delta encoder locks the */
+			/* senders by itself)                             */
+			l_frame = channel_info->send_frame;
+			if ((channel_info->flags & ICCOM_INIT_DELTA) == 0U) {
+				(void)pthread_mutex_lock(
+					&channel_info->send_mutex);
+				l_lock = ICCOM_LIB_ON;
+			}
+		}
+
+		if ((channel_info->flags & ICCOM_INIT_STAMP) != 0U) {
+			/* reserve send stamp header */
+			l_frame_size = ICCOM_STAMP_HEADER_SIZE;
+		}
+		if ((channel_info->flags & ICCOM_INIT_DELTA) != 0U) {
+			/* add delta header and changed ranges */
+			/* (sender locked until encode end)    */
+			l_coded_size = iccom_delta_encode(channel_info->delta,
+					send_buf, send_size,
+					&l_frame[l_frame_size]);
+			l_frame_size += l_coded_size;
+		} else {
+			(void)memcpy((void *)&l_frame[l_frame_size],
+				(const void *)send_buf, (size_t)send_size);
+			l_frame_size += send_size;
+		}
+		if ((channel_info->flags & ICCOM_INIT_STAMP) != 0U) {
+			/* add send stamp header */
+			l_stamp.seq = send_seq;
+			l_stamp.reserved = 0U;
+			l_stamp.time = iccom_lib_get_time();
+			(void)memcpy((void *)l_frame, (const void *)&l_stamp,
+				ICCOM_STAMP_HEADER_SIZE);
+		}
+
+		if ((channel_info->flags & ICCOM_INIT_CRC32C) != 0U) {
+			/* add CRC32C trailer (little endian) */
+			l_crc = iccom_crc32c(l_frame, l_frame_size);
+			l_frame[l_frame_size] = (uint8_t)l_crc;
+			l_frame[l_frame_size + 1U] = (uint8_t)(l_crc >> 8);
+			l_frame[l_frame_size + 2U] = (uint8_t)(l_crc >> 16);
+			l_frame[l_frame_size + 3U] = (uint8_t)(l_crc >> 24);
+			l_frame_size += ICCOM_CRC32C_SIZE;
+		}
+
+		retcode = iccom_lib_write_frame(channel_info, channel_no,
+				l_frame, l_frame_size);
+
+		if ((channel_info->flags & ICCOM_INIT_DELTA) != 0U) {
+			iccom_delta_encode_end(channel_info->delta,
+				l_coded_size, retcode);
+		}
+		if (l_lock == ICCOM_LIB_ON) {
+			(void)pthread_mutex_unlock(&channel_info->send_mutex);
+		}
+	} else {
+		retcode = iccom_lib_write_frame(channel_info, channel_no,
+				send_buf, send_size);
+	}
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_lib_write_frame                                         */
+/*  Function : Write one frame to Linux ICCOM driver.                        */
+/*  Callinq seq.                                                             */
+/*           iccom_lib_write_frame(                                          */
+/*                           struct iccom_channel_info_t *channel_info,      */
+/*                           uint32_t channel_no,                            */
+/*                           const uint8_t *frame,                           */
+/*                           uint32_t frame_size)                            */
+/*  Input    : *channel_info   : Channel handle information pointer.         */
+/*             channel_no      : Channel number.                             */
+/*             *frame          : Frame pointer.                              */
+/*             frame_size      : Frame size.                                 */
+/*  Return   : 1. ICCOM_OK           (0)  : Normal                           */
+/*             2. ICCOM_ERR_BUF_FULL (-3) : Buffer full error                */
+/*             3. ICCOM_ERR_TO_ACK   (-4) : Acknowledgement timeout erorr    */
+/*             4. ICCOM_ERR_TO_SEND  (-7) : Data send timeout error          */
+/*             5: ICCOM_ERR_SIZE     (-9) : Send size illegal                */
+/*             6. ICCOM_NG           (-1) : Other error                      */
+/*  Caller   : iccom_lib_send_data                                           */
+/*                                                                           */
+/*****************************************************************************/
+static int32_t iccom_lib_write_frame(
+			struct iccom_channel_info_t *channel_info,
+			uint32_t channel_no, const uint8_t *frame,
+			uint32_t frame_size)
+{
+	ssize_t write_count;			/* send size(result)         */
+	int32_t retcode = ICCOM_OK;		/* return code               */
+	uint64_t l_start;			/* write start time (metrics)*/
+
+	LIBPRT_DBG("write function para : 1st = %d, 2nd = %p, 3rd = %u",
+		    channel_info->fd, (const void *)frame, frame_size);
+	l_start = iccom_metrics_clock();
+	write_count = write(channel_info->fd, frame, (size_t)frame_size);
+	/* output channel handle debug log */
+	LIB_CANANEL_HANDLE_DBGLOG(channel_info, channel_no);
+	LIBPRT_NRL("send data : send size(result) = %ld", write_count);
+	if (write_count != (ssize_t)frame_size) {
+		if (write_count < 0)  {
+			/* abnormal end */
+			switch (errno) {
+			case ENOSPC:
+				retcode = ICCOM_ERR_BUF_FULL;
+				break;
+			case ETIMEDOUT:
+				retcode = ICCOM_ERR_TO_ACK;
+				break;
+			case EDEADLK:
+				retcode = ICCOM_ERR_TO_SEND;
+				break;
+			default:
+				retcode = ICCOM_NG;
+			break;
+			}
+			LIBPRT_ERR(
+				"send err : channel No. = %d,"
+				" errno = %d:%s, return code = %d",
+				channel_no, errno, strerror(errno),
+				retcode);
+		}
+		/* illegal send size */
+		else {
+			LIBPRT_ERR(
+				"send size mismatch : channel No. = %d,"
+				"request size = %d, result size = %ld",
+				channel_no, frame_size, write_count);
+			retcode = ICCOM_ERR_SIZE;
+		}
+	} else {
+		iccom_metrics_sent(&channel_info->metrics, frame_size,
+			l_start);
+	}
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : Iccom_lib_Final                                               */
+/*  Function : Execute finalization processing of channel communication.     */
+/*             1. Release channel handle from the channel table.             */
+/*             2. End the receive thread (and the threads of the channel).   */
+/*             3. Close the channel of Linux ICCOM driver.                   */
+/*             4. Release channel handle.                                    */
+/*  Callinq seq.                                                             */
+/*           Iccom_lib_Final(Iccom_channel_t ChannelHandle)                  */
+/*  Input    : *ChannelHandle  : Channel handle                              */
+/*  Return   : 1. ICCOM_OK           (0)  : Normal                           */
+/*             2. ICCOM_ERR_PARAM    (-2) : Parameter error                  */
+/*             3. ICCOM_NG           (-1) : 1 Data sending                   */
+/*                                        : 2 data receiving                 */
+/*                                          3 other                          */
+/*  Caller   : Application                                                   */
+/*  Note     : Use of channel number in this function is necessary to use    */
+/*             value obtained in call of iccom_lib_check_handle function.    */
+/*             The threads of the channel are ended without the channel      */
+/*             mutex locked, so their callback functions (receive, batch,    */
+/*             health) may call the channel functions, which return          */
+/*             ICCOM_ERR_PARAM once finalization has started.                */
+/*                                                                           */
+/*****************************************************************************/
+int32_t Iccom_lib_Final(Iccom_channel_t ChannelHandle)
+{
+	struct iccom_channel_info_t *l_channel_info;   /* channel handle inf.*/
+	struct iccom_channel_global_t *channel_global; /* ch. global pointer */
+	struct iccom_ctx_t *l_ctx;		/* context pointer           */
+	int32_t retcode = ICCOM_OK;		/* return code               */
+	int32_t ret;				/* call function return code */
+	uint32_t l_channel_no;			/* channel number            */
+	uint8_t channel_mutex_flag = ICCOM_LIB_OFF; /* channel mutex flag    */
+
+	LIBPRT_DBG("start : ChannelHandle = %p", ChannelHandle);
+
+	l_channel_info = (struct iccom_channel_info_t *)ChannelHandle;
+	/* check channel handle & get channel number */
+	LIBPRT_DBG("iccom_lib_check_handle para  1st = %p, 3rd = %p",
+		   (void *)l_channel_info, (void *)&l_channel_no);
+	ret = iccom_lib_check_handle(l_channel_info, &l_ctx, &l_channel_no);
+	LIBPRT_DBG("iccom_lib_check_handle ret = %d ,l_channel_no = %u",
+		    ret, l_channel_no);
+	if (ret != ICCOM_OK) {
+		LIBPRT_ERR("channel handle err : err = %d", ret);
+		retcode = ret;
+	}
+
+	if (retcode == ICCOM_OK) {
+		channel_global = &l_ctx->channel_global[l_channel_no];
+
+		/* lock channel handle */
+		LIBPRT_DBG("pthread_mutex_lock para = %p",
+			(void *)&channel_global->mutex_channel_info);
+		(void)pthread_mutex_lock(&channel_global->mutex_channel_info);
+		channel_mutex_flag = ICCOM_LIB_ON;
+
+		/* output channel handle debug log */
+		LIB_CANANEL_HANDLE_DBGLOG(l_channel_info, l_channel_no);
+
+		/* check channel handle pointer of global */
+		if (channel_global->channel_info != l_channel_info) {
+			LIBPRT_ERR("channel not open : channel No. = %u",
+				l_channel_no);
 			retcode = ICCOM_ERR_PARAM;
 		}
 	}
@@ -503,45 +2313,72 @@ int32_t Iccom_lib_Final(Iccom_channel_t ChannelHandle)
 	}
 
 	if (retcode == ICCOM_OK) {
-		/* wait receive thread end */
-		LIBPRT_DBG("pthread_join = %lu", l_channel_info->recv_thread_id);
-		(void)pthread_join(l_channel_info->recv_thread_id, NULL );
-
-		/* close channel */
-		LIBPRT_DBG("close function para = %d", l_channel_info->fd);
-		(void)close(l_channel_info->fd);
-		LIBPRT_NRL("close channel : retcode = %x", ret);
-
-		/* lock global mutex */
+		/* lock context mutex */
 		LIBPRT_DBG("pthread_mutex_lock para = %p",
-			(void *)&g_lib_mutex_global);
-		(void)pthread_mutex_lock(&g_lib_mutex_global);
+			(void *)&l_ctx->mutex_global);
+		(void)pthread_mutex_lock(&l_ctx->mutex_global);
 
 		/* clear channel handle pointer */
+		/* (channel functions called by the callback functions */
+		/*  from now on return ICCOM_ERR_PARAM)                */
 		channel_global->channel_info = NULL;
 
-		/* output channel handle debug log */
-		LIB_CANANEL_HANDLE_DBGLOG(l_channel_info, l_channel_no);
-
-		/* free channel handle */
-		LIBPRT_DBG("free para = %p", (void *)l_channel_info);
-		free(l_channel_info);
-
-		/* unlock global mutex */
+		/* unlock context mutex */
 		LIBPRT_DBG("pthread_mutex_unlock para = %p",
-			(void *)&g_lib_mutex_global);
-		(void)pthread_mutex_unlock(&g_lib_mutex_global);
+			(void *)&l_ctx->mutex_global);
+		(void)pthread_mutex_unlock(&l_ctx->mutex_global);
 
-		/* unlock channel handle & delete mutex */
+		/* unlock channel handle (the threads ended below may call */
+		/* callback functions, which may lock it)                  */
 		LIBPRT_DBG("pthread_mutex_unlock para = %p",
 			(void *)&channel_global->mutex_channel_info);
 		(void)pthread_mutex_unlock(
 			&channel_global->mutex_channel_info);
+
+		/* wait receive thread end */
+		LIBPRT_DBG("pthread_join = %lu", l_channel_info->recv_thread_id);
+		(void)pthread_join(l_channel_info->recv_thread_id, NULL );
+
+		/* stop link health prober */
+		iccom_health_destroy(l_channel_info->health);
+
+		/* stop batch receive queue (frames queued are delivered) */
+		iccom_batch_destroy(l_channel_info->batch);
+
+		/* stop conflation queue (data not sent is discarded) */
+		iccom_conflate_destroy(l_channel_info->conflate);
+
+		/* stop spill queue (records not sent remain in the file) */
+		iccom_spill_destroy(l_channel_info->spill);
+
+		/* delete channel mutex */
 		LIBPRT_DBG("pthread_mutex_destroy para = %p",
 			(void *)&channel_global->mutex_channel_info);
 		(void)pthread_mutex_destroy(
 			&channel_global->mutex_channel_info);
 
+		/* close channel */
+		LIBPRT_DBG("close function para = %d", l_channel_info->fd);
+		(void)close(l_channel_info->fd);
+		LIBPRT_NRL("close channel : retcode = %x", ret);
+
+		/* release message ID dispatch table */
+		iccom_dispatch_destroy(l_channel_info->dispatch);
+
+		/* release send rate shaper */
+		iccom_shaper_destroy(l_channel_info->shaper);
+
+		/* release delta encoder */
+		iccom_delta_destroy(l_channel_info->delta);
+
+		/* release send frame area */
+		free(l_channel_info->send_frame);
+		(void)pthread_mutex_destroy(&l_channel_info->send_mutex);
+
+		/* free channel handle */
+		LIBPRT_DBG("free para = %p", (void *)l_channel_info);
+		free(l_channel_info);
+
 	} else {
 		/* channel mutex lock already */
 		if (channel_mutex_flag == ICCOM_LIB_ON) {
@@ -573,7 +2410,12 @@ int32_t Iccom_lib_Final(Iccom_channel_t ChannelHandle)
 static void *iccom_lib_recv_thread(void *arg)
 {
 	struct iccom_channel_info_t *l_channel_info; /* channel handle info. */
+	struct iccom_health_t *l_health;	/* link health prober        */
 	ssize_t read_size;			/* receive size(result)      */
+	Iccom_recv_info l_recv_info;		/* receive information       */
+	int32_t ret;				/* call function return code */
+	uint8_t *l_data;			/* receive data pointer      */
+	uint32_t l_size;			/* receive data size         */
 
 	l_channel_info = (struct iccom_channel_info_t *)arg;
 
@@ -586,29 +2428,64 @@ static void *iccom_lib_recv_thread(void *arg)
 		LIBPRT_DBG("read function para : 1st = %d, 2nd = %p, 3rd = %u",
 			    l_channel_info->fd,
 			    (void *)l_channel_info->recv_buf,
-			    ICCOM_BUF_MAX_SIZE);
+			    l_channel_info->frame_max);
 		read_size = read(l_channel_info->fd, l_channel_info->recv_buf,
-			ICCOM_BUF_MAX_SIZE);
+			(size_t)l_channel_info->frame_max);
 		LIBPRT_NRL("receive data : receive size = %ld, errno = %d",
 			   read_size, errno);
 		if (read_size >= 0) {
-			LIBPRT_DBG(
-				"call callback function : call back = %p"
-				" channel No. = %d, size = %ld, buf = %p",
-				(void *)l_channel_info->recv_cb,
-				(int32_t)l_channel_info->channel_no,
-				read_size, (void *)l_channel_info->recv_buf);
-			/* call callback function */
-			(*l_channel_info->recv_cb)(
-				l_channel_info->channel_no,
-				(uint32_t)read_size,
-				l_channel_info->recv_buf);
+			/* set receive information */
+			l_recv_info.recv_time = iccom_lib_get_time();
+			l_recv_info.recv_seq = l_channel_info->recv_seq;
+			l_recv_info.send_time = 0U;
+			l_recv_info.send_seq = 0U;
+			l_recv_info.flags = 0U;
+			l_channel_info->recv_seq++;
+			(void)__atomic_fetch_add(
+				&l_channel_info->metrics.recv_count, 1U,
+				__ATOMIC_RELAXED);
+			(void)__atomic_fetch_add(
+				&l_channel_info->metrics.recv_bytes,
+				(uint64_t)read_size, __ATOMIC_RELAXED);
+
+			l_data = l_channel_info->recv_buf;
+			l_size = (uint32_t)read_size;
+			/* check and remove header and trailer of frame */
+			ret = iccom_lib_check_frame(l_channel_info, &l_data,
+				&l_size, &l_recv_info);
+			if (ret != ICCOM_OK) {
+				iccom_metrics_error(&l_channel_info->metrics,
+					ret, ICCOM_LIB_ON);
+			}
+			if (ret == ICCOM_OK) {
+				/* probe echoes are taken by the prober */
+				l_health = __atomic_load_n(
+					&l_channel_info->health,
+					__ATOMIC_ACQUIRE);
+				if ((l_health == NULL) ||
+				    (iccom_health_recv(l_health, l_data,
+					l_size, l_recv_info.recv_time) ==
+				     ICCOM_LIB_OFF)) {
+					iccom_lib_deliver(l_channel_info,
+						l_data, l_size, &l_recv_info);
+				}
+			} else if (l_channel_info->error_cb != NULL) {
+				l_channel_info->error_cb(
+					l_channel_info->user_data,
+					l_channel_info->channel_no, ret,
+					(uint32_t)read_size,
+					l_channel_info->recv_buf);
+			} else {
+				/* frame is discarded */
+			}
 		} else {
 			/* end data receive */
 			if (errno == ECANCELED) {
 				break;
 			}
 			/* otter */
+			iccom_metrics_error(&l_channel_info->metrics,
+				ICCOM_NG, ICCOM_LIB_ON);
 			LIBPRT_ERR(
 				"receive err : channel No. = %d, err = %d:%s",
 				(int32_t)l_channel_info->channel_no,
@@ -619,26 +2496,516 @@ static void *iccom_lib_recv_thread(void *arg)
 	pthread_exit(NULL);
 }
 
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_lib_check_frame                                         */
+/*  Function : Check the received frame and remove its header and trailer.   */
+/*             1. Verify and remove CRC32C trailer (ICCOM_INIT_CRC32C).      */
+/*             2. Remove send stamp header and set it to the receive         */
+/*                information (ICCOM_INIT_STAMP).                            */
+/*             3. Reconstruct the data of delta frame into the receive       */
+/*                buffer (ICCOM_INIT_DELTA).                                 */
+/*  Callinq seq.                                                             */
+/*           iccom_lib_check_frame(                                          */
+/*                           struct iccom_channel_info_t *channel_info,      */
+/*                           uint8_t **data, uint32_t *size,                 */
+/*                           Iccom_recv_info *recv_info)                     */
+/*  Input    : *channel_info   : Channel handle information pointer.         */
+/*             **data          : Received frame pointer.                     */
+/*             *size           : Received frame size.                        */
+/*  Output   : **data          : Received data pointer.                      */
+/*             *size           : Received data size.                         */
+/*             *recv_info      : Receive information.                        */
+/*  Return   : 1. ICCOM_OK           (0)  : Normal                           */
+/*             2. ICCOM_ERR_SIZE     (-9) : Frame too short                  */
+/*             3. ICCOM_ERR_CRC      (-11): CRC32C mismatch                  */
+/*             4. ICCOM_ERR_DELTA    (-12): No reference frame of delta      */
+/*  Caller   : iccom_lib_recv_thread                                         */
+/*                                                                           */
+/*****************************************************************************/
+static int32_t iccom_lib_check_frame(struct iccom_channel_info_t *channel_info,
+			uint8_t **data, uint32_t *size,
+			Iccom_recv_info *recv_info)
+{
+	Iccom_stamp_header l_stamp;		/* send stamp header         */
+	int32_t retcode = ICCOM_OK;		/* return code               */
+	uint8_t *l_data = *data;		/* frame pointer             */
+	uint32_t l_size = *size;		/* frame size                */
+	uint32_t l_min_size = 0U;		/* frame minimum size        */
+	uint32_t l_crc;				/* CRC32C of trailer         */
+
+	if ((channel_info->flags & ICCOM_INIT_STAMP) != 0U) {
+		l_min_size += ICCOM_STAMP_HEADER_SIZE;
+	}
+	if ((channel_info->flags & ICCOM_INIT_CRC32C) != 0U) {
+		l_min_size += ICCOM_CRC32C_SIZE;
+	}
+	if ((channel_info->flags & ICCOM_INIT_DELTA) != 0U) {
+		l_min_size += ICCOM_DELTA_HEADER_SIZE;
+	}
+	if (l_size < l_min_size) {
+		LIBPRT_ERR("short frame : channel No. = %d, size = %u",
+			(int32_t)channel_info->channel_no, l_size);
+		(void)__atomic_fetch_add(&channel_info->short_count, 1U,
+			__ATOMIC_RELAXED);
+		retcode = ICCOM_ERR_SIZE;
+	}
+
+	if ((retcode == ICCOM_OK) &&
+	    ((channel_info->flags & ICCOM_INIT_CRC32C) != 0U)) {
+		/* verify and remove CRC32C trailer */
+		l_size -= ICCOM_CRC32C_SIZE;
+		l_crc = (uint32_t)l_data[l_size] |
+			((uint32_t)l_data[l_size + 1U] << 8) |
+			((uint32_t)l_data[l_size + 2U] << 16) |
+			((uint32_t)l_data[l_size + 3U] << 24);
+		(void)__atomic_fetch_add(&channel_info->check_count, 1U,
+			__ATOMIC_RELAXED);
+		if (iccom_crc32c(l_data, l_size) != l_crc) {
+			LIBPRT_ERR("CRC32C mismatch : channel No. = %d,"
+				" size = %u",
+				(int32_t)channel_info->channel_no, *size);
+			(void)__atomic_fetch_add(
+				&channel_info->crc_error_count, 1U,
+				__ATOMIC_RELAXED);
+			retcode = ICCOM_ERR_CRC;
+		}
+	}
+
+	if ((retcode == ICCOM_OK) &&
+	    ((channel_info->flags & ICCOM_INIT_STAMP) != 0U)) {
+		/* remove send stamp header */
+		(void)memcpy((void *)&l_stamp, (const void *)l_data,
+			ICCOM_STAMP_HEADER_SIZE);
+		recv_info->send_time = l_stamp.time;
+		recv_info->send_seq = l_stamp.seq;
+		recv_info->flags |= ICCOM_RECV_INFO_STAMPED;
+		l_data = &l_data[ICCOM_STAMP_HEADER_SIZE];
+		l_size -= ICCOM_STAMP_HEADER_SIZE;
+	}
+
+	if ((retcode == ICCOM_OK) &&
+	    ((channel_info->flags & ICCOM_INIT_DELTA) != 0U)) {
+		/* reconstruct data */
+		retcode = iccom_delta_decode(channel_info->delta, l_data,
+				l_size, channel_info->recv_buf, &l_size);
+		l_data = channel_info->recv_buf;
+	}
+
+	if (retcode == ICCOM_OK) {
+		*data = l_data;
+		*size = l_size;
+	}
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_lib_deliver                                             */
+/*  Function : Pass the received data to message handler of its message ID   */
+/*             (Iccom_lib_DispatchConfig) or to callback function.           */
+/*  Callinq seq.                                                             */
+/*           iccom_lib_deliver(                                              */
+/*                     const struct iccom_channel_info_t *channel_info,      */
+/*                     uint8_t *recv_buf,                                    */
+/*                     uint32_t recv_size,                                   */
+/*                     const Iccom_recv_info *recv_info)                     */
+/*  Input    : *channel_info   : Channel handle information pointer.         */
+/*             *recv_buf       : Received data pointer.                      */
+/*             recv_size       : Received data size.                         */
+/*             *recv_info      : Receive information pointer.                */
+/*  Return   : NON                                                           */
+/*  Caller   : iccom_lib_recv_thread                                         */
+/*                                                                           */
+/*****************************************************************************/
+static void iccom_lib_deliver(const struct iccom_channel_info_t *channel_info,
+			uint8_t *recv_buf, uint32_t recv_size,
+			const Iccom_recv_info *recv_info)
+{
+	struct iccom_dispatch_t *l_dispatch;	/* dispatch table            */
+	struct iccom_dispatch_entry_t *l_entry;	/* handler entry             */
+	Iccom_msg_handler_t l_handler;		/* message handler           */
+	void *l_user_data;			/* handler user data         */
+	uint32_t l_msg_id;			/* message ID                */
+	uint64_t l_start;			/* handler start time        */
+
+	/* dispatch table is set by Iccom_lib_DispatchConfig */
+	l_dispatch = __atomic_load_n(&channel_info->dispatch,
+		__ATOMIC_ACQUIRE);
+	if (l_dispatch != NULL) {
+		l_entry = iccom_dispatch_lookup(l_dispatch, recv_buf,
+			recv_size, &l_msg_id, &l_handler, &l_user_data);
+		LIBPRT_DBG("dispatch : msg_id = %u, handler = %p",
+			l_msg_id, (void *)l_handler);
+
+		l_start = iccom_lib_get_time();
+		if (l_handler != NULL) {
+			(*l_handler)(l_user_data, channel_info->channel_no,
+				l_msg_id, recv_size, recv_buf, recv_info);
+		} else {
+			iccom_lib_call_callback(channel_info, recv_buf,
+				recv_size, recv_info);
+		}
+		iccom_dispatch_account(l_entry,
+			iccom_lib_get_time() - l_start);
+	} else {
+		iccom_lib_call_callback(channel_info, recv_buf, recv_size,
+			recv_info);
+	}
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_lib_call_callback                                       */
+/*  Function : Call callback function for pass the received data.            */
+/*             With the batch callback (Iccom_lib_BatchConfig), queue the    */
+/*             data for the batch callback function instead.                 */
+/*  Callinq seq.                                                             */
+/*           iccom_lib_call_callback(                                        */
+/*                     const struct iccom_channel_info_t *channel_info,      */
+/*                     uint8_t *recv_buf,                                    */
+/*                     uint32_t recv_size,                                   */
+/*                     const Iccom_recv_info *recv_info)                     */
+/*  Input    : *channel_info   : Channel handle information pointer.         */
+/*             *recv_buf       : Received data pointer.                      */
+/*             recv_size       : Received data size.                         */
+/*             *recv_info      : Receive information pointer.                */
+/*  Return   : NON                                                           */
+/*  Caller   : iccom_lib_deliver                                             */
+/*                                                                           */
+/*****************************************************************************/
+static void iccom_lib_call_callback(
+			const struct iccom_channel_info_t *channel_info,
+			uint8_t *recv_buf, uint32_t recv_size,
+			const Iccom_recv_info *recv_info)
+{
+	struct iccom_batch_t *l_batch;		/* batch receive queue       */
+
+	LIBPRT_DBG("call callback function : channel No. = %d, size = %u,"
+		" buf = %p, recv_seq = %lu",
+		(int32_t)channel_info->channel_no, recv_size,
+		(void *)recv_buf, recv_info->recv_seq);
+
+	/* batch receive queue is set by Iccom_lib_BatchConfig */
+	l_batch = __atomic_load_n(&channel_info->batch, __ATOMIC_ACQUIRE);
+
+	/* call callback function */
+	if (l_batch != NULL) {
+		iccom_batch_put(l_batch, recv_buf, recv_size, recv_info);
+	} else if (channel_info->recv_info_cb != NULL) {
+		(*channel_info->recv_info_cb)(
+			channel_info->user_data,
+			channel_info->channel_no,
+			recv_size, recv_buf, recv_info);
+	} else if (channel_info->recv_cb_ex != NULL) {
+		(*channel_info->recv_cb_ex)(
+			channel_info->user_data,
+			channel_info->channel_no,
+			recv_size, recv_buf);
+	} else {
+		(*channel_info->recv_cb)(
+			channel_info->channel_no,
+			recv_size, recv_buf);
+	}
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_lib_get_time                                            */
+/*  Function : Get current time of CLOCK_MONOTONIC.                          */
+/*  Callinq seq.                                                             */
+/*           iccom_lib_get_time(void)                                        */
+/*  Return   : current time (ns)                                             */
+/*  Caller   : The function of ICCOM library                                 */
+/*                                                                           */
+/*****************************************************************************/
+uint64_t iccom_lib_get_time(void)
+{
+	struct timespec l_ts;			/* current time              */
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &l_ts);
+	return ((uint64_t)l_ts.tv_sec * 1000000000U) +
+		(uint64_t)l_ts.tv_nsec;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_lib_get_id                                              */
+/*  Function : Get the message, stream or topic ID field of data.            */
+/*  Callinq seq.                                                             */
+/*           iccom_lib_get_id(const uint8_t *buf, uint32_t size,             */
+/*                            uint32_t offset, uint32_t width,               */
+/*                            uint32_t order, uint32_t *id)                  */
+/*  Input    : *buf            : Data pointer.                               */
+/*             size            : Data size.                                  */
+/*             offset          : ID byte offset.                             */
+/*             width           : ID byte width (0 to 4, 0: ID 0).            */
+/*             order           : ICCOM_ID_xxx_ENDIAN.                        */
+/*  Output   : *id             : ID (0: data shorter than the ID).           */
+/*  Return   : 1. ICCOM_OK           (0)  : Normal                           */
+/*             2. ICCOM_ERR_SIZE     (-9) : Data shorter than the ID         */
+/*  Caller   : iccom_dispatch_lookup, iccom_delta_encode,                    */
+/*             iccom_conflate_put                                            */
+/*                                                                           */
+/*****************************************************************************/
+int32_t iccom_lib_get_id(const uint8_t *buf, uint32_t size, uint32_t offset,
+			uint32_t width, uint32_t order, uint32_t *id)
+{
+	int32_t retcode = ICCOM_OK;		/* return code               */
+	uint32_t l_id = 0U;			/* ID                        */
+	uint32_t l_cnt;				/* loop counter              */
+
+	if ((width > size) || (offset > (size - width))) {
+		retcode = ICCOM_ERR_SIZE;
+	} else if (order == ICCOM_ID_BIG_ENDIAN) {
+		for (l_cnt = 0U; l_cnt < width; l_cnt++) {
+			l_id = (l_id << 8) | (uint32_t)buf[offset + l_cnt];
+		}
+	} else {
+		for (l_cnt = 0U; l_cnt < width; l_cnt++) {
+			l_id |= (uint32_t)buf[offset + l_cnt] << (8U * l_cnt);
+		}
+	}
+	*id = l_id;
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_lib_parse_dev_path                                      */
+/*  Function : Set device file name of context from path template.           */
+/*             The template has one "%u" (or "%d") replaced with the         */
+/*             channel number; "%%" is a '%' character.                      */
+/*  Callinq seq.                                                             */
+/*           iccom_lib_parse_dev_path(struct iccom_ctx_t *ctx,               */
+/*                                    const char *dev_path)                  */
+/*  Input    : *dev_path       : Path template (NULL: "/dev/iccom%u").       */
+/*  Output   : *ctx            : dev_prefix, dev_suffix of context.          */
+/*  Return   : 1. ICCOM_OK           (0)  : Normal                           */
+/*             2. ICCOM_ERR_PARAM    (-2) : Illegal template                 */
+/*  Caller   : Iccom_lib_CtxCreate                                           */
+/*                                                                           */
+/*****************************************************************************/
+static int32_t iccom_lib_parse_dev_path(struct iccom_ctx_t *ctx,
+			const char *dev_path)
+{
+	int8_t *l_out;				/* output name area          */
+	int32_t retcode = ICCOM_OK;		/* return code               */
+	uint32_t l_len = 0U;			/* output length             */
+	uint32_t l_conv = 0U;			/* "%u" count                */
+	uint32_t l_pos;				/* template position         */
+
+	if (dev_path == NULL) {
+		dev_path = ICCOM_DEVFILENAME "%u";
+	}
+
+	l_out = ctx->dev_prefix;
+	for (l_pos = 0U; (dev_path[l_pos] != '\0') && (retcode == ICCOM_OK);
+	     l_pos++) {
+		if (dev_path[l_pos] != '%') {
+			l_out[l_len] = (int8_t)dev_path[l_pos];
+			l_len++;
+		} else if (dev_path[l_pos + 1U] == '%') {
+			l_out[l_len] = (int8_t)'%';
+			l_len++;
+			l_pos++;
+		} else if (((dev_path[l_pos + 1U] == 'u') ||
+			    (dev_path[l_pos + 1U] == 'd')) && (l_conv == 0U)) {
+			/* channel number position */
+			l_out[l_len] = (int8_t)'\0';
+			l_out = ctx->dev_suffix;
+			l_len = 0U;
+			l_conv++;
+			l_pos++;
+		} else {
+			retcode = ICCOM_ERR_PARAM;
+		}
+		/* reserve channel number digits and terminator */
+		if (l_len >= (ICCOM_DEVFILE_LEN - 12U)) {
+			retcode = ICCOM_ERR_PARAM;
+		}
+	}
+
+	if ((retcode != ICCOM_OK) || (l_conv != 1U)) {
+		LIBPRT_ERR("illegal device file path : %s", dev_path);
+		retcode = ICCOM_ERR_PARAM;
+	} else {
+		l_out[l_len] = (int8_t)'\0';
+	}
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_lib_foreach_channel                                     */
+/*  Function : Call the function for each open channel of all contexts.      */
+/*  Callinq seq.                                                             */
+/*           iccom_lib_foreach_channel(                                      */
+/*                void (*func)(struct iccom_channel_info_t *channel_info,    */
+/*                             const char *dev_name, void *arg),             */
+/*                void *arg)                                                 */
+/*  Input    : func            : Function called for each channel.           */
+/*             *arg            : Argument of the function.                   */
+/*  Return   : NON                                                           */
+/*  Caller   : iccom_metrics_update                                          */
+/*  Note     : The context mutex is locked during the function, so the       */
+/*             channel handle information is not released; the function      */
+/*             must not lock the channel mutex (Iccom_lib_Final locks it     */
+/*             before the context mutex).                                    */
+/*                                                                           */
+/*****************************************************************************/
+void iccom_lib_foreach_channel(
+		void (*func)(struct iccom_channel_info_t *channel_info,
+			const char *dev_name, void *arg), void *arg)
+{
+	struct iccom_ctx_t *l_ctx;		/* context pointer           */
+	struct iccom_channel_info_t *l_channel_info; /* channel handle info. */
+	char l_name[ICCOM_DEVFILE_LEN];		/* device file name          */
+	int32_t ret;				/* call function return code */
+	uint32_t l_cnt;				/* loop counter              */
+
+	(void)pthread_rwlock_rdlock(&g_lib_ctx_lock);
+	for (l_ctx = &g_lib_ctx_default; l_ctx != NULL; l_ctx = l_ctx->next) {
+		(void)pthread_mutex_lock(&l_ctx->mutex_global);
+		for (l_cnt = 0U; l_cnt < l_ctx->channel_max; l_cnt++) {
+			l_channel_info =
+				l_ctx->channel_global[l_cnt].channel_info;
+			if (l_channel_info != NULL) {
+				/* (length checked at channel initialization) */
+				ret = snprintf(l_name, sizeof(l_name), "%s%u%s",
+					(const char *)l_ctx->dev_prefix, l_cnt,
+					(const char *)l_ctx->dev_suffix);
+				if ((ret > 0) &&
+				    (ret < (int32_t)sizeof(l_name))) {
+					func(l_channel_info, l_name, arg);
+				}
+			}
+		}
+		(void)pthread_mutex_unlock(&l_ctx->mutex_global);
+	}
+	(void)pthread_rwlock_unlock(&g_lib_ctx_lock);
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_lib_check_ctx                                           */
+/*  Function : Check context handle.                                         */
+/*  Callinq seq.                                                             */
+/*           iccom_lib_check_ctx(const struct iccom_ctx_t *ctx)              */
+/*  Input    : *ctx            : Context pointer.                            */
+/*  Return   : 1. ICCOM_OK           (0)  : Normal                           */
+/*             2. ICCOM_ERR_PARAM    (-2) : Not created context              */
+/*  Caller   : Iccom_lib_CtxInit                                             */
+/*                                                                           */
+/*****************************************************************************/
+static int32_t iccom_lib_check_ctx(const struct iccom_ctx_t *ctx)
+{
+	const struct iccom_ctx_t *l_ctx;	/* context pointer           */
+	int32_t retcode = ICCOM_OK;		/* return code               */
+
+	(void)pthread_rwlock_rdlock(&g_lib_ctx_lock);
+	for (l_ctx = &g_lib_ctx_default; l_ctx != NULL; l_ctx = l_ctx->next) {
+		if (l_ctx == ctx) {
+			break;
+		}
+	}
+	(void)pthread_rwlock_unlock(&g_lib_ctx_lock);
+
+	if (l_ctx == NULL) {
+		LIBPRT_ERR("not found context : ctx = %p", (const void *)ctx);
+		retcode = ICCOM_ERR_PARAM;
+	}
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_lib_lock_handle                                         */
+/*  Function : Check channel handle and lock the channel.                    */
+/*  Callinq seq.                                                             */
+/*           iccom_lib_lock_handle(Iccom_channel_t ChannelHandle,            */
+/*                    struct iccom_channel_info_t **channel_info,            */
+/*                    struct iccom_channel_global_t **channel_global)        */
+/*  Input    : ChannelHandle   : Channel handle.                             */
+/*  Output   : **channel_info  : Channel handle information pointer.         */
+/*             **channel_global: Channel global information pointer.         */
+/*  Return   : 1. ICCOM_OK           (0)  : Normal                           */
+/*                                          (mutex_channel_info locked)      */
+/*             2. ICCOM_ERR_PARAM    (-2) : Parameter error                  */
+/*  Caller   : The function in iccom_library.c                               */
+/*                                                                           */
+/*****************************************************************************/
+static int32_t iccom_lib_lock_handle(Iccom_channel_t ChannelHandle,
+			struct iccom_channel_info_t **channel_info,
+			struct iccom_channel_global_t **channel_global)
+{
+	struct iccom_channel_info_t *l_channel_info;   /* channel handle inf.*/
+	struct iccom_channel_global_t *l_channel_global; /* ch. global ptr.  */
+	struct iccom_ctx_t *l_ctx;		/* context pointer           */
+	int32_t retcode;			/* return code               */
+	uint32_t l_channel_no;			/* channel number            */
+
+	l_channel_info = (struct iccom_channel_info_t *)ChannelHandle;
+	/* check channel handle & get channel number */
+	retcode = iccom_lib_check_handle(l_channel_info, &l_ctx,
+			&l_channel_no);
+	if (retcode != ICCOM_OK) {
+		LIBPRT_ERR("channel handle err : err = %d", retcode);
+	}
+
+	if (retcode == ICCOM_OK) {
+		l_channel_global = &l_ctx->channel_global[l_channel_no];
+
+		/* lock channel handle */
+		(void)pthread_mutex_lock(&l_channel_global->mutex_channel_info);
+
+		/* check channel handle pointer of global */
+		if (l_channel_global->channel_info != l_channel_info) {
+			LIBPRT_ERR("channel not open : channel No. = %u",
+				l_channel_no);
+			(void)pthread_mutex_unlock(
+				&l_channel_global->mutex_channel_info);
+			retcode = ICCOM_ERR_PARAM;
+		}
+	}
+
+	if (retcode == ICCOM_OK) {
+		*channel_info = l_channel_info;
+		*channel_global = l_channel_global;
+	}
+	return retcode;
+}
+
 /*****************************************************************************/
 /*                                                                           */
 /*  Name     : iccom_lib_check_handle                                        */
-/*  Function : Check channel handle and get channel number                   */
+/*  Function : Check channel handle and get its context and channel number   */
 /*  Callinq seq.                                                             */
 /*           iccom_lib_check_handle(                                         */
 /*                           struct iccom_channel_info_t *channel_info,      */
+/*                           struct iccom_ctx_t          **ctx,              */
 /*                           uint32_t                    *channel_no)        */
 /*  Input    : *channel_info   : Channel handle pointer.                     */
-/*  Output   : *channel_no     : channel number pointer.                     */
+/*  Output   : **ctx           : context pointer.                            */
+/*             *channel_no     : channel number pointer.                     */
 /*  Return   : 1. ICCOM_OK           (0)  : Normal                           */
 /*             2. ICCOM_ERR_PARAM    (-2) : Parameter error                  */
-/*  Caller   : Iccom_lib_Send, Iccom_lib_Final                               */
+/*  Caller   : Iccom_lib_Send, Iccom_lib_Final, iccom_lib_lock_handle        */
+/*  Note     : The handle is searched in the channel table of each context   */
+/*             (under its context mutex) before it is read, so a released    */
+/*             or unknown handle is not accessed.  The caller locks the      */
+/*             channel mutex and checks that the table entry is still the    */
+/*             handle.                                                       */
 /*                                                                           */
 /*****************************************************************************/
 static int32_t iccom_lib_check_handle(
-	const struct iccom_channel_info_t *channel_info, uint32_t *channel_no)
+	const struct iccom_channel_info_t *channel_info,
+	struct iccom_ctx_t **ctx, uint32_t *channel_no)
 {
+	struct iccom_ctx_t *l_ctx = NULL;	/* context pointer           */
 	int32_t retcode = ICCOM_OK;	/* return code                       */
-	uint32_t ch_loop;		/* loop counter of channel number    */
+	uint32_t l_channel_no = 0U;	/* channel number                    */
+	uint32_t ch_loop = 0U;		/* loop counter of channel number    */
 
 	LIBPRT_DBG("start channel_info = %p", (const void *)channel_info);
 
@@ -649,28 +3016,45 @@ static int32_t iccom_lib_check_handle(
 	}
 
 	if (retcode == ICCOM_OK) {
-		/* lock global mutex */
-		LIBPRT_DBG("pthread_mutex_lock para = %p",
-			(void *)&g_lib_mutex_global);
-		(void)pthread_mutex_lock(&g_lib_mutex_global);
-
-		/* search channel handle pointer channel handle pointer */
-		for (ch_loop = 0U; ch_loop < (uint32_t)ICCOM_CHANNEL_MAX;
-		     ch_loop++) {
-			/* check channel handle pointer */
-			if (g_lib_channel_global[ch_loop].channel_info ==
-				channel_info) {
+		/* lock context list */
+		(void)pthread_rwlock_rdlock(&g_lib_ctx_lock);
+
+		for (l_ctx = &g_lib_ctx_default; l_ctx != NULL;
+		     l_ctx = l_ctx->next) {
+			/* lock context mutex */
+			LIBPRT_DBG("pthread_mutex_lock para = %p",
+				(void *)&l_ctx->mutex_global);
+			(void)pthread_mutex_lock(&l_ctx->mutex_global);
+
+			/* search channel handle pointer */
+			for (ch_loop = 0U; ch_loop < l_ctx->channel_max;
+			     ch_loop++) {
+				if (l_ctx->channel_global[ch_loop]
+					.channel_info == channel_info) {
+					break;
+				}
+			}
+			if (ch_loop < l_ctx->channel_max) {
+				/* found : the handle is not released while */
+				/* the context mutex is locked              */
+				l_channel_no =
+					(uint32_t)channel_info->channel_no;
+			}
+
+			/* unlock context mutex */
+			LIBPRT_DBG("pthread_mutex_unlock para = %p",
+				(void *)&l_ctx->mutex_global);
+			(void)pthread_mutex_unlock(&l_ctx->mutex_global);
+
+			if (ch_loop < l_ctx->channel_max) {
 				break;
 			}
 		}
 
-		/* unlock global mutex */
-		LIBPRT_DBG("pthread_mutex_unlock para = %p",
-			(void *)&g_lib_mutex_global);
-		(void)pthread_mutex_unlock(&g_lib_mutex_global);
+		/* unlock context list */
+		(void)pthread_rwlock_unlock(&g_lib_ctx_lock);
 
-		/* check loop count */
-		if (ch_loop >= (uint32_t)ICCOM_CHANNEL_MAX) {
+		if (l_ctx == NULL) {
 			/* not found channel handle pointer */
 			LIBPRT_ERR("not found channel handle pointer");
 			retcode = ICCOM_ERR_PARAM;
@@ -679,22 +3063,22 @@ static int32_t iccom_lib_check_handle(
 
 	if (retcode == ICCOM_OK) {
 		/* check channel number */
-		if ((uint32_t)channel_info->channel_no != ch_loop) {
+		if (l_channel_no != ch_loop) {
 			LIBPRT_ERR(
 				"mismatch channel No. : handle = %u,"
-				" global = %u",
-				(uint32_t)channel_info->channel_no, ch_loop);
+				" global = %u", l_channel_no, ch_loop);
 			retcode = ICCOM_ERR_PARAM;
 		}
 	}
 
 	if (retcode == ICCOM_OK) {
-		/* set channel number */
-		*channel_no = (uint32_t)channel_info->channel_no;
+		/* set context & channel number */
+		*ctx = l_ctx;
+		*channel_no = l_channel_no;
 	}
 
-	LIBPRT_DBG("end:channel No. %d, retcode = %d, loop_connter %u",
-		*channel_no, retcode, ch_loop);
+	LIBPRT_DBG("end:retcode = %d, channel No. = %u", retcode,
+		l_channel_no);
 	return retcode;
 }
 
@@ -720,20 +3104,22 @@ static void iccom_lib_handle_log(const int8_t *func_name, int32_t func_line,
 			struct iccom_channel_info_t *channel_info,
 			uint32_t channel_no)
 {
-	(void)printf("%s() L%d g_channel_no = %d\n",
-		func_name, func_line, channel_no);
-	(void)printf("g_ch[0]-[3] = %16p %16p %16p %16p\n",
-		(void *)g_lib_channel_global[0].channel_info,
-		(void *)g_lib_channel_global[1].channel_info,
-		(void *)g_lib_channel_global[2].channel_info,
-		(void *)g_lib_channel_global[3].channel_info);
-	(void)printf("g_ch[4]-[7] = %16p %16p %16p %16p\n",
-		(void *)g_lib_channel_global[4].channel_info,
-		(void *)g_lib_channel_global[5].channel_info,
-		(void *)g_lib_channel_global[6].channel_info,
-		(void *)g_lib_channel_global[7].channel_info);
-
-	if (g_lib_channel_global[channel_no].channel_info != NULL) {
+	const struct iccom_ctx_t *l_ctx = channel_info->ctx; /* context      */
+	uint32_t l_cnt;				/* loop counter              */
+
+	(void)printf("%s() L%d g_channel_no = %d, ctx = %p\n",
+		func_name, func_line, channel_no, (const void *)l_ctx);
+	for (l_cnt = 0U; l_cnt < l_ctx->channel_max; l_cnt++) {
+		(void)printf("%sg_ch[%u] = %16p", ((l_cnt % 4U) == 0U) ?
+			"" : " ", l_cnt,
+			(void *)l_ctx->channel_global[l_cnt].channel_info);
+		if (((l_cnt % 4U) == 3U) ||
+		    ((l_cnt + 1U) == l_ctx->channel_max)) {
+			(void)printf("\n");
+		}
+	}
+
+	if (l_ctx->channel_global[channel_no].channel_info != NULL) {
 		(void)printf("    channel_no = %d\n",
 			(int32_t)channel_info->channel_no);
 		(void)printf("    send_cnt   = %d\n",
@@ -742,6 +3128,13 @@ static void iccom_lib_handle_log(const int8_t *func_name, int32_t func_line,
 			(void *)channel_info->recv_buf);
 		(void)printf("    recv_cb    = %p\n",
 			(void *)channel_info->recv_cb);
+		(void)printf("    recv_cb_ex = %p\n",
+			(void *)channel_info->recv_cb_ex);
+		(void)printf("    user_data  = %p\n", channel_info->user_data);
+		(void)printf("    flags      = 0x%08x\n", channel_info->flags);
+		(void)printf("    frame_max  = %u\n", channel_info->frame_max);
+		(void)printf("    send_seq   = %u\n", channel_info->send_seq);
+		(void)printf("    recv_seq   = %lu\n", channel_info->recv_seq);
 		(void)printf("    fd         = %d\n", channel_info->fd);
 		(void)printf("    thread_id  = %lu\n",
 			                  channel_info->recv_thread_id);
@@ -749,17 +3142,17 @@ static void iccom_lib_handle_log(const int8_t *func_name, int32_t func_line,
 
 	(void)printf("%s() L%d mutex_channel_info = %d\n",
 		func_name, func_line, channel_no);
-	(void)printf("g_ch_mutex[0]-[3] = %16p %16p %16p %16p\n",
-		(void *)&g_lib_channel_global[0].mutex_channel_info,
-		(void *)&g_lib_channel_global[1].mutex_channel_info,
-		(void *)&g_lib_channel_global[2].mutex_channel_info,
-		(void *)&g_lib_channel_global[3].mutex_channel_info);
-	(void)printf("g_ch_mutex[4]-[7] = %16p %16p %16p %16p\n",
-		(void *)&g_lib_channel_global[4].mutex_channel_info,
-		(void *)&g_lib_channel_global[5].mutex_channel_info,
-		(void *)&g_lib_channel_global[6].mutex_channel_info,
-		(void *)&g_lib_channel_global[7].mutex_channel_info);
-	(void)printf("%s() L%d g_lib_mutex_global = %p\n",
-		func_name, func_line, (void *)&g_lib_mutex_global);
+	for (l_cnt = 0U; l_cnt < l_ctx->channel_max; l_cnt++) {
+		(void)printf("%sg_ch_mutex[%u] = %16p", ((l_cnt % 4U) == 0U) ?
+			"" : " ", l_cnt,
+			(const void *)&l_ctx->channel_global[l_cnt]
+				.mutex_channel_info);
+		if (((l_cnt % 4U) == 3U) ||
+		    ((l_cnt + 1U) == l_ctx->channel_max)) {
+			(void)printf("\n");
+		}
+	}
+	(void)printf("%s() L%d ctx mutex_global = %p\n",
+		func_name, func_line, (const void *)&l_ctx->mutex_global);
 }
 #endif
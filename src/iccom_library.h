@@ -14,20 +14,96 @@
 /* define definition                                                         */
 /*****************************************************************************/
 #define ICCOM_DEVFILENAME "/dev/iccom"	  /* device file name fixed portion  */
-#define ICCOM_DEVFILE_LEN (16U)		  /* device file name maximum length */
+#define ICCOM_DEVFILE_LEN (128U)	  /* device file name maximum length */
+#define ICCOM_CTX_CHANNEL_MAX (1024U)	  /* context channel maximum count   */
+
+#define ICCOM_INIT_FLAGS_ALL (ICCOM_INIT_STAMP | ICCOM_INIT_CRC32C | \
+			      ICCOM_INIT_DELTA)
+					  /* valid init flags                */
+
+#define ICCOM_DISPATCH_ID_MAX (65536U)	  /* registrable message ID max count*/
+#define ICCOM_DELTA_STREAM_MAX (256U)	  /* delta stream max count          */
+#define ICCOM_CONFLATE_TOPIC_MAX (4096U)  /* conflation topic max count      */
 
 #define ICCOM_LIB_ON  (1U)		  /* flag ON                         */
 #define ICCOM_LIB_OFF (0U)		  /* flag OFF                        */
 
+#define ICCOM_LIB_DROP (1)		  /* data dropped (internal code)    */
+#define ICCOM_LIB_EMPTY (2)		  /* queue empty (internal code)     */
+
 /*****************************************************************************/
 /* structure definition                                                      */
 /*****************************************************************************/
+/* message ID dispatch table (iccom_dispatch.c) */
+struct iccom_dispatch_t;
+struct iccom_dispatch_entry_t;
+
+/* send rate shaper (iccom_shaper.c) */
+struct iccom_shaper_t;
+
+/* spill queue (iccom_spill.c) */
+struct iccom_spill_t;
+
+/* delta encoder (iccom_delta.c) */
+struct iccom_delta_t;
+
+/* conflation queue (iccom_conflate.c) */
+struct iccom_conflate_t;
+
+/* batch receive queue (iccom_batch.c) */
+struct iccom_batch_t;
+
+/* link health prober (iccom_health.c) */
+struct iccom_health_t;
+
+struct iccom_ctx_t;
+
+/* channel counters of metrics page (updated with relaxed atomics) */
+struct iccom_metrics_counter_t {
+	uint64_t send_count;			/* frames sent               */
+	uint64_t send_bytes;			/* frame bytes sent          */
+	uint64_t send_error_count;		/* Iccom_lib_Send errors     */
+	uint64_t recv_count;			/* frames received           */
+	uint64_t recv_bytes;			/* frame bytes received      */
+	uint64_t recv_error_count;		/* receive errors            */
+	int32_t last_send_error;		/* last Iccom_lib_Send error */
+	int32_t last_recv_error;		/* last receive error        */
+	uint64_t spill_depth;			/* spill queue messages      */
+	uint64_t conflate_depth;		/* conflation queue topics   */
+	uint64_t error_count[ICCOM_METRICS_ERROR_MAX]; /* per error code     */
+	uint64_t send_latency[ICCOM_METRICS_HIST_SIZE]; /* write time hist.  */
+};
+
 /* channel handle information */
 struct iccom_channel_info_t {
 	enum Iccom_channel_number channel_no;	/* channel number            */
+	struct iccom_ctx_t *ctx;		/* context of channel        */
 	uint32_t send_req_cnt;			/* send request counter      */
 	uint8_t *recv_buf;			/* data receive buffer       */
 	Iccom_recv_callback_t recv_cb;		/* callback function         */
+	Iccom_recv_callback_ex_t recv_cb_ex;	/* callback function (ex)    */
+	void *user_data;			/* callback user data        */
+	Iccom_recv_info_callback_t recv_info_cb; /* callback (receive info) */
+	uint32_t flags;				/* ICCOM_INIT_xxx            */
+	Iccom_error_callback_t error_cb;	/* receive error callback    */
+	uint32_t frame_max;			/* frame maximum size        */
+	uint32_t data_max_size;			/* send data maximum size    */
+	uint8_t *send_frame;			/* send frame area (frame_max*/
+						/* over ICCOM_BUF_MAX_SIZE)  */
+	pthread_mutex_t send_mutex;		/* mutex of send_frame       */
+	uint32_t send_seq;			/* send sequence number      */
+	uint64_t recv_seq;			/* receive sequence number   */
+	uint64_t check_count;			/* CRC32C checked count      */
+	uint64_t crc_error_count;		/* CRC32C mismatch count     */
+	uint64_t short_count;			/* short frame count         */
+	struct iccom_dispatch_t *dispatch;	/* message ID dispatch table */
+	struct iccom_shaper_t *shaper;		/* send rate shaper          */
+	struct iccom_spill_t *spill;		/* spill queue               */
+	struct iccom_delta_t *delta;		/* delta encoder             */
+	struct iccom_conflate_t *conflate;	/* conflation queue          */
+	struct iccom_batch_t *batch;		/* batch receive queue       */
+	struct iccom_health_t *health;		/* link health prober        */
+	struct iccom_metrics_counter_t metrics;	/* metrics page counters     */
 	int    fd;				/* file descriptor           */
 	pthread_t recv_thread_id;		/* data receive thread ID    */
 };
@@ -38,8 +114,141 @@ struct iccom_channel_global_t {
 	pthread_mutex_t mutex_channel_info;		/* mutex information */
 };
 
+/* context information */
+struct iccom_ctx_t {
+	struct iccom_channel_global_t *channel_global;	/* channel table     */
+	uint32_t channel_max;				/* channel count     */
+	int8_t dev_prefix[ICCOM_DEVFILE_LEN];	/* device file name before   */
+						/* channel number            */
+	int8_t dev_suffix[ICCOM_DEVFILE_LEN];	/* device file name after    */
+						/* channel number            */
+	pthread_mutex_t mutex_global;		/* context mutex (channel    */
+						/* table)                    */
+	struct iccom_ctx_t *next;		/* next context              */
+};
+
 /* ioctl request command */
 #define ICCOM_IOC_CANCEL_RECEIVE	(1U)          /* Receive end specified */
+#define ICCOM_IOC_SET_FRAME_SIZE	(2U)	/* frame maximum size request */
+						/* (uint32_t: in requested,   */
+						/*  out accepted)             */
+
+/*****************************************************************************/
+/* internal function prototype                                               */
+/*****************************************************************************/
+/* current time get function (CLOCK_MONOTONIC, ns) */
+uint64_t iccom_lib_get_time(void);
+
+/* ID field get function (message, stream and topic IDs) */
+int32_t iccom_lib_get_id(const uint8_t *buf, uint32_t size, uint32_t offset,
+	uint32_t width, uint32_t order, uint32_t *id);
+
+/* data send function (with shaper and spill queue) */
+int32_t iccom_lib_send_shaped(struct iccom_channel_info_t *channel_info,
+	const uint8_t *send_buf, uint32_t send_size);
+
+/* frame send function (waits for the shaper, without spill queue) */
+int32_t iccom_lib_send_frame(struct iccom_channel_info_t *channel_info,
+	const uint8_t *send_buf, uint32_t send_size);
+
+/* channel walk function (ctx->mutex_global locked during func) */
+void iccom_lib_foreach_channel(
+	void (*func)(struct iccom_channel_info_t *channel_info,
+		const char *dev_name, void *arg), void *arg);
+
+/* CRC32C functions (iccom_crc32c.c) */
+uint32_t iccom_crc32c(const uint8_t *buf, uint32_t size);
+const char *iccom_crc32c_kernel(void);
+
+/* message ID dispatch table functions (iccom_dispatch.c) */
+int32_t iccom_dispatch_create(const Iccom_dispatch_param *param,
+	struct iccom_dispatch_t **dispatch);
+void iccom_dispatch_destroy(struct iccom_dispatch_t *dispatch);
+int32_t iccom_dispatch_register(struct iccom_dispatch_t *dispatch,
+	uint32_t msg_id, Iccom_msg_handler_t handler, void *user_data);
+struct iccom_dispatch_entry_t *iccom_dispatch_lookup(
+	struct iccom_dispatch_t *dispatch, const uint8_t *recv_buf,
+	uint32_t recv_size, uint32_t *msg_id, Iccom_msg_handler_t *handler,
+	void **user_data);
+void iccom_dispatch_account(struct iccom_dispatch_entry_t *entry,
+	uint64_t time);
+uint32_t iccom_dispatch_get_stats(struct iccom_dispatch_t *dispatch,
+	Iccom_dispatch_stats *stats, uint32_t stats_num);
+
+/* send rate shaper functions (iccom_shaper.c) */
+int32_t iccom_shaper_create(struct iccom_shaper_t **shaper);
+void iccom_shaper_destroy(struct iccom_shaper_t *shaper);
+int32_t iccom_shaper_config(struct iccom_shaper_t *shaper,
+	const Iccom_shaper_param *param);
+int32_t iccom_shaper_acquire(struct iccom_shaper_t *shaper,
+	uint32_t frame_size, uint8_t wait);
+void iccom_shaper_get_stats(struct iccom_shaper_t *shaper,
+	Iccom_shaper_stats *stats);
+
+/* spill queue functions (iccom_spill.c) */
+int32_t iccom_spill_create(const Iccom_spill_param *param,
+	struct iccom_channel_info_t *channel_info,
+	struct iccom_spill_t **spill);
+void iccom_spill_destroy(struct iccom_spill_t *spill);
+int32_t iccom_spill_put(struct iccom_spill_t *spill, const uint8_t *buf,
+	uint32_t size, uint32_t force);
+void iccom_spill_get_stats(struct iccom_spill_t *spill,
+	Iccom_spill_stats *stats);
+
+/* delta encoder functions (iccom_delta.c) */
+int32_t iccom_delta_create(uint32_t frame_max, struct iccom_delta_t **delta);
+void iccom_delta_destroy(struct iccom_delta_t *delta);
+int32_t iccom_delta_config(struct iccom_delta_t *delta,
+	const Iccom_delta_param *param);
+uint32_t iccom_delta_encode(struct iccom_delta_t *delta, const uint8_t *data,
+	uint32_t size, uint8_t *out);
+void iccom_delta_encode_end(struct iccom_delta_t *delta, uint32_t coded_size,
+	int32_t result);
+int32_t iccom_delta_decode(struct iccom_delta_t *delta, const uint8_t *in,
+	uint32_t in_size, uint8_t *out, uint32_t *out_size);
+void iccom_delta_get_stats(struct iccom_delta_t *delta,
+	Iccom_delta_stats *stats);
+const char *iccom_delta_kernel(void);
+
+/* conflation queue functions (iccom_conflate.c) */
+int32_t iccom_conflate_create(const Iccom_conflate_param *param,
+	struct iccom_channel_info_t *channel_info,
+	struct iccom_conflate_t **conflate);
+void iccom_conflate_destroy(struct iccom_conflate_t *conflate);
+int32_t iccom_conflate_put(struct iccom_conflate_t *conflate,
+	const uint8_t *buf, uint32_t size);
+void iccom_conflate_get_stats(struct iccom_conflate_t *conflate,
+	Iccom_conflate_stats *stats);
+
+/* batch receive queue functions (iccom_batch.c) */
+int32_t iccom_batch_create(const Iccom_batch_param *param,
+	struct iccom_channel_info_t *channel_info,
+	struct iccom_batch_t **batch);
+void iccom_batch_destroy(struct iccom_batch_t *batch);
+void iccom_batch_put(struct iccom_batch_t *batch, const uint8_t *buf,
+	uint32_t size, const Iccom_recv_info *recv_info);
+void iccom_batch_get_stats(struct iccom_batch_t *batch,
+	Iccom_batch_stats *stats);
+
+/* link health prober functions (iccom_health.c) */
+int32_t iccom_health_create(const Iccom_health_param *param,
+	struct iccom_channel_info_t *channel_info,
+	struct iccom_health_t **health);
+void iccom_health_destroy(struct iccom_health_t *health);
+uint32_t iccom_health_recv(struct iccom_health_t *health,
+	const uint8_t *buf, uint32_t size, uint64_t recv_time);
+void iccom_health_get_stats(struct iccom_health_t *health,
+	Iccom_health_stats *stats);
+
+/* metrics page functions (iccom_metrics.c) */
+void iccom_metrics_env_start(void);
+int32_t iccom_metrics_start(uint32_t interval);
+int32_t iccom_metrics_stop(void);
+uint64_t iccom_metrics_clock(void);
+void iccom_metrics_sent(struct iccom_metrics_counter_t *metrics,
+	uint32_t size, uint64_t start_time);
+void iccom_metrics_error(struct iccom_metrics_counter_t *metrics,
+	int32_t code, uint32_t recv);
 
 /*****************************************************************************/
 /* LOG definition                                                            */
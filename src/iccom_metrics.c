@@ -0,0 +1,596 @@
+/*
+ * Copyright (c) 2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "iccom.h"
+#include "iccom_library.h"
+
+/*****************************************************************************/
+/* define definition                                                         */
+/*****************************************************************************/
+#define ICCOM_METRICS_INTERVAL_DEFAULT (100U)	/* update interval (ms)      */
+#define ICCOM_METRICS_ENV "ICCOM_METRICS"	/* environment variable      */
+#define ICCOM_METRICS_SHM_NAME_LEN (64U)	/* shared memory name length */
+
+/*****************************************************************************/
+/* structure definition                                                      */
+/*****************************************************************************/
+/* metrics page publisher */
+struct iccom_metrics_t {
+	pthread_mutex_t api_mutex;		/* start / stop serialization*/
+	pthread_mutex_t mutex;			/* interval, stop request    */
+	pthread_cond_t cond;			/* stop request              */
+	Iccom_metrics_page *page;		/* shared memory page        */
+	char shm_name[ICCOM_METRICS_SHM_NAME_LEN]; /* shared memory name     */
+	uint64_t interval;			/* update interval (ns)      */
+	uint32_t stop;				/* publish thread stop req.  */
+	uint32_t exit_flag;			/* exit handler registered   */
+	pthread_t thread_id;			/* publish thread ID         */
+};
+
+/* channel walk state of one update */
+struct iccom_metrics_walk_t {
+	Iccom_metrics_page *page;		/* shared memory page        */
+	uint32_t count;				/* slots written             */
+};
+
+/*****************************************************************************/
+/* internal function prototype definition                                    */
+/*****************************************************************************/
+/* environment variable check function */
+static void iccom_metrics_env_once(void);
+/* process exit function */
+static void iccom_metrics_exit(void);
+/* publish thread function */
+static void *iccom_metrics_thread(void *arg);
+/* page update function */
+static void iccom_metrics_update(Iccom_metrics_page *page);
+/* channel slot update function */
+static void iccom_metrics_put_channel(
+	struct iccom_channel_info_t *channel_info, const char *dev_name,
+	void *arg);
+/* slot write function (seqlock) */
+static void iccom_metrics_write_slot(Iccom_metrics_channel *slot,
+	const Iccom_metrics_channel *data);
+
+/*****************************************************************************/
+/* metrics page global information                                           */
+/*****************************************************************************/
+static struct iccom_metrics_t g_metrics = {
+	PTHREAD_MUTEX_INITIALIZER,		/* start / stop serialization*/
+	PTHREAD_MUTEX_INITIALIZER		/* interval, stop request    */
+};
+/* publication flag (read by the data path without lock) */
+static uint32_t g_metrics_enabled = ICCOM_LIB_OFF;
+/* environment variable check (first channel initialization) */
+static pthread_once_t g_metrics_once = PTHREAD_ONCE_INIT;
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_metrics_env_start                                       */
+/*  Function : Start publication of metrics page when environment variable  */
+/*             ICCOM_METRICS is set to the update interval (ms).             */
+/*             Only the first call checks the environment variable.          */
+/*  Callinq seq.                                                             */
+/*           iccom_metrics_env_start(void)                                   */
+/*  Return   : NON                                                           */
+/*  Caller   : iccom_lib_init_common                                         */
+/*                                                                           */
+/*****************************************************************************/
+void iccom_metrics_env_start(void)
+{
+	(void)pthread_once(&g_metrics_once, iccom_metrics_env_once);
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_metrics_env_once                                        */
+/*  Function : Check environment variable ICCOM_METRICS.                     */
+/*             ICCOM_METRICS=<interval ms> : start publication               */
+/*             ICCOM_METRICS=0 or not set  : no publication                  */
+/*  Callinq seq.                                                             */
+/*           iccom_metrics_env_once(void)                                    */
+/*  Return   : NON                                                           */
+/*  Caller   : iccom_metrics_env_start (pthread_once)                        */
+/*                                                                           */
+/*****************************************************************************/
+static void iccom_metrics_env_once(void)
+{
+	const char *l_env;			/* environment variable      */
+	char *l_end;				/* end of number             */
+	unsigned long l_interval;		/* update interval (ms)      */
+	int32_t ret;				/* call function return code */
+
+	l_env = getenv(ICCOM_METRICS_ENV);
+	if ((l_env != NULL) && (*l_env != '\0')) {
+		l_interval = strtoul(l_env, &l_end, 10);
+		if ((*l_end != '\0') ||
+		    (l_interval > (unsigned long)ICCOM_METRICS_INTERVAL_MAX)) {
+			LIBPRT_ERR("%s illegal : %s", ICCOM_METRICS_ENV, l_env);
+		} else if (l_interval != 0UL) {
+			ret = iccom_metrics_start((uint32_t)l_interval);
+			if (ret != ICCOM_OK) {
+				LIBPRT_ERR("metrics page not published : %d",
+					ret);
+			}
+		} else {
+			/* publication disabled */
+		}
+	}
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_metrics_start                                           */
+/*  Function : Create metrics page ICCOM_METRICS_SHM_PREFIX<pid> and its     */
+/*             publish thread. When the page is published already, only     */
+/*             the update interval is changed.                               */
+/*  Callinq seq.                                                             */
+/*           iccom_metrics_start(uint32_t interval)                          */
+/*  Input    : interval        : Update interval (ms, 0: 100ms).             */
+/*  Return   : 1. ICCOM_OK           (0)  : Normal                           */
+/*             2. ICCOM_ERR_PARAM    (-2) : Parameter error                  */
+/*             3. ICCOM_NG           (-1) : Other error                      */
+/*  Caller   : Iccom_lib_MetricsStart, iccom_metrics_env_once                */
+/*                                                                           */
+/*****************************************************************************/
+int32_t iccom_metrics_start(uint32_t interval)
+{
+	Iccom_metrics_page *l_page = NULL;	/* shared memory page        */
+	pthread_condattr_t l_condattr;		/* condition attribute       */
+	void *l_map;				/* mapped address            */
+	FILE *l_comm;				/* process name file         */
+	int32_t retcode = ICCOM_OK;		/* return code               */
+	int32_t ret;				/* call function return code */
+	int32_t l_fd = (-1);			/* shared memory descriptor  */
+	uint32_t l_interval = interval;		/* update interval (ms)      */
+	uint32_t l_create_flag = ICCOM_LIB_OFF;	/* page creation flag        */
+	size_t l_len;				/* process name length       */
+
+	if (l_interval > ICCOM_METRICS_INTERVAL_MAX) {
+		LIBPRT_ERR("parameter err : interval = %u", l_interval);
+		retcode = ICCOM_ERR_PARAM;
+	} else if (l_interval == 0U) {
+		l_interval = ICCOM_METRICS_INTERVAL_DEFAULT;
+	} else {
+		/* interval as specified */
+	}
+
+	if (retcode == ICCOM_OK) {
+		(void)pthread_mutex_lock(&g_metrics.api_mutex);
+		if (g_metrics.page != NULL) {
+			/* published already : change interval */
+			(void)pthread_mutex_lock(&g_metrics.mutex);
+			g_metrics.interval = (uint64_t)l_interval * 1000000U;
+			g_metrics.page->interval = l_interval;
+			(void)pthread_cond_signal(&g_metrics.cond);
+			(void)pthread_mutex_unlock(&g_metrics.mutex);
+		} else {
+			l_create_flag = ICCOM_LIB_ON;
+		}
+	}
+
+	if (l_create_flag == ICCOM_LIB_ON) {
+		(void)snprintf(g_metrics.shm_name, sizeof(g_metrics.shm_name),
+			"%s%d", ICCOM_METRICS_SHM_PREFIX, (int32_t)getpid());
+		l_fd = shm_open(g_metrics.shm_name, O_CREAT | O_RDWR | O_TRUNC,
+			(mode_t)0644);
+		if (l_fd < 0) {
+			LIBPRT_ERR("shm_open err : %s, errno = %d:%s",
+				g_metrics.shm_name, errno, strerror(errno));
+			retcode = ICCOM_NG;
+		} else if (ftruncate(l_fd, (off_t)sizeof(*l_page)) != 0) {
+			LIBPRT_ERR("ftruncate err : errno = %d:%s",
+				errno, strerror(errno));
+			retcode = ICCOM_NG;
+		} else {
+			l_map = mmap(NULL, sizeof(*l_page),
+				PROT_READ | PROT_WRITE, MAP_SHARED, l_fd, 0);
+			if (l_map == MAP_FAILED) {
+				LIBPRT_ERR("mmap err : errno = %d:%s",
+					errno, strerror(errno));
+				retcode = ICCOM_NG;
+			} else {
+				l_page = (Iccom_metrics_page *)l_map;
+			}
+		}
+		if (l_fd >= 0) {
+			(void)close(l_fd);
+		}
+	}
+
+	if ((retcode == ICCOM_OK) && (l_create_flag == ICCOM_LIB_ON)) {
+		/* page header (zero cleared by ftruncate) */
+		l_page->version = ICCOM_METRICS_VERSION;
+		l_page->pid = (uint32_t)getpid();
+		l_page->slot_max = ICCOM_METRICS_SLOT_MAX;
+		l_page->interval = l_interval;
+		l_comm = fopen("/proc/self/comm", "r");
+		if (l_comm != NULL) {
+			if (fgets(l_page->name, (int32_t)ICCOM_METRICS_NAME_LEN,
+				l_comm) != NULL) {
+				l_len = strlen(l_page->name);
+				if ((l_len > 0U) &&
+				    (l_page->name[l_len - 1U] == '\n')) {
+					l_page->name[l_len - 1U] = '\0';
+				}
+			}
+			(void)fclose(l_comm);
+		}
+		iccom_metrics_update(l_page);
+		/* readers check magic last */
+		__atomic_store_n(&l_page->magic, ICCOM_METRICS_MAGIC,
+			__ATOMIC_RELEASE);
+
+		g_metrics.page = l_page;
+		g_metrics.interval = (uint64_t)l_interval * 1000000U;
+		g_metrics.stop = ICCOM_LIB_OFF;
+		(void)pthread_condattr_init(&l_condattr);
+		(void)pthread_condattr_setclock(&l_condattr, CLOCK_MONOTONIC);
+		(void)pthread_cond_init(&g_metrics.cond, &l_condattr);
+		(void)pthread_condattr_destroy(&l_condattr);
+
+		/* create publish thread */
+		ret = pthread_create(&g_metrics.thread_id, NULL,
+			iccom_metrics_thread, (void *)&g_metrics);
+		if (ret != 0) {
+			LIBPRT_ERR("pthread_create : ret = %d", ret);
+			(void)pthread_cond_destroy(&g_metrics.cond);
+			g_metrics.page = NULL;
+			retcode = ICCOM_NG;
+		} else {
+			__atomic_store_n(&g_metrics_enabled, ICCOM_LIB_ON,
+				__ATOMIC_RELAXED);
+			if (g_metrics.exit_flag == ICCOM_LIB_OFF) {
+				/* remove the page at process exit */
+				(void)atexit(iccom_metrics_exit);
+				g_metrics.exit_flag = ICCOM_LIB_ON;
+			}
+		}
+	}
+
+	if (retcode == ICCOM_NG) {
+		if (l_page != NULL) {
+			(void)munmap((void *)l_page, sizeof(*l_page));
+		}
+		(void)shm_unlink(g_metrics.shm_name);
+	}
+	if (retcode != ICCOM_ERR_PARAM) {
+		(void)pthread_mutex_unlock(&g_metrics.api_mutex);
+	}
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_metrics_stop                                            */
+/*  Function : End the publish thread and remove the metrics page.           */
+/*  Callinq seq.                                                             */
+/*           iccom_metrics_stop(void)                                        */
+/*  Return   : 1. ICCOM_OK           (0)  : Normal                           */
+/*                                          (also not published)             */
+/*  Caller   : Iccom_lib_MetricsStop, iccom_metrics_exit                     */
+/*                                                                           */
+/*****************************************************************************/
+int32_t iccom_metrics_stop(void)
+{
+	(void)pthread_mutex_lock(&g_metrics.api_mutex);
+	if (g_metrics.page != NULL) {
+		__atomic_store_n(&g_metrics_enabled, ICCOM_LIB_OFF,
+			__ATOMIC_RELAXED);
+
+		(void)pthread_mutex_lock(&g_metrics.mutex);
+		g_metrics.stop = ICCOM_LIB_ON;
+		(void)pthread_cond_signal(&g_metrics.cond);
+		(void)pthread_mutex_unlock(&g_metrics.mutex);
+		(void)pthread_join(g_metrics.thread_id, NULL);
+		(void)pthread_cond_destroy(&g_metrics.cond);
+
+		(void)shm_unlink(g_metrics.shm_name);
+		(void)munmap((void *)g_metrics.page, sizeof(*g_metrics.page));
+		g_metrics.page = NULL;
+	}
+	(void)pthread_mutex_unlock(&g_metrics.api_mutex);
+	return ICCOM_OK;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_metrics_exit                                            */
+/*  Function : Remove the metrics page at process exit.                      */
+/*  Callinq seq.                                                             */
+/*           iccom_metrics_exit(void)                                        */
+/*  Return   : NON                                                           */
+/*  Caller   : exit (atexit)                                                 */
+/*                                                                           */
+/*****************************************************************************/
+static void iccom_metrics_exit(void)
+{
+	(void)iccom_metrics_stop();
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_metrics_clock                                           */
+/*  Function : Get start time of a measured frame write.                     */
+/*  Callinq seq.                                                             */
+/*           iccom_metrics_clock(void)                                       */
+/*  Return   : Current time (CLOCK_MONOTONIC, ns)                            */
+/*             (0 : metrics page not published)                              */
+/*  Caller   : iccom_lib_write_frame                                         */
+/*                                                                           */
+/*****************************************************************************/
+uint64_t iccom_metrics_clock(void)
+{
+	uint64_t l_time = 0U;			/* current time (ns)         */
+
+	if (__atomic_load_n(&g_metrics_enabled, __ATOMIC_RELAXED) !=
+	    ICCOM_LIB_OFF) {
+		l_time = iccom_lib_get_time();
+	}
+	return l_time;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_metrics_sent                                            */
+/*  Function : Count a frame written to the driver.                          */
+/*  Callinq seq.                                                             */
+/*           iccom_metrics_sent(struct iccom_metrics_counter_t *metrics,     */
+/*                              uint32_t size, uint64_t start_time)          */
+/*  Input    : *metrics        : Channel counters pointer.                   */
+/*             size            : Frame size.                                 */
+/*             start_time      : iccom_metrics_clock before the write        */
+/*                               (0: write time not measured).               */
+/*  Return   : NON                                                           */
+/*  Caller   : iccom_lib_write_frame                                         */
+/*                                                                           */
+/*****************************************************************************/
+void iccom_metrics_sent(struct iccom_metrics_counter_t *metrics,
+			uint32_t size, uint64_t start_time)
+{
+	uint64_t l_time;			/* write time (ns)           */
+	uint32_t l_bucket = 0U;			/* histogram bucket          */
+
+	(void)__atomic_fetch_add(&metrics->send_count, 1U, __ATOMIC_RELAXED);
+	(void)__atomic_fetch_add(&metrics->send_bytes, (uint64_t)size,
+		__ATOMIC_RELAXED);
+	if (start_time != 0U) {
+		/* bucket n : 2^n to 2^(n+1)-1 ns */
+		l_time = iccom_lib_get_time() - start_time;
+		while ((l_time > 1U) &&
+		       (l_bucket < (ICCOM_METRICS_HIST_SIZE - 1U))) {
+			l_time >>= 1;
+			l_bucket++;
+		}
+		(void)__atomic_fetch_add(&metrics->send_latency[l_bucket], 1U,
+			__ATOMIC_RELAXED);
+	}
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_metrics_error                                           */
+/*  Function : Count an error of the channel.                                */
+/*  Callinq seq.                                                             */
+/*           iccom_metrics_error(struct iccom_metrics_counter_t *metrics,    */
+/*                               int32_t code, uint32_t recv)                */
+/*  Input    : *metrics        : Channel counters pointer.                   */
+/*             code            : Error code (ICCOM_ERR_xxx, ICCOM_NG).       */
+/*             recv            : ICCOM_LIB_ON : receive error                */
+/*                               ICCOM_LIB_OFF: Iccom_lib_Send error         */
+/*  Return   : NON                                                           */
+/*  Caller   : Iccom_lib_Send, iccom_lib_recv_thread                         */
+/*                                                                           */
+/*****************************************************************************/
+void iccom_metrics_error(struct iccom_metrics_counter_t *metrics,
+			int32_t code, uint32_t recv)
+{
+	uint32_t l_index = 0U;			/* error code index          */
+
+	if ((code < 0) && (code > -(int32_t)ICCOM_METRICS_ERROR_MAX)) {
+		l_index = (uint32_t)(-code);
+	}
+	(void)__atomic_fetch_add(&metrics->error_count[l_index], 1U,
+		__ATOMIC_RELAXED);
+	if (recv == ICCOM_LIB_ON) {
+		(void)__atomic_fetch_add(&metrics->recv_error_count, 1U,
+			__ATOMIC_RELAXED);
+		__atomic_store_n(&metrics->last_recv_error, code,
+			__ATOMIC_RELAXED);
+	} else {
+		(void)__atomic_fetch_add(&metrics->send_error_count, 1U,
+			__ATOMIC_RELAXED);
+		__atomic_store_n(&metrics->last_send_error, code,
+			__ATOMIC_RELAXED);
+	}
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_metrics_thread                                          */
+/*  Function : Update the metrics page at the update interval.               */
+/*  Callinq seq.                                                             */
+/*           iccom_metrics_thread(void *arg)                                 */
+/*  Input    : *arg            : Metrics page publisher pointer              */
+/*  return   : NULL                                                          */
+/*  Note     : This thread is created in iccom_metrics_start and ends in     */
+/*             iccom_metrics_stop.                                           */
+/*                                                                           */
+/*****************************************************************************/
+static void *iccom_metrics_thread(void *arg)
+{
+	struct iccom_metrics_t *l_metrics;	/* metrics page publisher    */
+	struct timespec l_wake;			/* next update time          */
+	uint64_t l_time;			/* next update time (ns)     */
+
+	l_metrics = (struct iccom_metrics_t *)arg;
+
+	(void)pthread_mutex_lock(&l_metrics->mutex);
+	while (l_metrics->stop == ICCOM_LIB_OFF) {
+		l_time = iccom_lib_get_time() + l_metrics->interval;
+		l_wake.tv_sec = (time_t)(l_time / 1000000000U);
+		l_wake.tv_nsec = (long)(l_time % 1000000000U);
+		(void)pthread_cond_timedwait(&l_metrics->cond,
+			&l_metrics->mutex, &l_wake);
+		if (l_metrics->stop == ICCOM_LIB_OFF) {
+			(void)pthread_mutex_unlock(&l_metrics->mutex);
+			iccom_metrics_update(l_metrics->page);
+			(void)pthread_mutex_lock(&l_metrics->mutex);
+		}
+	}
+	(void)pthread_mutex_unlock(&l_metrics->mutex);
+	return NULL;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_metrics_update                                          */
+/*  Function : Write the counters of all open channels to the page.          */
+/*             Slots of channels closed since the last update are cleared.   */
+/*  Callinq seq.                                                             */
+/*           iccom_metrics_update(Iccom_metrics_page *page)                  */
+/*  Input    : *page           : Metrics page pointer.                       */
+/*  Return   : NON                                                           */
+/*  Caller   : iccom_metrics_start, iccom_metrics_thread                     */
+/*                                                                           */
+/*****************************************************************************/
+static void iccom_metrics_update(Iccom_metrics_page *page)
+{
+	struct iccom_metrics_walk_t l_walk;	/* channel walk state        */
+	Iccom_metrics_channel l_empty;		/* slot of closed channel    */
+	uint32_t l_cnt;				/* loop counter              */
+
+	l_walk.page = page;
+	l_walk.count = 0U;
+	iccom_lib_foreach_channel(iccom_metrics_put_channel,
+		(void *)&l_walk);
+
+	(void)memset((void *)&l_empty, 0, sizeof(l_empty));
+	for (l_cnt = l_walk.count; l_cnt < page->slot_count; l_cnt++) {
+		iccom_metrics_write_slot(&page->slot[l_cnt], &l_empty);
+	}
+	__atomic_store_n(&page->slot_count, l_walk.count, __ATOMIC_RELEASE);
+	__atomic_store_n(&page->update_time, iccom_lib_get_time(),
+		__ATOMIC_RELEASE);
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_metrics_put_channel                                     */
+/*  Function : Write the counters of one channel to the next slot.           */
+/*  Callinq seq.                                                             */
+/*           iccom_metrics_put_channel(                                      */
+/*                           struct iccom_channel_info_t *channel_info,      */
+/*                           const char *dev_name, void *arg)                */
+/*  Input    : *channel_info   : Channel handle information pointer.         */
+/*             *dev_name       : Device file name.                           */
+/*             *arg            : Channel walk state pointer.                 */
+/*  Return   : NON                                                           */
+/*  Caller   : iccom_lib_foreach_channel                                     */
+/*  Note     : Channels over ICCOM_METRICS_SLOT_MAX are not published.       */
+/*                                                                           */
+/*****************************************************************************/
+static void iccom_metrics_put_channel(
+			struct iccom_channel_info_t *channel_info,
+			const char *dev_name, void *arg)
+{
+	struct iccom_metrics_walk_t *l_walk;	/* channel walk state        */
+	struct iccom_metrics_counter_t *l_cnt_p; /* channel counters         */
+	Iccom_metrics_channel l_data;		/* slot contents             */
+	size_t l_len;				/* device file name length   */
+	uint32_t l_cnt;				/* loop counter              */
+
+	l_walk = (struct iccom_metrics_walk_t *)arg;
+	if (l_walk->count < ICCOM_METRICS_SLOT_MAX) {
+		l_cnt_p = &channel_info->metrics;
+		(void)memset((void *)&l_data, 0, sizeof(l_data));
+		l_data.in_use = 1U;
+		l_data.channel_no = (uint32_t)channel_info->channel_no;
+		l_data.flags = channel_info->flags;
+		/* long name : the end (channel number) is kept */
+		l_len = strlen(dev_name);
+		if (l_len >= ICCOM_METRICS_NAME_LEN) {
+			dev_name = &dev_name[l_len -
+				(ICCOM_METRICS_NAME_LEN - 1U)];
+		}
+		(void)strncpy(l_data.dev_name, dev_name,
+			ICCOM_METRICS_NAME_LEN - 1U);
+		l_data.send_count = __atomic_load_n(&l_cnt_p->send_count,
+			__ATOMIC_RELAXED);
+		l_data.send_bytes = __atomic_load_n(&l_cnt_p->send_bytes,
+			__ATOMIC_RELAXED);
+		l_data.send_error_count = __atomic_load_n(
+			&l_cnt_p->send_error_count, __ATOMIC_RELAXED);
+		l_data.recv_count = __atomic_load_n(&l_cnt_p->recv_count,
+			__ATOMIC_RELAXED);
+		l_data.recv_bytes = __atomic_load_n(&l_cnt_p->recv_bytes,
+			__ATOMIC_RELAXED);
+		l_data.recv_error_count = __atomic_load_n(
+			&l_cnt_p->recv_error_count, __ATOMIC_RELAXED);
+		l_data.last_send_error = __atomic_load_n(
+			&l_cnt_p->last_send_error, __ATOMIC_RELAXED);
+		l_data.last_recv_error = __atomic_load_n(
+			&l_cnt_p->last_recv_error, __ATOMIC_RELAXED);
+		l_data.in_flight = __atomic_load_n(
+			&channel_info->send_req_cnt, __ATOMIC_RELAXED);
+		l_data.spill_depth = __atomic_load_n(&l_cnt_p->spill_depth,
+			__ATOMIC_RELAXED);
+		l_data.conflate_depth = __atomic_load_n(
+			&l_cnt_p->conflate_depth, __ATOMIC_RELAXED);
+		for (l_cnt = 0U; l_cnt < ICCOM_METRICS_ERROR_MAX; l_cnt++) {
+			l_data.error_count[l_cnt] = __atomic_load_n(
+				&l_cnt_p->error_count[l_cnt],
+				__ATOMIC_RELAXED);
+		}
+		for (l_cnt = 0U; l_cnt < ICCOM_METRICS_HIST_SIZE; l_cnt++) {
+			l_data.send_latency[l_cnt] = __atomic_load_n(
+				&l_cnt_p->send_latency[l_cnt],
+				__ATOMIC_RELAXED);
+		}
+		iccom_metrics_write_slot(&l_walk->page->slot[l_walk->count],
+			&l_data);
+		l_walk->count++;
+	}
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_metrics_write_slot                                      */
+/*  Function : Write the slot contents under the sequence number of slot.    */
+/*             The sequence number is odd while the contents are written.    */
+/*  Callinq seq.                                                             */
+/*           iccom_metrics_write_slot(Iccom_metrics_channel *slot,           */
+/*                                    const Iccom_metrics_channel *data)     */
+/*  Input    : *slot           : Slot pointer in the page.                   */
+/*             *data           : Slot contents (seq not used).               */
+/*  Return   : NON                                                           */
+/*  Caller   : iccom_metrics_update, iccom_metrics_put_channel               */
+/*  Note     : Only the publish thread (or iccom_metrics_start before the    */
+/*             thread) writes the page.                                      */
+/*                                                                           */
+/*****************************************************************************/
+static void iccom_metrics_write_slot(Iccom_metrics_channel *slot,
+			const Iccom_metrics_channel *data)
+{
+	uint32_t l_seq;				/* sequence number           */
+
+	l_seq = slot->seq;
+	__atomic_store_n(&slot->seq, l_seq + 1U, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	(void)memcpy((void *)&slot->in_use, (const void *)&data->in_use,
+		sizeof(*slot) - sizeof(slot->seq));
+	__atomic_store_n(&slot->seq, l_seq + 2U, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,385 @@
+/*
+ * Copyright (c) 2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <errno.h>
+#include <time.h>
+#include "iccom.h"
+#include "iccom_library.h"
+
+/*****************************************************************************/
+/* define definition                                                         */
+/*****************************************************************************/
+#define ICCOM_SHAPER_NSEC (1000000000U)	/* ns per second (token unit)   */
+
+/*****************************************************************************/
+/* structure definition                                                      */
+/*****************************************************************************/
+/* token bucket (level unit : 1/ICCOM_SHAPER_NSEC token) */
+struct iccom_shaper_bucket_t {
+	uint64_t rate;				/* rate (tokens/s, 0: unused)*/
+	int64_t size;				/* bucket size               */
+	int64_t level;				/* token level (<0 : waited  */
+						/* by blocked senders)       */
+};
+
+/* send rate shaper */
+struct iccom_shaper_t {
+	struct iccom_shaper_bucket_t byte_bucket; /* byte bucket             */
+	struct iccom_shaper_bucket_t msg_bucket;  /* message bucket          */
+	uint32_t mode;				/* ICCOM_SHAPER_xxx          */
+	uint64_t update_time;			/* last refill time (ns)     */
+	Iccom_shaper_stats stats;		/* statistics                */
+	pthread_mutex_t mutex;			/* mutex of shaper           */
+};
+
+/*****************************************************************************/
+/* internal function prototype definition                                    */
+/*****************************************************************************/
+/* bucket setting function */
+static void iccom_shaper_set_bucket(struct iccom_shaper_bucket_t *bucket,
+	uint32_t rate, uint32_t burst);
+/* bucket refill function */
+static void iccom_shaper_refill(struct iccom_shaper_bucket_t *bucket,
+	uint64_t elapsed);
+/* bucket conformance check function */
+static uint32_t iccom_shaper_conform(
+	const struct iccom_shaper_bucket_t *bucket, int64_t cost);
+/* bucket wait time get function */
+static uint64_t iccom_shaper_wait_time(
+	const struct iccom_shaper_bucket_t *bucket);
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_shaper_create                                           */
+/*  Function : Create send rate shaper (disabled).                           */
+/*  Callinq seq.                                                             */
+/*           iccom_shaper_create(struct iccom_shaper_t **shaper)             */
+/*  Output   : **shaper        : Shaper pointer.                             */
+/*  Return   : 1. ICCOM_OK           (0)  : Normal                           */
+/*             2. ICCOM_NG           (-1) : Other error                      */
+/*  Caller   : Iccom_lib_SetShaper                                           */
+/*                                                                           */
+/*****************************************************************************/
+int32_t iccom_shaper_create(struct iccom_shaper_t **shaper)
+{
+	struct iccom_shaper_t *l_shaper;	/* shaper                    */
+	int32_t retcode = ICCOM_OK;		/* return code               */
+
+	l_shaper = (struct iccom_shaper_t *)calloc(1U, sizeof(*l_shaper));
+	if (l_shaper == NULL) {
+		LIBPRT_ERR("cannot get shaper area");
+		retcode = ICCOM_NG;
+	} else {
+		(void)pthread_mutex_init(&l_shaper->mutex, NULL);
+		*shaper = l_shaper;
+	}
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_shaper_destroy                                          */
+/*  Function : Release send rate shaper.                                     */
+/*  Callinq seq.                                                             */
+/*           iccom_shaper_destroy(struct iccom_shaper_t *shaper)             */
+/*  Input    : *shaper         : Shaper pointer.                             */
+/*  Return   : NON                                                           */
+/*  Caller   : Iccom_lib_SetShaper, Iccom_lib_Final                          */
+/*                                                                           */
+/*****************************************************************************/
+void iccom_shaper_destroy(struct iccom_shaper_t *shaper)
+{
+	if (shaper != NULL) {
+		(void)pthread_mutex_destroy(&shaper->mutex);
+		free(shaper);
+	}
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_shaper_config                                           */
+/*  Function : Set the rates of send rate shaper (param NULL : disable).     */
+/*             The buckets start full; the statistics are kept.              */
+/*  Callinq seq.                                                             */
+/*           iccom_shaper_config(struct iccom_shaper_t *shaper,              */
+/*                               const Iccom_shaper_param *param)            */
+/*  Input    : *shaper         : Shaper pointer.                             */
+/*             *param          : Shaper parameter pointer.                   */
+/*  Return   : 1. ICCOM_OK           (0)  : Normal                           */
+/*             2. ICCOM_ERR_PARAM    (-2) : Parameter error                  */
+/*  Caller   : Iccom_lib_SetShaper                                           */
+/*                                                                           */
+/*****************************************************************************/
+int32_t iccom_shaper_config(struct iccom_shaper_t *shaper,
+			const Iccom_shaper_param *param)
+{
+	int32_t retcode = ICCOM_OK;		/* return code               */
+
+	/* check shaper parameter contents */
+	if ((param != NULL) &&
+	    ((param->mode > ICCOM_SHAPER_DROP) ||
+	     ((param->byte_rate != 0U) && (param->byte_burst == 0U)) ||
+	     ((param->msg_rate != 0U) && (param->msg_burst == 0U)))) {
+		LIBPRT_ERR("parameter err : byte_rate = %u, byte_burst = %u,"
+			" msg_rate = %u, msg_burst = %u, mode = %u",
+			param->byte_rate, param->byte_burst,
+			param->msg_rate, param->msg_burst, param->mode);
+		retcode = ICCOM_ERR_PARAM;
+	}
+
+	if (retcode == ICCOM_OK) {
+		(void)pthread_mutex_lock(&shaper->mutex);
+		if (param == NULL) {
+			iccom_shaper_set_bucket(&shaper->byte_bucket, 0U, 0U);
+			iccom_shaper_set_bucket(&shaper->msg_bucket, 0U, 0U);
+			shaper->mode = ICCOM_SHAPER_BLOCK;
+		} else {
+			iccom_shaper_set_bucket(&shaper->byte_bucket,
+				param->byte_rate, param->byte_burst);
+			iccom_shaper_set_bucket(&shaper->msg_bucket,
+				param->msg_rate, param->msg_burst);
+			shaper->mode = param->mode;
+		}
+		shaper->update_time = iccom_lib_get_time();
+		(void)pthread_mutex_unlock(&shaper->mutex);
+	}
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_shaper_acquire                                          */
+/*  Function : Take the tokens of one frame from the buckets.                */
+/*             ICCOM_SHAPER_BLOCK : The tokens are taken at once (the level  */
+/*             may become negative) and the caller waits until the buckets   */
+/*             are refilled to zero, so that blocked senders keep their      */
+/*             order and a frame larger than the burst can pass.             */
+/*             ICCOM_SHAPER_NONBLOCK / ICCOM_SHAPER_DROP : The frame passes  */
+/*             only when each bucket has its tokens (or is full).            */
+/*             With wait ICCOM_LIB_ON the caller waits as with               */
+/*             ICCOM_SHAPER_BLOCK whatever the mode (frames of the library   */
+/*             threads, which have no caller to reject or drop them to).     */
+/*  Callinq seq.                                                             */
+/*           iccom_shaper_acquire(struct iccom_shaper_t *shaper,             */
+/*                                uint32_t frame_size, uint8_t wait)         */
+/*  Input    : *shaper         : Shaper pointer.                             */
+/*             frame_size      : Frame size (bytes).                         */
+/*             wait            : ICCOM_LIB_ON : wait whatever the mode.      */
+/*  Return   : 1. ICCOM_OK           (0)  : Normal (send the frame)          */
+/*             2. ICCOM_LIB_DROP     (1)  : Frame is dropped                 */
+/*             3. ICCOM_ERR_RATE     (-10): Send rate exceeded               */
+/*  Caller   : iccom_lib_send_shaped, iccom_lib_send_frame,                  */
+/*             iccom_spill_drain_thread                                      */
+/*                                                                           */
+/*****************************************************************************/
+int32_t iccom_shaper_acquire(struct iccom_shaper_t *shaper,
+			uint32_t frame_size, uint8_t wait)
+{
+	struct timespec l_wake;			/* wake up time              */
+	int32_t retcode = ICCOM_OK;		/* return code               */
+	int ret;				/* call function return code */
+	int64_t l_byte_cost;			/* byte bucket cost          */
+	int64_t l_msg_cost;			/* message bucket cost       */
+	uint64_t l_now;				/* current time (ns)         */
+	uint64_t l_wait = 0U;			/* wait time (ns)            */
+	uint64_t l_msg_wait;			/* message bucket wait (ns)  */
+
+	l_byte_cost = (int64_t)frame_size * (int64_t)ICCOM_SHAPER_NSEC;
+	l_msg_cost = (int64_t)ICCOM_SHAPER_NSEC;
+
+	(void)pthread_mutex_lock(&shaper->mutex);
+
+	l_now = iccom_lib_get_time();
+	iccom_shaper_refill(&shaper->byte_bucket,
+		l_now - shaper->update_time);
+	iccom_shaper_refill(&shaper->msg_bucket,
+		l_now - shaper->update_time);
+	shaper->update_time = l_now;
+
+	if ((shaper->mode == ICCOM_SHAPER_BLOCK) || (wait == ICCOM_LIB_ON)) {
+		if (shaper->byte_bucket.rate != 0U) {
+			shaper->byte_bucket.level -= l_byte_cost;
+		}
+		if (shaper->msg_bucket.rate != 0U) {
+			shaper->msg_bucket.level -= l_msg_cost;
+		}
+		l_wait = iccom_shaper_wait_time(&shaper->byte_bucket);
+		l_msg_wait = iccom_shaper_wait_time(&shaper->msg_bucket);
+		if (l_msg_wait > l_wait) {
+			l_wait = l_msg_wait;
+		}
+	} else if ((iccom_shaper_conform(&shaper->byte_bucket,
+			l_byte_cost) == ICCOM_LIB_ON) &&
+		   (iccom_shaper_conform(&shaper->msg_bucket,
+			l_msg_cost) == ICCOM_LIB_ON)) {
+		if (shaper->byte_bucket.rate != 0U) {
+			shaper->byte_bucket.level -= l_byte_cost;
+		}
+		if (shaper->msg_bucket.rate != 0U) {
+			shaper->msg_bucket.level -= l_msg_cost;
+		}
+	} else if (shaper->mode == ICCOM_SHAPER_NONBLOCK) {
+		shaper->stats.reject_count++;
+		retcode = ICCOM_ERR_RATE;
+	} else {
+		shaper->stats.drop_count++;
+		shaper->stats.drop_bytes += frame_size;
+		retcode = ICCOM_LIB_DROP;
+	}
+
+	if (retcode == ICCOM_OK) {
+		if (l_wait == 0U) {
+			shaper->stats.pass_count++;
+		} else {
+			shaper->stats.delay_count++;
+			shaper->stats.delay_total += l_wait;
+			if (l_wait > shaper->stats.delay_max) {
+				shaper->stats.delay_max = l_wait;
+			}
+		}
+	}
+
+	(void)pthread_mutex_unlock(&shaper->mutex);
+
+	if (l_wait != 0U) {
+		LIBPRT_DBG("shaper wait = %lu ns", l_wait);
+		l_now += l_wait;
+		l_wake.tv_sec = (time_t)(l_now / ICCOM_SHAPER_NSEC);
+		l_wake.tv_nsec = (long)(l_now % ICCOM_SHAPER_NSEC);
+		do {
+			ret = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+				&l_wake, NULL);
+		} while (ret == EINTR);
+	}
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_shaper_get_stats                                        */
+/*  Function : Get statistics of send rate shaper.                           */
+/*  Callinq seq.                                                             */
+/*           iccom_shaper_get_stats(struct iccom_shaper_t *shaper,           */
+/*                                  Iccom_shaper_stats *stats)               */
+/*  Input    : *shaper         : Shaper pointer.                             */
+/*  Output   : *stats          : Statistics.                                 */
+/*  Return   : NON                                                           */
+/*  Caller   : Iccom_lib_GetShaperStats                                      */
+/*                                                                           */
+/*****************************************************************************/
+void iccom_shaper_get_stats(struct iccom_shaper_t *shaper,
+			Iccom_shaper_stats *stats)
+{
+	(void)pthread_mutex_lock(&shaper->mutex);
+	*stats = shaper->stats;
+	(void)pthread_mutex_unlock(&shaper->mutex);
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_shaper_set_bucket                                       */
+/*  Function : Set rate and size of token bucket, and fill it.               */
+/*  Callinq seq.                                                             */
+/*           iccom_shaper_set_bucket(struct iccom_shaper_bucket_t *bucket,   */
+/*                                   uint32_t rate, uint32_t burst)          */
+/*  Input    : *bucket         : Bucket pointer.                             */
+/*             rate            : Rate (tokens/s, 0: unused).                 */
+/*             burst           : Bucket size (tokens).                       */
+/*  Return   : NON                                                           */
+/*  Caller   : iccom_shaper_config                                           */
+/*                                                                           */
+/*****************************************************************************/
+static void iccom_shaper_set_bucket(struct iccom_shaper_bucket_t *bucket,
+			uint32_t rate, uint32_t burst)
+{
+	bucket->rate = (uint64_t)rate;
+	bucket->size = (int64_t)burst * (int64_t)ICCOM_SHAPER_NSEC;
+	bucket->level = bucket->size;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_shaper_refill                                           */
+/*  Function : Add the tokens of elapsed time to token bucket.               */
+/*  Callinq seq.                                                             */
+/*           iccom_shaper_refill(struct iccom_shaper_bucket_t *bucket,       */
+/*                               uint64_t elapsed)                           */
+/*  Input    : *bucket         : Bucket pointer.                             */
+/*             elapsed         : Elapsed time from last refill (ns).         */
+/*  Return   : NON                                                           */
+/*  Caller   : iccom_shaper_acquire                                          */
+/*                                                                           */
+/*****************************************************************************/
+static void iccom_shaper_refill(struct iccom_shaper_bucket_t *bucket,
+			uint64_t elapsed)
+{
+	uint64_t l_deficit;			/* tokens up to bucket size  */
+
+	if ((bucket->rate != 0U) && (bucket->level < bucket->size)) {
+		l_deficit = (uint64_t)(bucket->size - bucket->level);
+		/* elapsed * rate is computed only below the deficit */
+		if (elapsed >= (l_deficit / bucket->rate)) {
+			bucket->level = bucket->size;
+		} else {
+			bucket->level += (int64_t)(elapsed * bucket->rate);
+		}
+	}
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_shaper_conform                                          */
+/*  Function : Check whether token bucket has the tokens of cost.            */
+/*             A full bucket passes a cost larger than its size.             */
+/*  Callinq seq.                                                             */
+/*           iccom_shaper_conform(                                           */
+/*                        const struct iccom_shaper_bucket_t *bucket,        */
+/*                        int64_t cost)                                      */
+/*  Input    : *bucket         : Bucket pointer.                             */
+/*             cost            : Cost of frame.                              */
+/*  Return   : 1. ICCOM_LIB_ON        : Conform                              */
+/*             2. ICCOM_LIB_OFF       : Not conform                          */
+/*  Caller   : iccom_shaper_acquire                                          */
+/*                                                                           */
+/*****************************************************************************/
+static uint32_t iccom_shaper_conform(
+			const struct iccom_shaper_bucket_t *bucket, int64_t cost)
+{
+	uint32_t l_result = ICCOM_LIB_OFF;	/* check result              */
+
+	if ((bucket->rate == 0U) || (bucket->level >= cost) ||
+	    (bucket->level == bucket->size)) {
+		l_result = ICCOM_LIB_ON;
+	}
+	return l_result;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_shaper_wait_time                                        */
+/*  Function : Get the time until token level of bucket becomes zero.       */
+/*  Callinq seq.                                                             */
+/*           iccom_shaper_wait_time(                                         */
+/*                        const struct iccom_shaper_bucket_t *bucket)        */
+/*  Input    : *bucket         : Bucket pointer.                             */
+/*  Return   : Wait time (ns)                                                */
+/*  Caller   : iccom_shaper_acquire                                          */
+/*                                                                           */
+/*****************************************************************************/
+static uint64_t iccom_shaper_wait_time(
+			const struct iccom_shaper_bucket_t *bucket)
+{
+	uint64_t l_wait = 0U;			/* wait time (ns)            */
+
+	if ((bucket->rate != 0U) && (bucket->level < 0)) {
+		l_wait = (((uint64_t)-bucket->level) + bucket->rate - 1U) /
+			bucket->rate;
+	}
+	return l_wait;
+}
@@ -0,0 +1,792 @@
+/*
+ * Copyright (c) 2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "iccom.h"
+#include "iccom_library.h"
+
+/*****************************************************************************/
+/* define definition                                                         */
+/*****************************************************************************/
+#define ICCOM_SPILL_MAGIC (0x51534349U)	/* segment file magic ("ICSQ")   */
+#define ICCOM_SPILL_VERSION (1U)	/* segment file version          */
+#define ICCOM_SPILL_HEADER_SIZE (64U)	/* segment header area size      */
+#define ICCOM_SPILL_ALIGN (8U)		/* record alignment              */
+#define ICCOM_SPILL_RECORD_HEADER (4U)	/* record size field size        */
+#define ICCOM_SPILL_WRAP (0xFFFFFFFFU)	/* wrap marker (size field)      */
+#define ICCOM_SPILL_FILE_MAX (0x40000000U) /* segment file maximum size  */
+#define ICCOM_SPILL_RETRY_DEFAULT (100U) /* retry interval default (ms)  */
+
+/* record area size of data size */
+#define ICCOM_SPILL_RECORD_LEN(size) \
+	(((size) + ICCOM_SPILL_RECORD_HEADER + ICCOM_SPILL_ALIGN - 1U) & \
+	 ~(ICCOM_SPILL_ALIGN - 1U))
+
+/* segment file minimum size (header and 2 maximum records of data size) */
+#define ICCOM_SPILL_FILE_MIN(size) (ICCOM_SPILL_HEADER_SIZE + \
+	(2U * ICCOM_SPILL_RECORD_LEN(size)))
+
+/*****************************************************************************/
+/* structure definition                                                      */
+/*****************************************************************************/
+/* segment file header (at offset 0 of the file) */
+struct iccom_spill_header_t {
+	uint32_t magic;				/* ICCOM_SPILL_MAGIC         */
+	uint32_t version;			/* ICCOM_SPILL_VERSION       */
+	uint32_t capacity;			/* record area size          */
+	uint32_t head;				/* oldest record offset      */
+	uint32_t tail;				/* next record offset        */
+	uint32_t used;				/* used record area size     */
+	uint64_t count;				/* queued record count       */
+	uint64_t bytes;				/* queued data bytes         */
+	uint64_t head_seq;			/* removed record count      */
+};
+
+/* spill queue */
+struct iccom_spill_t {
+	struct iccom_channel_info_t *channel_info; /* channel handle info.   */
+	struct iccom_spill_header_t *header;	/* segment header (mapped)   */
+	uint8_t *record;			/* record area (mapped)      */
+	size_t map_size;			/* mapped size               */
+	int fd;					/* segment file descriptor   */
+	struct iccom_shaper_t *shaper;		/* drain rate shaper         */
+	uint8_t *buf;				/* send data area (drain)    */
+	uint64_t retry_time;			/* retry interval (ns)       */
+	Iccom_spill_stats stats;		/* statistics                */
+	uint32_t stop;				/* drain thread stop request */
+	pthread_t drain_thread_id;		/* drain thread ID           */
+	pthread_mutex_t mutex;			/* mutex of queue            */
+	pthread_cond_t cond;			/* queue put / stop          */
+};
+
+/*****************************************************************************/
+/* internal function prototype definition                                    */
+/*****************************************************************************/
+/* segment file open function */
+static int32_t iccom_spill_open(struct iccom_spill_t *spill,
+	const Iccom_spill_param *param);
+/* drain thread */
+static void *iccom_spill_drain_thread(void *arg);
+/* segment records check function */
+static int32_t iccom_spill_verify(const struct iccom_spill_header_t *header,
+	const uint8_t *record);
+/* record size check function */
+static int32_t iccom_spill_check_size(const struct iccom_spill_t *spill,
+	uint32_t size);
+/* segment reinitialization function */
+static void iccom_spill_reset(struct iccom_spill_t *spill);
+/* oldest record get function */
+static uint8_t *iccom_spill_peek(struct iccom_spill_t *spill,
+	uint32_t *size);
+/* oldest record remove function */
+static void iccom_spill_remove(struct iccom_spill_t *spill);
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_spill_create                                            */
+/*  Function : Create spill queue of the channel and start its drain thread. */
+/*             A segment file left by the previous process (same size) is    */
+/*             taken over, and its records are sent first.  The file is      */
+/*             locked (flock) while the queue exists.                        */
+/*  Callinq seq.                                                             */
+/*           iccom_spill_create(const Iccom_spill_param *param,              */
+/*                        struct iccom_channel_info_t *channel_info,         */
+/*                        struct iccom_spill_t **spill)                      */
+/*  Input    : *param          : Spill parameter pointer.                    */
+/*             *channel_info   : Channel handle information pointer.         */
+/*  Output   : **spill         : Spill queue pointer.                        */
+/*  Return   : 1. ICCOM_OK           (0)  : Normal                           */
+/*             2. ICCOM_ERR_PARAM    (-2) : Parameter error                  */
+/*             3. ICCOM_ERR_BUSY     (-5) : Segment file used by another     */
+/*                                          spill queue                      */
+/*             4. ICCOM_NG           (-1) : Other error                      */
+/*  Caller   : Iccom_lib_SpillConfig                                         */
+/*                                                                           */
+/*****************************************************************************/
+int32_t iccom_spill_create(const Iccom_spill_param *param,
+			struct iccom_channel_info_t *channel_info,
+			struct iccom_spill_t **spill)
+{
+	struct iccom_spill_t *l_spill = NULL;	/* spill queue               */
+	Iccom_shaper_param l_shaper_param;	/* drain shaper parameter    */
+	pthread_condattr_t l_condattr;		/* condition attribute       */
+	int32_t retcode = ICCOM_OK;		/* return code               */
+	int ret;				/* call function return code */
+	uint8_t l_sync_flag = ICCOM_LIB_OFF;	/* mutex/cond initialized    */
+
+	/* check spill parameter contents */
+	if ((param->path == NULL) ||
+	    (param->file_size <
+	     ICCOM_SPILL_FILE_MIN(channel_info->data_max_size)) ||
+	    (param->file_size > ICCOM_SPILL_FILE_MAX)) {
+		LIBPRT_ERR("parameter err : path = %p, file_size = %u",
+			(const void *)param->path, param->file_size);
+		retcode = ICCOM_ERR_PARAM;
+	}
+
+	if (retcode == ICCOM_OK) {
+		l_spill = (struct iccom_spill_t *)calloc(1U,
+			sizeof(*l_spill));
+		if (l_spill == NULL) {
+			LIBPRT_ERR("cannot get spill queue area");
+			retcode = ICCOM_NG;
+		} else {
+			l_spill->channel_info = channel_info;
+			l_spill->fd = -1;
+			l_spill->retry_time = (uint64_t)
+				((param->retry_time != 0U) ? param->retry_time :
+				ICCOM_SPILL_RETRY_DEFAULT) * 1000000U;
+			l_spill->buf = (uint8_t *)malloc(
+				(size_t)channel_info->data_max_size);
+			if (l_spill->buf == NULL) {
+				LIBPRT_ERR("cannot get send data area");
+				retcode = ICCOM_NG;
+			}
+		}
+	}
+
+	if (retcode == ICCOM_OK) {
+		retcode = iccom_spill_open(l_spill, param);
+	}
+
+	if ((retcode == ICCOM_OK) &&
+	    ((param->byte_rate != 0U) || (param->msg_rate != 0U))) {
+		/* drain rate : smooth (burst of one frame) */
+		(void)memset((void *)&l_shaper_param, 0,
+			sizeof(l_shaper_param));
+		l_shaper_param.byte_rate = param->byte_rate;
+		l_shaper_param.byte_burst = channel_info->frame_max;
+		l_shaper_param.msg_rate = param->msg_rate;
+		l_shaper_param.msg_burst = 1U;
+		l_shaper_param.mode = ICCOM_SHAPER_BLOCK;
+		retcode = iccom_shaper_create(&l_spill->shaper);
+		if (retcode == ICCOM_OK) {
+			retcode = iccom_shaper_config(l_spill->shaper,
+					&l_shaper_param);
+		}
+	}
+
+	if (retcode == ICCOM_OK) {
+		(void)pthread_mutex_init(&l_spill->mutex, NULL);
+		(void)pthread_condattr_init(&l_condattr);
+		(void)pthread_condattr_setclock(&l_condattr, CLOCK_MONOTONIC);
+		(void)pthread_cond_init(&l_spill->cond, &l_condattr);
+		(void)pthread_condattr_destroy(&l_condattr);
+		l_sync_flag = ICCOM_LIB_ON;
+
+		/* records taken over from the segment file (metrics) */
+		__atomic_store_n(&channel_info->metrics.spill_depth,
+			l_spill->header->count, __ATOMIC_RELAXED);
+
+		/* create drain thread */
+		ret = pthread_create(&l_spill->drain_thread_id, NULL,
+			iccom_spill_drain_thread, (void *)l_spill);
+		if (ret != 0) {
+			LIBPRT_ERR("pthread_create : ret = %d", ret);
+			retcode = ICCOM_NG;
+		}
+	}
+
+	if (retcode == ICCOM_OK) {
+		*spill = l_spill;
+	} else if (l_spill != NULL) {
+		if (l_sync_flag == ICCOM_LIB_ON) {
+			(void)pthread_cond_destroy(&l_spill->cond);
+			(void)pthread_mutex_destroy(&l_spill->mutex);
+		}
+		iccom_shaper_destroy(l_spill->shaper);
+		if (l_spill->header != NULL) {
+			(void)munmap((void *)l_spill->header,
+				l_spill->map_size);
+		}
+		if (l_spill->fd >= 0) {
+			(void)close(l_spill->fd);
+		}
+		free(l_spill->buf);
+		free(l_spill);
+	} else {
+		/* nothing to release */
+	}
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_spill_destroy                                           */
+/*  Function : Stop drain thread and release spill queue.                    */
+/*             The records not sent remain in the segment file.              */
+/*  Callinq seq.                                                             */
+/*           iccom_spill_destroy(struct iccom_spill_t *spill)                */
+/*  Input    : *spill          : Spill queue pointer.                        */
+/*  Return   : NON                                                           */
+/*  Caller   : Iccom_lib_Final                                               */
+/*                                                                           */
+/*****************************************************************************/
+void iccom_spill_destroy(struct iccom_spill_t *spill)
+{
+	if (spill != NULL) {
+		(void)pthread_mutex_lock(&spill->mutex);
+		spill->stop = ICCOM_LIB_ON;
+		(void)pthread_cond_broadcast(&spill->cond);
+		(void)pthread_mutex_unlock(&spill->mutex);
+		(void)pthread_join(spill->drain_thread_id, NULL);
+
+		(void)msync((void *)spill->header, spill->map_size, MS_SYNC);
+		(void)munmap((void *)spill->header, spill->map_size);
+		(void)close(spill->fd);
+		iccom_shaper_destroy(spill->shaper);
+		(void)pthread_cond_destroy(&spill->cond);
+		(void)pthread_mutex_destroy(&spill->mutex);
+		free(spill->buf);
+		free(spill);
+	}
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_spill_put                                               */
+/*  Function : Put send data to the end of spill queue.                      */
+/*             The oldest records are dropped when the segment is full.      */
+/*  Callinq seq.                                                             */
+/*           iccom_spill_put(struct iccom_spill_t *spill,                    */
+/*                           const uint8_t *buf, uint32_t size,              */
+/*                           uint32_t force)                                 */
+/*  Input    : *spill          : Spill queue pointer.                        */
+/*             *buf            : Send data pointer.                          */
+/*             size            : Send data size.                             */
+/*             force           : ICCOM_LIB_OFF : put only when the queue     */
+/*                                               is not empty                */
+/*                               ICCOM_LIB_ON  : put always                  */
+/*  Return   : 1. ICCOM_OK           (0)  : Normal (data queued)             */
+/*             2. ICCOM_LIB_EMPTY    (2)  : Queue empty (force OFF)          */
+/*  Caller   : Iccom_lib_Send                                                */
+/*                                                                           */
+/*****************************************************************************/
+int32_t iccom_spill_put(struct iccom_spill_t *spill, const uint8_t *buf,
+			uint32_t size, uint32_t force)
+{
+	struct iccom_spill_header_t *l_header;	/* segment header            */
+	int32_t retcode = ICCOM_OK;		/* return code               */
+	uint32_t l_len;				/* record area size          */
+	uint32_t l_skip;			/* skipped area at the end   */
+	uint32_t l_drop_size;			/* dropped record data size  */
+	uint32_t l_marker = ICCOM_SPILL_WRAP;	/* wrap marker               */
+
+	l_header = spill->header;
+	l_len = ICCOM_SPILL_RECORD_LEN(size);
+
+	(void)pthread_mutex_lock(&spill->mutex);
+
+	if ((force == ICCOM_LIB_OFF) && (l_header->count == 0U)) {
+		retcode = ICCOM_LIB_EMPTY;
+	}
+
+	if (retcode == ICCOM_OK) {
+		/* drop oldest records until the record fits */
+		while (1) {
+			if (l_header->count == 0U) {
+				/* restart from the top of the record area */
+				l_header->head = 0U;
+				l_header->tail = 0U;
+				l_header->used = 0U;
+			}
+			l_skip = ((l_header->tail + l_len) >
+				l_header->capacity) ?
+				(l_header->capacity - l_header->tail) : 0U;
+			if ((l_header->used + l_skip + l_len) <=
+			    l_header->capacity) {
+				break;
+			}
+			if (iccom_spill_peek(spill, &l_drop_size) != NULL) {
+				iccom_spill_remove(spill);
+				spill->stats.drop_count++;
+				spill->stats.drop_bytes += l_drop_size;
+			}
+		}
+		if (l_skip != 0U) {
+			/* record does not fit at the end : wrap */
+			(void)memcpy((void *)&spill->record[l_header->tail],
+				(const void *)&l_marker,
+				ICCOM_SPILL_RECORD_HEADER);
+			l_header->used += l_skip;
+			l_header->tail = 0U;
+		}
+		(void)memcpy((void *)&spill->record[l_header->tail],
+			(const void *)&size, ICCOM_SPILL_RECORD_HEADER);
+		(void)memcpy((void *)&spill->record[l_header->tail +
+			ICCOM_SPILL_RECORD_HEADER], (const void *)buf,
+			(size_t)size);
+		/* record is written before the header is updated */
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+		l_header->tail += l_len;
+		if (l_header->tail == l_header->capacity) {
+			l_header->tail = 0U;
+		}
+		l_header->used += l_len;
+		l_header->count++;
+		l_header->bytes += size;
+		__atomic_store_n(&spill->channel_info->metrics.spill_depth,
+			l_header->count, __ATOMIC_RELAXED);
+		spill->stats.spill_count++;
+		if (l_header->count == 1U) {
+			/* wake drain thread (not while waiting for retry) */
+			(void)pthread_cond_signal(&spill->cond);
+		}
+	}
+
+	(void)pthread_mutex_unlock(&spill->mutex);
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_spill_get_stats                                         */
+/*  Function : Get statistics of spill queue.                                */
+/*  Callinq seq.                                                             */
+/*           iccom_spill_get_stats(struct iccom_spill_t *spill,              */
+/*                                 Iccom_spill_stats *stats)                 */
+/*  Input    : *spill          : Spill queue pointer.                        */
+/*  Output   : *stats          : Statistics.                                 */
+/*  Return   : NON                                                           */
+/*  Caller   : Iccom_lib_GetSpillStats                                       */
+/*                                                                           */
+/*****************************************************************************/
+void iccom_spill_get_stats(struct iccom_spill_t *spill,
+			Iccom_spill_stats *stats)
+{
+	(void)pthread_mutex_lock(&spill->mutex);
+	*stats = spill->stats;
+	stats->depth_count = spill->header->count;
+	stats->depth_bytes = spill->header->bytes;
+	stats->used_size = spill->header->used;
+	stats->capacity = spill->header->capacity;
+	(void)pthread_mutex_unlock(&spill->mutex);
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_spill_open                                              */
+/*  Function : Open, lock and map segment file.                              */
+/*             The file is initialized unless it has a valid header of the   */
+/*             same size and valid records.                                  */
+/*  Callinq seq.                                                             */
+/*           iccom_spill_open(struct iccom_spill_t *spill,                   */
+/*                            const Iccom_spill_param *param)                */
+/*  Input    : *spill          : Spill queue pointer.                        */
+/*             *param          : Spill parameter pointer.                    */
+/*  Return   : 1. ICCOM_OK           (0)  : Normal                           */
+/*             2. ICCOM_ERR_BUSY     (-5) : Segment file locked              */
+/*             3. ICCOM_NG           (-1) : Other error                      */
+/*  Caller   : iccom_spill_create                                            */
+/*                                                                           */
+/*****************************************************************************/
+static int32_t iccom_spill_open(struct iccom_spill_t *spill,
+			const Iccom_spill_param *param)
+{
+	struct iccom_spill_header_t *l_header;	/* segment header            */
+	struct stat l_stat;			/* file status               */
+	void *l_map;				/* mapped address            */
+	int32_t retcode = ICCOM_OK;		/* return code               */
+	uint32_t l_capacity;			/* record area size          */
+
+	l_capacity = (param->file_size - ICCOM_SPILL_HEADER_SIZE) &
+		~(ICCOM_SPILL_ALIGN - 1U);
+	spill->map_size = (size_t)ICCOM_SPILL_HEADER_SIZE + l_capacity;
+
+	spill->fd = open(param->path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+	if ((spill->fd < 0) || (fstat(spill->fd, &l_stat) != 0)) {
+		LIBPRT_ERR("segment file open err : path = %s, errno = %d:%s",
+			param->path, errno, strerror(errno));
+		retcode = ICCOM_NG;
+	}
+
+	if (retcode == ICCOM_OK) {
+		/* one spill queue per segment file (any process) */
+		if (flock(spill->fd, LOCK_EX | LOCK_NB) != 0) {
+			LIBPRT_ERR("segment file lock err : path = %s,"
+				" errno = %d:%s", param->path, errno,
+				strerror(errno));
+			retcode = (errno == EWOULDBLOCK) ? ICCOM_ERR_BUSY :
+				ICCOM_NG;
+		}
+	}
+
+	if ((retcode == ICCOM_OK) &&
+	    ((size_t)l_stat.st_size != spill->map_size)) {
+		if (ftruncate(spill->fd, (off_t)spill->map_size) != 0) {
+			LIBPRT_ERR("ftruncate err : errno = %d:%s",
+				errno, strerror(errno));
+			retcode = ICCOM_NG;
+		}
+	}
+
+	if (retcode == ICCOM_OK) {
+		l_map = mmap(NULL, spill->map_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED, spill->fd, 0);
+		if (l_map == MAP_FAILED) {
+			LIBPRT_ERR("mmap err : errno = %d:%s",
+				errno, strerror(errno));
+			retcode = ICCOM_NG;
+		} else {
+			spill->header = (struct iccom_spill_header_t *)l_map;
+			spill->record = &((uint8_t *)l_map)[
+				ICCOM_SPILL_HEADER_SIZE];
+		}
+	}
+
+	if (retcode == ICCOM_OK) {
+		l_header = spill->header;
+		if ((l_header->magic == ICCOM_SPILL_MAGIC) &&
+		    (l_header->version == ICCOM_SPILL_VERSION) &&
+		    (l_header->capacity == l_capacity) &&
+		    (l_header->head < l_capacity) &&
+		    (l_header->tail < l_capacity) &&
+		    (l_header->used <= l_capacity) &&
+		    (((l_header->head | l_header->tail) &
+		      (ICCOM_SPILL_ALIGN - 1U)) == 0U) &&
+		    (iccom_spill_verify(l_header, spill->record) ==
+		     ICCOM_OK)) {
+			LIBPRT_NRL("segment file taken over : count = %lu",
+				l_header->count);
+		} else {
+			(void)memset((void *)l_header, 0,
+				ICCOM_SPILL_HEADER_SIZE);
+			l_header->magic = ICCOM_SPILL_MAGIC;
+			l_header->version = ICCOM_SPILL_VERSION;
+			l_header->capacity = l_capacity;
+		}
+	}
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_spill_drain_thread                                      */
+/*  Function : Send the records of spill queue in order.                     */
+/*             A record is removed after it is sent; a send error is         */
+/*             retried after the retry interval.                             */
+/*  Callinq seq.                                                             */
+/*           iccom_spill_drain_thread(void *arg)                             */
+/*  Input    : *arg            : Spill queue pointer                         */
+/*  return   : NULL                                                          */
+/*  Note     : This thread is created in iccom_spill_create and ends in      */
+/*             iccom_spill_destroy.                                          */
+/*                                                                           */
+/*****************************************************************************/
+static void *iccom_spill_drain_thread(void *arg)
+{
+	struct iccom_spill_t *l_spill;		/* spill queue               */
+	struct timespec l_wake;			/* retry time                */
+	const uint8_t *l_record;		/* oldest record data        */
+	int32_t ret;				/* call function return code */
+	uint32_t l_size;			/* send data size            */
+	uint64_t l_head_seq;			/* removed count at peek     */
+	uint64_t l_start;			/* send start time (ns)      */
+
+	l_spill = (struct iccom_spill_t *)arg;
+
+	(void)pthread_mutex_lock(&l_spill->mutex);
+	while (l_spill->stop == ICCOM_LIB_OFF) {
+		if (l_spill->header->count == 0U) {
+			(void)pthread_cond_wait(&l_spill->cond,
+				&l_spill->mutex);
+			continue;
+		}
+
+		/* copy oldest record (put may drop it while sending) */
+		l_record = iccom_spill_peek(l_spill, &l_size);
+		if (l_record == NULL) {
+			/* broken record : segment reinitialized */
+			continue;
+		}
+		l_head_seq = l_spill->header->head_seq;
+		if (l_size <= l_spill->channel_info->data_max_size) {
+			(void)memcpy((void *)l_spill->buf,
+				(const void *)l_record, (size_t)l_size);
+			(void)pthread_mutex_unlock(&l_spill->mutex);
+
+			l_start = iccom_lib_get_time();
+			if (l_spill->shaper != NULL) {
+				(void)iccom_shaper_acquire(l_spill->shaper,
+					l_size, ICCOM_LIB_ON);
+			}
+			ret = iccom_lib_send_frame(l_spill->channel_info,
+				l_spill->buf, l_size);
+
+			(void)pthread_mutex_lock(&l_spill->mutex);
+		} else {
+			/* record of a larger frame size (taken over) */
+			l_start = 0U;
+			ret = ICCOM_ERR_SIZE;
+		}
+		if ((ret == ICCOM_ERR_TO_SEND) || (ret == ICCOM_ERR_TO_ACK) ||
+		    (ret == ICCOM_ERR_BUF_FULL) || (ret == ICCOM_NG)) {
+			/* link not ready : retry the record later */
+			l_spill->stats.retry_count++;
+			l_start = iccom_lib_get_time() + l_spill->retry_time;
+			l_wake.tv_sec = (time_t)(l_start / 1000000000U);
+			l_wake.tv_nsec = (long)(l_start % 1000000000U);
+			if (l_spill->stop == ICCOM_LIB_OFF) {
+				(void)pthread_cond_timedwait(&l_spill->cond,
+					&l_spill->mutex, &l_wake);
+			}
+			continue;
+		}
+
+		if (ret == ICCOM_OK) {
+			l_spill->stats.drain_count++;
+			l_spill->stats.drain_bytes += l_size;
+			l_spill->stats.drain_time +=
+				iccom_lib_get_time() - l_start;
+		} else {
+			/* data not sendable (not retried) */
+			LIBPRT_ERR("spill record dropped : size = %u, ret = %d",
+				l_size, ret);
+			l_spill->stats.drop_count++;
+			l_spill->stats.drop_bytes += l_size;
+		}
+		/* remove the record unless it was dropped by put */
+		if (l_spill->header->head_seq == l_head_seq) {
+			iccom_spill_remove(l_spill);
+		}
+	}
+	(void)pthread_mutex_unlock(&l_spill->mutex);
+	return NULL;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_spill_verify                                            */
+/*  Function : Check the records of a segment file to take over : every      */
+/*             record must be within the record area, and the records must   */
+/*             end at tail with the used size and bytes of the header.       */
+/*  Callinq seq.                                                             */
+/*           iccom_spill_verify(const struct iccom_spill_header_t *header,   */
+/*                              const uint8_t *record)                       */
+/*  Input    : *header         : Segment header pointer (head, tail and      */
+/*                               capacity checked).                          */
+/*             *record         : Record area pointer.                        */
+/*  Return   : 1. ICCOM_OK           (0)  : Records valid                    */
+/*             2. ICCOM_NG           (-1) : Records broken                   */
+/*  Caller   : iccom_spill_open                                              */
+/*                                                                           */
+/*****************************************************************************/
+static int32_t iccom_spill_verify(const struct iccom_spill_header_t *header,
+			const uint8_t *record)
+{
+	int32_t retcode = ICCOM_OK;		/* return code               */
+	uint32_t l_pos;				/* record offset             */
+	uint32_t l_size;			/* record size field         */
+	uint32_t l_len;				/* record area size          */
+	uint64_t l_used = 0U;			/* used record area size     */
+	uint64_t l_bytes = 0U;			/* data bytes                */
+	uint64_t l_cnt;				/* loop counter              */
+
+	l_pos = header->head;
+	for (l_cnt = 0U; (l_cnt < header->count) && (retcode == ICCOM_OK);
+	     l_cnt++) {
+		(void)memcpy((void *)&l_size, (const void *)&record[l_pos],
+			ICCOM_SPILL_RECORD_HEADER);
+		if ((l_size == ICCOM_SPILL_WRAP) && (l_pos != 0U)) {
+			/* wrapped : the record is at the top */
+			l_used += header->capacity - l_pos;
+			l_pos = 0U;
+			(void)memcpy((void *)&l_size, (const void *)record,
+				ICCOM_SPILL_RECORD_HEADER);
+		}
+		if ((l_size > header->capacity) ||
+		    (ICCOM_SPILL_RECORD_LEN(l_size) >
+		     (header->capacity - l_pos))) {
+			retcode = ICCOM_NG;
+		} else {
+			l_len = ICCOM_SPILL_RECORD_LEN(l_size);
+			l_used += l_len;
+			l_bytes += l_size;
+			l_pos += l_len;
+			if (l_pos == header->capacity) {
+				l_pos = 0U;
+			}
+		}
+	}
+
+	if ((retcode == ICCOM_OK) && (header->count != 0U) &&
+	    ((l_pos != header->tail) || (l_used != header->used) ||
+	     (l_bytes != header->bytes))) {
+		retcode = ICCOM_NG;
+	}
+	if ((retcode == ICCOM_OK) && (header->count == 0U) &&
+	    ((header->used != 0U) || (header->bytes != 0U))) {
+		retcode = ICCOM_NG;
+	}
+	if (retcode != ICCOM_OK) {
+		LIBPRT_ERR("segment file records broken : count = %lu",
+			header->count);
+	}
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_spill_check_size                                        */
+/*  Function : Check the size field of the oldest record : the record must   */
+/*             be within the record area and the used size.                  */
+/*  Callinq seq.                                                             */
+/*           iccom_spill_check_size(const struct iccom_spill_t *spill,       */
+/*                                  uint32_t size)                           */
+/*  Input    : *spill          : Spill queue pointer.                        */
+/*             size            : Size field of the record at head.           */
+/*  Return   : 1. ICCOM_OK           (0)  : Record valid                     */
+/*             2. ICCOM_NG           (-1) : Record broken                    */
+/*  Caller   : iccom_spill_peek, iccom_spill_remove                          */
+/*                                                                           */
+/*****************************************************************************/
+static int32_t iccom_spill_check_size(const struct iccom_spill_t *spill,
+			uint32_t size)
+{
+	const struct iccom_spill_header_t *l_header; /* segment header       */
+	int32_t retcode = ICCOM_OK;		/* return code               */
+
+	l_header = spill->header;
+	if ((l_header->count == 0U) ||
+	    (l_header->head >= l_header->capacity) ||
+	    (size > l_header->capacity) ||
+	    (ICCOM_SPILL_RECORD_LEN(size) >
+	     (l_header->capacity - l_header->head)) ||
+	    (ICCOM_SPILL_RECORD_LEN(size) > l_header->used) ||
+	    (size > l_header->bytes)) {
+		LIBPRT_ERR("spill record broken : head = %u, size = %u",
+			l_header->head, size);
+		retcode = ICCOM_NG;
+	}
+	return retcode;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_spill_reset                                             */
+/*  Function : Reinitialize the segment of a broken record; the records      */
+/*             queued are dropped.                                           */
+/*  Callinq seq.                                                             */
+/*           iccom_spill_reset(struct iccom_spill_t *spill)                  */
+/*  Input    : *spill          : Spill queue pointer.                        */
+/*  Return   : NON                                                           */
+/*  Caller   : iccom_spill_peek, iccom_spill_remove                          */
+/*  Note     : Called with spill mutex.                                      */
+/*                                                                           */
+/*****************************************************************************/
+static void iccom_spill_reset(struct iccom_spill_t *spill)
+{
+	struct iccom_spill_header_t *l_header;	/* segment header            */
+
+	l_header = spill->header;
+	spill->stats.drop_count += l_header->count;
+	l_header->head = 0U;
+	l_header->tail = 0U;
+	l_header->used = 0U;
+	l_header->count = 0U;
+	l_header->bytes = 0U;
+	/* (drain thread does not remove the record it is sending) */
+	l_header->head_seq++;
+	__atomic_store_n(&spill->channel_info->metrics.spill_depth, 0U,
+		__ATOMIC_RELAXED);
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_spill_peek                                              */
+/*  Function : Get the oldest record (skipping wrap marker).                 */
+/*             A broken record reinitializes the segment.                    */
+/*  Callinq seq.                                                             */
+/*           iccom_spill_peek(struct iccom_spill_t *spill, uint32_t *size)   */
+/*  Input    : *spill          : Spill queue pointer.                        */
+/*  Output   : *size           : Data size.                                  */
+/*  Return   : Data pointer of the oldest record                             */
+/*             (NULL : broken record, queue emptied)                         */
+/*  Caller   : iccom_spill_put, iccom_spill_drain_thread                     */
+/*  Note     : The queue must not be empty.  Called with spill mutex.        */
+/*                                                                           */
+/*****************************************************************************/
+static uint8_t *iccom_spill_peek(struct iccom_spill_t *spill, uint32_t *size)
+{
+	struct iccom_spill_header_t *l_header;	/* segment header            */
+	uint8_t *l_data = NULL;			/* record data pointer       */
+	uint32_t l_size = 0U;			/* record size field         */
+
+	l_header = spill->header;
+	if (l_header->head < l_header->capacity) {
+		(void)memcpy((void *)&l_size,
+			(const void *)&spill->record[l_header->head],
+			ICCOM_SPILL_RECORD_HEADER);
+	}
+	if ((l_size == ICCOM_SPILL_WRAP) && (l_header->head != 0U) &&
+	    ((l_header->capacity - l_header->head) <= l_header->used)) {
+		/* wrapped : the record is at the top */
+		l_header->used -= l_header->capacity - l_header->head;
+		l_header->head = 0U;
+		(void)memcpy((void *)&l_size, (const void *)spill->record,
+			ICCOM_SPILL_RECORD_HEADER);
+	}
+	if (iccom_spill_check_size(spill, l_size) == ICCOM_OK) {
+		*size = l_size;
+		l_data = &spill->record[l_header->head +
+			ICCOM_SPILL_RECORD_HEADER];
+	} else {
+		iccom_spill_reset(spill);
+	}
+	return l_data;
+}
+
+/*****************************************************************************/
+/*                                                                           */
+/*  Name     : iccom_spill_remove                                            */
+/*  Function : Remove the oldest record (after iccom_spill_peek).            */
+/*             A broken record reinitializes the segment.                    */
+/*  Callinq seq.                                                             */
+/*           iccom_spill_remove(struct iccom_spill_t *spill)                 */
+/*  Input    : *spill          : Spill queue pointer.                        */
+/*  Return   : NON                                                           */
+/*  Caller   : iccom_spill_put, iccom_spill_drain_thread                     */
+/*  Note     : Called with spill mutex.                                      */
+/*                                                                           */
+/*****************************************************************************/
+static void iccom_spill_remove(struct iccom_spill_t *spill)
+{
+	struct iccom_spill_header_t *l_header;	/* segment header            */
+	uint32_t l_size = 0U;			/* record data size          */
+	uint32_t l_len;				/* record area size          */
+
+	l_header = spill->header;
+	if (l_header->head < l_header->capacity) {
+		(void)memcpy((void *)&l_size,
+			(const void *)&spill->record[l_header->head],
+			ICCOM_SPILL_RECORD_HEADER);
+	}
+	if (iccom_spill_check_size(spill, l_size) != ICCOM_OK) {
+		iccom_spill_reset(spill);
+	} else {
+		l_len = ICCOM_SPILL_RECORD_LEN(l_size);
+		l_header->head += l_len;
+		if (l_header->head == l_header->capacity) {
+			l_header->head = 0U;
+		}
+		l_header->used -= l_len;
+		l_header->count--;
+		l_header->bytes -= l_size;
+		l_header->head_seq++;
+		__atomic_store_n(&spill->channel_info->metrics.spill_depth,
+			l_header->count, __ATOMIC_RELAXED);
+	}
+}
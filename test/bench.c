@@ -0,0 +1,482 @@
+/*
+ * ICCOM library benchmark.
+ *
+ * Runs against the loopback stand-in of the driver (iccom_loopback.c) and
+ * prints one JSON object per line on stdout:
+ *   pingpong   : send -> callback round trip percentiles per message size
+ *   stream     : one-way throughput per message size
+ *   jitter     : callback delivery jitter of a periodic sender
+ *   contention : aggregate send rate of 1..N threads on one channel and
+ *                on one channel per thread
+ *   crc32c     : CRC32C cost per frame size (ICCOM_INIT_CRC32C)
+ *   delta      : delta encode cost and coded size per frame size with
+ *                two changed fields per frame (ICCOM_INIT_DELTA)
+ *   bulk       : one-way throughput of full frames per frame maximum size
+ *                requested at Iccom_lib_InitEx (frame_max)
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#include <math.h>
+#include <iccom.h>
+#include "iccom_library.h"
+
+struct bench_rx {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	uint64_t count;
+	uint64_t bytes;
+	uint64_t last_ns;
+};
+
+struct bench_sender {
+	pthread_t thread;
+	Iccom_channel_t handle;
+	uint32_t size;
+	uint32_t count;
+	uint32_t errors;
+};
+
+static struct bench_rx rx[ICCOM_CHANNEL_MAX];
+static uint8_t rbuf[ICCOM_CHANNEL_MAX][ICCOM_BUF_MAX_SIZE];
+static pthread_barrier_t start_barrier;
+
+static const uint32_t sizes[] = { 16, 64, 256, 1024, ICCOM_BUF_MAX_SIZE };
+#define NSIZES (sizeof(sizes) / sizeof(sizes[0]))
+
+/* frame maximum sizes of the bulk case (loopback accepts up to 16 KiB) */
+static const uint32_t frame_sizes[] = { ICCOM_BUF_MAX_SIZE, 4096, 8192,
+					16384 };
+#define NFRAMES (sizeof(frame_sizes) / sizeof(frame_sizes[0]))
+#define BULK_FRAME_MAX 16384
+
+static uint8_t bulk_rbuf[BULK_FRAME_MAX];
+static uint8_t sbuf[BULK_FRAME_MAX];
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void callback(enum Iccom_channel_number ch, uint32_t sz, uint8_t *buf)
+{
+	uint64_t t = now_ns();
+	struct bench_rx *r = &rx[ch];
+
+	pthread_mutex_lock(&r->lock);
+	r->count++;
+	r->bytes += sz;
+	r->last_ns = t;
+	pthread_cond_broadcast(&r->cond);
+	pthread_mutex_unlock(&r->lock);
+}
+
+static uint64_t rx_count(int ch)
+{
+	uint64_t n;
+
+	pthread_mutex_lock(&rx[ch].lock);
+	n = rx[ch].count;
+	pthread_mutex_unlock(&rx[ch].lock);
+	return n;
+}
+
+/* wait until channel ch has received "target" frames, return arrival time */
+static uint64_t rx_wait(int ch, uint64_t target)
+{
+	struct bench_rx *r = &rx[ch];
+	uint64_t t;
+
+	pthread_mutex_lock(&r->lock);
+	while (r->count < target)
+		pthread_cond_wait(&r->cond, &r->lock);
+	t = r->last_ns;
+	pthread_mutex_unlock(&r->lock);
+	return t;
+}
+
+static int open_channel(int ch, Iccom_channel_t *handle)
+{
+	Iccom_init_param ip;
+	int ret;
+
+	ip.channel_no = ch;
+	ip.recv_buf = rbuf[ch];
+	ip.recv_cb = callback;
+
+	ret = Iccom_lib_Init(&ip, handle);
+	if (ret != ICCOM_OK)
+		fprintf(stderr, "Iccom_lib_Init(%d) error %d\n", ch, ret);
+	return ret;
+}
+
+static int send_frame(Iccom_channel_t handle, uint32_t size)
+{
+	Iccom_send_param sp;
+
+	sp.channel_handle = handle;
+	sp.send_size = size;
+	sp.send_buf = sbuf;
+	return Iccom_lib_Send(&sp);
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* nearest-rank percentile of a sorted array */
+static uint64_t pct(const uint64_t *v, uint32_t n, double p)
+{
+	uint32_t i = (uint32_t)ceil(p / 100.0 * n);
+
+	return v[i ? i - 1 : 0];
+}
+
+static void bench_pingpong(Iccom_channel_t handle, uint32_t iter)
+{
+	uint64_t *lat = malloc(iter * sizeof(*lat));
+	uint64_t base, t0;
+	uint32_t s, i;
+
+	if (lat == NULL)
+		return;
+
+	for (s = 0; s < NSIZES; s++) {
+		base = rx_count(0);
+		for (i = 0; i < iter; i++) {
+			t0 = now_ns();
+			if (send_frame(handle, sizes[s]) != ICCOM_OK)
+				break;
+			lat[i] = rx_wait(0, base + i + 1) - t0;
+		}
+		if (i == 0)
+			continue;
+		qsort(lat, i, sizeof(*lat), cmp_u64);
+		printf("{\"bench\":\"pingpong\",\"size\":%u,\"samples\":%u,"
+		       "\"min_ns\":%lu,\"p50_ns\":%lu,\"p90_ns\":%lu,"
+		       "\"p99_ns\":%lu,\"p999_ns\":%lu,\"max_ns\":%lu}\n",
+		       sizes[s], i, lat[0], pct(lat, i, 50), pct(lat, i, 90),
+		       pct(lat, i, 99), pct(lat, i, 99.9), lat[i - 1]);
+	}
+	free(lat);
+}
+
+static void bench_stream(Iccom_channel_t handle, uint32_t count)
+{
+	uint64_t base, t0, t1;
+	uint32_t s, i, errors;
+	double sec;
+
+	for (s = 0; s < NSIZES; s++) {
+		base = rx_count(0);
+		errors = 0;
+		t0 = now_ns();
+		for (i = 0; i < count; i++)
+			if (send_frame(handle, sizes[s]) != ICCOM_OK)
+				errors++;
+		t1 = rx_wait(0, base + count - errors);
+		sec = (t1 - t0) / 1e9;
+		printf("{\"bench\":\"stream\",\"size\":%u,\"messages\":%u,"
+		       "\"errors\":%u,\"elapsed_ns\":%lu,\"msgs_per_s\":%.0f,"
+		       "\"mbytes_per_s\":%.2f}\n",
+		       sizes[s], count - errors, errors, t1 - t0,
+		       (count - errors) / sec,
+		       (double)(count - errors) * sizes[s] / sec / 1e6);
+	}
+}
+
+static void bench_jitter(Iccom_channel_t handle, uint32_t count,
+			 uint32_t period_us)
+{
+	uint64_t *dev = malloc(count * sizeof(*dev));
+	uint64_t period = period_us * 1000ULL;
+	uint64_t base, prev = 0, t, sum = 0;
+	double mean, var = 0;
+	struct timespec next;
+	uint32_t i, n = 0;
+
+	if (dev == NULL)
+		return;
+
+	base = rx_count(0);
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	for (i = 0; i < count; i++) {
+		next.tv_nsec += period;
+		while (next.tv_nsec >= 1000000000L) {
+			next.tv_sec++;
+			next.tv_nsec -= 1000000000L;
+		}
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+		if (send_frame(handle, 64) != ICCOM_OK)
+			break;
+		t = rx_wait(0, base + i + 1);
+		/* deviation of the callback inter-arrival time from the period */
+		if (i > 0) {
+			dev[n] = t - prev > period ? t - prev - period :
+						     period - (t - prev);
+			sum += dev[n];
+			n++;
+		}
+		prev = t;
+	}
+
+	if (n > 0) {
+		mean = (double)sum / n;
+		for (i = 0; i < n; i++)
+			var += (dev[i] - mean) * (dev[i] - mean);
+		qsort(dev, n, sizeof(*dev), cmp_u64);
+		printf("{\"bench\":\"jitter\",\"period_us\":%u,\"samples\":%u,"
+		       "\"mean_ns\":%.0f,\"stddev_ns\":%.0f,\"p50_ns\":%lu,"
+		       "\"p99_ns\":%lu,\"max_ns\":%lu}\n",
+		       period_us, n, mean, sqrt(var / n), pct(dev, n, 50),
+		       pct(dev, n, 99), dev[n - 1]);
+	}
+	free(dev);
+}
+
+static void *sender_thread(void *arg)
+{
+	struct bench_sender *s = arg;
+	uint32_t i;
+
+	pthread_barrier_wait(&start_barrier);
+	for (i = 0; i < s->count; i++)
+		if (send_frame(s->handle, s->size) != ICCOM_OK)
+			s->errors++;
+	return NULL;
+}
+
+static void bench_contention(Iccom_channel_t *handle, uint32_t max_threads,
+			     uint32_t count)
+{
+	struct bench_sender *snd = calloc(max_threads, sizeof(*snd));
+	uint64_t base[ICCOM_CHANNEL_MAX], expect[ICCOM_CHANNEL_MAX];
+	uint64_t t0, t1, end;
+	uint32_t nthr, i, mode, ch, total;
+	double sec;
+
+	if (snd == NULL)
+		return;
+
+	for (mode = 0; mode < 2; mode++) {
+		for (nthr = 1; nthr <= max_threads; nthr++) {
+			pthread_barrier_init(&start_barrier, NULL, nthr + 1);
+			for (ch = 0; ch < ICCOM_CHANNEL_MAX; ch++) {
+				base[ch] = rx_count(ch);
+				expect[ch] = base[ch];
+			}
+			for (i = 0; i < nthr; i++) {
+				ch = mode ? i % ICCOM_CHANNEL_MAX : 0;
+				snd[i].handle = handle[ch];
+				snd[i].size = 64;
+				snd[i].count = count;
+				snd[i].errors = 0;
+				pthread_create(&snd[i].thread, NULL,
+					       sender_thread, &snd[i]);
+			}
+			pthread_barrier_wait(&start_barrier);
+			t0 = now_ns();
+			total = 0;
+			for (i = 0; i < nthr; i++) {
+				pthread_join(snd[i].thread, NULL);
+				ch = mode ? i % ICCOM_CHANNEL_MAX : 0;
+				expect[ch] += count - snd[i].errors;
+				total += count - snd[i].errors;
+			}
+			t1 = t0;
+			for (ch = 0; ch < ICCOM_CHANNEL_MAX; ch++) {
+				if (expect[ch] == base[ch])
+					continue;
+				end = rx_wait(ch, expect[ch]);
+				if (end > t1)
+					t1 = end;
+			}
+			pthread_barrier_destroy(&start_barrier);
+			sec = (t1 - t0) / 1e9;
+			printf("{\"bench\":\"contention\",\"channels\":\"%s\","
+			       "\"threads\":%u,\"messages\":%u,"
+			       "\"errors\":%u,\"elapsed_ns\":%lu,"
+			       "\"msgs_per_s\":%.0f}\n",
+			       mode ? "many" : "one", nthr, total,
+			       nthr * count - total, t1 - t0, total / sec);
+		}
+	}
+	free(snd);
+}
+
+static void bench_crc32c(uint32_t iter)
+{
+	volatile uint32_t crc = 0;
+	uint64_t t0, t1;
+	uint32_t s, i;
+
+	for (s = 0; s < NSIZES; s++) {
+		crc += iccom_crc32c(sbuf, sizes[s]);	/* warm up */
+		t0 = now_ns();
+		for (i = 0; i < iter; i++)
+			crc += iccom_crc32c(sbuf, sizes[s]);
+		t1 = now_ns();
+		printf("{\"bench\":\"crc32c\",\"kernel\":\"%s\",\"size\":%u,"
+		       "\"samples\":%u,\"ns_per_frame\":%.1f,"
+		       "\"mbytes_per_s\":%.0f}\n",
+		       iccom_crc32c_kernel(), sizes[s], iter,
+		       (double)(t1 - t0) / iter,
+		       (double)iter * sizes[s] / ((t1 - t0) / 1e9) / 1e6);
+	}
+}
+
+static void bench_delta(uint32_t iter)
+{
+	static uint8_t frame[ICCOM_BUF_MAX_SIZE];
+	static uint8_t out[ICCOM_DELTA_HEADER_SIZE + ICCOM_BUF_MAX_SIZE];
+	struct iccom_delta_t *delta;
+	Iccom_delta_param param = { .key_interval = 0xFFFFFFFFU };
+	uint64_t t0, t1, coded;
+	uint32_t s, i, n;
+
+	if (iccom_delta_create(ICCOM_BUF_MAX_SIZE, &delta) != ICCOM_OK ||
+	    iccom_delta_config(delta, &param) != ICCOM_OK)
+		return;
+
+	for (s = 0; s < NSIZES; s++) {
+		memset(frame, 0x5a, sizes[s]);
+		n = iccom_delta_encode(delta, frame, sizes[s], out);
+		iccom_delta_encode_end(delta, n, ICCOM_OK);	/* keyframe */
+		coded = 0;
+		t0 = now_ns();
+		for (i = 0; i < iter; i++) {
+			/* a counter at the head and a field at the middle */
+			frame[0] = (uint8_t)i;
+			frame[sizes[s] / 2] = (uint8_t)(i >> 3);
+			n = iccom_delta_encode(delta, frame, sizes[s], out);
+			iccom_delta_encode_end(delta, n, ICCOM_OK);
+			coded += n;
+		}
+		t1 = now_ns();
+		printf("{\"bench\":\"delta\",\"kernel\":\"%s\",\"size\":%u,"
+		       "\"samples\":%u,\"ns_per_frame\":%.1f,"
+		       "\"coded_bytes\":%.1f}\n",
+		       iccom_delta_kernel(), sizes[s], iter,
+		       (double)(t1 - t0) / iter, (double)coded / iter);
+	}
+	iccom_delta_destroy(delta);
+}
+
+static void callback_ex(void *user_data, enum Iccom_channel_number ch,
+			uint32_t sz, uint8_t *buf)
+{
+	callback(ch, sz, buf);
+}
+
+/* bulk transfer of count frames of the data maximum size per frame size */
+static void bench_bulk(uint32_t count)
+{
+	Iccom_ctx_param cp = { .dev_path = "/dev/iccom-bulk%u" };
+	Iccom_init_param_ex ip;
+	Iccom_channel_t handle;
+	Iccom_ctx_t ctx;
+	uint32_t s, i, errors, frame_max, data_max;
+	uint64_t base, t0, t1;
+	double sec;
+
+	if (Iccom_lib_CtxCreate(&cp, &ctx) != ICCOM_OK)
+		return;
+
+	for (s = 0; s < NFRAMES; s++) {
+		memset(&ip, 0, sizeof(ip));
+		ip.channel_no = ICCOM_CHANNEL_0;
+		ip.recv_buf = bulk_rbuf;
+		ip.recv_cb = callback_ex;
+		ip.frame_max = frame_sizes[s];
+		if (Iccom_lib_CtxInit(ctx, &ip, &handle) != ICCOM_OK)
+			break;
+		(void)Iccom_lib_GetFrameSize(handle, &frame_max, &data_max);
+
+		base = rx_count(0);
+		errors = 0;
+		t0 = now_ns();
+		for (i = 0; i < count; i++)
+			if (send_frame(handle, data_max) != ICCOM_OK)
+				errors++;
+		t1 = rx_wait(0, base + count - errors);
+		sec = (t1 - t0) / 1e9;
+		printf("{\"bench\":\"bulk\",\"frame_max\":%u,\"negotiated\":%u,"
+		       "\"messages\":%u,\"errors\":%u,\"msgs_per_s\":%.0f,"
+		       "\"mbytes_per_s\":%.2f}\n",
+		       frame_sizes[s], frame_max, count - errors, errors,
+		       (count - errors) / sec,
+		       (double)(count - errors) * data_max / sec / 1e6);
+		(void)Iccom_lib_Final(handle);
+	}
+	(void)Iccom_lib_CtxDestroy(ctx);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-i iterations] [-n messages] [-t threads]\n"
+		"  -i  ping-pong and jitter samples per case (default 10000)\n"
+		"  -n  messages per stream / contention case (default 100000)\n"
+		"  -t  maximum number of sender threads (default %d)\n",
+		prog, ICCOM_CHANNEL_MAX);
+}
+
+int main(int argc, char *argv[])
+{
+	Iccom_channel_t handle[ICCOM_CHANNEL_MAX];
+	uint32_t iter = 10000, count = 100000, threads = ICCOM_CHANNEL_MAX;
+	int ch, opt, ret = 0;
+
+	while ((opt = getopt(argc, argv, "i:n:t:h")) != -1) {
+		switch (opt) {
+		case 'i':
+			iter = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			count = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			threads = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (iter == 0 || count == 0 || threads == 0) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	for (ch = 0; ch < ICCOM_CHANNEL_MAX; ch++) {
+		pthread_mutex_init(&rx[ch].lock, NULL);
+		pthread_cond_init(&rx[ch].cond, NULL);
+		if (open_channel(ch, &handle[ch]) != ICCOM_OK)
+			return 1;
+	}
+	memset(sbuf, 0xa5, sizeof(sbuf));
+
+	bench_pingpong(handle[0], iter);
+	bench_stream(handle[0], count);
+	bench_jitter(handle[0], iter / 10 ? iter / 10 : 1, 1000);
+	bench_contention(handle, threads, count / 10 ? count / 10 : 1);
+	bench_crc32c(iter);
+	bench_delta(iter);
+	bench_bulk(count / 10 ? count / 10 : 1);
+
+	for (ch = 0; ch < ICCOM_CHANNEL_MAX; ch++)
+		if (Iccom_lib_Final(handle[ch]) != ICCOM_OK)
+			ret = 1;
+
+	return ret;
+}
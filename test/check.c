@@ -0,0 +1,966 @@
+/*
+ * ICCOM library behaviour checks.
+ *
+ * Runs against the loopback stand-in of the driver (iccom_loopback.c) and
+ * prints "PASS <check>" or the failed conditions and "FAIL <check>" per
+ * check; the exit status is 1 when a check failed.  Checks named on the
+ * command line are run alone.
+ *   dispatch : frames are routed to the handler of their message ID,
+ *              unknown IDs to the default handler, counted per ID; a
+ *              handler replaced again and again takes no memory
+ *   handle   : a released or unknown channel handle is refused with
+ *              ICCOM_ERR_PARAM, without being accessed
+ *   shaper   : ICCOM_SHAPER_NONBLOCK rejects, ICCOM_SHAPER_DROP drops and
+ *              ICCOM_SHAPER_BLOCK delays the frames over the rate
+ *   crc      : a corrupted frame is passed to the error callback with
+ *              ICCOM_ERR_CRC and counted, good frames are delivered
+ *   delta    : delta frames are reconstructed; after a lost frame the
+ *              delta frames fail with ICCOM_ERR_DELTA until the keyframe
+ *   peer     : the reference CR7 codec (peer/iccom_delta_peer.c) decodes
+ *              the delta frames of the library and the library decodes
+ *              the ones the reference codec encodes from them
+ *   conflate : data of a topic not sent yet is replaced in place, so only
+ *              the newest data per topic is sent
+ *   batch    : frames are grouped up to batch_max, and within batch_time
+ *   health   : probes measure the round trip time, lost probes degrade
+ *              the link until the next echo, probes wait for the shaper
+ *              of the channel; refused on a delta channel
+ *   frame    : the frame size is negotiated with the driver, or is
+ *              ICCOM_BUF_MAX_SIZE when it does not support it (run with
+ *              LOOPBACK_FRAME_MAX=0)
+ *   spill    : link down spills frames to the segment file, link up drains
+ *              them in order at the rate of the shaper of the channel, a
+ *              full segment drops the oldest records, a second queue of
+ *              the file is refused and the records left by Iccom_lib_Final
+ *              are taken over by the next queue of the file
+ *
+ * Frames sent carry a sequence number in bytes 0-3, a message or topic ID
+ * in bytes 4-7 and a pattern (byte n = n) from byte 8, checked on receive.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <malloc.h>
+#include <time.h>
+#include <iccom.h>
+#include <iccom_delta_peer.h>
+
+#define CHECK_LOG_MAX	1024	/* received frames logged */
+#define CHECK_WAIT_MS	2000	/* receive wait timeout */
+#define CHECK_FRAME_MAX	16384	/* frame size maximum of the loopback */
+#define CHECK_DATA_OFS	8	/* pattern offset of frames */
+#define CHECK_DEV0	"/dev/iccom0"
+#define CHECK_REREGISTER 4097	/* handler replacements of one ID */
+
+#define PEER_STREAMS	2	/* delta streams of the peer check (ID 1, 2) */
+#define PEER_FRAMES	24	/* frames sent by the peer check */
+
+#define SPILL_FILE_SIZE	8192	/* segment file of 78 records of 100 bytes */
+#define SPILL_OVERFILL	100	/* frames sent to the full segment */
+
+#define CHECK(cond)	check_true((cond) != 0, #cond, __LINE__)
+
+/* poll cond every millisecond up to CHECK_WAIT_MS */
+#define WAIT_UNTIL(cond)						\
+	do {								\
+		int w_;							\
+		for (w_ = 0; w_ < CHECK_WAIT_MS && !(cond); w_++)	\
+			usleep(1000);					\
+	} while (0)
+
+/* loopback stand-in of the driver */
+int loopback_set_link(const char *path, int up);
+int loopback_drop(const char *path, unsigned int n);
+int loopback_corrupt(const char *path, unsigned int n);
+int loopback_echo(const char *path,
+		  uint32_t (*fn)(void *arg, uint8_t *frame, uint32_t size,
+				 uint32_t frame_size), void *arg);
+
+struct check_rx {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	uint32_t count;			/* frames received */
+	uint32_t bad;			/* frames with broken pattern */
+	uint32_t seq[CHECK_LOG_MAX];	/* bytes 0-3 of each frame */
+	uint32_t id[CHECK_LOG_MAX];	/* bytes 4-7 of each frame */
+	uint32_t size[CHECK_LOG_MAX];
+	uint32_t error_count;		/* error callback calls */
+	int32_t last_error;
+	uint32_t call_count;		/* batch callback calls */
+	uint32_t call[CHECK_LOG_MAX];	/* frames per batch call */
+	uint32_t health_count;		/* health callback calls */
+	Iccom_health_event health[CHECK_LOG_MAX];
+};
+
+/* message handler of a message ID (dispatch) */
+struct check_msg {
+	uint32_t count;
+	uint32_t last_id;
+};
+
+struct check_case {
+	const char *name;
+	void (*run)(void);
+};
+
+/* CR7 side of the peer check : decodes and encodes again every frame */
+struct check_peer {
+	struct iccom_delta_peer_rx_t rx[PEER_STREAMS];
+	struct iccom_delta_peer_tx_t tx[PEER_STREAMS];
+	uint8_t ref[PEER_STREAMS][CHECK_FRAME_MAX];
+	uint8_t last[PEER_STREAMS][CHECK_FRAME_MAX];
+	uint32_t decoded;		/* library frames decoded */
+	uint32_t bad;			/* frames not decoded or broken */
+	uint32_t key_count;		/* keyframes of the library */
+	uint32_t diff_count;		/* delta frames of the library */
+};
+
+static struct check_rx rx = {
+	PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER
+};
+static uint8_t rbuf[2][CHECK_FRAME_MAX];
+static uint8_t sbuf[CHECK_FRAME_MAX];
+static int failed;			/* failed conditions of the check */
+
+static void check_true(int ok, const char *cond, int line)
+{
+	if (!ok) {
+		printf("  check.c:%d: %s\n", line, cond);
+		failed++;
+	}
+}
+
+static void rx_callback(void *user_data, enum Iccom_channel_number ch,
+			uint32_t sz, uint8_t *buf)
+{
+	struct check_rx *r = user_data;
+	uint32_t seq = 0, id = 0, i;
+	int bad = 0;
+
+	if (sz >= CHECK_DATA_OFS) {
+		memcpy(&seq, buf, sizeof(seq));
+		memcpy(&id, &buf[4], sizeof(id));
+	}
+	for (i = CHECK_DATA_OFS; i < sz; i++)
+		if (buf[i] != (uint8_t)i)
+			bad = 1;
+
+	pthread_mutex_lock(&r->lock);
+	if (r->count < CHECK_LOG_MAX) {
+		r->seq[r->count] = seq;
+		r->id[r->count] = id;
+		r->size[r->count] = sz;
+	}
+	r->count++;
+	r->bad += bad;
+	pthread_cond_broadcast(&r->cond);
+	pthread_mutex_unlock(&r->lock);
+}
+
+static void err_callback(void *user_data, enum Iccom_channel_number ch,
+			 int32_t error, uint32_t sz, uint8_t *buf)
+{
+	struct check_rx *r = user_data;
+
+	pthread_mutex_lock(&r->lock);
+	r->error_count++;
+	r->last_error = error;
+	pthread_cond_broadcast(&r->cond);
+	pthread_mutex_unlock(&r->lock);
+}
+
+static void msg_handler(void *user_data, enum Iccom_channel_number ch,
+			uint32_t msg_id, uint32_t sz, uint8_t *buf,
+			const Iccom_recv_info *info)
+{
+	struct check_msg *m = user_data;
+
+	m->count++;
+	m->last_id = msg_id;
+	rx_callback(&rx, ch, sz, buf);
+}
+
+static void batch_callback(void *user_data, enum Iccom_channel_number ch,
+			   const Iccom_recv_frame *frames, uint32_t count)
+{
+	struct check_rx *r = user_data;
+	uint32_t i;
+
+	pthread_mutex_lock(&r->lock);
+	if (r->call_count < CHECK_LOG_MAX)
+		r->call[r->call_count] = count;
+	r->call_count++;
+	pthread_mutex_unlock(&r->lock);
+
+	for (i = 0; i < count; i++)
+		rx_callback(r, ch, frames[i].recv_size, frames[i].recv_buf);
+}
+
+static void health_callback(void *user_data, enum Iccom_channel_number ch,
+			    const Iccom_health_event *event)
+{
+	struct check_rx *r = user_data;
+
+	pthread_mutex_lock(&r->lock);
+	if (r->health_count < CHECK_LOG_MAX)
+		r->health[r->health_count] = *event;
+	r->health_count++;
+	pthread_cond_broadcast(&r->cond);
+	pthread_mutex_unlock(&r->lock);
+}
+
+static void rx_reset(void)
+{
+	pthread_mutex_lock(&rx.lock);
+	rx.count = 0;
+	rx.bad = 0;
+	rx.error_count = 0;
+	rx.last_error = ICCOM_OK;
+	rx.call_count = 0;
+	rx.health_count = 0;
+	pthread_mutex_unlock(&rx.lock);
+}
+
+/* wait until the counter of rx reaches "target", return the counter */
+static uint32_t rx_wait(const uint32_t *counter, uint32_t target)
+{
+	struct timespec deadline;
+	uint32_t n;
+	int ret = 0;
+
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += CHECK_WAIT_MS / 1000;
+	deadline.tv_nsec += (CHECK_WAIT_MS % 1000) * 1000000L;
+	if (deadline.tv_nsec >= 1000000000L) {
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000L;
+	}
+
+	pthread_mutex_lock(&rx.lock);
+	while (*counter < target && ret == 0)
+		ret = pthread_cond_timedwait(&rx.cond, &rx.lock, &deadline);
+	n = *counter;
+	pthread_mutex_unlock(&rx.lock);
+	return n;
+}
+
+/* 1 when the first n frames received carry first, first + 1, ... */
+static int rx_in_order(uint32_t first, uint32_t n)
+{
+	uint32_t i;
+
+	for (i = 0; i < n && i < CHECK_LOG_MAX; i++)
+		if (rx.seq[i] != first + i)
+			return 0;
+	return 1;
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void init_param(Iccom_init_param_ex *ip, int ch)
+{
+	memset(ip, 0, sizeof(*ip));
+	ip->channel_no = ch;
+	ip->recv_buf = rbuf[ch];
+	ip->recv_cb = rx_callback;
+	ip->user_data = &rx;
+	ip->error_cb = err_callback;
+}
+
+/* send "size" bytes with the sequence number and message or topic ID */
+static int send_msg(Iccom_channel_t handle, uint32_t seq, uint32_t id,
+		    uint32_t size)
+{
+	Iccom_send_param sp;
+
+	memcpy(sbuf, &seq, sizeof(seq));
+	memcpy(&sbuf[4], &id, sizeof(id));
+	sp.channel_handle = handle;
+	sp.send_size = size;
+	sp.send_buf = sbuf;
+	return Iccom_lib_Send(&sp);
+}
+
+static void check_dispatch(void)
+{
+	struct check_msg msg[3];	/* [0]: default, [1]: ID 1, [2]: ID 2 */
+	Iccom_init_param_ex ip;
+	Iccom_dispatch_param dp;
+	Iccom_dispatch_stats ds[4];
+	Iccom_channel_t h = NULL;
+	uint32_t i, n = 0;
+	size_t heap;
+
+	rx_reset();
+	memset(msg, 0, sizeof(msg));
+	init_param(&ip, ICCOM_CHANNEL_0);
+	CHECK(Iccom_lib_InitEx(&ip, &h) == ICCOM_OK);
+
+	memset(&dp, 0, sizeof(dp));
+	dp.id_offset = 4;
+	dp.id_width = 4;
+	dp.id_order = ICCOM_ID_LITTLE_ENDIAN;
+	dp.id_max_count = 4;
+	dp.default_handler = msg_handler;
+	dp.default_user_data = &msg[0];
+	CHECK(Iccom_lib_DispatchConfig(h, &dp) == ICCOM_OK);
+	CHECK(Iccom_lib_DispatchRegister(h, 1, msg_handler, &msg[1]) ==
+	      ICCOM_OK);
+	CHECK(Iccom_lib_DispatchRegister(h, 2, msg_handler, &msg[2]) ==
+	      ICCOM_OK);
+
+	for (i = 0; i < 3; i++)
+		CHECK(send_msg(h, i, 1, 64) == ICCOM_OK);
+	for (i = 3; i < 5; i++)
+		CHECK(send_msg(h, i, 2, 64) == ICCOM_OK);
+	CHECK(send_msg(h, 5, 7, 64) == ICCOM_OK);
+	CHECK(rx_wait(&rx.count, 6) == 6);
+	CHECK(rx_in_order(0, 6) && rx.bad == 0);
+	CHECK(msg[1].count == 3 && msg[1].last_id == 1);
+	CHECK(msg[2].count == 2 && msg[2].last_id == 2);
+	CHECK(msg[0].count == 1 && msg[0].last_id == 7);
+
+	/* statistics : unknown IDs first, then in registration order */
+	WAIT_UNTIL(Iccom_lib_DispatchGetStats(h, ds, 4, &n) == ICCOM_OK &&
+		   ds[0].count + ds[1].count + ds[2].count == 6);
+	CHECK(n == 3);
+	CHECK((ds[0].flags & ICCOM_DISPATCH_STATS_DEFAULT) != 0);
+	CHECK(ds[0].count == 1);
+	CHECK(ds[1].msg_id == 1 && ds[1].count == 3);
+	CHECK(ds[2].msg_id == 2 && ds[2].count == 2);
+
+	/* unregistered ID : default handler */
+	CHECK(Iccom_lib_DispatchRegister(h, 2, NULL, NULL) == ICCOM_OK);
+	CHECK(send_msg(h, 6, 2, 64) == ICCOM_OK);
+	CHECK(rx_wait(&rx.count, 7) == 7);
+	CHECK(msg[2].count == 2);
+	CHECK(msg[0].count == 2 && msg[0].last_id == 2);
+
+	/* handlers are replaced in place : the heap does not grow */
+	heap = mallinfo2().uordblks;
+	for (i = 0; i < CHECK_REREGISTER; i++)
+		CHECK(Iccom_lib_DispatchRegister(h, 1, msg_handler,
+			&msg[1U + (i & 1U)]) == ICCOM_OK);
+	CHECK(mallinfo2().uordblks < heap + 4096U);
+	CHECK(send_msg(h, 7, 1, 64) == ICCOM_OK);
+	CHECK(rx_wait(&rx.count, 8) == 8);
+	CHECK(msg[1].count == 4 && msg[1].last_id == 1);
+	CHECK(Iccom_lib_DispatchGetStats(h, ds, 4, &n) == ICCOM_OK && n == 3);
+
+	CHECK(Iccom_lib_Final(h) == ICCOM_OK);
+}
+
+static void check_handle(void)
+{
+	Iccom_init_param_ex ip;
+	Iccom_shaper_stats st;
+	Iccom_channel_t h = NULL;
+	uint8_t *junk;
+
+	rx_reset();
+	init_param(&ip, ICCOM_CHANNEL_0);
+	CHECK(Iccom_lib_InitEx(&ip, &h) == ICCOM_OK);
+	CHECK(Iccom_lib_Final(h) == ICCOM_OK);
+
+	/* released handle */
+	CHECK(Iccom_lib_Final(h) == ICCOM_ERR_PARAM);
+	CHECK(send_msg(h, 0, 0, 64) == ICCOM_ERR_PARAM);
+	CHECK(Iccom_lib_GetShaperStats(h, &st) == ICCOM_ERR_PARAM);
+
+	/* never a handle (its contents are not read) */
+	junk = malloc(4096);
+	CHECK(junk != NULL);
+	if (junk != NULL) {
+		memset(junk, 0xff, 4096);
+		CHECK(Iccom_lib_Final((Iccom_channel_t)junk) ==
+		      ICCOM_ERR_PARAM);
+		free(junk);
+	}
+
+	/* the channel can be opened again */
+	CHECK(Iccom_lib_InitEx(&ip, &h) == ICCOM_OK);
+	CHECK(send_msg(h, 1, 0, 64) == ICCOM_OK);
+	CHECK(rx_wait(&rx.count, 1) == 1 && rx.seq[0] == 1);
+	CHECK(Iccom_lib_Final(h) == ICCOM_OK);
+}
+
+static void check_shaper(void)
+{
+	Iccom_init_param_ex ip;
+	Iccom_shaper_param sp;
+	Iccom_shaper_stats st;
+	Iccom_channel_t h = NULL;
+	uint32_t i, ok = 0, rate = 0;
+	uint64_t t0, elapsed;
+
+	rx_reset();
+	init_param(&ip, ICCOM_CHANNEL_0);
+	CHECK(Iccom_lib_InitEx(&ip, &h) == ICCOM_OK);
+
+	/* 10 msgs/s, burst of 5 : the 6th frame on is over the rate */
+	memset(&sp, 0, sizeof(sp));
+	sp.msg_rate = 10;
+	sp.msg_burst = 5;
+	sp.mode = ICCOM_SHAPER_NONBLOCK;
+	CHECK(Iccom_lib_SetShaper(h, &sp) == ICCOM_OK);
+	for (i = 0; i < 10; i++) {
+		switch (send_msg(h, i, 0, 64)) {
+		case ICCOM_OK:
+			ok++;
+			break;
+		case ICCOM_ERR_RATE:
+			rate++;
+			break;
+		}
+	}
+	CHECK(ok == 5 && rate == 5);
+	CHECK(Iccom_lib_GetShaperStats(h, &st) == ICCOM_OK);
+	CHECK(st.pass_count == 5 && st.reject_count == 5);
+	CHECK(st.delay_count == 0 && st.drop_count == 0);
+	CHECK(rx_wait(&rx.count, 5) == 5 && rx_in_order(0, 5));
+
+	/* drop : ICCOM_OK, but not sent (the buckets start full again) */
+	sp.mode = ICCOM_SHAPER_DROP;
+	CHECK(Iccom_lib_SetShaper(h, &sp) == ICCOM_OK);
+	for (i = 0; i < 10; i++)
+		CHECK(send_msg(h, 100 + i, 0, 64) == ICCOM_OK);
+	CHECK(Iccom_lib_GetShaperStats(h, &st) == ICCOM_OK);
+	CHECK(st.pass_count == 10);
+	CHECK(st.drop_count == 5 && st.drop_bytes == 5 * 64);
+	CHECK(rx_wait(&rx.count, 10) == 10 && rx_in_order(0, 5));
+	CHECK(rx.seq[5] == 100 && rx.seq[9] == 104);
+
+	/* block : 100 msgs/s, burst of 1 : 4 waits of 10ms */
+	memset(&sp, 0, sizeof(sp));
+	sp.msg_rate = 100;
+	sp.msg_burst = 1;
+	sp.mode = ICCOM_SHAPER_BLOCK;
+	CHECK(Iccom_lib_SetShaper(h, &sp) == ICCOM_OK);
+	t0 = now_ns();
+	for (i = 0; i < 5; i++)
+		CHECK(send_msg(h, 200 + i, 0, 64) == ICCOM_OK);
+	elapsed = now_ns() - t0;
+	CHECK(elapsed >= 35000000U);
+	CHECK(Iccom_lib_GetShaperStats(h, &st) == ICCOM_OK);
+	CHECK(st.pass_count == 11 && st.delay_count == 4);
+	/* late wake-ups shorten the next wait : bounds only */
+	CHECK(st.delay_total != 0 && st.delay_total <= elapsed);
+	CHECK(st.delay_max >= 5000000U && st.delay_max <= st.delay_total);
+	CHECK(rx_wait(&rx.count, 15) == 15 && rx.seq[14] == 204);
+
+	CHECK(Iccom_lib_Final(h) == ICCOM_OK);
+}
+
+static void check_crc(void)
+{
+	Iccom_init_param_ex ip;
+	Iccom_integrity_stats st;
+	Iccom_channel_t h = NULL;
+
+	rx_reset();
+	init_param(&ip, ICCOM_CHANNEL_0);
+	ip.flags = ICCOM_INIT_CRC32C;
+	CHECK(Iccom_lib_InitEx(&ip, &h) == ICCOM_OK);
+
+	CHECK(send_msg(h, 0, 0, 256) == ICCOM_OK);
+	CHECK(rx_wait(&rx.count, 1) == 1);
+
+	/* corrupted frame : error callback, not delivered */
+	loopback_corrupt(CHECK_DEV0, 1);
+	CHECK(send_msg(h, 1, 0, 256) == ICCOM_OK);
+	CHECK(rx_wait(&rx.error_count, 1) == 1);
+	CHECK(rx.last_error == ICCOM_ERR_CRC);
+
+	CHECK(send_msg(h, 2, 0, 256) == ICCOM_OK);
+	CHECK(rx_wait(&rx.count, 2) == 2);
+	CHECK(rx.seq[0] == 0 && rx.seq[1] == 2 && rx.size[1] == 256);
+	CHECK(rx.bad == 0 && rx.error_count == 1);
+
+	CHECK(Iccom_lib_GetIntegrityStats(h, &st) == ICCOM_OK);
+	CHECK(st.check_count == 3 && st.crc_error_count == 1);
+	CHECK(st.short_count == 0);
+
+	CHECK(Iccom_lib_Final(h) == ICCOM_OK);
+}
+
+static void check_delta(void)
+{
+	Iccom_init_param_ex ip;
+	Iccom_delta_param dp;
+	Iccom_delta_stats st;
+	Iccom_channel_t h = NULL;
+	uint32_t i;
+
+	rx_reset();
+	init_param(&ip, ICCOM_CHANNEL_0);
+	ip.flags = ICCOM_INIT_DELTA;
+	CHECK(Iccom_lib_InitEx(&ip, &h) == ICCOM_OK);
+
+	/* keyframes 0 and 8, the others only change the sequence number */
+	memset(&dp, 0, sizeof(dp));
+	dp.key_interval = 8;
+	CHECK(Iccom_lib_DeltaConfig(h, &dp) == ICCOM_OK);
+	for (i = 0; i < 4; i++)
+		CHECK(send_msg(h, i, 0, 512) == ICCOM_OK);
+	CHECK(rx_wait(&rx.count, 4) == 4);
+	CHECK(rx_in_order(0, 4) && rx.bad == 0 && rx.size[3] == 512);
+
+	/* frame 4 lost : 5 to 7 have no reference frame */
+	loopback_drop(CHECK_DEV0, 1);
+	for (i = 4; i < 10; i++)
+		CHECK(send_msg(h, i, 0, 512) == ICCOM_OK);
+	CHECK(rx_wait(&rx.count, 6) == 6);
+	CHECK(rx.seq[4] == 8 && rx.seq[5] == 9 && rx.bad == 0);
+	CHECK(rx.error_count == 3 && rx.last_error == ICCOM_ERR_DELTA);
+
+	CHECK(Iccom_lib_GetDeltaStats(h, &st) == ICCOM_OK);
+	CHECK(st.key_count == 2 && st.diff_count == 8);
+	CHECK(st.data_bytes == 10 * 512 && st.coded_bytes < st.data_bytes);
+	CHECK(st.recv_key_count == 2 && st.desync_count == 3);
+	CHECK(st.format_error_count == 0);
+
+	CHECK(Iccom_lib_Final(h) == ICCOM_OK);
+}
+
+/* loopback echo : CR7 side decoding the frame and sending it back */
+static uint32_t peer_echo(void *arg, uint8_t *frame, uint32_t size,
+			  uint32_t frame_size)
+{
+	struct check_peer *p = arg;
+	const uint8_t *data;
+	uint32_t id, data_size, seq, i;
+
+	if (iccom_delta_peer_stream(frame, size, &id) !=
+	    ICCOM_DELTA_PEER_OK || id == 0 || id > PEER_STREAMS) {
+		p->bad++;
+		return size;
+	}
+	if (frame[8] == ICCOM_DELTA_PEER_KEY)
+		p->key_count++;
+	else
+		p->diff_count++;
+	if (iccom_delta_peer_decode(&p->rx[id - 1], frame, size, &data,
+				    &data_size) != ICCOM_DELTA_PEER_OK) {
+		p->bad++;
+		return size;
+	}
+
+	memcpy(&seq, data, sizeof(seq));
+	if (data_size < CHECK_DATA_OFS || seq != p->decoded)
+		p->bad++;
+	for (i = CHECK_DATA_OFS; i < data_size; i++)
+		if (data[i] != (uint8_t)i)
+			p->bad++;
+	p->decoded++;
+
+	if (data_size + ICCOM_DELTA_PEER_HEADER_SIZE > frame_size)
+		return size;
+	return iccom_delta_peer_encode(&p->tx[id - 1], data, data_size,
+				       frame);
+}
+
+static void check_peer(void)
+{
+	static struct check_peer peer;
+	Iccom_init_param_ex ip;
+	Iccom_delta_param dp;
+	Iccom_delta_stats st;
+	Iccom_channel_t h = NULL;
+	uint32_t i;
+
+	rx_reset();
+	memset(&peer, 0, sizeof(peer));
+	for (i = 0; i < PEER_STREAMS; i++) {
+		iccom_delta_peer_rx_init(&peer.rx[i], peer.ref[i],
+					 CHECK_FRAME_MAX);
+		/* keyframes at other frames than the library's */
+		iccom_delta_peer_tx_init(&peer.tx[i], i + 1, peer.last[i],
+					 CHECK_FRAME_MAX, 6);
+	}
+
+	init_param(&ip, ICCOM_CHANNEL_0);
+	ip.flags = ICCOM_INIT_DELTA;
+	CHECK(Iccom_lib_InitEx(&ip, &h) == ICCOM_OK);
+	CHECK(loopback_echo(CHECK_DEV0, peer_echo, &peer) == 0);
+
+	/* streams 1 and 2 (ID in bytes 4-7) of 12 frames, the size changes */
+	/* at the 7th frame of each : keyframes 0, 4, 6 and 10 of the       */
+	/* library, 0 and 6 of the peer                                     */
+	memset(&dp, 0, sizeof(dp));
+	dp.key_interval = 4;
+	dp.stream_max = PEER_STREAMS;
+	dp.id_offset = 4;
+	dp.id_width = 4;
+	dp.id_order = ICCOM_ID_LITTLE_ENDIAN;
+	CHECK(Iccom_lib_DeltaConfig(h, &dp) == ICCOM_OK);
+	for (i = 0; i < PEER_FRAMES; i++)
+		CHECK(send_msg(h, i, 1 + (i & 1U), 256 + (i / 12) * 64) ==
+		      ICCOM_OK);
+	CHECK(rx_wait(&rx.count, PEER_FRAMES) == PEER_FRAMES);
+	CHECK(rx_in_order(0, PEER_FRAMES) && rx.bad == 0);
+	CHECK(rx.size[0] == 256 && rx.size[PEER_FRAMES - 1] == 320);
+	CHECK(rx.error_count == 0);
+
+	/* library to peer */
+	CHECK(peer.decoded == PEER_FRAMES && peer.bad == 0);
+	CHECK(peer.key_count == 8 && peer.diff_count == 16);
+
+	/* peer to library */
+	CHECK(Iccom_lib_GetDeltaStats(h, &st) == ICCOM_OK);
+	CHECK(st.key_count == 8 && st.diff_count == 16);
+	CHECK(st.recv_key_count == 4 && st.recv_diff_count == 20);
+	CHECK(st.desync_count == 0 && st.format_error_count == 0);
+
+	CHECK(Iccom_lib_Final(h) == ICCOM_OK);
+}
+
+static void check_conflate(void)
+{
+	Iccom_init_param_ex ip;
+	Iccom_conflate_param cp;
+	Iccom_conflate_stats st;
+	Iccom_channel_t h = NULL;
+	uint32_t i;
+
+	rx_reset();
+	init_param(&ip, ICCOM_CHANNEL_0);
+	CHECK(Iccom_lib_InitEx(&ip, &h) == ICCOM_OK);
+
+	memset(&cp, 0, sizeof(cp));
+	cp.topic_max = 4;
+	cp.id_offset = 4;
+	cp.id_width = 4;
+	cp.retry_time = 200;
+	CHECK(Iccom_lib_ConflateConfig(h, &cp) == ICCOM_OK);
+
+	/* link down : topic 1 waits for the retry */
+	loopback_set_link(CHECK_DEV0, 0);
+	CHECK(send_msg(h, 1, 1, 64) == ICCOM_OK);
+	WAIT_UNTIL(Iccom_lib_GetConflateStats(h, &st) == ICCOM_OK &&
+		   st.retry_count != 0);
+
+	/* newer data replaces the data waiting */
+	for (i = 2; i <= 5; i++)
+		CHECK(send_msg(h, i, 1, 64) == ICCOM_OK);
+	for (i = 10; i <= 12; i++)
+		CHECK(send_msg(h, i, 2, 64) == ICCOM_OK);
+	CHECK(send_msg(h, 20, 3, 64) == ICCOM_OK);
+	CHECK(send_msg(h, 30, 4, 64) == ICCOM_OK);
+	CHECK(send_msg(h, 40, 5, 64) == ICCOM_ERR_BUF_FULL);
+	CHECK(Iccom_lib_GetConflateStats(h, &st) == ICCOM_OK);
+	CHECK(st.put_count == 10 && st.conflate_count == 6);
+	CHECK(st.topic_count == 4 && st.depth_count == 4);
+	CHECK(st.overflow_count == 1);
+
+	/* link up : the newest data of each topic in order */
+	loopback_set_link(CHECK_DEV0, 1);
+	CHECK(rx_wait(&rx.count, 4) == 4);
+	CHECK(rx.seq[0] == 5 && rx.id[0] == 1);
+	CHECK(rx.seq[1] == 12 && rx.id[1] == 2);
+	CHECK(rx.seq[2] == 20 && rx.seq[3] == 30);
+	WAIT_UNTIL(Iccom_lib_GetConflateStats(h, &st) == ICCOM_OK &&
+		   st.send_count == 4);
+	CHECK(st.send_count == 4 && st.depth_count == 0);
+	CHECK(st.latency_max != 0);
+	usleep(20000);
+	CHECK(rx_wait(&rx.count, 0) == 4);
+
+	CHECK(Iccom_lib_Final(h) == ICCOM_OK);
+}
+
+static void check_batch(void)
+{
+	Iccom_init_param_ex ip;
+	Iccom_batch_param bp;
+	Iccom_batch_stats st;
+	Iccom_channel_t h = NULL;
+	uint32_t i;
+
+	rx_reset();
+	init_param(&ip, ICCOM_CHANNEL_0);
+	CHECK(Iccom_lib_InitEx(&ip, &h) == ICCOM_OK);
+
+	memset(&bp, 0, sizeof(bp));
+	bp.batch_cb = batch_callback;
+	bp.user_data = &rx;
+	bp.batch_max = 4;
+	bp.batch_time = 100000;
+	CHECK(Iccom_lib_BatchConfig(h, &bp) == ICCOM_OK);
+
+	/* 10 frames at once : 4 + 4, then 2 after batch_time */
+	for (i = 0; i < 10; i++)
+		CHECK(send_msg(h, i, 0, 64) == ICCOM_OK);
+	CHECK(rx_wait(&rx.count, 10) == 10);
+	CHECK(rx_in_order(0, 10) && rx.bad == 0);
+	CHECK(rx.call_count == 3);
+	CHECK(rx.call[0] == 4 && rx.call[1] == 4 && rx.call[2] == 2);
+	WAIT_UNTIL(Iccom_lib_GetBatchStats(h, &st) == ICCOM_OK &&
+		   st.frame_count == 10);
+	CHECK(st.call_count == 3 && st.frame_count == 10);
+	CHECK(st.full_count == 2 && st.max_count == 4);
+
+	/* frames within batch_time of the first one : one call */
+	rx_reset();
+	for (i = 0; i < 3; i++) {
+		CHECK(send_msg(h, 100 + i, 0, 64) == ICCOM_OK);
+		usleep(10000);
+	}
+	CHECK(rx_wait(&rx.count, 3) == 3);
+	CHECK(rx.call_count == 1 && rx.call[0] == 3);
+	CHECK(rx_in_order(100, 3));
+
+	CHECK(Iccom_lib_Final(h) == ICCOM_OK);
+}
+
+static void check_health(void)
+{
+	Iccom_init_param_ex ip;
+	Iccom_health_param hp;
+	Iccom_health_stats st;
+	Iccom_shaper_param sp;
+	Iccom_shaper_stats ss;
+	Iccom_channel_t h = NULL;
+	uint64_t n;
+
+	rx_reset();
+	init_param(&ip, ICCOM_CHANNEL_0);
+	CHECK(Iccom_lib_InitEx(&ip, &h) == ICCOM_OK);
+
+	memset(&hp, 0, sizeof(hp));
+	hp.health_cb = health_callback;
+	hp.user_data = &rx;
+	hp.interval = 10;
+	hp.timeout = 50;
+	CHECK(Iccom_lib_HealthConfig(h, &hp) == ICCOM_OK);
+
+	/* echoes : round trip time measured, not delivered */
+	WAIT_UNTIL(Iccom_lib_GetHealthStats(h, &st) == ICCOM_OK &&
+		   st.echo_count >= 5);
+	CHECK(st.echo_count >= 5 && st.lost_count == 0);
+	CHECK(st.state == ICCOM_HEALTH_OK);
+	CHECK(st.rtt_min != 0 && st.rtt_min <= st.rtt_p50);
+	CHECK(st.rtt_p50 <= st.rtt_p99 && st.rtt_p99 <= st.rtt_max);
+	CHECK(st.rtt_ewma != 0);
+	CHECK(rx_wait(&rx.count, 0) == 0 && rx.health_count == 0);
+
+	/* echoes lost : degraded until the next echo */
+	loopback_drop(CHECK_DEV0, 1000000);
+	CHECK(rx_wait(&rx.health_count, 1) == 1);
+	CHECK(rx.health[0].state == ICCOM_HEALTH_DEGRADED);
+	CHECK((rx.health[0].reason & ICCOM_HEALTH_REASON_LOST) != 0);
+	loopback_drop(CHECK_DEV0, 0);
+	CHECK(rx_wait(&rx.health_count, 2) == 2);
+	CHECK(rx.health[1].state == ICCOM_HEALTH_OK);
+	CHECK(Iccom_lib_GetHealthStats(h, &st) == ICCOM_OK);
+	CHECK(st.lost_count != 0);
+
+	/* shaper of the channel : probes wait for it (10 msgs/s) */
+	memset(&sp, 0, sizeof(sp));
+	sp.msg_rate = 10;
+	sp.msg_burst = 1;
+	sp.mode = ICCOM_SHAPER_DROP;
+	CHECK(Iccom_lib_SetShaper(h, &sp) == ICCOM_OK);
+	CHECK(Iccom_lib_GetHealthStats(h, &st) == ICCOM_OK);
+	n = st.probe_count;
+	usleep(300000);
+	CHECK(Iccom_lib_GetHealthStats(h, &st) == ICCOM_OK);
+	CHECK(st.probe_count - n <= 5 && st.send_error_count == 0);
+	CHECK(Iccom_lib_GetShaperStats(h, &ss) == ICCOM_OK);
+	CHECK(ss.delay_count != 0 && ss.drop_count == 0);
+
+	CHECK(Iccom_lib_Final(h) == ICCOM_OK);
+
+	/* probes are not delta encoded : refused */
+	init_param(&ip, ICCOM_CHANNEL_0);
+	ip.flags = ICCOM_INIT_DELTA;
+	CHECK(Iccom_lib_InitEx(&ip, &h) == ICCOM_OK);
+	CHECK(Iccom_lib_HealthConfig(h, &hp) == ICCOM_ERR_PARAM);
+	CHECK(Iccom_lib_Final(h) == ICCOM_OK);
+}
+
+static void check_frame(void)
+{
+	Iccom_init_param_ex ip;
+	Iccom_channel_t h = NULL;
+	const char *env;
+	uint32_t expect = CHECK_FRAME_MAX, frame_max = 0, data_max = 0;
+
+	/* frame size accepted by the loopback */
+	env = getenv("LOOPBACK_FRAME_MAX");
+	if (env != NULL)
+		expect = strtoul(env, NULL, 0);
+	if (expect > CHECK_FRAME_MAX)
+		expect = CHECK_FRAME_MAX;
+	if (expect < ICCOM_BUF_MAX_SIZE)
+		expect = ICCOM_BUF_MAX_SIZE;
+
+	rx_reset();
+	init_param(&ip, ICCOM_CHANNEL_0);
+	ip.flags = ICCOM_INIT_STAMP | ICCOM_INIT_CRC32C;
+	ip.frame_max = CHECK_FRAME_MAX;
+	CHECK(Iccom_lib_InitEx(&ip, &h) == ICCOM_OK);
+	CHECK(Iccom_lib_GetFrameSize(h, &frame_max, &data_max) == ICCOM_OK);
+	CHECK(frame_max == expect);
+	CHECK(data_max == expect - ICCOM_STAMP_HEADER_SIZE -
+	      ICCOM_CRC32C_SIZE);
+
+	CHECK(send_msg(h, 0, 0, data_max) == ICCOM_OK);
+	CHECK(rx_wait(&rx.count, 1) == 1);
+	CHECK(rx.size[0] == data_max && rx.bad == 0);
+	CHECK(send_msg(h, 1, 0, data_max + 1) == ICCOM_ERR_PARAM);
+
+	CHECK(Iccom_lib_Final(h) == ICCOM_OK);
+}
+
+/* wait until the spill queue is empty, return the statistics */
+static void spill_wait_empty(Iccom_channel_t handle, Iccom_spill_stats *st)
+{
+	WAIT_UNTIL(Iccom_lib_GetSpillStats(handle, st) != ICCOM_OK ||
+		   st->depth_count == 0);
+}
+
+static void check_spill(void)
+{
+	Iccom_init_param_ex ip;
+	Iccom_spill_param sp;
+	Iccom_spill_stats st;
+	Iccom_shaper_param shp;
+	Iccom_shaper_stats ss;
+	Iccom_channel_t h = NULL, h2 = NULL;
+	char path[64];
+	uint32_t i, n;
+	uint64_t t0;
+
+	snprintf(path, sizeof(path), "/tmp/iccom-check-spill.%d",
+		 (int)getpid());
+	unlink(path);
+	memset(&sp, 0, sizeof(sp));
+	sp.path = path;
+	sp.file_size = SPILL_FILE_SIZE;
+	sp.retry_time = 10;
+
+	rx_reset();
+	init_param(&ip, ICCOM_CHANNEL_0);
+	CHECK(Iccom_lib_InitEx(&ip, &h) == ICCOM_OK);
+	CHECK(Iccom_lib_SpillConfig(h, &sp) == ICCOM_OK);
+
+	/* link down : the frames are spilled */
+	loopback_set_link(CHECK_DEV0, 0);
+	for (i = 0; i < 10; i++)
+		CHECK(send_msg(h, i, 0, 100) == ICCOM_OK);
+	CHECK(Iccom_lib_GetSpillStats(h, &st) == ICCOM_OK);
+	CHECK(st.depth_count == 10 && st.spill_count == 10);
+	CHECK(rx_wait(&rx.count, 0) == 0);
+
+	/* link up : drained in order */
+	loopback_set_link(CHECK_DEV0, 1);
+	CHECK(rx_wait(&rx.count, 10) == 10);
+	CHECK(rx_in_order(0, 10) && rx.bad == 0);
+	spill_wait_empty(h, &st);
+	CHECK(st.depth_count == 0 && st.drain_count == 10);
+	CHECK(st.drop_count == 0);
+
+	/* shaper of the channel : the drain waits for it (100 msgs/s) */
+	rx_reset();
+	loopback_set_link(CHECK_DEV0, 0);
+	for (i = 0; i < 10; i++)
+		CHECK(send_msg(h, i, 0, 100) == ICCOM_OK);
+	memset(&shp, 0, sizeof(shp));
+	shp.msg_rate = 100;
+	shp.msg_burst = 1;
+	shp.mode = ICCOM_SHAPER_NONBLOCK;
+	CHECK(Iccom_lib_SetShaper(h, &shp) == ICCOM_OK);
+	t0 = now_ns();
+	loopback_set_link(CHECK_DEV0, 1);
+	CHECK(rx_wait(&rx.count, 10) == 10);
+	CHECK(now_ns() - t0 >= 80000000U);
+	CHECK(rx_in_order(0, 10));
+	CHECK(Iccom_lib_GetShaperStats(h, &ss) == ICCOM_OK);
+	CHECK(ss.delay_count >= 9 && ss.reject_count == 0);
+	CHECK(Iccom_lib_SetShaper(h, NULL) == ICCOM_OK);
+	spill_wait_empty(h, &st);
+
+	/* full segment : the oldest records are dropped first */
+	rx_reset();
+	loopback_set_link(CHECK_DEV0, 0);
+	for (i = 0; i < SPILL_OVERFILL; i++)
+		CHECK(send_msg(h, i, 0, 100) == ICCOM_OK);
+	CHECK(Iccom_lib_GetSpillStats(h, &st) == ICCOM_OK);
+	n = st.depth_count;
+	CHECK(n > 0 && n < SPILL_OVERFILL);
+	CHECK(st.drop_count == SPILL_OVERFILL - n);
+	CHECK(st.drop_bytes == (SPILL_OVERFILL - n) * 100);
+	loopback_set_link(CHECK_DEV0, 1);
+	CHECK(rx_wait(&rx.count, n) == n);
+	CHECK(rx_in_order(SPILL_OVERFILL - n, n));
+	spill_wait_empty(h, &st);
+
+	/* second queue of the segment file : refused */
+	init_param(&ip, ICCOM_CHANNEL_1);
+	CHECK(Iccom_lib_InitEx(&ip, &h2) == ICCOM_OK);
+	CHECK(Iccom_lib_SpillConfig(h2, &sp) == ICCOM_ERR_BUSY);
+
+	/* records left by Iccom_lib_Final : taken over and drained */
+	rx_reset();
+	loopback_set_link(CHECK_DEV0, 0);
+	for (i = 0; i < 10; i++)
+		CHECK(send_msg(h, 1000 + i, 0, 100) == ICCOM_OK);
+	CHECK(Iccom_lib_Final(h) == ICCOM_OK);
+	CHECK(Iccom_lib_SpillConfig(h2, &sp) == ICCOM_OK);
+	CHECK(rx_wait(&rx.count, 10) == 10);
+	CHECK(rx_in_order(1000, 10));
+	spill_wait_empty(h2, &st);
+	CHECK(st.depth_count == 0 && st.drain_count == 10);
+	CHECK(Iccom_lib_Final(h2) == ICCOM_OK);
+
+	unlink(path);
+}
+
+static const struct check_case cases[] = {
+	{ "dispatch", check_dispatch },
+	{ "handle", check_handle },
+	{ "shaper", check_shaper },
+	{ "crc", check_crc },
+	{ "delta", check_delta },
+	{ "peer", check_peer },
+	{ "conflate", check_conflate },
+	{ "batch", check_batch },
+	{ "health", check_health },
+	{ "frame", check_frame },
+	{ "spill", check_spill },
+};
+#define NCASES (sizeof(cases) / sizeof(cases[0]))
+
+int main(int argc, char *argv[])
+{
+	unsigned int i;
+	int j, fail = 0;
+
+	for (i = 0; i < sizeof(sbuf); i++)
+		sbuf[i] = (uint8_t)i;
+
+	for (i = 0; i < NCASES; i++) {
+		for (j = 1; j < argc; j++)
+			if (strcmp(argv[j], cases[i].name) == 0)
+				break;
+		if (argc > 1 && j == argc)
+			continue;
+
+		failed = 0;
+		cases[i].run();
+		printf("%s %s\n", failed ? "FAIL" : "PASS", cases[i].name);
+		if (failed)
+			fail = 1;
+	}
+
+	return fail;
+}
@@ -0,0 +1,193 @@
+/*
+ * ICCOM C++ interface (iccom.hpp) behaviour checks.
+ *
+ * Runs against the loopback stand-in of the driver (iccom_loopback.c) and
+ * prints "PASS <check>" or the failed conditions and "FAIL <check>" per
+ * check, like check.c.
+ *   channel  : frames sent through an iccom::channel reach its handler in
+ *              order, close() finalizes the channel
+ *   released : destroying a channel whose handle was finalized through
+ *              native_handle() returns (the handle is unknown)
+ *   busy     : destroying a channel while a send of another thread is
+ *              delayed by the shaper waits for the send, then finalizes
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+#include <iccom.hpp>
+
+#define CHECK(cond)	check_true((cond), #cond, __LINE__)
+
+namespace {
+
+constexpr int check_wait_ms = 2000;	/* receive wait timeout */
+constexpr std::uint32_t check_frames = 10;
+constexpr unsigned int check_alarm_s = 30;	/* hang guard of a check */
+
+int failed;				/* failed conditions of the check */
+
+void check_true(bool ok, const char *cond, int line)
+{
+	if (!ok) {
+		std::printf("  check_hpp.cpp:%d: %s\n", line, cond);
+		failed++;
+	}
+}
+
+/* frames seen by a handler, shared with the check */
+struct rx_log {
+	std::mutex lock;
+	std::uint32_t count = 0;	/* frames received */
+	std::uint32_t bad = 0;		/* out of order or broken frames */
+};
+
+struct rx_handler {
+	rx_log *log;
+
+	void operator()(iccom::payload p)
+	{
+		std::uint32_t seq = 0;
+		std::lock_guard g(log->lock);
+
+		if (p.size() >= sizeof(seq))
+			std::memcpy(&seq, p.data(), sizeof(seq));
+		if (p.size() != 64 || seq != log->count)
+			log->bad++;
+		log->count++;
+	}
+};
+
+using rx_channel = iccom::channel<rx_handler>;
+
+std::error_code send_seq(const rx_channel &ch, std::uint32_t seq)
+{
+	std::uint8_t buf[64] = {};
+
+	std::memcpy(buf, &seq, sizeof(seq));
+	return ch.send(buf);
+}
+
+std::uint32_t rx_wait(rx_log &log, std::uint32_t target)
+{
+	for (int i = 0; i < check_wait_ms; i++) {
+		{
+			std::lock_guard g(log.lock);
+			if (log.count >= target)
+				break;
+		}
+		usleep(1000);
+	}
+	std::lock_guard g(log.lock);
+	return log.count;
+}
+
+void check_channel()
+{
+	rx_log log;
+	rx_channel ch(ICCOM_CHANNEL_0, rx_handler{ &log });
+
+	CHECK(ch && ch.native_handle() != nullptr);
+	CHECK(ch.number() == ICCOM_CHANNEL_0);
+	for (std::uint32_t i = 0; i < check_frames; i++)
+		CHECK(!send_seq(ch, i));
+	CHECK(rx_wait(log, check_frames) == check_frames && log.bad == 0);
+
+	CHECK(!ch.close());
+	CHECK(!ch && ch.native_handle() == nullptr);
+	CHECK(ch.send(iccom::payload()) == iccom::errc::param);
+	/* the channel number is free again */
+	rx_channel again(ICCOM_CHANNEL_0, rx_handler{ &log });
+	CHECK(!send_seq(again, check_frames));
+	CHECK(rx_wait(log, check_frames + 1) == check_frames + 1);
+}
+
+void check_released()
+{
+	rx_log log;
+
+	{
+		rx_channel ch(ICCOM_CHANNEL_0, rx_handler{ &log });
+
+		CHECK(Iccom_lib_Final(ch.native_handle()) == ICCOM_OK);
+		CHECK(ch.close() == iccom::errc::param);
+		CHECK(ch.send(iccom::payload()) == iccom::errc::param);
+		/* the destructor must not retry the unknown handle */
+	}
+	rx_channel again(ICCOM_CHANNEL_0, rx_handler{ &log });
+	CHECK(!send_seq(again, 0));
+	CHECK(rx_wait(log, 1) == 1 && log.bad == 0);
+}
+
+void check_busy()
+{
+	using namespace std::chrono_literals;
+	Iccom_shaper_param sp{};
+	std::error_code sent;
+	std::thread sender;
+	rx_log log;
+
+	/* 10 msgs/s, burst of 1 : the second frame waits about 100ms */
+	sp.msg_rate = 10;
+	sp.msg_burst = 1;
+	sp.mode = ICCOM_SHAPER_BLOCK;
+	{
+		rx_channel ch(ICCOM_CHANNEL_0, rx_handler{ &log });
+
+		CHECK(!ch.set_shaper(&sp));
+		CHECK(!send_seq(ch, 0));
+		sender = std::thread([&] { sent = send_seq(ch, 1); });
+		std::this_thread::sleep_for(20ms);
+		CHECK(ch.close() == iccom::errc::param);
+		/* the destructor waits for the delayed send */
+	}
+	sender.join();
+	CHECK(!sent);
+
+	rx_log again_log;
+	rx_channel again(ICCOM_CHANNEL_0, rx_handler{ &again_log });
+	CHECK(!send_seq(again, 0));
+	CHECK(rx_wait(again_log, 1) == 1 && again_log.bad == 0);
+}
+
+struct check_case {
+	const char *name;
+	void (*run)();
+};
+
+const check_case cases[] = {
+	{ "channel", check_channel },
+	{ "released", check_released },
+	{ "busy", check_busy },
+};
+
+} /* namespace */
+
+int main(int argc, char *argv[])
+{
+	int fail = 0;
+
+	for (const auto &c : cases) {
+		int j;
+
+		for (j = 1; j < argc; j++)
+			if (std::strcmp(argv[j], c.name) == 0)
+				break;
+		if (argc > 1 && j == argc)
+			continue;
+
+		failed = 0;
+		/* a finalize which does not return fails by SIGALRM */
+		(void)alarm(check_alarm_s);
+		c.run();
+		(void)alarm(0);
+		std::printf("%s %s\n", failed ? "FAIL" : "PASS", c.name);
+		if (failed)
+			fail = 1;
+	}
+
+	return fail;
+}
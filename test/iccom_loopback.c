@@ -0,0 +1,454 @@
+/*
+ * Loopback stand-in for the Linux ICCOM driver.
+ *
+ * Linked into test programs ahead of libc, it intercepts open(), read(),
+ * write(), ioctl() and close() on every path starting with "/dev/iccom"
+ * (so "/dev/iccom3" as well as "/dev/iccom-b3" for a second context) and
+ * emulates the driver with one in-process frame queue per path: every
+ * frame written to a channel is returned by the next read() of that
+ * channel, as if the CR7 side echoed it back.  All other paths are passed
+ * through to libc.
+ *
+ * Driver behaviour emulated:
+ *  - a channel can be opened once (EBUSY otherwise)
+ *  - write() blocks while the peer queue is full, ETIMEDOUT after
+ *    LOOPBACK_ACK_TIMEOUT_MS (the driver's ack timeout)
+ *  - read() blocks until a frame is queued, ECANCELED after
+ *    ICCOM_IOC_CANCEL_RECEIVE
+ *  - frames are up to ICCOM_BUF_MAX_SIZE bytes (EINVAL otherwise) until
+ *    ICCOM_IOC_SET_FRAME_SIZE raises the frame size of the channel, up to
+ *    LOOPBACK_FRAME_MAX bytes (environment variable LOOPBACK_FRAME_MAX
+ *    overrides it; 0 emulates a driver without the request: ENOTTY)
+ *
+ * loopback_set_link(path, 0) emulates a CR7 reset of an open channel:
+ * write() fails with EDEADLK (send timeout) until loopback_set_link(path, 1).
+ * loopback_drop(path, n) loses the echo of the next n frames written (the
+ * write succeeds), loopback_corrupt(path, n) flips a bit in the first byte
+ * of the next n frames echoed.  loopback_echo(path, fn, arg) passes every
+ * frame echoed to fn, which may rewrite it as the CR7 side would (up to the
+ * frame size of the channel) and returns its new size.
+ */
+
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <iccom.h>
+
+#define LOOPBACK_DEVNAME	"/dev/iccom"
+#define LOOPBACK_CHANNELS	64	/* open channels at a time */
+#define LOOPBACK_PATH_LEN	128
+#define LOOPBACK_DEPTH		64	/* queued frames per channel */
+#define LOOPBACK_ACK_TIMEOUT_MS	1000
+#define LOOPBACK_IOC_CANCEL	1UL	/* ICCOM_IOC_CANCEL_RECEIVE */
+#define LOOPBACK_IOC_FRAME_SIZE	2UL	/* ICCOM_IOC_SET_FRAME_SIZE */
+#define LOOPBACK_FRAME_MAX	16384	/* accepted frame size maximum */
+
+typedef uint32_t (*loopback_echo_fn)(void *arg, uint8_t *frame,
+				     uint32_t size, uint32_t frame_size);
+
+struct loopback_frame {
+	uint32_t size;
+	uint8_t *data;			/* frame_size bytes of area */
+};
+
+struct loopback_channel {
+	char path[LOOPBACK_PATH_LEN];
+	int fd;				/* -1 when closed */
+	int cancel;
+	int link_down;
+	unsigned int drop;		/* frames to lose */
+	unsigned int corrupt;		/* frames to corrupt */
+	loopback_echo_fn echo;		/* frame rewrite, NULL: none */
+	void *echo_arg;
+	unsigned int head, count;
+	uint32_t frame_size;		/* frame size maximum */
+	uint8_t *area;			/* data of all frames */
+	pthread_cond_t readable;
+	pthread_cond_t writable;
+	struct loopback_frame frame[LOOPBACK_DEPTH];
+};
+
+static pthread_mutex_t lb_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t lb_once = PTHREAD_ONCE_INIT;
+static struct loopback_channel lb_ch[LOOPBACK_CHANNELS];
+static uint32_t lb_frame_max = LOOPBACK_FRAME_MAX;
+
+static int (*real_open)(const char *, int, ...);
+static ssize_t (*real_read)(int, void *, size_t);
+static ssize_t (*real_write)(int, const void *, size_t);
+static int (*real_ioctl)(int, unsigned long, ...);
+static int (*real_close)(int);
+
+static void lb_init(void)
+{
+	const char *env;
+	int i;
+
+	real_open = dlsym(RTLD_NEXT, "open");
+	real_read = dlsym(RTLD_NEXT, "read");
+	real_write = dlsym(RTLD_NEXT, "write");
+	real_ioctl = dlsym(RTLD_NEXT, "ioctl");
+	real_close = dlsym(RTLD_NEXT, "close");
+
+	env = getenv("LOOPBACK_FRAME_MAX");
+	if (env != NULL)
+		lb_frame_max = strtoul(env, NULL, 0);
+
+	for (i = 0; i < LOOPBACK_CHANNELS; i++) {
+		lb_ch[i].fd = -1;
+		pthread_cond_init(&lb_ch[i].readable, NULL);
+		pthread_cond_init(&lb_ch[i].writable, NULL);
+	}
+}
+
+/* must be called with lb_lock held */
+static struct loopback_channel *lb_lookup(int fd)
+{
+	int i;
+
+	if (fd < 0)
+		return NULL;
+
+	for (i = 0; i < LOOPBACK_CHANNELS; i++)
+		if (lb_ch[i].fd == fd)
+			return &lb_ch[i];
+
+	return NULL;
+}
+
+/* must be called with lb_lock held and the queue empty */
+static int lb_set_frame_size(struct loopback_channel *c, uint32_t size)
+{
+	uint8_t *area;
+	int i;
+
+	if (c->area != NULL && c->frame_size == size)
+		return 0;
+
+	area = malloc((size_t)size * LOOPBACK_DEPTH);
+	if (area == NULL)
+		return -1;
+	free(c->area);
+	c->area = area;
+	c->frame_size = size;
+	for (i = 0; i < LOOPBACK_DEPTH; i++)
+		c->frame[i].data = &area[(size_t)size * i];
+	return 0;
+}
+
+static int lb_open_channel(const char *path)
+{
+	struct loopback_channel *c = NULL;
+	int fd, i;
+
+	if (strlen(path) >= LOOPBACK_PATH_LEN) {
+		errno = ENODEV;
+		return -1;
+	}
+
+	/* reserve a real descriptor so the number cannot collide */
+	fd = real_open("/dev/null", O_RDWR);
+	if (fd < 0)
+		return -1;
+
+	pthread_mutex_lock(&lb_lock);
+	for (i = 0; i < LOOPBACK_CHANNELS; i++) {
+		if (lb_ch[i].fd >= 0 && strcmp(lb_ch[i].path, path) == 0) {
+			pthread_mutex_unlock(&lb_lock);
+			real_close(fd);
+			errno = EBUSY;
+			return -1;
+		}
+		if (lb_ch[i].fd < 0 && c == NULL)
+			c = &lb_ch[i];
+	}
+	if (c == NULL || lb_set_frame_size(c, ICCOM_BUF_MAX_SIZE) != 0) {
+		pthread_mutex_unlock(&lb_lock);
+		real_close(fd);
+		errno = ENXIO;
+		return -1;
+	}
+	strcpy(c->path, path);
+	c->fd = fd;
+	c->cancel = 0;
+	c->link_down = 0;
+	c->drop = 0;
+	c->corrupt = 0;
+	c->echo = NULL;
+	c->head = 0;
+	c->count = 0;
+	pthread_mutex_unlock(&lb_lock);
+
+	return fd;
+}
+
+int open(const char *path, int flags, ...)
+{
+	mode_t mode = 0;
+	va_list ap;
+
+	pthread_once(&lb_once, lb_init);
+
+	if (strncmp(path, LOOPBACK_DEVNAME, strlen(LOOPBACK_DEVNAME)) == 0)
+		return lb_open_channel(path);
+
+	if (flags & (O_CREAT | O_TMPFILE)) {
+		va_start(ap, flags);
+		mode = va_arg(ap, mode_t);
+		va_end(ap);
+	}
+
+	return real_open(path, flags, mode);
+}
+
+ssize_t write(int fd, const void *buf, size_t count)
+{
+	struct loopback_channel *c;
+	struct loopback_frame *f;
+	struct timespec deadline;
+	int ret = 0;
+
+	pthread_once(&lb_once, lb_init);
+
+	pthread_mutex_lock(&lb_lock);
+	c = lb_lookup(fd);
+	if (c == NULL) {
+		pthread_mutex_unlock(&lb_lock);
+		return real_write(fd, buf, count);
+	}
+
+	if (count > c->frame_size) {
+		pthread_mutex_unlock(&lb_lock);
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (c->link_down) {
+		pthread_mutex_unlock(&lb_lock);
+		errno = EDEADLK;
+		return -1;
+	}
+
+	if (c->drop != 0) {
+		c->drop--;
+		pthread_mutex_unlock(&lb_lock);
+		return count;
+	}
+
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += LOOPBACK_ACK_TIMEOUT_MS / 1000;
+	deadline.tv_nsec += (LOOPBACK_ACK_TIMEOUT_MS % 1000) * 1000000L;
+	if (deadline.tv_nsec >= 1000000000L) {
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000L;
+	}
+
+	while (c->count == LOOPBACK_DEPTH && ret == 0)
+		ret = pthread_cond_timedwait(&c->writable, &lb_lock, &deadline);
+
+	if (c->count == LOOPBACK_DEPTH) {
+		pthread_mutex_unlock(&lb_lock);
+		errno = ETIMEDOUT;
+		return -1;
+	}
+
+	f = &c->frame[(c->head + c->count) % LOOPBACK_DEPTH];
+	f->size = count;
+	memcpy(f->data, buf, count);
+	if (c->echo != NULL)
+		f->size = c->echo(c->echo_arg, f->data, f->size,
+				  c->frame_size);
+	if (c->corrupt != 0 && count != 0) {
+		c->corrupt--;
+		f->data[0] ^= 0x01;
+	}
+	c->count++;
+	pthread_cond_signal(&c->readable);
+	pthread_mutex_unlock(&lb_lock);
+
+	return count;
+}
+
+ssize_t read(int fd, void *buf, size_t count)
+{
+	struct loopback_channel *c;
+	struct loopback_frame *f;
+	size_t size;
+
+	pthread_once(&lb_once, lb_init);
+
+	pthread_mutex_lock(&lb_lock);
+	c = lb_lookup(fd);
+	if (c == NULL) {
+		pthread_mutex_unlock(&lb_lock);
+		return real_read(fd, buf, count);
+	}
+
+	while (c->count == 0 && !c->cancel)
+		pthread_cond_wait(&c->readable, &lb_lock);
+
+	if (c->cancel) {
+		c->cancel = 0;
+		pthread_mutex_unlock(&lb_lock);
+		errno = ECANCELED;
+		return -1;
+	}
+
+	f = &c->frame[c->head];
+	size = f->size < count ? f->size : count;
+	memcpy(buf, f->data, size);
+	c->head = (c->head + 1) % LOOPBACK_DEPTH;
+	c->count--;
+	pthread_cond_signal(&c->writable);
+	pthread_mutex_unlock(&lb_lock);
+
+	return size;
+}
+
+int ioctl(int fd, unsigned long request, ...)
+{
+	struct loopback_channel *c;
+	void *arg;
+	va_list ap;
+
+	pthread_once(&lb_once, lb_init);
+
+	va_start(ap, request);
+	arg = va_arg(ap, void *);
+	va_end(ap);
+
+	pthread_mutex_lock(&lb_lock);
+	c = lb_lookup(fd);
+	if (c == NULL) {
+		pthread_mutex_unlock(&lb_lock);
+		return real_ioctl(fd, request, arg);
+	}
+
+	if (request == LOOPBACK_IOC_FRAME_SIZE && lb_frame_max != 0) {
+		/* accept the requested size up to the maximum */
+		uint32_t *size = arg;
+
+		if (*size > lb_frame_max)
+			*size = lb_frame_max;
+		if (*size < ICCOM_BUF_MAX_SIZE)
+			*size = ICCOM_BUF_MAX_SIZE;
+		if (c->count != 0 || lb_set_frame_size(c, *size) != 0) {
+			pthread_mutex_unlock(&lb_lock);
+			errno = EBUSY;
+			return -1;
+		}
+		pthread_mutex_unlock(&lb_lock);
+		return 0;
+	}
+
+	if (request != LOOPBACK_IOC_CANCEL) {
+		pthread_mutex_unlock(&lb_lock);
+		errno = ENOTTY;
+		return -1;
+	}
+
+	c->cancel = 1;
+	pthread_cond_broadcast(&c->readable);
+	pthread_mutex_unlock(&lb_lock);
+
+	return 0;
+}
+
+int loopback_set_link(const char *path, int up)
+{
+	int i, ret = -1;
+
+	pthread_once(&lb_once, lb_init);
+
+	pthread_mutex_lock(&lb_lock);
+	for (i = 0; i < LOOPBACK_CHANNELS; i++) {
+		if (lb_ch[i].fd >= 0 && strcmp(lb_ch[i].path, path) == 0) {
+			lb_ch[i].link_down = !up;
+			ret = 0;
+		}
+	}
+	pthread_mutex_unlock(&lb_lock);
+
+	return ret;
+}
+
+int loopback_drop(const char *path, unsigned int n)
+{
+	int i, ret = -1;
+
+	pthread_once(&lb_once, lb_init);
+
+	pthread_mutex_lock(&lb_lock);
+	for (i = 0; i < LOOPBACK_CHANNELS; i++) {
+		if (lb_ch[i].fd >= 0 && strcmp(lb_ch[i].path, path) == 0) {
+			lb_ch[i].drop = n;
+			ret = 0;
+		}
+	}
+	pthread_mutex_unlock(&lb_lock);
+
+	return ret;
+}
+
+int loopback_corrupt(const char *path, unsigned int n)
+{
+	int i, ret = -1;
+
+	pthread_once(&lb_once, lb_init);
+
+	pthread_mutex_lock(&lb_lock);
+	for (i = 0; i < LOOPBACK_CHANNELS; i++) {
+		if (lb_ch[i].fd >= 0 && strcmp(lb_ch[i].path, path) == 0) {
+			lb_ch[i].corrupt = n;
+			ret = 0;
+		}
+	}
+	pthread_mutex_unlock(&lb_lock);
+
+	return ret;
+}
+
+int loopback_echo(const char *path, loopback_echo_fn fn, void *arg)
+{
+	int i, ret = -1;
+
+	pthread_once(&lb_once, lb_init);
+
+	pthread_mutex_lock(&lb_lock);
+	for (i = 0; i < LOOPBACK_CHANNELS; i++) {
+		if (lb_ch[i].fd >= 0 && strcmp(lb_ch[i].path, path) == 0) {
+			lb_ch[i].echo = fn;
+			lb_ch[i].echo_arg = arg;
+			ret = 0;
+		}
+	}
+	pthread_mutex_unlock(&lb_lock);
+
+	return ret;
+}
+
+int close(int fd)
+{
+	struct loopback_channel *c;
+
+	pthread_once(&lb_once, lb_init);
+
+	pthread_mutex_lock(&lb_lock);
+	c = lb_lookup(fd);
+	if (c != NULL) {
+		c->fd = -1;
+		c->count = 0;
+		pthread_cond_broadcast(&c->writable);
+	}
+	pthread_mutex_unlock(&lb_lock);
+
+	return real_close(fd);
+}
@@ -0,0 +1,362 @@
+/*
+ * iccom-top : live view of the ICCOM channels of all processes.
+ *
+ * Reads the metrics pages (/dev/shm/iccom-metrics.<pid>) which the library
+ * publishes when a process calls Iccom_lib_MetricsStart() or runs with
+ * ICCOM_METRICS=<interval ms>, and prints one line per open channel:
+ *   TX/s RX/s     : frames per second sent / received
+ *   TXKB/s RXKB/s : frame kilobytes per second sent / received
+ *   ERR/s         : Iccom_lib_Send and receive errors per second
+ *   INFL          : Iccom_lib_Send calls in progress
+ *   SPILL CONFL   : spill queue messages / conflation queue topics
+ *   P50 P99 MAX   : frame write time percentiles of the interval (us,
+ *                   upper bound of the histogram bucket)
+ *   LAST          : last error (S: send, R: receive)
+ *
+ * The pages are read without any lock of the library: each channel slot
+ * is copied again while its sequence number is odd or changes during the
+ * copy.  Pages of processes which did not exit normally are skipped, and
+ * removed with -c.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <signal.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <iccom.h>
+
+#define SHM_DIR		"/dev/shm"
+#define MAX_PAGES	64
+#define MAX_ROWS	1024
+#define READ_RETRY	1000
+
+struct top_page {
+	char shm_name[64];
+	const Iccom_metrics_page *page;
+};
+
+struct top_row {
+	uint32_t pid;
+	char name[ICCOM_METRICS_NAME_LEN];
+	Iccom_metrics_channel ch;
+};
+
+static struct top_page pages[MAX_PAGES];
+static unsigned int npages;
+static struct top_row prev[MAX_ROWS], cur[MAX_ROWS];
+static unsigned int nprev, ncur;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void unmap_pages(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < npages; i++)
+		munmap((void *)pages[i].page, sizeof(Iccom_metrics_page));
+	npages = 0;
+}
+
+/* map the pages of running processes (stale pages removed with clean) */
+static void map_pages(int clean)
+{
+	const char *prefix = ICCOM_METRICS_SHM_PREFIX + 1;
+	const Iccom_metrics_page *page;
+	struct dirent *de;
+	char name[64];
+	long pid;
+	void *map;
+	DIR *dir;
+	int fd;
+
+	unmap_pages();
+
+	dir = opendir(SHM_DIR);
+	if (dir == NULL)
+		return;
+
+	while ((de = readdir(dir)) != NULL && npages < MAX_PAGES) {
+		if (strncmp(de->d_name, prefix, strlen(prefix)) != 0)
+			continue;
+		pid = strtol(de->d_name + strlen(prefix), NULL, 10);
+		if (snprintf(name, sizeof(name), "/%s", de->d_name) >=
+		    (int)sizeof(name))
+			continue;
+		if (pid <= 0 || (kill((pid_t)pid, 0) != 0 && errno == ESRCH)) {
+			if (clean)
+				shm_unlink(name);
+			continue;
+		}
+
+		fd = shm_open(name, O_RDONLY, 0);
+		if (fd < 0)
+			continue;
+		map = mmap(NULL, sizeof(*page), PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+		if (map == MAP_FAILED)
+			continue;
+
+		/* the page may still be being created, or of other version */
+		page = map;
+		if (__atomic_load_n(&page->magic, __ATOMIC_ACQUIRE) !=
+		    ICCOM_METRICS_MAGIC ||
+		    page->version != ICCOM_METRICS_VERSION ||
+		    page->slot_max != ICCOM_METRICS_SLOT_MAX) {
+			munmap(map, sizeof(*page));
+			continue;
+		}
+		strcpy(pages[npages].shm_name, name);
+		pages[npages].page = page;
+		npages++;
+	}
+	closedir(dir);
+}
+
+/* consistent copy of one slot (seqlock read side) */
+static int read_slot(const Iccom_metrics_channel *slot,
+		     Iccom_metrics_channel *out)
+{
+	uint32_t seq1, seq2;
+	int i;
+
+	for (i = 0; i < READ_RETRY; i++) {
+		seq1 = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+		if (seq1 & 1) {
+			sched_yield();
+			continue;
+		}
+		memcpy(out, slot, sizeof(*out));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		seq2 = __atomic_load_n(&slot->seq, __ATOMIC_RELAXED);
+		if (seq1 == seq2)
+			return 0;
+	}
+	return -1;
+}
+
+static void collect(void)
+{
+	const Iccom_metrics_page *page;
+	struct top_row *row;
+	uint32_t count, s;
+	unsigned int i;
+
+	ncur = 0;
+	for (i = 0; i < npages; i++) {
+		page = pages[i].page;
+		count = __atomic_load_n(&page->slot_count, __ATOMIC_ACQUIRE);
+		if (count > ICCOM_METRICS_SLOT_MAX)
+			count = ICCOM_METRICS_SLOT_MAX;
+		for (s = 0; s < count && ncur < MAX_ROWS; s++) {
+			row = &cur[ncur];
+			if (read_slot(&page->slot[s], &row->ch) != 0 ||
+			    !row->ch.in_use)
+				continue;
+			row->pid = page->pid;
+			memcpy(row->name, page->name, sizeof(row->name));
+			row->name[ICCOM_METRICS_NAME_LEN - 1] = '\0';
+			row->ch.dev_name[ICCOM_METRICS_NAME_LEN - 1] = '\0';
+			ncur++;
+		}
+	}
+}
+
+static const struct top_row *find_prev(const struct top_row *row)
+{
+	unsigned int i;
+
+	for (i = 0; i < nprev; i++)
+		if (prev[i].pid == row->pid &&
+		    strcmp(prev[i].ch.dev_name, row->ch.dev_name) == 0)
+			return &prev[i];
+	return NULL;
+}
+
+/* counter difference (reopened channel : counted from zero) */
+static uint64_t diff(uint64_t now, uint64_t before)
+{
+	return now >= before ? now - before : now;
+}
+
+/* write time percentile of the interval (us), -1 : no frame written */
+static double latency_pct(const uint64_t *hist, double p)
+{
+	uint64_t total = 0, sum = 0, target;
+	unsigned int i;
+
+	for (i = 0; i < ICCOM_METRICS_HIST_SIZE; i++)
+		total += hist[i];
+	if (total == 0)
+		return -1.0;
+
+	target = (uint64_t)(p * total);
+	if (target >= total)
+		target = total - 1;
+	for (i = 0; i < ICCOM_METRICS_HIST_SIZE; i++) {
+		sum += hist[i];
+		if (sum > target)
+			break;
+	}
+	/* upper bound of bucket i : 2^(i+1) ns */
+	return (double)(2ULL << i) / 1000.0;
+}
+
+static void print_latency(double us)
+{
+	if (us < 0.0)
+		printf(" %7s", "-");
+	else
+		printf(" %7.1f", us);
+}
+
+static void print_rows(double sec)
+{
+	const struct top_row *row, *before;
+	Iccom_metrics_channel d;
+	uint64_t err;
+	unsigned int i, j;
+	char last[16];
+
+	printf("%6s %-12s %-16s %8s %8s %8s %8s %6s %4s %6s %5s"
+	       " %7s %7s %7s %5s\n",
+	       "PID", "COMMAND", "DEVICE", "TX/s", "TXKB/s", "RX/s", "RXKB/s",
+	       "ERR/s", "INFL", "SPILL", "CONFL", "P50us", "P99us", "MAXus",
+	       "LAST");
+
+	for (i = 0; i < ncur; i++) {
+		row = &cur[i];
+		before = find_prev(row);
+		memset(&d, 0, sizeof(d));
+		if (before != NULL) {
+			d.send_count = diff(row->ch.send_count,
+					    before->ch.send_count);
+			d.send_bytes = diff(row->ch.send_bytes,
+					    before->ch.send_bytes);
+			d.recv_count = diff(row->ch.recv_count,
+					    before->ch.recv_count);
+			d.recv_bytes = diff(row->ch.recv_bytes,
+					    before->ch.recv_bytes);
+			d.send_error_count = diff(row->ch.send_error_count,
+					before->ch.send_error_count);
+			d.recv_error_count = diff(row->ch.recv_error_count,
+					before->ch.recv_error_count);
+			for (j = 0; j < ICCOM_METRICS_HIST_SIZE; j++)
+				d.send_latency[j] =
+					diff(row->ch.send_latency[j],
+					     before->ch.send_latency[j]);
+		}
+		err = d.send_error_count + d.recv_error_count;
+
+		if (row->ch.last_recv_error != 0)
+			snprintf(last, sizeof(last), "R%d",
+				 row->ch.last_recv_error);
+		else if (row->ch.last_send_error != 0)
+			snprintf(last, sizeof(last), "S%d",
+				 row->ch.last_send_error);
+		else
+			strcpy(last, "-");
+
+		printf("%6u %-12.12s %-16.16s %8.0f %8.1f %8.0f %8.1f %6.0f"
+		       " %4u %6llu %5llu",
+		       row->pid, row->name, row->ch.dev_name,
+		       d.send_count / sec, d.send_bytes / sec / 1024.0,
+		       d.recv_count / sec, d.recv_bytes / sec / 1024.0,
+		       err / sec, row->ch.in_flight,
+		       (unsigned long long)row->ch.spill_depth,
+		       (unsigned long long)row->ch.conflate_depth);
+		print_latency(latency_pct(d.send_latency, 0.50));
+		print_latency(latency_pct(d.send_latency, 0.99));
+		print_latency(latency_pct(d.send_latency, 1.0));
+		printf(" %5s\n", last);
+	}
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-d seconds] [-n count] [-b] [-c]\n"
+		"  -d  refresh interval (default 1)\n"
+		"  -n  number of refreshes (default: until interrupted)\n"
+		"  -b  batch mode (no screen clear)\n"
+		"  -c  remove pages of processes which have exited\n",
+		prog);
+}
+
+int main(int argc, char *argv[])
+{
+	struct timespec ts;
+	double delay = 1.0, sec;
+	long count = -1, n;
+	uint64_t t0, t1;
+	int batch = 0, clean = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "d:n:bch")) != -1) {
+		switch (opt) {
+		case 'd':
+			delay = strtod(optarg, NULL);
+			break;
+		case 'n':
+			count = strtol(optarg, NULL, 10);
+			break;
+		case 'b':
+			batch = 1;
+			break;
+		case 'c':
+			clean = 1;
+			break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+	if (delay < 0.1)
+		delay = 0.1;
+
+	ts.tv_sec = (time_t)delay;
+	ts.tv_nsec = (long)((delay - ts.tv_sec) * 1e9);
+
+	/* first sample : rates need two of them */
+	map_pages(clean);
+	collect();
+	t0 = now_ns();
+
+	for (n = 0; count < 0 || n < count; n++) {
+		memcpy(prev, cur, sizeof(cur[0]) * ncur);
+		nprev = ncur;
+		nanosleep(&ts, NULL);
+
+		/* processes may have started or exited meanwhile */
+		map_pages(clean);
+		collect();
+		t1 = now_ns();
+		sec = (t1 - t0) / 1e9;
+		t0 = t1;
+
+		if (!batch)
+			printf("\033[H\033[J");
+		printf("iccom-top - %u process(es), %u channel(s),"
+		       " interval %.1f s\n\n", npages, ncur, sec);
+		print_rows(sec);
+		if (batch)
+			printf("\n");
+		fflush(stdout);
+	}
+
+	unmap_pages();
+	return 0;
+}